@@ -1,5 +1,6 @@
 #include <caf/all.hpp>
 #include "vast.h"
+#include "vast/bitstream.h"
 
 int main(int argc, char *argv[])
 {
@@ -56,6 +57,13 @@ int main(int argc, char *argv[])
                    (throughput == std::numeric_limits<size_t>::max()
                     ? "unlimited" : std::to_string(throughput)));
 
+  if (auto t = cfg->as<size_t>("index.parallel-threshold"))
+  {
+    vast::ewah_bitstream::parallelize(*t, threads);
+    VAST_LOG_VERBOSE("set parallel bitwise operation threshold to " << *t <<
+                     " blocks");
+  }
+
   auto program = caf::spawn<vast::program>(std::move(*cfg));
   caf::anon_send(program, caf::atom("run"));
   caf::await_all_actors_done();
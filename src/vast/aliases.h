@@ -4,6 +4,7 @@
 #include <cstdint>
 #include <limits>
 #include <memory>
+#include "vast/config.h"
 
 namespace vast {
 
@@ -13,8 +14,13 @@ using integer = int64_t;
 using count = uint64_t;
 using real = double;
 
+#ifdef VAST_USE_ROARING_BITSTREAM
+class roaring_bitstream;
+using default_bitstream = roaring_bitstream;
+#else
 class ewah_bitstream;
 using default_bitstream = ewah_bitstream;
+#endif
 
 /// Uniquely identifies a VAST event.
 using event_id = uint64_t;
@@ -1,12 +1,17 @@
 #ifndef VAST_BITMAP_H
 #define VAST_BITMAP_H
 
+#include <algorithm>
+#include <deque>
 #include <list>
 #include <stdexcept>
 #include <unordered_map>
 #include "vast/bitstream.h"
+#include "vast/none.h"
 #include "vast/operator.h"
 #include "vast/serialization/all.h"
+#include "vast/io/array_stream.h"
+#include "vast/io/serialization.h"
 #include "vast/util/operators.h"
 #include "vast/util/stack_vector.h"
 
@@ -48,42 +53,226 @@ template <
   typename T,
   typename = std::enable_if_t<std::is_floating_point<T>::value>
 >
-uint64_t order(T x, size_t sig_bits = 5)
+uint64_t order(T x, size_t sig_bits = 52)
 {
   static_assert(std::numeric_limits<T>::is_iec559,
                 "can only order IEEE 754 double types");
 
   assert(sig_bits >= 0 && sig_bits <= 52);
 
-  static constexpr auto exp_mask = (~0ull << 53) >> 1;
-  static constexpr auto sig_mask = ~0ull >> 12;
+  static constexpr auto sign_mask = 1ull << 63;
+
+  if (x == 0)
+    x = 0; // Treat -0 and +0 alike.
 
   auto p = reinterpret_cast<uint64_t*>(&x);
-  bool positive = ~*p & (1ull << 63);
-  auto exp = (*p & exp_mask) >> 52;
-  auto sig = *p & sig_mask;
 
-  // If the value is positive we add a 1 as MSB left of the exponent and if
-  // the value is negative, we make the MSB 0. If the value is negative we
-  // also have to reverse the exponent to ensure that, e.g., -1 is considered
-  // *smaller* than -0.1, although the exponent of -1 is *larger* than -0.1.
-  // Because the exponent already has a offset-binary encoding, this merely
-  // involves subtracting it from 2^11-1.
-  auto result = positive ? exp | (1ull << 12) : (exp_mask >> 52) - exp;
+  // If the value is positive we set the sign bit, which makes all positive
+  // values larger than all negative ones. Exponent and significand already
+  // have an offset-binary encoding, so positive values order correctly as
+  // is. If the value is negative we flip all bits, because, e.g., -1 must be
+  // *smaller* than -0.1, although its exponent is *larger*. With all 52 bits
+  // of the significand, the mapping is lossless.
+  auto result = *p & sign_mask ? ~*p : *p | sign_mask;
+
+  // Finally, we cut off the undesired bits of the significand.
+  return result >> (52 - sig_bits);
+}
+
+/// Collects the operands of an n-ary bitwise operation while decoding. An
+/// operand either refers to a bitstream of the coder or is an intermediate
+/// result, which the list owns. When coders operate on read-only bitstream
+/// views, the list refers to intermediate results through views as well, so
+/// that all operands have the same type.
+template <typename Bitstream>
+class operand_list
+{
+public:
+  using result_type = owning_bitstream_t<Bitstream>;
 
-  // Next, we add the desired bits of the significand. Because the
-  // significand is always great or equal to 0, we can use the same
-  // subtraction method for negative values as for the offset-binary encoded
-  // exponent.
-  if (sig_bits > 0)
+  /// Adds a bitstream which outlives the list.
+  /// @param x The bitstream to add.
+  void add(Bitstream const& x)
   {
-    result <<= sig_bits;
-    result |= (positive ? sig : sig_mask - sig) >> (52 - sig_bits);
+    xs_.push_back(&x);
   }
 
-  return result;
+  /// Adds an intermediate result.
+  /// @param x The result to add.
+  void add(result_type&& x)
+  {
+    results_.push_back(std::move(x));
+    refer(std::is_same<Bitstream, result_type>{});
+  }
+
+  /// Computes the conjunction of all operands.
+  /// @returns The result of ::and_all over the operands.
+  result_type conjunction() const
+  {
+    return and_all(xs_.begin(), xs_.end());
+  }
+
+private:
+  void refer(std::true_type)
+  {
+    xs_.push_back(&results_.back());
+  }
+
+  void refer(std::false_type)
+  {
+    views_.emplace_back(results_.back());
+    xs_.push_back(&views_.back());
+  }
+
+  std::vector<Bitstream const*> xs_;
+  std::deque<result_type> results_;
+  std::deque<Bitstream> views_;
+};
+
+// Combine a decoding result with a bitstream of a coder. For read-only views,
+// the compound assignment operators do not apply.
+template <typename Bitstream>
+void assign_and(Bitstream& result, Bitstream const& x)
+{
+  result &= x;
+}
+
+template <typename Bitstream, typename View>
+void assign_and(Bitstream& result, View const& x)
+{
+  result = and_(result, x);
+}
+
+template <typename Bitstream>
+void assign_or(Bitstream& result, Bitstream const& x)
+{
+  result |= x;
+}
+
+template <typename Bitstream, typename View>
+void assign_or(Bitstream& result, View const& x)
+{
+  result = or_(result, x);
 }
 
+/// A bitstream of a coder which stays in serialized form until first used.
+/// Deserialization only records where the bytes of the bitstream are: with a
+/// deserializer that supports zero-copy access, such as one over a
+/// memory-mapped file, the bytes remain in the mapping, otherwise the
+/// bitstream keeps a copy. Decoding happens on first access, so that a lookup
+/// decodes only the bitstreams it touches.
+template <typename Bitstream>
+class lazy_bitstream : util::equality_comparable<lazy_bitstream<Bitstream>>
+{
+public:
+  lazy_bitstream() = default;
+
+  lazy_bitstream(Bitstream bs)
+    : bitstream_{std::move(bs)}
+  {
+  }
+
+  /// Retrieves the bitstream, decoding it if necessary.
+  /// @returns The decoded bitstream.
+  Bitstream const& get() const
+  {
+    decode();
+    return bitstream_;
+  }
+
+  /// Retrieves the bitstream for modification, after which the serialized
+  /// form no longer applies.
+  /// @returns The decoded bitstream.
+  Bitstream& get()
+  {
+    decode();
+    if (data_ != nullptr
+        && std::is_same<Bitstream, owning_bitstream_t<Bitstream>>::value)
+    {
+      data_ = nullptr;
+      size_ = 0;
+      storage_.reset();
+    }
+
+    return bitstream_;
+  }
+
+  /// Checks whether the bitstream still awaits decoding.
+  /// @returns `true` if the bitstream exists only in serialized form.
+  bool encoded() const
+  {
+    return ! decoded_;
+  }
+
+private:
+  void decode() const
+  {
+    if (decoded_)
+      return;
+
+    // A bitstream view may point into the serialized bytes, which outlive it.
+    io::array_input_stream source{data_, size_};
+    binary_deserializer d{source, true};
+    d >> bitstream_;
+    decoded_ = true;
+  }
+
+  mutable Bitstream bitstream_;
+  mutable bool decoded_ = true;
+  void const* data_ = nullptr;
+  size_t size_ = 0;
+  std::shared_ptr<std::vector<uint8_t>> storage_;
+
+private:
+  friend access;
+
+  void serialize(serializer& sink) const
+  {
+    // Unmodified bitstreams go out as they came in.
+    if (data_ != nullptr)
+    {
+      sink.begin_sequence(size_);
+      sink.write_raw(data_, size_);
+      sink.end_sequence();
+    }
+    else
+    {
+      std::vector<uint8_t> buf;
+      io::archive(buf, bitstream_);
+      sink << buf;
+    }
+  }
+
+  void deserialize(deserializer& source)
+  {
+    uint64_t n;
+    source.begin_sequence(n);
+    void const* data;
+    if (n > 0 && source.read_view(&data, n))
+    {
+      data_ = data;
+      storage_.reset();
+    }
+    else
+    {
+      storage_ = std::make_shared<std::vector<uint8_t>>(n);
+      if (n > 0)
+        source.read_raw(storage_->data(), n);
+      data_ = storage_->data();
+    }
+
+    source.end_sequence();
+    size_ = n;
+    bitstream_ = Bitstream{};
+    decoded_ = false;
+  }
+
+  friend bool operator==(lazy_bitstream const& x, lazy_bitstream const& y)
+  {
+    return x.get() == y.get();
+  }
+};
+
 } // namespace detail
 
 /// The base class for bitmap coders.
@@ -178,6 +367,17 @@ class equality_coder
   using super = coder<equality_coder<T, Bitstream>>;
   friend super;
 
+public:
+  /// Retrieves the bitstream of a given value. The bitstream may be shorter
+  /// than the coder, in which case the missing rows are 0.
+  /// @param x The value.
+  /// @returns The bitstream of *x* or `nullptr` if *x* does not occur.
+  Bitstream const* find(T x) const
+  {
+    auto i = bitstreams_.find(x);
+    return i == bitstreams_.end() ? nullptr : &i->second.get();
+  }
+
 private:
   uint64_t cardinality_impl() const
   {
@@ -188,7 +388,7 @@ private:
   {
     if (bit)
       for (auto& p : bitstreams_)
-        if (! p.second.append(n, bit))
+        if (! p.second.get().append(n, bit))
           return false;
 
     return true;
@@ -199,7 +399,7 @@ private:
     auto i = bitstreams_.find(x);
     if (i != bitstreams_.end())
     {
-      auto& bs = i->second;
+      auto& bs = i->second.get();
       bs.append(this->size() - bs.size(), false);
       return bs.push_back(true);
     }
@@ -211,16 +411,19 @@ private:
     }
   }
 
-  trial<Bitstream> decode_impl(T x, relational_operator op) const
+  trial<owning_bitstream_t<Bitstream>>
+  decode_impl(T x, relational_operator op) const
   {
+    using result_type = owning_bitstream_t<Bitstream>;
+
     if (! (op == equal || op == not_equal))
       return error{"unsupported relational operator:", op};
 
     auto i = bitstreams_.find(x);
-    if (i == bitstreams_.end() || i->second.empty())
-      return Bitstream{this->size(), op == not_equal};
+    if (i == bitstreams_.end() || i->second.get().empty())
+      return result_type{this->size(), op == not_equal};
 
-    auto result = i->second;
+    result_type result{i->second.get()};
     result.append(this->size() - result.size(), false);
 
     return std::move(op == equal ? result : result.flip());
@@ -230,10 +433,10 @@ private:
   void each_impl(F f) const
   {
     for (auto& p : bitstreams_)
-      f(1, p.first, p.second);
+      f(1, p.first, p.second.get());
   }
 
-  std::unordered_map<T, Bitstream> bitstreams_;
+  std::unordered_map<T, detail::lazy_bitstream<Bitstream>> bitstreams_;
 
 private:
   friend access;
@@ -282,24 +485,34 @@ public:
   {
   }
 
+  /// Constructs a binary bit-slice coder for values of a given width.
+  /// @param width The number of bits to record per value.
+  /// @pre `width > 0 && width <= std::numeric_limits<T>::digits`
+  explicit binary_bitslice_coder(size_t width)
+    : bitstreams_(width)
+  {
+    assert(width > 0);
+    assert(width <= bits);
+  }
+
   /// Retrieves a bitstream for a given power of 2.
   /// @param mag The order of magnitude.
   /// @pre `mag < bits` where *bits* represents the number of bits in `T`.
   Bitstream const& get(size_t mag) const
   {
-    return bitstreams_[mag];
+    return bitstreams_[mag].get();
   }
 
 private:
   uint64_t cardinality_impl() const
   {
-    return bits;
+    return bitstreams_.size();
   }
 
   bool append_impl(size_t n, bool bit)
   {
     for (auto& bs : bitstreams_)
-      if (! bs.append(n, bit))
+      if (! bs.get().append(n, bit))
         return false;
 
     return true;
@@ -308,24 +521,87 @@ private:
   bool encode_impl(T x)
   {
     for (size_t i = 0; i < bitstreams_.size(); ++i)
-      bitstreams_[i].push_back((x >> i) & 1);
+      bitstreams_[i].get().push_back((x >> i) & 1);
 
     return true;
   }
 
-  trial<Bitstream> decode_impl(T x, relational_operator op) const
+  trial<owning_bitstream_t<Bitstream>>
+  decode_impl(T x, relational_operator op) const
   {
+    using result_type = owning_bitstream_t<Bitstream>;
+
+    // Values exceeding the coder width compare greater than all rows.
+    auto width = bitstreams_.size();
+    if (width < bits && (x >> width) != 0)
+      switch (op)
+      {
+        default:
+          return error{"unsupported relational operator: ", op};
+        case equal:
+        case greater:
+        case greater_equal:
+          return result_type{this->size(), false};
+        case not_equal:
+        case less:
+        case less_equal:
+          return result_type{this->size(), true};
+      }
+
     switch (op)
     {
       default:
         return error{"unsupported relational operator: ", op};
+      case less:
+      case less_equal:
+      case greater:
+      case greater_equal:
+        {
+          if (std::is_signed<T>::value)
+            return error{"unsupported relational operator: ", op};
+
+          // Scans the slices from the most significant bit downwards, as
+          // described by O'Neil and Quass in "Improved Query Performance
+          // with Variant Indexes".
+          result_type lt{this->size(), false};
+          result_type gt{this->size(), false};
+          result_type eq{this->size(), true};
+          size_t i = width;
+          while (i --> 0)
+          {
+            result_type slice{bitstreams_[i].get()};
+            if ((x >> i) & 1)
+            {
+              lt |= eq & ~slice;
+              eq &= slice;
+            }
+            else
+            {
+              gt |= eq & slice;
+              eq &= ~slice;
+            }
+          }
+
+          if (op == less)
+            return std::move(lt);
+          else if (op == less_equal)
+            return std::move(lt | eq);
+          else if (op == greater)
+            return std::move(gt);
+          else
+            return std::move(gt | eq);
+        }
       case equal:
       case not_equal:
         {
-          Bitstream r{this->size(), true};
+          detail::operand_list<Bitstream> operands;
           for (size_t i = 0; i < bitstreams_.size(); ++i)
-            r &= ((x >> i) & 1) ? bitstreams_[i] : ~bitstreams_[i];
+            if ((x >> i) & 1)
+              operands.add(bitstreams_[i].get());
+            else
+              operands.add(~bitstreams_[i].get());
 
+          auto r = operands.conjunction();
           return {std::move(op == equal ? r : r.flip())};
         }
     }
@@ -335,10 +611,10 @@ private:
   void each_impl(F f) const
   {
     for (size_t i = 0; i < bitstreams_.size(); ++i)
-      f(1, i, bitstreams_[i]);
+      f(1, i, bitstreams_[i].get());
   }
 
-  std::vector<Bitstream> bitstreams_;
+  std::vector<detail::lazy_bitstream<Bitstream>> bitstreams_;
 
 private:
   friend access;
@@ -412,6 +688,13 @@ public:
     initialize();
   }
 
+  /// Retrieves the base of the coder.
+  /// @returns The sequence of bases, starting with the least significant
+  ///          component.
+  value_list const& base() const
+  {
+    return base_;
+  }
 
 protected:
   /// Decomposes a value into vector of values according to the given base.
@@ -470,7 +753,8 @@ private:
     return static_cast<Derived*>(this)->encode_value(x);
   }
 
-  trial<Bitstream> decode_impl(T x, relational_operator op) const
+  trial<owning_bitstream_t<Bitstream>>
+  decode_impl(T x, relational_operator op) const
   {
     return static_cast<Derived const*>(this)->decode_value(x, op);
   }
@@ -541,7 +825,7 @@ private:
       {
         auto idx = base_[i] == 2 ? 0 : v_[i];
         auto& bs = bitstreams_[i][idx];
-        bs.append(this->size() - bs->size(), false);
+        bs.append(this->size() - bs.size(), false);
         if (! bs.push_back(true))
           return false;
       }
@@ -549,20 +833,27 @@ private:
     return true;
   }
 
-  trial<Bitstream> decode_value(T x, relational_operator op) const
+  trial<owning_bitstream_t<Bitstream>>
+  decode_value(T x, relational_operator op) const
   {
+    using result_type = owning_bitstream_t<Bitstream>;
+
     this->decompose(x);
 
-    Bitstream r{this->size(), true};
+    // The all-ones bitstream ensures that the result spans the entire coder.
+    detail::operand_list<Bitstream> operands;
+    operands.add(result_type{this->size(), true});
     for (size_t i = 0; i < v_.size(); ++i)
     {
       auto idx = v_[i];
       if (base_[i] == 2 && idx != 0)
         --idx;
 
-      r &= bitstreams_[i][idx];
+      operands.add(bitstreams_[i][idx]);
     }
 
+    auto r = operands.conjunction();
+
     switch (op)
     {
       default:
@@ -594,14 +885,32 @@ class range_bitslice_coder
   using super::bitstreams_;
 
 public:
+  using value_list = typename super::value_list;
+
   range_bitslice_coder()
     : super{10, std::numeric_limits<T>::digits10 + 1}
+  {
+    trim();
+  }
+
+  /// Constructs a range bit-slice coder with a given base.
+  /// @param base The sequence of bases.
+  /// @pre `! base.empty()` and `b >= 2` for all *b* in *base*.
+  explicit range_bitslice_coder(value_list base)
+    : super{std::move(base)}
+  {
+    trim();
+  }
+
+private:
+  // Range encoding needs only b-1 bitstreams for a component with base b,
+  // because the bitstream for b-1 would consist of 1s only.
+  void trim()
   {
     for (auto& component : bitstreams_)
       component.resize(component.size() - 1);
   }
 
-private:
   bool encode_value(T x)
   {
     this->decompose(x);
@@ -618,21 +927,24 @@ private:
   //
   // @todo Add some optimizations from Ming-Chuan Wu to reduce the number of
   // bitstream scans (and bitwise operations).
-  trial<Bitstream> decode_value(T x, relational_operator op) const
+  trial<owning_bitstream_t<Bitstream>>
+  decode_value(T x, relational_operator op) const
   {
+    using result_type = owning_bitstream_t<Bitstream>;
+
     if (x == std::numeric_limits<T>::min())
     {
       if (op == less)  // A < min => false
-        return Bitstream{this->size(), false};
+        return result_type{this->size(), false};
       else if (op == greater_equal) // A >= min => true
-        return Bitstream{this->size(), true};
+        return result_type{this->size(), true};
     }
     else if (op == less || op == greater_equal)
     {
       --x;
     }
 
-    Bitstream result{this->size(), true};
+    result_type result{this->size(), true};
 
     this->decompose(x);
 
@@ -646,30 +958,35 @@ private:
       case greater_equal:
         {
           if (v_[0] < base_[0] - 1) // && bitstream != all_ones
-            result = bitstreams_[0][v_[0]];
+            result = result_type{bitstreams_[0][v_[0]]};
 
           for (size_t i = 1; i < v_.size(); ++i)
           {
             if (v_[i] != base_[i] - 1) // && bitstream != all_ones
-              result &= bitstreams_[i][v_[i]];
+              detail::assign_and(result, bitstreams_[i][v_[i]]);
 
             if (v_[i] != 0) // && bitstream != all_ones
-              result |= bitstreams_[i][v_[i] - 1];
+              detail::assign_or(result, bitstreams_[i][v_[i] - 1]);
           }
         }
         break;
       case equal:
       case not_equal:
         {
+          detail::operand_list<Bitstream> operands;
+          operands.add(std::move(result));
           for (size_t i = 0; i < v_.size(); ++i)
           {
+            auto& bs = bitstreams_[i];
             if (v_[i] == 0) // && bitstream != all_ones
-              result &= bitstreams_[i][0];
+              operands.add(bs[0]);
             else if (v_[i] == base_[i] - 1)
-              result &= ~bitstreams_[i][base_[i] - 2];
+              operands.add(~bs[base_[i] - 2]);
             else
-              result &= bitstreams_[i][v_[i]] ^ bitstreams_[i][v_[i] - 1];
+              operands.add(bs[v_[i]] ^ bs[v_[i] - 1]);
           }
+
+          result = operands.conjunction();
         }
         break;
     }
@@ -681,6 +998,758 @@ private:
   }
 };
 
+/// An interval bit-slice coder. For a component with base *b*, it uses
+/// *floor(b/2)+1* bitstreams, roughly half as many as range encoding. With
+/// *m = ceil(b/2)*, bitstream *j* has a 1 for all values in the interval
+/// *[j, j+m-1]*. Equality and range predicates on a component then take at
+/// most one bitwise operation on two bitstreams. The scheme is due to
+/// Chee-Yong Chan and Yannis E. Ioannidis.
+template <typename T, typename Bitstream>
+class interval_bitslice_coder
+  : public bitslice_coder<
+      interval_bitslice_coder<T, Bitstream>, T, Bitstream
+    >
+{
+  using super = bitslice_coder<
+      interval_bitslice_coder<T, Bitstream>, T, Bitstream
+    >;
+
+  friend super;
+  using super::v_;
+  using super::base_;
+  using super::bitstreams_;
+
+  using offset_binary_type = typename super::offset_binary_type;
+  using result_type = owning_bitstream_t<Bitstream>;
+
+public:
+  using value_list = typename super::value_list;
+
+  interval_bitslice_coder()
+    : super{10, std::numeric_limits<T>::digits10 + 1}
+  {
+    trim();
+  }
+
+  /// Constructs an interval bit-slice coder with a given base.
+  /// @param base The sequence of bases.
+  /// @pre `! base.empty()` and `b >= 2` for all *b* in *base*.
+  explicit interval_bitslice_coder(value_list base)
+    : super{std::move(base)}
+  {
+    trim();
+  }
+
+private:
+  void trim()
+  {
+    for (size_t i = 0; i < bitstreams_.size(); ++i)
+      bitstreams_[i].resize(base_[i] / 2 + 1);
+  }
+
+  bool encode_value(T x)
+  {
+    this->decompose(x);
+
+    for (size_t i = 0; i < bitstreams_.size(); ++i)
+    {
+      auto v = static_cast<size_t>(v_[i]);
+      auto m = static_cast<size_t>((base_[i] + 1) / 2);
+      for (size_t j = 0; j < bitstreams_[i].size(); ++j)
+        if (! bitstreams_[i][j].push_back(v >= j && v - j < m))
+          return false;
+    }
+
+    return true;
+  }
+
+  // Computes the rows whose value in component i equals x.
+  result_type component_equal(size_t i, offset_binary_type x) const
+  {
+    auto& bs = bitstreams_[i];
+    auto b = base_[i];
+    auto m = (b + 1) / 2;
+    if (x + m < b)
+      return result_type{bs[x]} & ~bs[x + 1];
+    else if (x >= m)
+      return result_type{bs[x - m + 1]} & ~bs[x - m];
+
+    result_type r{bs[0]};
+    detail::assign_and(r, bs[b - m]);
+    return r;
+  }
+
+  // Computes the rows whose value in component i is at most x.
+  result_type component_less_equal(size_t i, offset_binary_type x) const
+  {
+    auto& bs = bitstreams_[i];
+    auto b = base_[i];
+    auto m = (b + 1) / 2;
+    if (x + 1 >= b)
+      return result_type{this->size(), true};
+    else if (x + 1 < m)
+      return result_type{bs[0]} & ~bs[x + 1];
+    else if (x + 1 == m)
+      return result_type{bs[0]};
+
+    result_type r{bs[0]};
+    detail::assign_or(r, bs[x - m + 1]);
+    return r;
+  }
+
+  trial<result_type> decode_value(T x, relational_operator op) const
+  {
+    if (x == std::numeric_limits<T>::min())
+    {
+      if (op == less)  // A < min => false
+        return result_type{this->size(), false};
+      else if (op == greater_equal) // A >= min => true
+        return result_type{this->size(), true};
+    }
+    else if (op == less || op == greater_equal)
+    {
+      --x;
+    }
+
+    this->decompose(x);
+
+    result_type result;
+    switch (op)
+    {
+      default:
+        return error{"unsupported relational operator: ", op};
+      case less:
+      case less_equal:
+      case greater:
+      case greater_equal:
+        {
+          // A value is at most x if its most significant differing
+          // component is smaller, i.e., for each component from the least
+          // significant one: (A_i <= x_i AND lower) OR A_i < x_i.
+          result = component_less_equal(0, v_[0]);
+          for (size_t i = 1; i < v_.size(); ++i)
+          {
+            auto r = component_less_equal(i, v_[i]);
+            r &= result;
+            if (v_[i] > 0)
+              r |= component_less_equal(i, v_[i] - 1);
+
+            result = std::move(r);
+          }
+        }
+        break;
+      case equal:
+      case not_equal:
+        {
+          detail::operand_list<Bitstream> operands;
+          operands.add(result_type{this->size(), true});
+          for (size_t i = 0; i < v_.size(); ++i)
+            operands.add(component_equal(i, v_[i]));
+
+          result = operands.conjunction();
+        }
+        break;
+    }
+
+    if (op == greater || op == greater_equal || op == not_equal)
+      return std::move(result.flip());
+    else
+      return std::move(result);
+  }
+};
+
+/// The encodings among which an ::adaptive_coder chooses.
+enum bitmap_encoding : uint8_t
+{
+  equality_encoding,
+  range_encoding,
+  binary_encoding
+};
+
+/// A coder which selects its encoding based on the values it observes. It
+/// starts out with equality encoding and tracks cardinality and value range.
+/// Once the cardinality exceeds a threshold, it re-encodes all rows with a
+/// bit-slice coder: a binary bit-slice coder if nearly every value is
+/// distinct, and a range bit-slice coder with a cost-optimal base otherwise.
+/// Both bit-slice coders operate on the offset-binary representation of a
+/// value relative to the smallest value, so that they only need as many
+/// bitstreams as the value range requires. A value outside of the range
+/// triggers another re-encoding, which leaves twice the room.
+template <typename T, typename Bitstream>
+class adaptive_coder
+  : public coder<adaptive_coder<T, Bitstream>>,
+    util::equality_comparable<adaptive_coder<T, Bitstream>>
+{
+  using super = coder<adaptive_coder<T, Bitstream>>;
+  friend super;
+
+public:
+  using offset_binary_type = decltype(detail::order(T()));
+  using range_coder_type = range_bitslice_coder<offset_binary_type, Bitstream>;
+  using binary_coder_type =
+    binary_bitslice_coder<offset_binary_type, Bitstream>;
+  using value_list = typename range_coder_type::value_list;
+
+  /// The default number of distinct values up to which the coder retains
+  /// equality encoding.
+  static constexpr uint64_t default_max_cardinality = 1 << 10;
+
+  /// The largest base of a single component in a range encoding.
+  static constexpr offset_binary_type max_base = 1 << 8;
+
+  /// Constructs an adaptive coder.
+  /// @param max_cardinality The number of distinct values beyond which the
+  ///                        coder switches to a bit-slice encoding.
+  adaptive_coder(uint64_t max_cardinality = default_max_cardinality)
+    : max_cardinality_{max_cardinality},
+      range_{value_list{2}},
+      binary_{1}
+  {
+  }
+
+  /// Retrieves the current encoding.
+  /// @returns The encoding of the coder.
+  bitmap_encoding encoding() const
+  {
+    return encoding_;
+  }
+
+  /// Retrieves the base of the range encoding.
+  /// @returns The base with the least significant component first.
+  /// @pre `encoding() == range_encoding`
+  value_list const& base() const
+  {
+    return range_.base();
+  }
+
+  /// Re-evaluates the encoding for all values seen so far. Unlike the switch
+  /// during ingestion, this counts the distinct values of all rows and sizes
+  /// a bit-slice encoding for the exact value range, so it suits the point
+  /// when no more values arrive.
+  /// @returns `true` if the coder changed its encoding.
+  bool optimize()
+  {
+    if (min_ > max_)
+      return false;
+
+    if (encoding_ != equality_encoding)
+      recount();
+
+    auto e = choose();
+    auto span = max_ - min_;
+    if (e == encoding_)
+    {
+      if (e == equality_encoding)
+        return false;
+
+      if (lo_ == min_
+          && (e == range_encoding
+              ? range_.base() == optimal_base(span)
+              : binary_.cardinality() == width(span)))
+        return false;
+    }
+
+    return reencode(e, min_, span);
+  }
+
+  /// Computes a range-encoding base for the values *[0, span]* with minimal
+  /// cost. The cost of a base with *n* components is the number of
+  /// bitstreams, *sum(b_i - 1)*, plus the number of bitstream scans
+  /// RangeEval-Opt needs at most, *2n*.
+  /// @param span The largest value to represent.
+  /// @returns The base with the least significant component first.
+  static value_list optimal_base(offset_binary_type span)
+  {
+    value_list best;
+    auto best_cost = std::numeric_limits<uint64_t>::max();
+    for (size_t n = 1; n <= width(span); ++n)
+    {
+      // Finds the smallest uniform base with n components.
+      offset_binary_type lo = 2;
+      offset_binary_type hi = max_base;
+      if (! covers(value_list(n, hi), span))
+        continue;
+
+      while (lo < hi)
+      {
+        auto mid = lo + (hi - lo) / 2;
+        if (covers(value_list(n, mid), span))
+          hi = mid;
+        else
+          lo = mid + 1;
+      }
+
+      auto cost = n * (lo - 1) + 2 * n;
+      if (cost < best_cost)
+      {
+        best_cost = cost;
+        best = value_list(n, lo);
+      }
+    }
+
+    // A uniform base often covers more than necessary, in which case we
+    // shrink the most significant components.
+    for (auto i = best.size(); i --> 0; )
+      while (best[i] > 2)
+      {
+        --best[i];
+        if (! covers(best, span))
+        {
+          ++best[i];
+          break;
+        }
+      }
+
+    return best;
+  }
+
+private:
+  static bool covers(value_list const& base, offset_binary_type span)
+  {
+    offset_binary_type p = 1;
+    for (auto b : base)
+    {
+      if (p > span / b)
+        return true;
+
+      p *= b;
+    }
+
+    return p > span;
+  }
+
+  // Computes the largest value a range encoding can represent.
+  static offset_binary_type capacity(value_list const& base)
+  {
+    auto max = std::numeric_limits<offset_binary_type>::max();
+    offset_binary_type p = 1;
+    for (auto b : base)
+    {
+      if (p > max / b)
+        return max;
+
+      p *= b;
+    }
+
+    return p - 1;
+  }
+
+  static size_t width(offset_binary_type span)
+  {
+    size_t w = 1;
+    while (w < std::numeric_limits<offset_binary_type>::digits
+           && (span >> w) != 0)
+      ++w;
+
+    return w;
+  }
+
+  // Leaves room for values beyond the range observed so far.
+  static offset_binary_type widen(offset_binary_type span)
+  {
+    auto max = std::numeric_limits<offset_binary_type>::max();
+    return span > max / 2 ? max : 2 * span + 1;
+  }
+
+  // Re-encodes all rows for a widened range that extends below and above
+  // the values observed so far by the same amount. Since each re-encoding
+  // doubles the range, values arriving in ascending or descending order
+  // trigger only logarithmically many re-encodings.
+  bool regrow(bitmap_encoding e)
+  {
+    auto max = std::numeric_limits<offset_binary_type>::max();
+    auto span = widen(max_ - min_);
+    auto slack = (span - (max_ - min_)) / 2;
+    auto lo = min_ >= slack ? min_ - slack : offset_binary_type{0};
+    if (max - lo < span)
+      lo = max - span;
+
+    return reencode(e, lo, span);
+  }
+
+  static bool compare(T x, relational_operator op, T y)
+  {
+    switch (op)
+    {
+      default:
+        return false;
+      case less:
+        return x < y;
+      case less_equal:
+        return x <= y;
+      case greater:
+        return x > y;
+      case greater_equal:
+        return x >= y;
+    }
+  }
+
+  // Selects an encoding based on the statistics collected so far.
+  bitmap_encoding choose() const
+  {
+    if (distinct_ <= max_cardinality_)
+      return equality_encoding;
+
+    // If nearly every value is distinct, the bitstreams of a range encoding
+    // hardly compress and the space-optimal binary encoding wins.
+    if (distinct_ > sampled_ / 2)
+      return binary_encoding;
+
+    return range_encoding;
+  }
+
+  // Counts the values and distinct values of all rows. Only the equality
+  // encoding keeps track of them during ingestion.
+  void recount()
+  {
+    std::vector<offset_binary_type> xs;
+    std::vector<bool> present;
+    reconstruct(xs, present);
+
+    std::vector<offset_binary_type> values;
+    for (size_t i = 0; i < xs.size(); ++i)
+      if (present[i])
+        values.push_back(xs[i]);
+
+    std::sort(values.begin(), values.end());
+    sampled_ = values.size();
+    distinct_ = std::unique(values.begin(), values.end()) - values.begin();
+  }
+
+  // Recovers the offset-binary value of every row.
+  void reconstruct(std::vector<offset_binary_type>& xs,
+                   std::vector<bool>& present) const
+  {
+    switch (encoding_)
+    {
+      case equality_encoding:
+        xs.resize(equality_.size());
+        present.resize(equality_.size());
+        equality_.each(
+          [&](size_t, T x, Bitstream const& bs)
+          {
+            auto o = detail::order(x);
+            for (auto i : bs)
+            {
+              xs[i] = o;
+              present[i] = true;
+            }
+          });
+        return;
+      case range_encoding:
+        {
+          // A component with value v has its bitstreams v, v+1, ... set, so
+          // each set bit lowers the maximum value of the component by one.
+          // The arithmetic may wrap around, but the final values fit.
+          auto& base = range_.base();
+          std::vector<offset_binary_type> weights(base.size());
+          offset_binary_type max = 0;
+          offset_binary_type w = 1;
+          for (size_t i = 0; i < base.size(); ++i)
+          {
+            weights[i] = w;
+            max += (base[i] - 1) * w;
+            w *= base[i];
+          }
+
+          xs.assign(present_.size(), lo_ + max);
+          range_.each(
+            [&](size_t i, size_t, Bitstream const& bs)
+            {
+              for (auto j : bs)
+                xs[j] -= weights[i];
+            });
+        }
+        break;
+      case binary_encoding:
+        xs.assign(present_.size(), lo_);
+        binary_.each(
+          [&](size_t, size_t i, Bitstream const& bs)
+          {
+            for (auto j : bs)
+              xs[j] += offset_binary_type{1} << i;
+          });
+        break;
+    }
+
+    present.resize(present_.size());
+    for (auto i : present_)
+      present[i] = true;
+  }
+
+  // Re-encodes all rows with a bit-slice coder for the values
+  // *[lo, lo + span]*.
+  bool reencode(bitmap_encoding e, offset_binary_type lo,
+                offset_binary_type span)
+  {
+    assert(e != equality_encoding);
+
+    std::vector<offset_binary_type> xs;
+    std::vector<bool> present;
+    reconstruct(xs, present);
+
+    range_coder_type range{value_list{2}};
+    binary_coder_type binary{1};
+    offset_binary_type limit = 0;
+    if (e == range_encoding)
+    {
+      range = range_coder_type{optimal_base(span)};
+      limit = capacity(range.base());
+    }
+    else
+    {
+      auto w = width(span);
+      binary = binary_coder_type{w};
+      limit = w == std::numeric_limits<offset_binary_type>::digits
+        ? std::numeric_limits<offset_binary_type>::max()
+        : (offset_binary_type{1} << w) - 1;
+    }
+
+    owning_bitstream_t<Bitstream> p;
+    for (size_t i = 0; i < xs.size(); ++i)
+    {
+      auto success = present[i]
+        ? (e == range_encoding
+           ? range.encode(xs[i] - lo)
+           : binary.encode(xs[i] - lo))
+        : (e == range_encoding
+           ? range.append(1, false)
+           : binary.append(1, false));
+
+      if (! success || ! p.push_back(present[i]))
+        return false;
+    }
+
+    encoding_ = e;
+    lo_ = lo;
+    limit_ = limit;
+    present_ = std::move(p);
+    equality_ = {};
+    range_ = std::move(range);
+    binary_ = std::move(binary);
+    return true;
+  }
+
+  uint64_t cardinality_impl() const
+  {
+    switch (encoding_)
+    {
+      default:
+        return equality_.cardinality();
+      case range_encoding:
+        {
+          uint64_t n = 0;
+          for (auto b : range_.base())
+            n += b - 1;
+          return n;
+        }
+      case binary_encoding:
+        return binary_.cardinality();
+    }
+  }
+
+  bool append_impl(size_t n, bool bit)
+  {
+    switch (encoding_)
+    {
+      default:
+        return equality_.append(n, bit);
+      case range_encoding:
+        return range_.append(n, bit) && present_.append(n, false);
+      case binary_encoding:
+        return binary_.append(n, bit) && present_.append(n, false);
+    }
+  }
+
+  bool encode_impl(T x)
+  {
+    auto o = detail::order(x);
+    min_ = std::min(min_, o);
+    max_ = std::max(max_, o);
+
+    if (encoding_ == equality_encoding)
+    {
+      if (! equality_.encode(x))
+        return false;
+
+      distinct_ = equality_.cardinality();
+      ++sampled_;
+      if (distinct_ <= max_cardinality_)
+        return true;
+
+      return regrow(choose());
+    }
+
+    if (o < lo_ || o - lo_ > limit_)
+      if (! regrow(encoding_))
+        return false;
+
+    auto success = encoding_ == range_encoding
+      ? range_.encode(o - lo_)
+      : binary_.encode(o - lo_);
+
+    return success && present_.push_back(true);
+  }
+
+  trial<owning_bitstream_t<Bitstream>>
+  decode_impl(T x, relational_operator op) const
+  {
+    using result_type = owning_bitstream_t<Bitstream>;
+
+    switch (op)
+    {
+      default:
+        return error{"unsupported relational operator: ", op};
+      case equal:
+      case not_equal:
+      case less:
+      case less_equal:
+      case greater:
+      case greater_equal:
+        break;
+    }
+
+    if (encoding_ == equality_encoding)
+    {
+      if (op == equal || op == not_equal)
+        return equality_.decode(x, op);
+
+      // Range predicates visit every distinct value, of which there are at
+      // most as many as the cardinality threshold.
+      std::vector<Bitstream const*> operands;
+      equality_.each(
+        [&](size_t, T y, Bitstream const& bs)
+        {
+          if (compare(y, op, x))
+            operands.push_back(&bs);
+        });
+
+      if (operands.empty())
+        return result_type{this->size(), false};
+
+      auto r = or_all(operands.begin(), operands.end());
+      if (r.size() < this->size())
+        r.append(this->size() - r.size(), false);
+
+      return std::move(r);
+    }
+
+    auto o = detail::order(x);
+    if (o < lo_)
+    {
+      if (op == greater || op == greater_equal)
+        return result_type{present_};
+      else
+        return result_type{this->size(), op == not_equal};
+    }
+    else if (o - lo_ > limit_)
+    {
+      if (op == less || op == less_equal)
+        return result_type{present_};
+      else
+        return result_type{this->size(), op == not_equal};
+    }
+
+    // Rows without a value only satisfy inequality.
+    auto r = encoding_ == range_encoding
+      ? range_.decode(o - lo_, op == not_equal ? equal : op)
+      : binary_.decode(o - lo_, op == not_equal ? equal : op);
+
+    if (r)
+    {
+      *r &= present_;
+      if (op == not_equal)
+        r->flip();
+    }
+
+    return r;
+  }
+
+  template <typename F>
+  void each_impl(F f) const
+  {
+    switch (encoding_)
+    {
+      case equality_encoding:
+        equality_.each(f);
+        break;
+      case range_encoding:
+        range_.each(f);
+        break;
+      case binary_encoding:
+        binary_.each(f);
+        break;
+    }
+  }
+
+  bitmap_encoding encoding_ = equality_encoding;
+  uint64_t max_cardinality_;
+  uint64_t distinct_ = 0;
+  uint64_t sampled_ = 0;
+  offset_binary_type min_ = std::numeric_limits<offset_binary_type>::max();
+  offset_binary_type max_ = 0;
+  offset_binary_type lo_ = 0;
+  offset_binary_type limit_ = 0;
+  owning_bitstream_t<Bitstream> present_;
+  equality_coder<T, Bitstream> equality_;
+  range_coder_type range_;
+  binary_coder_type binary_;
+
+private:
+  friend access;
+
+  void serialize(serializer& sink) const
+  {
+    super::serialize(sink);
+    sink << static_cast<uint8_t>(encoding_) << max_cardinality_
+         << distinct_ << sampled_ << min_ << max_;
+
+    if (encoding_ == equality_encoding)
+      sink << equality_;
+    else if (encoding_ == range_encoding)
+      sink << lo_ << limit_ << present_ << range_;
+    else
+      sink << lo_ << limit_ << present_ << binary_;
+  }
+
+  void deserialize(deserializer& source)
+  {
+    super::deserialize(source);
+    uint8_t encoding;
+    source >> encoding >> max_cardinality_
+           >> distinct_ >> sampled_ >> min_ >> max_;
+
+    encoding_ = static_cast<bitmap_encoding>(encoding);
+    if (encoding_ == equality_encoding)
+      source >> equality_;
+    else if (encoding_ == range_encoding)
+      source >> lo_ >> limit_ >> present_ >> range_;
+    else
+      source >> lo_ >> limit_ >> present_ >> binary_;
+  }
+
+  friend bool operator==(adaptive_coder const& x, adaptive_coder const& y)
+  {
+    if (! (static_cast<super const&>(x) == static_cast<super const&>(y)
+           && x.encoding_ == y.encoding_))
+      return false;
+
+    switch (x.encoding_)
+    {
+      default:
+        return x.equality_ == y.equality_;
+      case range_encoding:
+        return x.lo_ == y.lo_
+            && x.present_ == y.present_
+            && x.range_ == y.range_;
+      case binary_encoding:
+        return x.lo_ == y.lo_
+            && x.present_ == y.present_
+            && x.binary_ == y.binary_;
+    }
+  }
+};
+
 /// A null binning policy acting as identity function.
 template <typename T>
 struct null_binner : util::equality_comparable<null_binner<T>>
@@ -690,6 +1759,11 @@ struct null_binner : util::equality_comparable<null_binner<T>>
     return x;
   }
 
+  bool exact() const
+  {
+    return true;
+  }
+
   void serialize(serializer&) const
   {
   }
@@ -743,11 +1817,25 @@ public:
       fractional_ = integral_;
   }
 
+  /// Constructs a precision binner that leaves all values intact.
+  precision_binner(none)
+    : integral_{0}
+  {
+  }
+
   T operator()(T x) const
   {
     return dispatch(x, is_double<T>());
   }
 
+  /// Checks whether the binner maps every value onto itself.
+  /// @returns `true` *iff* the binner does not lose precision.
+  bool exact() const
+  {
+    return integral_ == 0
+        || (! is_double<T>::value && integral_ == 1);
+  }
+
 private:
   T dispatch(T x, std::true_type) const
   {
@@ -766,7 +1854,7 @@ private:
 
   T dispatch(T x, std::false_type) const
   {
-    return x / integral_;
+    return integral_ ? x / integral_ : x;
   }
 
   T integral_;
@@ -842,7 +1930,7 @@ public:
   }
 
   /// Shorthand for `lookup(equal, x)`.
-  trial<Bitstream> operator[](T x) const
+  trial<owning_bitstream_t<Bitstream>> operator[](T x) const
   {
     return lookup(equal, x);
   }
@@ -855,7 +1943,8 @@ public:
   ///
   /// @returns An engaged bitstream for all values *v* where *op(v,x)* is
   /// `true` or a disengaged bitstream if *x* does not exist.
-  trial<Bitstream> lookup(relational_operator op, T x) const
+  trial<owning_bitstream_t<Bitstream>>
+  lookup(relational_operator op, T x) const
   {
     return coder_.decode(binner_(x), op);
   }
@@ -874,6 +1963,14 @@ public:
     return size() == 0;
   }
 
+  /// Checks whether the bitmap stores values without loss, i.e., whether its
+  /// binner leaves all values intact.
+  /// @returns `true` *iff* lookups yield no false positives.
+  bool exact() const
+  {
+    return binner_.exact();
+  }
+
   /// Accesses the underlying coder of the bitmap.
   /// @returns The coder of this bitmap.
   coder_type const& coder() const
@@ -881,6 +1978,11 @@ public:
     return coder_;
   }
 
+  coder_type& coder()
+  {
+    return coder_;
+  }
+
 private:
   coder_type coder_;
   binner_type binner_;
@@ -953,21 +2055,23 @@ public:
     return bool_.append(n, bit);
   }
 
-  trial<Bitstream> operator[](bool x) const
+  trial<owning_bitstream_t<Bitstream>> operator[](bool x) const
   {
     return lookup(x);
   }
 
-  trial<Bitstream> lookup(relational_operator op, bool x) const
+  trial<owning_bitstream_t<Bitstream>>
+  lookup(relational_operator op, bool x) const
   {
+    using result_type = owning_bitstream_t<Bitstream>;
     switch (op)
     {
       default:
         return error{"unsupported relational operator: ", op};
       case not_equal:
-        return {x ? ~bool_ : bool_};
+        return {x ? ~bool_ : result_type{bool_}};
       case equal:
-        return {x ? bool_ : ~bool_};
+        return {x ? result_type{bool_} : ~bool_};
     }
   }
 
@@ -1,11 +1,18 @@
 #ifndef VAST_BITMAP_INDEX_H
 #define VAST_BITMAP_INDEX_H
 
+#include <algorithm>
+#include <array>
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <vector>
 #include "vast/bitmap.h"
 #include "vast/operator.h"
 #include "vast/optional.h"
 #include "vast/logger.h"
 #include "vast/value.h"
+#include "vast/detail/connection.h"
 #include "vast/util/operators.h"
 #include "vast/util/trial.h"
 
@@ -82,6 +89,23 @@ public:
     return derived()->size_impl();
   }
 
+  /// Re-evaluates the encoding of the index once ingestion has completed,
+  /// e.g., when the enclosing partition has reached its capacity.
+  /// @returns `true` if the index changed its encoding.
+  bool optimize()
+  {
+    return derived()->optimize_impl();
+  }
+
+  /// Checks whether lookups yield exact results, in which case the rows of a
+  /// result need no further check against the predicate.
+  /// @param op The relational operator of the lookup.
+  /// @returns `true` if lookups with *op* produce no false positives.
+  bool exact(relational_operator op) const
+  {
+    return derived()->exact_impl(op);
+  }
+
   /// Checks whether the bitmap is empty.
   /// @returns `true` if `size() == 0`.
   bool empty() const
@@ -115,6 +139,17 @@ public:
         && mask_.append(delta, false);
   }
 
+protected:
+  bool optimize_impl()
+  {
+    return false;
+  }
+
+  bool exact_impl(relational_operator) const
+  {
+    return false;
+  }
+
 private:
   friend access;
 
@@ -156,6 +191,8 @@ struct bitmap_index_concept
   virtual trial<Bitstream> lookup(relational_operator op,
                                   data const& d) const = 0;
   virtual uint64_t size() const = 0;
+  virtual bool optimize() = 0;
+  virtual bool exact(relational_operator op) const = 0;
 
   virtual std::unique_ptr<bitmap_index_concept> copy() const = 0;
   virtual bool equals(bitmap_index_concept const& other) const = 0;
@@ -200,6 +237,16 @@ struct bitmap_index_model
     return bmi_.size();
   }
 
+  virtual bool optimize() final
+  {
+    return bmi_.optimize();
+  }
+
+  virtual bool exact(relational_operator op) const final
+  {
+    return bmi_.exact(op);
+  }
+
   BitmapIndex const& cast(bmi_concept const& c) const
   {
     if (typeid(c) != typeid(*this))
@@ -321,6 +368,18 @@ public:
     return concept_->empty();
   }
 
+  bool optimize()
+  {
+    assert(concept_);
+    return concept_->optimize();
+  }
+
+  bool exact(relational_operator op) const
+  {
+    assert(concept_);
+    return concept_->exact(op);
+  }
+
   bool catch_up(uint64_t n)
   {
     assert(concept_);
@@ -357,7 +416,8 @@ private:
   }
 };
 
-/// A bitmap index for arithmetic values.
+/// A bitmap index for arithmetic values. Except for booleans, the index
+/// chooses its encoding at runtime via an ::adaptive_coder.
 template <typename Bitstream, typename T>
 class arithmetic_bitmap_index
   : public bitmap_index_base<arithmetic_bitmap_index<Bitstream, T>, Bitstream>,
@@ -386,12 +446,18 @@ class arithmetic_bitmap_index
       >
     >;
 
+  using binnable =
+    std::integral_constant<
+      bool,
+      std::is_same<T, real>::value
+      || std::is_same<T, time_point>::value
+      || std::is_same<T, time_duration>::value
+    >;
+
   template <typename U>
   using bitmap_binner =
     std::conditional_t<
-      std::is_same<T, real>::value
-      || std::is_same<T, time_point>::value
-      || std::is_same<T, time_duration>::value,
+      binnable::value,
       precision_binner<U>,
       null_binner<U>
     >;
@@ -403,7 +469,7 @@ class arithmetic_bitmap_index
       equality_coder<B, U>,
       std::conditional_t<
         std::is_arithmetic<bitmap_value_type>::value,
-        range_bitslice_coder<B, U>,
+        adaptive_coder<B, U>,
         std::false_type
       >
     >;
@@ -414,8 +480,16 @@ class arithmetic_bitmap_index
 public:
   using bitstream_type = Bitstream;
 
-  arithmetic_bitmap_index() = default;
+  /// Constructs an arithmetic bitmap index. Real and time values are indexed
+  /// losslessly until a binner reduces their precision.
+  arithmetic_bitmap_index()
+  {
+    init_binner(binnable{});
+  }
 
+  /// Configures the binner of real and time values, which trades exactness
+  /// for a smaller index.
+  /// @param xs The parameters forwarded to the constructor of the binner.
   template <typename... Ts>
   void binner(Ts&&... xs)
   {
@@ -523,6 +597,45 @@ private:
     return bitmap_.size();
   }
 
+  bool optimize_impl()
+  {
+    return optimize_coder(std::is_same<T, boolean>{});
+  }
+
+  bool optimize_coder(std::true_type)
+  {
+    return false;
+  }
+
+  bool optimize_coder(std::false_type)
+  {
+    return bitmap_.coder().optimize();
+  }
+
+  bool exact_impl(relational_operator) const
+  {
+    return exact_binner(binnable{});
+  }
+
+  bool exact_binner(std::true_type) const
+  {
+    return bitmap_.exact();
+  }
+
+  bool exact_binner(std::false_type) const
+  {
+    return true;
+  }
+
+  void init_binner(std::true_type)
+  {
+    bitmap_.binner(nil);
+  }
+
+  void init_binner(std::false_type)
+  {
+  }
+
   bitmap_type bitmap_;
 
 private:
@@ -545,6 +658,250 @@ private:
   }
 };
 
+/// A bitmap index for time points which organizes values hierarchically. It
+/// assigns each value to a day, hour, and minute bucket, each of which has an
+/// equality-encoded bitmap. Each minute bucket additionally has its own fine
+/// bitmap with the offsets of its values within the minute, one row per value
+/// in the bucket. A range lookup ORs the buckets entirely on one side of the
+/// queried value, coarse to fine, and only consults the fine bitmap of the
+/// minute bucket of the queried value. The cost of the fine lookup thus
+/// depends on the number of values in that bucket rather than on the number
+/// of rows. The buckets also provide histograms without touching the fine
+/// bitmaps.
+template <typename Bitstream>
+class time_bitmap_index
+  : public bitmap_index_base<time_bitmap_index<Bitstream>, Bitstream>
+{
+  using super = bitmap_index_base<time_bitmap_index<Bitstream>, Bitstream>;
+  friend super;
+
+  template <typename>
+  friend struct detail::bitmap_index_model;
+
+  using rep = time_range::rep;
+
+public:
+  using bitstream_type = Bitstream;
+
+  /// The resolutions of the bucket levels, from coarse to fine.
+  enum resolution : uint8_t
+  {
+    days,
+    hours,
+    minutes
+  };
+
+  /// Counts the values per bucket.
+  /// @param r The resolution of the buckets.
+  /// @returns A mapping from the start of each non-empty bucket to the number
+  ///          of values in it.
+  std::map<time_point, uint64_t> histogram(resolution r) const
+  {
+    std::map<time_point, uint64_t> result;
+    buckets_[r].coder().each(
+        [&](size_t, rep id, Bitstream const& bs)
+        {
+          auto n = bs.count();
+          if (n > 0)
+            result.emplace(time_range::nanoseconds(id * width(r)), n);
+        });
+
+    return result;
+  }
+
+private:
+  static rep width(size_t level)
+  {
+    static constexpr rep minute = 60ll * 1000 * 1000 * 1000;
+    switch (level)
+    {
+      default:
+        return minute;
+      case days:
+        return 24 * 60 * minute;
+      case hours:
+        return 60 * minute;
+    }
+  }
+
+  // Computes the bucket of a value, rounding towards negative infinity.
+  static rep bucket(rep x, size_t level)
+  {
+    auto w = width(level);
+    return x >= 0 ? x / w : -((-x - 1) / w) - 1;
+  }
+
+  bool push_back_impl(data const& d)
+  {
+    auto t = get<time_point>(d);
+    return t && push_back_impl(*t);
+  }
+
+  bool push_back_impl(time_point t)
+  {
+    auto x = t.since_epoch().count();
+    for (size_t i = 0; i < buckets_.size(); ++i)
+      if (! buckets_[i].push_back(bucket(x, i)))
+        return false;
+
+    auto m = bucket(x, minutes);
+    return fine_[m].push_back(x - m * width(minutes));
+  }
+
+  bool stretch_impl(size_t n)
+  {
+    for (auto& bm : buckets_)
+      if (! bm.append(n, false))
+        return false;
+
+    return true;
+  }
+
+  trial<Bitstream> lookup_impl(relational_operator op, data const& d) const
+  {
+    auto t = get<time_point>(d);
+    if (! t)
+      return error{"invalid type: ", d};
+
+    return lookup_impl(op, *t);
+  }
+
+  trial<Bitstream> lookup_impl(relational_operator op, time_point t) const
+  {
+    auto x = t.since_epoch().count();
+    switch (op)
+    {
+      default:
+        return error{"unsupported relational operator: ", op};
+      case equal:
+      case not_equal:
+        {
+          auto r = lookup_edge(equal, x);
+          if (r && op == not_equal)
+            r->flip();
+
+          return r;
+        }
+      case less:
+      case less_equal:
+      case greater:
+      case greater_equal:
+        break;
+    }
+
+    // Collect all buckets strictly before or after the bucket of x, but
+    // within the enclosing bucket of x one level up. Below the top level, we
+    // only visit the siblings of the bucket of x rather than all buckets.
+    // A single disjunction then combines the buckets with the edge.
+    auto after = op == greater || op == greater_equal;
+    std::vector<Bitstream const*> operands;
+    buckets_[days].coder().each(
+        [&](size_t, rep b, Bitstream const& bs)
+        {
+          if (after ? b > bucket(x, days) : b < bucket(x, days))
+            operands.push_back(&bs);
+        });
+
+    for (size_t i = 1; i < buckets_.size(); ++i)
+    {
+      auto id = bucket(x, i);
+      auto n = width(i - 1) / width(i);
+      auto first = bucket(x, i - 1) * n;
+      auto b = after ? id + 1 : first;
+      auto end = after ? first + n : id;
+      for (; b < end; ++b)
+        if (auto bs = buckets_[i].coder().find(b))
+          operands.push_back(bs);
+    }
+
+    auto edge = lookup_edge(op, x);
+    if (! edge)
+      return edge;
+
+    operands.push_back(&*edge);
+    auto r = or_all(operands.begin(), operands.end());
+    if (r.size() < this->size())
+      r.append(this->size() - r.size(), false);
+
+    return std::move(r);
+  }
+
+  // Looks up a value among the values within its minute bucket.
+  trial<Bitstream> lookup_edge(relational_operator op, rep x) const
+  {
+    auto m = bucket(x, minutes);
+    auto rows = buckets_[minutes].lookup(equal, m);
+    if (! rows || rows->all_zero())
+      return rows;
+
+    auto i = fine_.find(m);
+    assert(i != fine_.end());
+    auto hits = i->second.lookup(op, x - m * width(minutes));
+    if (! hits)
+      return hits;
+
+    // The k-th row of the fine bitmap corresponds to the k-th row in the
+    // minute bucket. Since both ascend, we walk them in lockstep.
+    bitstream_builder<Bitstream> builder;
+    auto next = hits->begin();
+    auto end = hits->end();
+    uint64_t k = 0;
+    for (auto row : *rows)
+    {
+      if (next == end)
+        break;
+
+      if (*next == k++)
+      {
+        builder.add(row);
+        ++next;
+      }
+    }
+
+    return builder.finish(this->size());
+  }
+
+  uint64_t size_impl() const
+  {
+    return buckets_[days].size();
+  }
+
+  bool optimize_impl()
+  {
+    auto changed = false;
+    for (auto& p : fine_)
+      changed = p.second.coder().optimize() || changed;
+
+    return changed;
+  }
+
+  bool exact_impl(relational_operator) const
+  {
+    return true;
+  }
+
+  std::array<bitmap<rep, Bitstream, equality_coder>, 3> buckets_;
+  std::unordered_map<rep, bitmap<rep, Bitstream, adaptive_coder>> fine_;
+
+private:
+  friend access;
+
+  void serialize(serializer& sink) const
+  {
+    sink << static_cast<super const&>(*this) << buckets_ << fine_;
+  }
+
+  void deserialize(deserializer& source)
+  {
+    source >> static_cast<super&>(*this) >> buckets_ >> fine_;
+  }
+
+  friend bool operator==(time_bitmap_index const& x, time_bitmap_index const& y)
+  {
+    return x.buckets_ == y.buckets_ && x.fine_ == y.fine_;
+  }
+};
+
 /// A bitmap index for strings.
 template <typename Bitstream>
 class string_bitmap_index
@@ -556,6 +913,9 @@ class string_bitmap_index
   template <typename>
   friend struct detail::bitmap_index_model;
 
+  template <typename>
+  friend class dictionary_bitmap_index;
+
 public:
   using bitstream_type = Bitstream;
 
@@ -637,19 +997,23 @@ private:
           if (r->all_zero())
             return Bitstream{this->size(), op == not_equal};
 
+          std::vector<Bitstream> operands;
+          operands.reserve(size + 1);
+          operands.push_back(std::move(*r));
           for (size_t i = 0; i < size; ++i)
           {
             auto b = bitmaps_[i].lookup(equal, static_cast<uint8_t>(begin[i]));
             if (! b)
               return b.error();
 
-            if (! b->all_zero())
-              *r &= *b;
-            else
+            if (b->all_zero())
               return Bitstream{this->size(), op == not_equal};
+
+            operands.push_back(std::move(*b));
           }
 
-          return std::move(op == equal ? *r : r->flip());
+          auto result = and_all(operands.begin(), operands.end());
+          return std::move(op == equal ? result : result.flip());
         }
       case ni:
       case not_ni:
@@ -661,11 +1025,12 @@ private:
             return Bitstream{this->size(), op == not_ni};
 
           // TODO: Be more clever than iterating over all k-grams (#45).
-          Bitstream r{this->size(), 0};
+          std::vector<Bitstream> matches{Bitstream{this->size(), 0}};
+          std::vector<Bitstream> substr;
+          substr.reserve(size);
           for (size_t i = 0; i < bitmaps_.size() - size + 1; ++i)
           {
-            Bitstream substr{this->size(), 1};;
-            auto skip = false;
+            substr.clear();
             for (size_t j = 0; j < size; ++j)
             {
               auto bs = bitmaps_[i + j].lookup(equal, begin[j]);
@@ -673,18 +1038,16 @@ private:
                 return bs.error();
 
               if (bs->all_zero())
-              {
-                skip = true;
                 break;
-              }
 
-              substr &= *bs;
+              substr.push_back(std::move(*bs));
             }
 
-            if (! skip)
-              r |= substr;
+            if (substr.size() == size)
+              matches.push_back(and_all(substr.begin(), substr.end()));
           }
 
+          auto r = or_all(matches.begin(), matches.end());
           return std::move(op == ni ? r : r.flip());
         }
     }
@@ -740,132 +1103,891 @@ private:
   }
 };
 
-/// A bitmap index for IP addresses.
+/// A bitmap index for strings which maps each distinct string to a dense
+/// code and records the codes in an equality-coded bitmap. An equality lookup
+/// thus touches a single bitstream, independent of the string length, and
+/// substring lookups scan the distinct values instead of the rows. Once the
+/// number of distinct values exceeds a configurable limit, the index migrates
+/// to a ::string_bitmap_index, whose size does not grow with the cardinality.
 template <typename Bitstream>
-class address_bitmap_index
-  : public bitmap_index_base<address_bitmap_index<Bitstream>, Bitstream>
+class dictionary_bitmap_index
+  : public bitmap_index_base<dictionary_bitmap_index<Bitstream>, Bitstream>
 {
-  using super = bitmap_index_base<address_bitmap_index<Bitstream>, Bitstream>;
+  using super =
+    bitmap_index_base<dictionary_bitmap_index<Bitstream>, Bitstream>;
   friend super;
 
   template <typename>
-    friend struct detail::bitmap_index_model;
+  friend struct detail::bitmap_index_model;
+
+  template <typename>
+  friend class ngram_bitmap_index;
 
 public:
   using bitstream_type = Bitstream;
+  using code_type = uint32_t;
 
-  address_bitmap_index() = default;
+  /// The default number of distinct values before falling back to
+  /// per-character bitmaps.
+  static constexpr uint64_t default_max_cardinality = 1 << 16;
+
+  /// Constructs a dictionary-encoded string index.
+  /// @param max_cardinality The number of distinct values the dictionary may
+  ///                        hold before the index migrates to a
+  ///                        ::string_bitmap_index.
+  dictionary_bitmap_index(uint64_t max_cardinality = default_max_cardinality)
+    : max_cardinality_{max_cardinality}
+  {
+  }
+
+  /// Checks whether the index still uses the dictionary encoding.
+  /// @returns `false` if the index fell back to per-character bitmaps.
+  bool dictionary_encoded() const
+  {
+    return ! migrated_;
+  }
+
+  /// Retrieves the number of distinct values in the dictionary.
+  /// @returns The number of distinct values or 0 after the fallback.
+  uint64_t cardinality() const
+  {
+    return values_.size();
+  }
 
 private:
-  bool push_back_impl(address const& a)
+  template <typename Iterator>
+  bool push_back_string(Iterator begin, Iterator end)
   {
-    auto& bytes = a.data();
-    size_t start = a.is_v4() ? 12 : 0;
+    if (migrated_)
+      return fallback_.push_back_string(begin, end);
 
-    if (! v4_.push_back(start == 12))
-      return false;
+    auto str = std::string(begin, end);
+    auto i = codes_.find(str);
+    if (i != codes_.end())
+      return codes_bitmap_.push_back(i->second);
 
-    for (size_t i = 0; i < 16; ++i)
-      if (! bitmaps_[i].push_back(i < start ? 0x00 : bytes[i]))
-        return false;
+    if (values_.size() >= max_cardinality_)
+      return migrate() && fallback_.push_back_string(begin, end);
 
-    return true;
+    auto code = static_cast<code_type>(values_.size());
+    values_.push_back(str);
+    codes_.emplace(std::move(str), code);
+    return codes_bitmap_.push_back(code);
   }
 
   bool push_back_impl(data const& d)
   {
-    if (auto a = get<address>(d))
-      return push_back_impl(*a);
-    else if (auto s = get<subnet>(d))
-      return push_back_impl(s->network());
-    else
-      return false;
+    auto str = get<std::string>(d);
+    return str && push_back_impl(*str);
   }
 
-  bool stretch_impl(size_t n)
+  bool push_back_impl(std::string const& str)
   {
-    for (size_t i = 0; i < 16; ++i)
-      if (! bitmaps_[i].append(n, false))
-        return false;
+    return push_back_string(str.begin(), str.end());
+  }
 
-    return v4_.append(n, false);
+  template <size_t N>
+  bool push_back_impl(char const (&str)[N])
+  {
+    return push_back_string(str, str + N - 1);
   }
 
-  trial<Bitstream> lookup_impl(relational_operator op, data const& d) const
+  bool stretch_impl(size_t n)
   {
-    if (! (op == equal || op == not_equal || op == in || op == not_in))
-      return error{"unsupported relational operator: ", op};
+    return migrated_ ? fallback_.stretch_impl(n) : codes_bitmap_.append(n);
+  }
 
-    if (v4_.empty())
-      return Bitstream{};
+  // Replays all rows into a string bitmap index and discards the dictionary.
+  bool migrate()
+  {
+    static constexpr auto no_code = std::numeric_limits<code_type>::max();
+    std::vector<code_type> rows(codes_bitmap_.size(), no_code);
+    codes_bitmap_.coder().each(
+      [&](size_t, code_type code, Bitstream const& bs)
+      {
+        for (auto i : bs)
+          rows[i] = code;
+      });
+
+    string_bitmap_index<Bitstream> fallback;
+    size_t i = 0;
+    while (i < rows.size())
+      if (rows[i] == no_code)
+      {
+        auto j = i;
+        while (j < rows.size() && rows[j] == no_code)
+          ++j;
+        if (! fallback.stretch_impl(j - i))
+          return false;
+        i = j;
+      }
+      else
+      {
+        if (! fallback.push_back_impl(values_[rows[i++]]))
+          return false;
+      }
 
-    switch (which(d))
-    {
-      default:
-        return error{"invalid value"};
-      case data::tag::address:
-        return lookup_impl(op, *get<address>(d));
-      case data::tag::subnet:
-        return lookup_impl(op, *get<subnet>(d));
-    }
+    VAST_LOG_VERBOSE("dictionary index exceeded " << max_cardinality_ <<
+                     " distinct values, switching to per-character bitmaps");
+    fallback_ = std::move(fallback);
+    migrated_ = true;
+    values_.clear();
+    codes_.clear();
+    codes_bitmap_ = {};
+    return true;
   }
 
-  trial<Bitstream> lookup_impl(relational_operator op, address const& a) const
+  // Computes the disjunction of the bitstreams of all codes whose values
+  // satisfy a predicate.
+  template <typename Predicate>
+  trial<Bitstream> lookup_values(Predicate p) const
   {
-    if (! (op == equal || op == not_equal))
-      return error{"unsupported relational operator: ", op};
+    std::vector<bool> hits(values_.size());
+    for (code_type code = 0; code < values_.size(); ++code)
+      hits[code] = p(values_[code]);
 
-    auto& bytes = a.data();
-    auto is_v4 = a.is_v4();
-    auto r = is_v4 ? v4_ : Bitstream{this->size(), true};
+    return lookup_codes(hits);
+  }
 
-    for (size_t i = is_v4 ? 12 : 0; i < 16; ++ i)
-    {
-      auto bs = bitmaps_[i][bytes[i]];
-      if (! bs)
-        return bs.error();
+  // Computes the disjunction of the bitstreams of the flagged codes.
+  trial<Bitstream> lookup_codes(std::vector<bool> const& hits) const
+  {
+    std::vector<Bitstream const*> operands;
+    codes_bitmap_.coder().each(
+      [&](size_t, code_type code, Bitstream const& bs)
+      {
+        if (hits[code])
+          operands.push_back(&bs);
+      });
 
-      if (! bs->all_zero())
-        r &= *bs;
+    if (operands.empty())
+      return Bitstream{this->size(), false};
+
+    auto r = or_all(operands.begin(), operands.end());
+    if (r.size() < this->size())
+      r.append(this->size() - r.size(), false);
+
+    return std::move(r);
+  }
+
+  trial<Bitstream> lookup_pattern(relational_operator op,
+                                  pattern const& pat) const
+  {
+    if (! (op == match || op == not_match))
+      return error{"unsupported relational operator: ", op};
+
+    // Without the dictionary, every row is a candidate for the query to
+    // check.
+    if (migrated_)
+      return Bitstream{this->size(), true};
+
+    // Matching each distinct value once yields an exact result.
+    std::vector<bool> hits(values_.size());
+    for (auto code : pat.match(values_))
+      hits[code] = true;
+
+    auto r = lookup_codes(hits);
+    if (r && op == not_match)
+      r->flip();
+
+    return r;
+  }
+
+  template <typename Iterator>
+  trial<Bitstream> lookup_string(relational_operator op,
+                                 Iterator begin, Iterator end) const
+  {
+    if (migrated_)
+      return fallback_.lookup_string(op, begin, end);
+
+    auto str = std::string(begin, end);
+    switch (op)
+    {
+      default:
+        return error{"unsupported relational operator: ", op};
+      case equal:
+      case not_equal:
+        {
+          auto i = codes_.find(str);
+          if (i == codes_.end())
+            return Bitstream{this->size(), op == not_equal};
+
+          return codes_bitmap_.lookup(op, i->second);
+        }
+      case ni:
+      case not_ni:
+        {
+          if (str.empty())
+            return Bitstream{this->size(), op == ni};
+
+          auto r = lookup_values(
+              [&](std::string const& x) { return x.find(str) != x.npos; });
+          if (r && op == not_ni)
+            r->flip();
+
+          return r;
+        }
+      case in:
+      case not_in:
+        {
+          auto r = lookup_values(
+              [&](std::string const& x) { return str.find(x) != str.npos; });
+          if (r && op == not_in)
+            r->flip();
+
+          return r;
+        }
+    }
+  }
+
+  // Looks up membership in a set of strings. With the dictionary in place,
+  // the lookup flags the code of each string and ORs the bitstreams of the
+  // flagged codes in one pass.
+  template <typename Container>
+  trial<Bitstream> lookup_container(relational_operator op,
+                                    Container const& c) const
+  {
+    if (! (op == in || op == not_in))
+      return error{"unsupported relational operator: ", op};
+
+    if (! migrated_)
+    {
+      std::vector<bool> hits(values_.size());
+      for (auto& x : c)
+      {
+        auto str = get<std::string>(x);
+        if (! str)
+          return error{"not string data: ", x};
+
+        auto i = codes_.find(*str);
+        if (i != codes_.end())
+          hits[i->second] = true;
+      }
+
+      auto r = lookup_codes(hits);
+      if (r && op == not_in)
+        r->flip();
+
+      return r;
+    }
+
+    std::vector<Bitstream> operands;
+    for (auto& x : c)
+    {
+      auto str = get<std::string>(x);
+      if (! str)
+        return error{"not string data: ", x};
+
+      auto bs = lookup_impl(equal, *str);
+      if (! bs)
+        return bs.error();
+
+      operands.push_back(std::move(*bs));
+    }
+
+    auto r = operands.empty()
+      ? Bitstream{this->size(), false}
+      : or_all(operands.begin(), operands.end());
+
+    return std::move(op == in ? r : r.flip());
+  }
+
+  trial<Bitstream> lookup_impl(relational_operator op, data const& d) const
+  {
+    switch (which(d))
+    {
+      default:
+        return error{"not string data: ", d};
+      case data::tag::string:
+        return lookup_impl(op, *get<std::string>(d));
+      case data::tag::pattern:
+        return lookup_pattern(op, *get<pattern>(d));
+      case data::tag::vector:
+        return lookup_container(op, *get<vector>(d));
+      case data::tag::set:
+        return lookup_container(op, *get<set>(d));
+    }
+  }
+
+  trial<Bitstream> lookup_impl(relational_operator op,
+                               std::string const& str) const
+  {
+    return lookup_string(op, str.begin(), str.end());
+  }
+
+  template <size_t N>
+  trial<Bitstream> lookup_impl(relational_operator op,
+                               char const (&str)[N]) const
+  {
+    return lookup_string(op, str, str + N - 1);
+  }
+
+  uint64_t size_impl() const
+  {
+    return migrated_ ? fallback_.size_impl() : codes_bitmap_.size();
+  }
+
+  // All lookups through the dictionary compare whole values, whereas the
+  // per-character bitmaps leave some candidates to the query.
+  bool exact_impl(relational_operator) const
+  {
+    return ! migrated_;
+  }
+
+  uint64_t max_cardinality_;
+  std::vector<std::string> values_;
+  std::unordered_map<std::string, code_type> codes_;
+  bitmap<code_type, Bitstream, equality_coder> codes_bitmap_;
+  string_bitmap_index<Bitstream> fallback_;
+  bool migrated_ = false;
+
+private:
+  friend access;
+
+  void serialize(serializer& sink) const
+  {
+    sink << static_cast<super const&>(*this) << max_cardinality_ << migrated_;
+    if (migrated_)
+      sink << fallback_;
+    else
+      sink << values_ << codes_bitmap_;
+  }
+
+  void deserialize(deserializer& source)
+  {
+    source >> static_cast<super&>(*this) >> max_cardinality_ >> migrated_;
+    if (migrated_)
+    {
+      source >> fallback_;
+    }
+    else
+    {
+      source >> values_ >> codes_bitmap_;
+      codes_.clear();
+      for (code_type code = 0; code < values_.size(); ++code)
+        codes_.emplace(values_[code], code);
+    }
+  }
+
+  friend bool operator==(dictionary_bitmap_index const& x,
+                         dictionary_bitmap_index const& y)
+  {
+    if (x.migrated_ || y.migrated_)
+      return x.migrated_ && y.migrated_ && x.fallback_ == y.fallback_;
+
+    return x.values_ == y.values_ && x.codes_bitmap_ == y.codes_bitmap_;
+  }
+};
+
+/// A bitmap index for strings which complements a ::dictionary_bitmap_index
+/// with a posting bitstream for each *n*-gram, i.e., substring of length *n*.
+/// For a substring lookup with at least *n* characters, the index intersects
+/// the postings of all *n*-grams of the search string. The result is a
+/// superset of the actual matches, e.g., "abcab" contains all trigrams of
+/// "abcabc", so that the query must verify the candidates.
+template <typename Bitstream>
+class ngram_bitmap_index
+  : public bitmap_index_base<ngram_bitmap_index<Bitstream>, Bitstream>
+{
+  using super = bitmap_index_base<ngram_bitmap_index<Bitstream>, Bitstream>;
+  friend super;
+
+  template <typename>
+  friend struct detail::bitmap_index_model;
+
+public:
+  using bitstream_type = Bitstream;
+
+  /// The default *n*-gram length.
+  static constexpr size_t default_n = 3;
+
+  /// The maximum *n*-gram length.
+  static constexpr size_t max_n = sizeof(uint64_t);
+
+  /// Constructs an *n*-gram index.
+  /// @param n The length of the *n*-grams in *[1, max_n]*.
+  ngram_bitmap_index(size_t n = default_n)
+    : n_{n}
+  {
+    assert(n_ >= 1 && n_ <= max_n);
+  }
+
+private:
+  using gram_type = uint64_t;
+
+  // Packs all n-grams of a string into integers, sorted and without
+  // duplicates.
+  template <typename Iterator>
+  std::vector<gram_type> grams(Iterator begin, Iterator end) const
+  {
+    std::vector<gram_type> result;
+    auto size = static_cast<size_t>(end - begin);
+    if (size < n_)
+      return result;
+
+    result.reserve(size - n_ + 1);
+    for (size_t i = 0; i + n_ <= size; ++i)
+    {
+      gram_type g = 0;
+      for (size_t j = 0; j < n_; ++j)
+        g = (g << 8) | static_cast<uint8_t>(begin[i + j]);
+      result.push_back(g);
+    }
+
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+    return result;
+  }
+
+  template <typename Iterator>
+  bool push_back_string(Iterator begin, Iterator end)
+  {
+    auto row = strings_.size_impl();
+    for (auto g : grams(begin, end))
+    {
+      auto& bs = postings_[g];
+      if (bs.size() < row && ! bs.append(row - bs.size(), false))
+        return false;
+
+      if (! bs.push_back(true))
+        return false;
+    }
+
+    return strings_.push_back_string(begin, end);
+  }
+
+  bool push_back_impl(data const& d)
+  {
+    auto str = get<std::string>(d);
+    return str && push_back_impl(*str);
+  }
+
+  bool push_back_impl(std::string const& str)
+  {
+    return push_back_string(str.begin(), str.end());
+  }
+
+  template <size_t N>
+  bool push_back_impl(char const (&str)[N])
+  {
+    return push_back_string(str, str + N - 1);
+  }
+
+  bool stretch_impl(size_t n)
+  {
+    return strings_.stretch_impl(n);
+  }
+
+  template <typename Iterator>
+  trial<Bitstream> lookup_string(relational_operator op,
+                                 Iterator begin, Iterator end) const
+  {
+    // Negations would turn the candidate superset into a subset, so only
+    // the positive substring search goes through the postings.
+    if (op != ni || static_cast<size_t>(end - begin) < n_)
+      return strings_.lookup_string(op, begin, end);
+
+    std::vector<Bitstream const*> operands;
+    for (auto g : grams(begin, end))
+    {
+      auto i = postings_.find(g);
+      if (i == postings_.end())
+        return Bitstream{this->size(), false};
+
+      operands.push_back(&i->second);
+    }
+
+    auto r = and_all(operands.begin(), operands.end());
+    if (r.size() < this->size())
+      r.append(this->size() - r.size(), false);
+
+    return std::move(r);
+  }
+
+  trial<Bitstream> lookup_impl(relational_operator op, data const& d) const
+  {
+    if (auto str = get<std::string>(d))
+      return lookup_impl(op, *str);
+
+    return strings_.lookup_impl(op, d);
+  }
+
+  trial<Bitstream> lookup_impl(relational_operator op,
+                               std::string const& str) const
+  {
+    return lookup_string(op, str.begin(), str.end());
+  }
+
+  template <size_t N>
+  trial<Bitstream> lookup_impl(relational_operator op,
+                               char const (&str)[N]) const
+  {
+    return lookup_string(op, str, str + N - 1);
+  }
+
+  uint64_t size_impl() const
+  {
+    return strings_.size_impl();
+  }
+
+  // Substring lookups through the postings yield candidates only.
+  bool exact_impl(relational_operator op) const
+  {
+    return op != ni && strings_.exact_impl(op);
+  }
+
+  uint64_t n_;
+  dictionary_bitmap_index<Bitstream> strings_;
+  std::unordered_map<gram_type, Bitstream> postings_;
+
+private:
+  friend access;
+
+  void serialize(serializer& sink) const
+  {
+    sink << static_cast<super const&>(*this) << n_ << strings_ << postings_;
+  }
+
+  void deserialize(deserializer& source)
+  {
+    source >> static_cast<super&>(*this) >> n_ >> strings_ >> postings_;
+  }
+
+  friend bool operator==(ngram_bitmap_index const& x,
+                         ngram_bitmap_index const& y)
+  {
+    return x.n_ == y.n_
+        && x.strings_ == y.strings_
+        && x.postings_ == y.postings_;
+  }
+};
+
+/// A bitmap index for IP addresses. The lower 32 bits of every address, i.e.,
+/// an entire IPv4 address, share one binary bit-slice bitmap. The bitmaps for
+/// the upper 96 bits come into existence with the first IPv6 address, so that
+/// an index over IPv4 addresses does not record any zero bytes. Optionally,
+/// the index keeps equality bitmaps of the /8, /16, and /24 prefixes of IPv4
+/// addresses, which answer subnet queries of these lengths with a single
+/// bitstream and shorten all longer ones.
+template <typename Bitstream>
+class address_bitmap_index
+  : public bitmap_index_base<address_bitmap_index<Bitstream>, Bitstream>
+{
+  using super = bitmap_index_base<address_bitmap_index<Bitstream>, Bitstream>;
+  friend super;
+
+  template <typename>
+    friend struct detail::bitmap_index_model;
+
+public:
+  using bitstream_type = Bitstream;
+
+  address_bitmap_index() = default;
+
+  /// Constructs an address index.
+  /// @param prefixes Whether to keep bitmaps of IPv4 prefixes.
+  explicit address_bitmap_index(bool prefixes)
+    : prefixes_{prefixes}
+  {
+  }
+
+private:
+  static uint32_t low_bits(address const& a)
+  {
+    auto& bytes = a.data();
+    return uint32_t{bytes[12]} << 24
+         | uint32_t{bytes[13]} << 16
+         | uint32_t{bytes[14]} << 8
+         | uint32_t{bytes[15]};
+  }
+
+  bool has_v6() const
+  {
+    return ! v6_.empty();
+  }
+
+  bool push_back_impl(address const& a)
+  {
+    auto is_v4 = a.is_v4();
+    if (! is_v4 && ! has_v6() && ! v4_.empty())
+    {
+      for (auto& bm : high_)
+        if (! bm.append(v4_.size(), false))
+          return false;
+
+      if (! v6_.append(v4_.size(), false))
+        return false;
+    }
+
+    if (! is_v4 || has_v6())
+    {
+      auto& bytes = a.data();
+      for (size_t i = 0; i < 12; ++i)
+        if (! high_[i].push_back(is_v4 ? 0x00 : bytes[i]))
+          return false;
+
+      if (! v6_.push_back(! is_v4))
+        return false;
+    }
+
+    auto x = low_bits(a);
+    if (prefixes_)
+      for (size_t i = 0; i < 3; ++i)
+        if (! (is_v4
+               ? prefix_bitmaps_[i].push_back(x >> (24 - 8 * i))
+               : prefix_bitmaps_[i].append(1, false)))
+          return false;
+
+    return low_.push_back(x) && v4_.push_back(is_v4);
+  }
+
+  bool push_back_impl(data const& d)
+  {
+    if (auto a = get<address>(d))
+      return push_back_impl(*a);
+    else if (auto s = get<subnet>(d))
+      return push_back_impl(s->network());
+    else
+      return false;
+  }
+
+  bool stretch_impl(size_t n)
+  {
+    if (has_v6())
+    {
+      for (auto& bm : high_)
+        if (! bm.append(n, false))
+          return false;
+
+      if (! v6_.append(n, false))
+        return false;
+    }
+
+    if (prefixes_)
+      for (auto& bm : prefix_bitmaps_)
+        if (! bm.append(n, false))
+          return false;
+
+    return low_.append(n, false) && v4_.append(n, false);
+  }
+
+  trial<Bitstream> lookup_impl(relational_operator op, data const& d) const
+  {
+    if (! (op == equal || op == not_equal || op == in || op == not_in))
+      return error{"unsupported relational operator: ", op};
+
+    if (v4_.empty())
+      return Bitstream{};
+
+    switch (which(d))
+    {
+      default:
+        return error{"invalid value"};
+      case data::tag::address:
+        return lookup_impl(op, *get<address>(d));
+      case data::tag::subnet:
+        return lookup_impl(op, *get<subnet>(d));
+      case data::tag::set:
+        return lookup_set(op, *get<set>(d));
+    }
+  }
+
+  trial<Bitstream> lookup_impl(relational_operator op, address const& a) const
+  {
+    if (! (op == equal || op == not_equal))
+      return error{"unsupported relational operator: ", op};
+
+    auto r = a.is_v4() ? lookup_v4(low_bits(a), 32) : lookup_v6(a, 128);
+    return std::move(op == equal ? r : r.flip());
+  }
+
+  trial<Bitstream> lookup_impl(relational_operator op, subnet const& s) const
+  {
+    if (! (op == in || op == not_in))
+      return error{"unsupported relational operator: ", op};
+
+    auto topk = s.length();
+    if (topk == 0)
+      return error{"invalid IP subnet length: ", topk};
+
+    auto& net = s.network();
+    Bitstream r;
+    if (net.is_v4())
+    {
+      r = lookup_v4(low_bits(net), topk);
+    }
+    else
+    {
+      r = lookup_v6(net, topk);
+
+      // A short IPv6 prefix may cover the IPv4-mapped address space.
+      uint32_t any = 0;
+      if (topk <= 96 && s.contains({&any, address::ipv4, address::host}))
+        r |= v4_;
+    }
+
+    if (op == not_in)
+      r.flip();
+
+    return std::move(r);
+  }
+
+  // Looks up membership in a set of addresses. Instead of probing each
+  // address separately, the lookup descends the bit slices once for all IPv4
+  // addresses in sorted order, so that addresses with a common prefix share
+  // the operations on it, and abandons a prefix as soon as it matches no row.
+  trial<Bitstream> lookup_set(relational_operator op, set const& s) const
+  {
+    if (! (op == in || op == not_in))
+      return error{"unsupported relational operator: ", op};
+
+    Bitstream r{this->size(), false};
+    std::vector<uint32_t> v4;
+    v4.reserve(s.size());
+    for (auto& x : s)
+    {
+      auto a = get<address>(x);
+      if (! a)
+        return error{"not address data: ", x};
+
+      if (a->is_v4())
+        v4.push_back(low_bits(*a));
+      else
+        r |= lookup_v6(*a, 128);
+    }
+
+    std::sort(v4.begin(), v4.end());
+    if (prefixes_)
+    {
+      // Each run of addresses within the same /24 starts at its prefix bitmap.
+      auto i = v4.begin();
+      while (i != v4.end())
+      {
+        auto net = *i >> 8;
+        auto j = std::find_if(i, v4.end(),
+                              [=](uint32_t x) { return x >> 8 != net; });
+
+        auto bs = prefix_bitmaps_[2][net];
+        if (bs)
+          lookup_v4_sorted(&*i, &*i + (j - i), 8, *bs, r);
+
+        i = j;
+      }
+    }
+    else if (! v4.empty())
+    {
+      lookup_v4_sorted(v4.data(), v4.data() + v4.size(), 32, v4_, r);
+    }
+
+    if (op == not_in)
+      r.flip();
+
+    return std::move(r);
+  }
+
+  // Adds to *result* the rows among *candidates* whose low *bits* bits occur
+  // in the sorted range [*first*, *last*). All values in the range must agree
+  // on the bits above, which *candidates* already reflects.
+  void lookup_v4_sorted(uint32_t const* first, uint32_t const* last,
+                        size_t bits, Bitstream const& candidates,
+                        Bitstream& result) const
+  {
+    if (candidates.all_zero())
+      return;
+
+    if (bits == 0)
+    {
+      result |= candidates;
+      return;
+    }
+
+    --bits;
+    auto& bs = low_.coder().get(bits);
+    auto mid = std::partition_point(
+        first, last, [=](uint32_t x) { return ((x >> bits) & 1) == 0; });
+
+    if (first != mid)
+      lookup_v4_sorted(first, mid, bits, candidates - bs, result);
+
+    if (mid != last)
+      lookup_v4_sorted(mid, last, bits, candidates & bs, result);
+  }
+
+  // Computes the IPv4 rows whose top *topk* bits equal those of *x*.
+  Bitstream lookup_v4(uint32_t x, size_t topk) const
+  {
+    // Only the complemented bit slices need to be materialized.
+    std::vector<Bitstream const*> operands;
+    std::deque<Bitstream> intermediates;
+    size_t covered = 0;
+    if (prefixes_)
+      for (auto i = prefix_bitmaps_.size(); i --> 0; )
+      {
+        auto length = 8 * (i + 1);
+        if (length > topk)
+          continue;
+
+        auto bs = prefix_bitmaps_[i][x >> (32 - length)];
+        if (length == topk)
+          return std::move(*bs);
+
+        intermediates.push_back(std::move(*bs));
+        operands.push_back(&intermediates.back());
+        covered = length;
+        break;
+      }
+
+    if (covered == 0)
+      operands.push_back(&v4_);
+
+    for (auto j = 32 - covered; j --> 32 - topk; )
+    {
+      auto& bs = low_.coder().get(j);
+      if ((x >> j) & 1)
+      {
+        operands.push_back(&bs);
+      }
       else
-        return Bitstream{this->size(), op == not_equal};
+      {
+        intermediates.push_back(~bs);
+        operands.push_back(&intermediates.back());
+      }
     }
 
-    return std::move(op == equal ? r : r.flip());
+    return and_all(operands.begin(), operands.end());
   }
 
-  trial<Bitstream> lookup_impl(relational_operator op, subnet const& s) const
+  // Computes the IPv6 rows whose top *topk* bits equal those of *a*.
+  Bitstream lookup_v6(address const& a, size_t topk) const
   {
-    if (! (op == in || op == not_in))
-      return error{"unsupported relational operator: ", op};
+    if (! has_v6())
+      return Bitstream{this->size(), false};
 
-    auto topk = s.length();
-    if (topk == 0)
-      return error{"invalid IP subnet length: ", topk};
+    std::vector<Bitstream const*> operands;
+    std::deque<Bitstream> complements;
+    operands.push_back(&v6_);
 
-    auto net = s.network();
-    auto is_v4 = net.is_v4();
-    if ((is_v4 ? topk + 96 : topk) == 128)
-      return lookup_impl(op == in ? equal : not_equal, s.network());
+    auto& bytes = a.data();
+    for (size_t bit = 0; bit < topk; ++bit)
+    {
+      auto i = bit / 8;
+      auto j = 7 - bit % 8;
+      auto& bs = i < 12
+        ? high_[i].coder().get(j)
+        : low_.coder().get(8 * (15 - i) + j);
 
-    auto r = is_v4 ? v4_ : Bitstream{this->size(), true};
-    auto bit = topk;
-    auto& bytes = net.data();
-    for (size_t i = is_v4 ? 12 : 0; i < 16; ++ i)
-      for (size_t j = 8; j --> 0; )
+      if ((bytes[i] >> j) & 1)
       {
-        auto& bs = bitmaps_[i].coder().get(j);
-        r &= ((bytes[i] >> j) & 1) ? bs : ~bs;
-
-        if (! --bit)
-        {
-          if (op == not_in)
-            r.flip();
-          return std::move(r);
-        }
+        operands.push_back(&bs);
       }
+      else
+      {
+        complements.push_back(~bs);
+        operands.push_back(&complements.back());
+      }
+    }
 
-    return Bitstream{this->size(), false};
+    return and_all(operands.begin(), operands.end());
   }
 
   uint64_t size_impl() const
@@ -873,26 +1995,42 @@ private:
     return v4_.size();
   }
 
-  std::array<bitmap<uint8_t, Bitstream, binary_bitslice_coder>, 16> bitmaps_;
+  bool exact_impl(relational_operator) const
+  {
+    return true;
+  }
+
   Bitstream v4_;
+  Bitstream v6_;
+  bitmap<uint32_t, Bitstream, binary_bitslice_coder> low_;
+  std::array<bitmap<uint8_t, Bitstream, binary_bitslice_coder>, 12> high_;
+  bool prefixes_ = false;
+  std::array<bitmap<uint32_t, Bitstream, equality_coder>, 3> prefix_bitmaps_;
 
 private:
   friend access;
 
   void serialize(serializer& sink) const
   {
-    sink << static_cast<super const&>(*this) << v4_ << bitmaps_;
+    sink << static_cast<super const&>(*this) << v4_ << v6_ << low_ << high_
+         << prefixes_ << prefix_bitmaps_;
   }
 
   void deserialize(deserializer& source)
   {
-    source >> static_cast<super&>(*this) >> v4_ >> bitmaps_;
+    source >> static_cast<super&>(*this) >> v4_ >> v6_ >> low_ >> high_
+           >> prefixes_ >> prefix_bitmaps_;
   }
 
   friend bool operator==(address_bitmap_index const& x,
                          address_bitmap_index const& y)
   {
-    return x.bitmaps_ == y.bitmaps_;
+    return x.v4_ == y.v4_
+        && x.v6_ == y.v6_
+        && x.low_ == y.low_
+        && x.high_ == y.high_
+        && x.prefixes_ == y.prefixes_
+        && x.prefix_bitmaps_ == y.prefix_bitmaps_;
   }
 };
 
@@ -960,6 +2098,11 @@ private:
     return length_.size();
   }
 
+  bool exact_impl(relational_operator) const
+  {
+    return true;
+  }
+
   address_bitmap_index<Bitstream> network_;
   bitmap<uint8_t, Bitstream, range_bitslice_coder> length_;
 
@@ -1057,6 +2200,11 @@ private:
     return proto_.size();
   }
 
+  bool exact_impl(relational_operator) const
+  {
+    return true;
+  }
+
   bitmap<port::number_type, Bitstream, range_bitslice_coder> num_;
   bitmap<std::underlying_type<port::port_type>::type, Bitstream> proto_;
 
@@ -1079,10 +2227,158 @@ private:
   }
 };
 
+/// A composite bitmap index for connection records, i.e., records with the
+/// fields `orig_h`, `orig_p`, `resp_h`, and `resp_p`, with the transport
+/// protocol given by the port types. It hashes the 5-tuple of each record via
+/// detail::connection and equality-encodes the digests. Because most lookups
+/// leave the ephemeral originator port open, the index hashes each tuple once
+/// more without the originator port.
+///
+/// A lookup takes a record with the fields in the above order, where a nil
+/// originator port acts as wildcard. Since distinct tuples may share a
+/// digest, the index is not exact.
+template <typename Bitstream>
+class connection_bitmap_index
+  : public bitmap_index_base<connection_bitmap_index<Bitstream>, Bitstream>
+{
+  using super =
+    bitmap_index_base<connection_bitmap_index<Bitstream>, Bitstream>;
+
+  friend super;
+
+  template <typename>
+  friend struct detail::bitmap_index_model;
+
+public:
+  using bitstream_type = Bitstream;
+
+  /// The positions of `orig_h`, `orig_p`, `resp_h`, and `resp_p` in a record.
+  using field_positions = std::array<uint8_t, 4>;
+
+  connection_bitmap_index() = default;
+
+  /// Constructs a connection bitmap index.
+  /// @param fields The positions of the tuple fields in the indexed records.
+  explicit connection_bitmap_index(field_positions fields)
+    : fields_(fields)
+  {
+  }
+
+private:
+  // Computes the digest of a tuple, or nothing if the tuple is incomplete.
+  static optional<uint64_t> hash(record const& r, field_positions const& fs,
+                                 bool service)
+  {
+    for (auto i : fs)
+      if (i >= r.size())
+        return {};
+
+    auto orig_h = get<address>(r[fs[0]]);
+    auto resp_h = get<address>(r[fs[2]]);
+    auto resp_p = get<port>(r[fs[3]]);
+    if (! (orig_h && resp_h && resp_p))
+      return {};
+
+    detail::connection c;
+    c.src = *orig_h;
+    c.dst = *resp_h;
+    c.sport = port{0, resp_p->type()};
+    c.dport = *resp_p;
+    if (! service)
+    {
+      auto orig_p = get<port>(r[fs[1]]);
+      if (! orig_p)
+        return {};
+
+      c.sport = *orig_p;
+    }
+
+    return std::hash<detail::connection>{}(c);
+  }
+
+  bool push_back_impl(data const& d)
+  {
+    auto r = get<record>(d);
+    if (! r)
+      return false;
+
+    auto h = hash(*r, fields_, false);
+    auto s = hash(*r, fields_, true);
+    return (h ? full_.push_back(*h) : full_.append(1, false))
+        && (s ? service_.push_back(*s) : service_.append(1, false));
+  }
+
+  bool stretch_impl(size_t n)
+  {
+    return full_.append(n, false) && service_.append(n, false);
+  }
+
+  trial<Bitstream> lookup_impl(relational_operator op, data const& d) const
+  {
+    if (! (op == equal || op == not_equal))
+      return error{"unsupported relational operator: ", op};
+
+    auto r = get<record>(d);
+    if (! r)
+      return error{"invalid connection tuple: ", d};
+
+    auto service = r->size() > 1 && is<none>((*r)[1]);
+    auto h = hash(*r, {{0, 1, 2, 3}}, service);
+    if (! h)
+      return error{"invalid connection tuple: ", d};
+
+    auto& bm = service ? service_ : full_;
+    auto result = bm.lookup(equal, *h);
+    if (result && op == not_equal)
+      result->flip();
+
+    return result;
+  }
+
+  uint64_t size_impl() const
+  {
+    return full_.size();
+  }
+
+  field_positions fields_ = {{0, 1, 2, 3}};
+  bitmap<uint64_t, Bitstream, equality_coder> full_;
+  bitmap<uint64_t, Bitstream, equality_coder> service_;
+
+private:
+  friend access;
+
+  void serialize(serializer& sink) const
+  {
+    sink << static_cast<super const&>(*this) << fields_ << full_ << service_;
+  }
+
+  void deserialize(deserializer& source)
+  {
+    source >> static_cast<super&>(*this) >> fields_ >> full_ >> service_;
+  }
+
+  friend bool operator==(connection_bitmap_index const& x,
+                         connection_bitmap_index const& y)
+  {
+    return x.fields_ == y.fields_
+        && x.full_ == y.full_
+        && x.service_ == y.service_;
+  }
+};
+
 template <typename Bitstream, typename... Args>
 trial<bitmap_index<Bitstream>> make_bitmap_index(type_tag t, Args&&... args);
 
 /// A bitmap index for sets, vectors, and tuples.
+///
+/// In *positional* mode, the index keeps one element index per container
+/// position, which makes the cost of a membership lookup grow with the
+/// longest container seen. In *membership* mode, the index records all
+/// elements in a single element index, one row per element, plus a bitstream
+/// that maps each element row to the row of its container. The bitstream
+/// encodes the container sizes in unary: each row contributes a 1 followed by
+/// a 0 per element. A membership lookup then costs a single element lookup,
+/// regardless of container length, plus one pass over the row markers.
 template <typename Bitstream>
 class sequence_bitmap_index
   : public bitmap_index_base<sequence_bitmap_index<Bitstream>, Bitstream>
@@ -1098,8 +2394,12 @@ public:
 
   sequence_bitmap_index() = default;
 
-  sequence_bitmap_index(type t)
-    : elem_type_{std::move(t)}
+  /// Constructs a sequence bitmap index.
+  /// @param t The element type.
+  /// @param positional Whether to index elements per container position.
+  sequence_bitmap_index(type t, bool positional = true)
+    : elem_type_{std::move(t)},
+      positional_{positional}
   {
   }
 
@@ -1121,7 +2421,27 @@ private:
   bool push_back_impl(Container const& c)
   {
     if (c.empty())
-      return size_.append(1, false);
+      return size_.append(1, false) && (positional_ || rows_.push_back(true));
+
+    if (! positional_)
+    {
+      if (bmis_.empty())
+      {
+        auto bmi = make_bitmap_index<Bitstream>(elem_type_);
+        if (! bmi)
+          return false;
+
+        bmis_.push_back(std::move(*bmi));
+      }
+
+      for (auto& x : c)
+        if (! bmis_.front().push_back(x))
+          return false;
+
+      return rows_.push_back(true)
+          && rows_.append(c.size(), false)
+          && size_.push_back(c.size());
+    }
 
     if (bmis_.size() < c.size())
     {
@@ -1146,7 +2466,7 @@ private:
 
   bool stretch_impl(size_t n)
   {
-    return size_.append(n, false);
+    return size_.append(n, false) && (positional_ || rows_.append(n, true));
   }
 
   trial<Bitstream> lookup_impl(relational_operator op, data const& d) const
@@ -1163,6 +2483,48 @@ private:
       return Bitstream{};
 
     Bitstream r;
+    if (! positional_)
+    {
+      if (! bmis_.empty())
+      {
+        auto hits = bmis_.front().lookup(equal, d);
+        if (! hits)
+          return hits;
+
+        // The marker of row k sits at position p_k, with the elements of
+        // row k right after it. Hence element i belongs to the last row k
+        // with p_k - k <= i. Since the hits ascend, so do their rows.
+        bitstream_builder<Bitstream> builder;
+        auto next = rows_.begin();
+        auto end = rows_.end();
+        uint64_t next_row = 0;
+        for (auto i : *hits)
+        {
+          while (next != end && *next - next_row <= i)
+          {
+            ++next;
+            ++next_row;
+          }
+
+          auto row = next_row - 1;
+          if (row < builder.size())
+            continue; // Duplicate element in the same container.
+
+          builder.add(row);
+        }
+
+        r = builder.finish(this->size());
+      }
+
+      if (r.size() < this->size())
+        r.append(this->size() - r.size(), false);
+
+      if (op == not_in)
+        r.flip();
+
+      return std::move(r);
+    }
+
     auto t = bmis_.front().lookup(equal, d);
     if (t)
       r |= *t;
@@ -1192,8 +2554,19 @@ private:
     return size_.size();
   }
 
+  bool optimize_impl()
+  {
+    auto changed = false;
+    for (auto& bmi : bmis_)
+      changed = bmi.optimize() || changed;
+
+    return changed;
+  }
+
   type elem_type_;
+  bool positional_ = true;
   std::vector<bitmap_index<Bitstream>> bmis_;
+  Bitstream rows_;
   bitmap<uint32_t, Bitstream, range_bitslice_coder> size_;
 
 private:
@@ -1201,19 +2574,235 @@ private:
 
   void serialize(serializer& sink) const
   {
-    sink << static_cast<super const&>(*this) << elem_type_ << bmis_ << size_;
+    sink << static_cast<super const&>(*this) << elem_type_ << positional_
+         << bmis_ << rows_ << size_;
   }
 
   void deserialize(deserializer& source)
   {
-    source >> static_cast<super&>(*this) >> elem_type_ >> bmis_ >> size_;
+    source >> static_cast<super&>(*this) >> elem_type_ >> positional_
+           >> bmis_ >> rows_ >> size_;
   }
 
   friend bool
   operator==(sequence_bitmap_index const& x, sequence_bitmap_index const& y)
   {
     return x.elem_type_ == y.elem_type_
+        && x.positional_ == y.positional_
         && x.bmis_ == y.bmis_
+        && x.rows_ == y.rows_
+        && x.size_ == y.size_;
+  }
+};
+
+/// A bitmap index for tables. It keeps one key and one value index per entry
+/// position so that a key/value pair can be looked up by intersecting the two
+/// indexes at the same position.
+///
+/// A lookup with `in` or `ni` interprets its operand as follows:
+/// - a scalar *x* selects the rows whose table has the key *x*.
+/// - a table selects the rows whose table contains all given entries. An
+///   entry with a nil key matches any key, i.e., it selects tables that hold
+///   the entry's value.
+template <typename Bitstream>
+class table_bitmap_index
+  : public bitmap_index_base<table_bitmap_index<Bitstream>, Bitstream>
+{
+  using super = bitmap_index_base<table_bitmap_index<Bitstream>, Bitstream>;
+  friend super;
+
+  template <typename>
+  friend struct detail::bitmap_index_model;
+
+public:
+  using bitstream_type = Bitstream;
+
+  table_bitmap_index() = default;
+
+  /// Constructs a table bitmap index.
+  /// @param key_type The type of the table keys.
+  /// @param value_type The type of the table values.
+  table_bitmap_index(type key_type, type value_type)
+    : key_type_{std::move(key_type)},
+      value_type_{std::move(value_type)}
+  {
+  }
+
+private:
+  bool push_back_impl(data const& d)
+  {
+    auto t = get<table>(d);
+    return t && push_back_impl(*t);
+  }
+
+  bool push_back_impl(table const& t)
+  {
+    if (t.empty())
+      return size_.append(1, false);
+
+    while (keys_.size() < t.size())
+    {
+      auto k = make_bitmap_index<Bitstream>(key_type_);
+      if (! k)
+        return false;
+
+      auto v = make_bitmap_index<Bitstream>(value_type_);
+      if (! v)
+        return false;
+
+      keys_.push_back(std::move(*k));
+      values_.push_back(std::move(*v));
+    }
+
+    size_t i = 0;
+    for (auto& p : t)
+    {
+      if (! keys_[i].push_back(p.first, this->size()))
+        return false;
+
+      if (! values_[i].push_back(p.second, this->size()))
+        return false;
+
+      ++i;
+    }
+
+    return size_.push_back(t.size());
+  }
+
+  bool stretch_impl(size_t n)
+  {
+    return size_.append(n, false);
+  }
+
+  trial<Bitstream> lookup_impl(relational_operator op, data const& d) const
+  {
+    if (op == ni)
+      op = in;
+    else if (op == not_ni)
+      op = not_in;
+
+    if (! (op == in || op == not_in))
+      return error{"unsupported relational operator: ", op};
+
+    if (this->empty())
+      return Bitstream{};
+
+    trial<Bitstream> r = Bitstream{};
+    auto t = get<table>(d);
+    if (! t)
+    {
+      r = lookup_entry(&d, nullptr);
+    }
+    else if (t->empty())
+    {
+      return error{"empty table operand"};
+    }
+    else
+    {
+      for (auto i = t->begin(); i != t->end(); ++i)
+      {
+        auto key = is<none>(i->first) ? nullptr : &i->first;
+        auto e = lookup_entry(key, &i->second);
+        if (! e)
+          return e;
+
+        if (i == t->begin())
+          *r = std::move(*e);
+        else
+          *r &= *e;
+      }
+    }
+
+    if (! r)
+      return r;
+
+    if (op == not_in)
+      r->flip();
+
+    return r;
+  }
+
+  // Computes the rows which have an entry with the given key and value. A
+  // null pointer for either one acts as wildcard.
+  trial<Bitstream> lookup_entry(data const* key, data const* value) const
+  {
+    Bitstream r;
+    for (size_t i = 0; i < keys_.size(); ++i)
+    {
+      trial<Bitstream> bs = Bitstream{};
+      if (key)
+      {
+        bs = keys_[i].lookup(equal, *key);
+        if (! bs)
+          return bs;
+      }
+
+      if (value)
+      {
+        auto v = values_[i].lookup(equal, *value);
+        if (! v)
+          return v;
+
+        if (key)
+          *bs &= *v;
+        else
+          bs = std::move(v);
+      }
+
+      r |= *bs;
+    }
+
+    if (r.size() < this->size())
+      r.append(this->size() - r.size(), false);
+
+    return std::move(r);
+  }
+
+  uint64_t size_impl() const
+  {
+    return size_.size();
+  }
+
+  bool optimize_impl()
+  {
+    auto changed = false;
+    for (auto& bmi : keys_)
+      changed = bmi.optimize() || changed;
+
+    for (auto& bmi : values_)
+      changed = bmi.optimize() || changed;
+
+    return changed;
+  }
+
+  type key_type_;
+  type value_type_;
+  std::vector<bitmap_index<Bitstream>> keys_;
+  std::vector<bitmap_index<Bitstream>> values_;
+  bitmap<uint32_t, Bitstream, range_bitslice_coder> size_;
+
+private:
+  friend access;
+
+  void serialize(serializer& sink) const
+  {
+    sink << static_cast<super const&>(*this) << key_type_ << value_type_
+         << keys_ << values_ << size_;
+  }
+
+  void deserialize(deserializer& source)
+  {
+    source >> static_cast<super&>(*this) >> key_type_ >> value_type_
+           >> keys_ >> values_ >> size_;
+  }
+
+  friend bool
+  operator==(table_bitmap_index const& x, table_bitmap_index const& y)
+  {
+    return x.key_type_ == y.key_type_
+        && x.value_type_ == y.value_type_
+        && x.keys_ == y.keys_
+        && x.values_ == y.values_
         && x.size_ == y.size_;
   }
 };
@@ -1240,7 +2829,7 @@ trial<bitmap_index<Bitstream>> make_bitmap_index(type const& t, Args&&... args)
     case type::tag::time_duration:
       return {arithmetic_bitmap_index<Bitstream, time_duration>(std::forward<Args>(args)...)};
     case type::tag::string:
-      return {string_bitmap_index<Bitstream>(std::forward<Args>(args)...)};
+      return {dictionary_bitmap_index<Bitstream>(std::forward<Args>(args)...)};
     case type::tag::address:
       return {address_bitmap_index<Bitstream>(std::forward<Args>(args)...)};
     case type::tag::subnet:
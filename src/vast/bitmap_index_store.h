@@ -0,0 +1,375 @@
+#ifndef VAST_BITMAP_INDEX_STORE_H
+#define VAST_BITMAP_INDEX_STORE_H
+
+#include <cassert>
+#include <cstring>
+#include <vector>
+#include "vast/aliases.h"
+#include "vast/data.h"
+#include "vast/file_system.h"
+#include "vast/io/array_stream.h"
+#include "vast/io/serialization.h"
+#include "vast/util/trial.h"
+#include "vast/util/hash/crc.h"
+
+namespace vast {
+
+/// Persists a bitmap index on the file system. The store keeps a checkpoint
+/// of the entire bitmap index plus a log of the values appended since. A
+/// flush only appends the new values to the log, and loading replays the log
+/// on top of the checkpoint. Once the log holds more values than the
+/// checkpoint, the next flush writes a new checkpoint and discards the log,
+/// which bounds the total amount of data written to a constant factor of the
+/// index size.
+///
+/// A checkpoint goes to a temporary file first, which then replaces the
+/// previous checkpoint, so that a failure midway leaves the previous
+/// checkpoint and log intact. Should the log survive a new checkpoint,
+/// replaying skips the values which the checkpoint covers already. Each flush
+/// appends one frame to the log, consisting of the size and CRC32 of the
+/// serialized values followed by the values. Replaying stops at the first
+/// incomplete or corrupt frame, which a crash during a flush leaves behind,
+/// and cuts it off the log.
+///
+/// When loading the checkpoint for lookups only, the store can map it into
+/// memory, whereupon the bitmap index decodes only the bitstreams which
+/// lookups touch. As long as nothing gets appended, the store leaves both the
+/// bitmap index and its files untouched.
+/// @tparam BitmapIndex The bitmap index type.
+template <typename BitmapIndex>
+class bitmap_index_store
+{
+public:
+  /// Constructs a bitmap index store.
+  /// @param p The path of the checkpoint. The log resides next to it, with
+  ///          the suffix `.log`.
+  /// @param bmi The bitmap index to start from if *p* holds none yet.
+  bitmap_index_store(path p, BitmapIndex bmi = {})
+    : path_{std::move(p)},
+      log_path_{path_},
+      blank_{bmi},
+      bmi_{std::move(bmi)}
+  {
+    log_path_ += ".log";
+  }
+
+  /// Loads the checkpoint and replays the log, unless loaded already.
+  /// @param mapped If `true`, the bitmap index refers to the checkpoint in
+  ///               memory instead of copying it.
+  /// @returns `nothing` on success.
+  trial<void> load(bool mapped)
+  {
+    if (loaded_)
+      return nothing;
+
+    loaded_ = true;
+
+    if (exists(path_))
+    {
+      trial<void> t = nothing;
+      if (mapped)
+      {
+        mapping_ = mapped_file{path_};
+        t = mapping_.open();
+        if (t)
+          t = io::unarchive(mapping_, last_flush_, bmi_);
+      }
+      else
+      {
+        t = io::unarchive(path_, last_flush_, bmi_);
+      }
+
+      if (! t)
+        return t;
+
+      checkpoint_ = bmi_.size();
+    }
+
+    if (exists(log_path_))
+    {
+      auto t = replay_log();
+      if (! t)
+        return t;
+
+      last_flush_ = bmi_.size();
+    }
+
+    return nothing;
+  }
+
+  /// Reloads a mapped bitmap index without the mapping, because a checkpoint
+  /// replaces the file which the undecoded bitstreams still point into.
+  /// @returns `nothing` on success.
+  trial<void> unmap()
+  {
+    if (! mapping_.is_open())
+      return nothing;
+
+    assert(! modified_);
+    bmi_ = blank_;
+    checkpoint_ = 0;
+    logged_ = 0;
+    loaded_ = false;
+    auto t = load(false);
+    mapping_.close();
+    return t;
+  }
+
+  /// Appends a value to the bitmap index and records it for the next flush.
+  /// @param x The value to append.
+  /// @param id The ID of the event which *x* belongs to.
+  /// @returns `true` on success.
+  bool push_back(data x, event_id id)
+  {
+    assert(! mapped());
+    if (! bmi_.push_back(x, id))
+      return false;
+
+    modified_ = true;
+    log_.emplace_back(id, std::move(x));
+    return true;
+  }
+
+  /// Optimizes the encoding of the bitmap index, in which case the next
+  /// flush writes a checkpoint. Without values appended since loading, the
+  /// encoding stays as it is, because the checkpoint has it settled already.
+  /// @returns `true` if the encoding changed.
+  bool optimize()
+  {
+    if (! modified_ || ! bmi_.optimize())
+      return false;
+
+    last_flush_ = 0;
+    return true;
+  }
+
+  /// Writes the values appended since the last flush, either to the log or
+  /// as part of a new checkpoint.
+  /// @returns `nothing` on success.
+  trial<void> flush()
+  {
+    if (unflushed() == 0)
+      return nothing;
+
+    // A flush after a change in encoding must write a checkpoint.
+    auto t = checkpoint_due() ? checkpoint() : append_log();
+    if (! t)
+      return t;
+
+    last_flush_ = bmi_.size();
+    return nothing;
+  }
+
+  /// Retrieves the bitmap index.
+  /// @returns The bitmap index.
+  BitmapIndex const& bitmap_index() const
+  {
+    return bmi_;
+  }
+
+  /// Retrieves the path of the checkpoint.
+  /// @returns The path of the checkpoint.
+  vast::path const& checkpoint_path() const
+  {
+    return path_;
+  }
+
+  /// Retrieves the path of the log.
+  /// @returns The path of the log.
+  vast::path const& log_path() const
+  {
+    return log_path_;
+  }
+
+  /// Checks whether the store has loaded the bitmap index.
+  /// @returns `true` if the store has loaded the bitmap index.
+  bool loaded() const
+  {
+    return loaded_;
+  }
+
+  /// Checks whether the store has appended values since loading.
+  /// @returns `true` if the store has appended values since loading.
+  bool modified() const
+  {
+    return modified_;
+  }
+
+  /// Checks whether the bitmap index refers to a mapped checkpoint.
+  /// @returns `true` if the bitmap index refers to a mapped checkpoint.
+  bool mapped() const
+  {
+    return mapping_.is_open();
+  }
+
+  /// Checks whether the next flush writes a checkpoint rather than
+  /// appending to the log.
+  /// @returns `true` if the next flush writes a checkpoint.
+  bool checkpoint_due() const
+  {
+    return last_flush_ == 0 || logged_ + log_.size() > checkpoint_;
+  }
+
+  /// Retrieves the number of rows appended since the last flush.
+  /// @returns The number of rows that the next flush writes.
+  uint64_t unflushed() const
+  {
+    auto size = static_cast<uint64_t>(bmi_.size());
+    return size > last_flush_ ? size - last_flush_ : 0;
+  }
+
+private:
+  // Writes the entire bitmap index and discards the log.
+  trial<void> checkpoint()
+  {
+    // Files open without truncation, so we start from scratch.
+    auto tmp = path_;
+    tmp += ".tmp";
+    if (exists(tmp) && ! rm(tmp))
+      return error{"failed to remove ", tmp};
+
+    auto size = static_cast<decltype(last_flush_)>(bmi_.size());
+    auto t = io::archive(tmp, size, bmi_);
+    if (! t)
+      return t;
+
+    if (! mv(tmp, path_))
+      return error{"failed to rename ", tmp, " to ", path_};
+
+    if (exists(log_path_) && ! rm(log_path_))
+      return error{"failed to remove ", log_path_};
+
+    checkpoint_ = size;
+    logged_ = 0;
+    log_.clear();
+    return nothing;
+  }
+
+  // Appends the values since the last flush to the log.
+  trial<void> append_log()
+  {
+    std::vector<uint8_t> payload;
+    auto t = io::archive(payload, log_);
+    if (! t)
+      return t;
+
+    uint64_t size = payload.size();
+    uint32_t crc = util::crc32::digest_bytes(payload.data(), payload.size());
+    std::vector<uint8_t> frame(frame_header + payload.size());
+    std::memcpy(frame.data(), &size, sizeof(size));
+    std::memcpy(frame.data() + sizeof(size), &crc, sizeof(crc));
+    std::memcpy(frame.data() + frame_header, payload.data(), payload.size());
+
+    file f{log_path_};
+    t = f.open(file::write_only, true);
+    if (! t)
+      return t;
+
+    if (! f.write(frame.data(), frame.size()))
+      return error{"failed to write to ", log_path_};
+
+    logged_ += log_.size();
+    log_.clear();
+    return nothing;
+  }
+
+  // Pushes the logged values onto the bitmap index.
+  trial<void> replay_log()
+  {
+    auto contents = vast::load(log_path_);
+    if (! contents)
+      return contents.error();
+
+    auto& log = *contents;
+    size_t offset = 0;
+    while (log.size() - offset >= frame_header)
+    {
+      uint64_t size;
+      uint32_t crc;
+      std::memcpy(&size, log.data() + offset, sizeof(size));
+      std::memcpy(&crc, log.data() + offset + sizeof(size), sizeof(crc));
+      auto payload = log.data() + offset + frame_header;
+      if (log.size() - offset - frame_header < size
+          || util::crc32::digest_bytes(payload, size) != crc)
+        break;
+
+      std::vector<std::pair<event_id, data>> entries;
+      {
+        io::array_input_stream source{payload, size};
+        binary_deserializer d{source};
+        d >> entries;
+      }
+
+      for (auto& entry : entries)
+      {
+        if (entry.first > 0 && entry.first < bmi_.size())
+          continue;
+
+        if (! bmi_.push_back(entry.second, entry.first))
+          return error{"failed to replay value ", entry.second,
+                       " of event ", entry.first};
+      }
+
+      logged_ += entries.size();
+      offset += frame_header + size;
+    }
+
+    if (offset < log.size())
+      return truncate_log(log, offset);
+
+    return nothing;
+  }
+
+  // Cuts off an incomplete or corrupt frame at the end of the log, so that
+  // subsequent flushes append after the last valid frame. As with
+  // checkpoints, the valid frames go to a temporary file first.
+  trial<void> truncate_log(std::string const& log, size_t size)
+  {
+    if (size == 0)
+    {
+      if (! rm(log_path_))
+        return error{"failed to remove ", log_path_};
+
+      return nothing;
+    }
+
+    auto tmp = log_path_;
+    tmp += ".tmp";
+    if (exists(tmp) && ! rm(tmp))
+      return error{"failed to remove ", tmp};
+
+    {
+      file f{tmp};
+      auto t = f.open(file::write_only);
+      if (! t)
+        return t;
+
+      if (! f.write(log.data(), size))
+        return error{"failed to write to ", tmp};
+    }
+
+    if (! mv(tmp, log_path_))
+      return error{"failed to rename ", tmp, " to ", log_path_};
+
+    return nothing;
+  }
+
+  // The size of a frame header in the log: payload size plus CRC32.
+  static constexpr size_t frame_header = sizeof(uint64_t) + sizeof(uint32_t);
+
+  vast::path const path_;
+  vast::path log_path_;
+  BitmapIndex const blank_;
+  BitmapIndex bmi_;
+  mapped_file mapping_;
+  bool loaded_ = false;
+  bool modified_ = false;
+  uint64_t last_flush_ = 1;
+  uint64_t checkpoint_ = 0;
+  uint64_t logged_ = 0;
+  std::vector<std::pair<event_id, data>> log_;
+};
+
+} // namespace vast
+
+#endif
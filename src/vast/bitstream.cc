@@ -1,7 +1,51 @@
 #include "vast/bitstream.h"
 
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "vast/detail/bitwise.h"
+#include "vast/util/byte_swap.h"
+#include "vast/util/thread_pool.h"
+
 namespace vast {
 
+namespace {
+
+// Writes the positions of the 1-bits in a block into a buffer.
+// @returns The number of positions written.
+bitvector::size_type decode_block(bitvector::block_type block,
+                                  bitvector::size_type offset,
+                                  bitvector::size_type* out,
+                                  bitvector::size_type n)
+{
+  bitvector::size_type k = 0;
+  while (block && k < n)
+  {
+    out[k++] = offset + bitvector::lowest_bit(block);
+    block &= block - 1;
+  }
+
+  return k;
+}
+
+// Writes the positions of a 1-fill spanning [first, last) into a buffer.
+// @returns The number of positions written.
+bitvector::size_type decode_fill(bitvector::size_type first,
+                                 bitvector::size_type last,
+                                 bitvector::size_type* out,
+                                 bitvector::size_type n)
+{
+  auto k = std::min(n, last - first);
+  for (bitvector::size_type j = 0; j < k; ++j)
+    out[j] = first + j;
+
+  return k;
+}
+
+} // namespace <anonymous>
+
 detail::bitstream_concept::iterator::iterator(iterator const& other)
   : concept_{other.concept_ ? other.concept_->copy() : nullptr}
 {
@@ -49,6 +93,8 @@ detail::bitstream_concept::iterator::dereference() const
 }
 
 
+#ifndef VAST_MONOMORPHIC_BITSTREAM
+
 bitstream::bitstream(bitstream const& other)
   : concept_{other.concept_ ? other.concept_->copy() : nullptr}
 {
@@ -152,6 +198,12 @@ void bitstream::clear_impl() noexcept
   concept_->clear_impl();
 }
 
+void bitstream::reserve_impl(size_type blocks)
+{
+  assert(concept_);
+  concept_->reserve_impl(blocks);
+}
+
 bool bitstream::at(size_type i) const
 {
   assert(concept_);
@@ -218,7 +270,14 @@ bitstream::size_type bitstream::find_prev_impl(size_type i) const
   return concept_->find_prev_impl(i);
 }
 
-bitvector const& bitstream::bits_impl() const
+bitstream::size_type
+bitstream::decode_impl(size_type i, size_type* out, size_type n) const
+{
+  assert(concept_);
+  return concept_->decode_impl(i, out, n);
+}
+
+bitvector bitstream::bits_impl() const
 {
   assert(concept_);
   return concept_->bits_impl();
@@ -245,6 +304,314 @@ bool operator==(bitstream const& x, bitstream const& y)
   return x.equals(y);
 }
 
+bitstream detail::apply_all(std::vector<bitstream const*> const& xs,
+                            bool conjunction)
+{
+  // An invalid operand voids a conjunction but leaves a disjunction
+  // unaffected, just like the binary operators.
+  bitstream_concept const* first = nullptr;
+  std::vector<bitstream_concept const*> others;
+  for (auto x : xs)
+    if (! x->concept_)
+    {
+      if (conjunction)
+        return {};
+    }
+    else if (! first)
+    {
+      first = x->concept_.get();
+    }
+    else
+    {
+      others.push_back(x->concept_.get());
+    }
+
+  bitstream result;
+  if (first)
+    result.concept_ = others.empty()
+      ? first->copy()
+      : first->combine(others, conjunction);
+
+  return result;
+}
+
+bitvector::size_type detail::count_apply(bitstream const& lhs,
+                                         bitstream const& rhs,
+                                         count_operation op)
+{
+  // An invalid operand acts like in the corresponding binary operator: it
+  // voids a conjunction and leaves a disjunction unaffected.
+  if (lhs.concept_ && rhs.concept_)
+    return lhs.concept_->combine_count(*rhs.concept_, op);
+
+  if (op == count_operation::or_ && (lhs.concept_ || rhs.concept_))
+    return lhs.concept_ ? lhs.count() : rhs.count();
+
+  if (op == count_operation::andnot && lhs.concept_)
+    return lhs.count();
+
+  return 0;
+}
+
+#else // VAST_MONOMORPHIC_BITSTREAM
+
+bitstream::operator bool() const
+{
+  return valid_;
+}
+
+bool bitstream::equals(bitstream const& other) const
+{
+  assert(valid_);
+  assert(other.valid_);
+  return bitstream_ == other.bitstream_;
+}
+
+void bitstream::bitwise_not()
+{
+  if (valid_)
+    bitstream_.bitwise_not();
+}
+
+void bitstream::bitwise_and(bitstream const& other)
+{
+  if (valid_ && other.valid_)
+  {
+    bitstream_.bitwise_and(other.bitstream_);
+  }
+  else
+  {
+    bitstream_.clear_impl();
+    valid_ = false;
+  }
+}
+
+void bitstream::bitwise_or(bitstream const& other)
+{
+  if (! other.valid_)
+    return;
+
+  if (valid_)
+  {
+    bitstream_.bitwise_or(other.bitstream_);
+  }
+  else
+  {
+    bitstream_ = other.bitstream_;
+    valid_ = true;
+  }
+}
+
+void bitstream::bitwise_xor(bitstream const& other)
+{
+  if (valid_ && other.valid_)
+  {
+    bitstream_.bitwise_xor(other.bitstream_);
+  }
+  else
+  {
+    bitstream_.clear_impl();
+    valid_ = false;
+  }
+}
+
+void bitstream::bitwise_subtract(bitstream const& other)
+{
+  if (valid_ && other.valid_)
+    bitstream_.bitwise_subtract(other.bitstream_);
+}
+
+void bitstream::append_impl(size_type n, bool bit)
+{
+  assert(valid_);
+  bitstream_.append_impl(n, bit);
+}
+
+void bitstream::append_block_impl(block_type block, size_type bits)
+{
+  assert(valid_);
+  bitstream_.append_block_impl(block, bits);
+}
+
+void bitstream::push_back_impl(bool bit)
+{
+  assert(valid_);
+  bitstream_.push_back_impl(bit);
+}
+
+void bitstream::trim_impl()
+{
+  assert(valid_);
+  bitstream_.trim_impl();
+}
+
+void bitstream::clear_impl() noexcept
+{
+  assert(valid_);
+  bitstream_.clear_impl();
+}
+
+void bitstream::reserve_impl(size_type blocks)
+{
+  assert(valid_);
+  bitstream_.reserve_impl(blocks);
+}
+
+bool bitstream::at(size_type i) const
+{
+  assert(valid_);
+  return bitstream_.at(i);
+}
+
+bitstream::size_type bitstream::size_impl() const
+{
+  assert(valid_);
+  return bitstream_.size_impl();
+}
+
+bitstream::size_type bitstream::count_impl() const
+{
+  assert(valid_);
+  return bitstream_.count_impl();
+}
+
+bool bitstream::empty_impl() const
+{
+  assert(valid_);
+  return bitstream_.empty_impl();
+}
+
+bitstream::const_iterator bitstream::begin_impl() const
+{
+  assert(valid_);
+  return bitstream_.begin_impl();
+}
+
+bitstream::const_iterator bitstream::end_impl() const
+{
+  assert(valid_);
+  return bitstream_.end_impl();
+}
+
+bool bitstream::back_impl() const
+{
+  assert(valid_);
+  return bitstream_.back_impl();
+}
+
+bitstream::size_type bitstream::find_first_impl() const
+{
+  assert(valid_);
+  return bitstream_.find_first_impl();
+}
+
+bitstream::size_type bitstream::find_next_impl(size_type i) const
+{
+  assert(valid_);
+  return bitstream_.find_next_impl(i);
+}
+
+bitstream::size_type bitstream::find_last_impl() const
+{
+  assert(valid_);
+  return bitstream_.find_last_impl();
+}
+
+bitstream::size_type bitstream::find_prev_impl(size_type i) const
+{
+  assert(valid_);
+  return bitstream_.find_prev_impl(i);
+}
+
+bitstream::size_type
+bitstream::decode_impl(size_type i, size_type* out, size_type n) const
+{
+  assert(valid_);
+  return bitstream_.decode_impl(i, out, n);
+}
+
+bitvector bitstream::bits_impl() const
+{
+  assert(valid_);
+  return bitstream_.bits_impl();
+}
+
+// To remain compatible with the polymorphic bitstream, we write the wrapped
+// bitstream as if it were the model which a polymorphic bitstream holds.
+using default_bitstream_model = detail::bitstream_model<default_bitstream>;
+
+void bitstream::serialize(serializer& sink) const
+{
+  sink << valid_;
+  if (! valid_)
+    return;
+  auto gti = global_typeid(typeid(default_bitstream_model));
+  assert(gti);
+  sink.begin_instance(typeid(default_bitstream_model));
+  sink.write_type(gti);
+  sink << bitstream_;
+  sink.end_instance();
+}
+
+void bitstream::deserialize(deserializer& source)
+{
+  bool valid;
+  source >> valid;
+  if (! valid)
+    return;
+  global_type_info const* gti = nullptr;
+  source.begin_instance(typeid(default_bitstream_model));
+  if (! (source.read_type(gti) && gti
+         && *gti == typeid(default_bitstream_model)))
+    return;
+  source >> bitstream_;
+  source.end_instance();
+  valid_ = true;
+}
+
+bool operator==(bitstream const& x, bitstream const& y)
+{
+  return x.equals(y);
+}
+
+bitstream detail::apply_all(std::vector<bitstream const*> const& xs,
+                            bool conjunction)
+{
+  // An invalid operand voids a conjunction but leaves a disjunction
+  // unaffected, just like the binary operators.
+  std::vector<default_bitstream const*> operands;
+  operands.reserve(xs.size());
+  for (auto x : xs)
+    if (x->valid_)
+      operands.push_back(&x->bitstream_);
+    else if (conjunction)
+      return {};
+
+  if (operands.empty())
+    return {};
+  if (operands.size() == 1)
+    return bitstream{*operands[0]};
+  return bitstream{apply_all(operands, conjunction)};
+}
+
+bitvector::size_type detail::count_apply(bitstream const& lhs,
+                                         bitstream const& rhs,
+                                         count_operation op)
+{
+  if (lhs.valid_ && rhs.valid_)
+    return count_apply(lhs.bitstream_, rhs.bitstream_, op);
+
+  if (op == count_operation::or_ && (lhs.valid_ || rhs.valid_))
+    return lhs.valid_ ? lhs.count() : rhs.count();
+
+  if (op == count_operation::andnot && lhs.valid_)
+    return lhs.count();
+
+  return 0;
+}
+
+#endif // VAST_MONOMORPHIC_BITSTREAM
+
 
 null_bitstream::iterator
 null_bitstream::iterator::begin(null_bitstream const& n)
@@ -374,6 +741,11 @@ void null_bitstream::clear_impl() noexcept
   bits_.clear();
 }
 
+void null_bitstream::reserve_impl(size_type blocks)
+{
+  bits_.reserve(blocks * block_width);
+}
+
 bool null_bitstream::at(size_type i) const
 {
   return bits_[i];
@@ -429,6 +801,22 @@ null_bitstream::size_type null_bitstream::find_prev_impl(size_type i) const
   return bits_.find_prev(i);
 }
 
+null_bitstream::size_type
+null_bitstream::decode_impl(size_type i, size_type* out, size_type n) const
+{
+  size_type k = 0;
+  for (auto b = i / block_width; b < bits_.blocks() && k < n; ++b)
+  {
+    auto block = bits_.block(b);
+    if (b == i / block_width)
+      block &= all_one << (i % block_width);
+
+    k += decode_block(block, b * block_width, out + k, n - k);
+  }
+
+  return k;
+}
+
 bitvector const& null_bitstream::bits_impl() const
 {
   return bits_;
@@ -673,6 +1061,21 @@ ewah_bitstream::ewah_bitstream(size_type n, bool bit)
   append(n, bit);
 }
 
+ewah_bitstream::ewah_bitstream(ewah_bitstream_view const& view)
+  : num_bits_{view.num_bits_},
+    last_marker_{view.last_marker_}
+{
+  for (size_type i = 0; i < view.blocks(); ++i)
+  {
+    auto bits = i + 1 < view.blocks()
+      ? block_width
+      : view.num_block_bits_ - i * block_width;
+    bits_.append(view.block(i), bits);
+  }
+
+  reindex();
+}
+
 bool ewah_bitstream::equals(ewah_bitstream const& other) const
 {
   return bits_ == other.bits_;
@@ -810,6 +1213,8 @@ void ewah_bitstream::append_impl(size_type n, bool bit)
     }
 
     last_marker_ = bits_.blocks() - 1;
+    auto run = marker_num_clean(bits_.block(last_marker_)) * block_width;
+    index_marker(last_marker_, num_bits_ - remaining_bits - run);
   }
 
   bits_.resize(bits_.size() + remaining_bits, bit);
@@ -980,22 +1385,41 @@ void ewah_bitstream::trim_impl()
       bits_.last_block() = all_one;
     }
   }
+
+  // Trimming may have removed or modified the markers from the last one on.
+  while (! skips_.empty() && skips_.back().first >= last_marker_)
+    skips_.pop_back();
 }
 
 void ewah_bitstream::clear_impl() noexcept
 {
   bits_.clear();
+  skips_.clear();
   num_bits_ = last_marker_ = 0;
 }
 
+void ewah_bitstream::reserve_impl(size_type blocks)
+{
+  bits_.reserve(blocks * block_width);
+}
+
 bool ewah_bitstream::at(size_type i) const
 {
-  for (auto& seq : sequence_range{*this})
-    if (i >= seq.offset && i < seq.offset + seq.length)
-      return seq.is_fill() ? seq.data : seq.data & bitvector::bit_mask(i);
+  if (i >= num_bits_)
+  {
+    auto msg = "EWAH element out-of-range element access at index ";
+    throw std::out_of_range{msg + std::to_string(i)};
+  }
+
+  auto loc = locate(i);
+  auto marker = bits_.block(loc.first);
+  auto clean_end = loc.second + marker_num_clean(marker) * block_width;
+  if (i < clean_end)
+    return marker_type(marker);
 
-  auto msg = "EWAH element out-of-range element access at index ";
-  throw std::out_of_range{msg + std::to_string(i)};
+  // Positions beyond the run of the last marker map to the last block.
+  auto block = loc.first + 1 + (i - clean_end) / block_width;
+  return bits_.block(block) & bitvector::bit_mask(i);
 }
 
 ewah_bitstream::size_type ewah_bitstream::size_impl() const
@@ -1005,14 +1429,26 @@ ewah_bitstream::size_type ewah_bitstream::size_impl() const
 
 ewah_bitstream::size_type ewah_bitstream::count_impl() const
 {
+  if (bits_.empty())
+    return 0;
+
+  // We hand each run of dirty blocks as a whole to the population count
+  // kernel and only look at the markers ourselves.
   size_type n = 0;
-  for (auto& seq : sequence_range{*this})
-    if (seq.is_literal())
-      n += bitvector::count(seq.data);
-    else if (seq.data)
-      n += seq.length;
+  size_type i = 0;
+  auto last = bits_.blocks() - 1;
+  while (i < last)
+  {
+    auto marker = bits_.block(i);
+    auto num_dirty = marker_num_dirty(marker);
+    if (marker_type(marker))
+      n += marker_num_clean(marker) * block_width;
 
-  return n;
+    n += detail::popcount(bits_.data() + i + 1, num_dirty);
+    i += num_dirty + 1;
+  }
+
+  return n + bitvector::count(bits_.block(last));
 }
 
 bool ewah_bitstream::empty_impl() const
@@ -1055,6 +1491,50 @@ ewah_bitstream::size_type ewah_bitstream::find_prev_impl(size_type i) const
   return i == 0 ? npos : find_backward(i - 1);
 }
 
+ewah_bitstream::size_type
+ewah_bitstream::decode_impl(size_type i, size_type* out, size_type n) const
+{
+  if (i >= num_bits_)
+    return 0;
+
+  auto loc = locate(i);
+  auto marker = loc.first;
+  auto offset = loc.second;
+  auto last = bits_.blocks() - 1;
+
+  // Decodes a block starting at position *pos*, ignoring bits before *i*.
+  size_type k = 0;
+  auto decode_from = [&](block_type block, size_type pos)
+  {
+    if (pos < i)
+      block &= all_one << (i - pos);
+
+    k += decode_block(block, pos, out + k, n - k);
+  };
+
+  while (marker < last && k < n)
+  {
+    auto block = bits_.block(marker);
+    auto num_clean = marker_num_clean(block);
+    auto num_dirty = marker_num_dirty(block);
+    auto clean_end = offset + num_clean * block_width;
+    if (marker_type(block) && i < clean_end)
+      k += decode_fill(std::max(i, offset), clean_end, out + k, n - k);
+
+    auto first = i > clean_end ? (i - clean_end) / block_width : 0;
+    for (auto b = first; b < num_dirty && k < n; ++b)
+      decode_from(bits_.block(marker + 1 + b), clean_end + b * block_width);
+
+    offset = clean_end + num_dirty * block_width;
+    marker += num_dirty + 1;
+  }
+
+  if (k < n)
+    decode_from(bits_.block(last), offset);
+
+  return k;
+}
+
 bitvector const& ewah_bitstream::bits_impl() const
 {
   return bits_;
@@ -1104,6 +1584,7 @@ void ewah_bitstream::integrate_last_block()
       auto m = marker_num_clean(marker_type(0, last_block_type), 1);
       last_block = m;
       last_marker_ = bits_.blocks() - 1;
+      index_marker(last_marker_, num_bits_ - block_width);
     }
   }
   else
@@ -1126,6 +1607,7 @@ void ewah_bitstream::bump_dirty_count()
     auto dirty_block = last_block;
     last_block = marker_num_dirty(1);
     last_marker_ = bits_.blocks() - 1;
+    index_marker(last_marker_, num_bits_ - block_width);
     bits_.append(dirty_block);
   }
   else
@@ -1135,91 +1617,792 @@ void ewah_bitstream::bump_dirty_count()
   }
 }
 
-ewah_bitstream::size_type ewah_bitstream::find_forward(size_type i) const
+void ewah_bitstream::index_marker(size_type marker, size_type offset)
+{
+  auto prev = skips_.empty() ? 0 : skips_.back().first;
+  if (marker - prev >= skip_interval)
+    skips_.emplace_back(marker, offset);
+}
+
+void ewah_bitstream::reindex()
 {
-  auto range = sequence_range{*this};
-  auto seq = range.begin();
-  auto end = range.end();
+  skips_.clear();
+  if (bits_.empty())
+    return;
 
-  while (seq != end)
+  size_type marker = 0;
+  size_type offset = 0;
+  while (marker < bits_.blocks() - 1)
   {
-    // First we skip over all sequences {[a,b) | b <= i} and stop at the
-    // first sequence.
-    if (seq->offset + seq->length <= i)
-    {
-      ++seq;
-      continue;
-    }
+    index_marker(marker, offset);
+    auto block = bits_.block(marker);
+    auto num_dirty = marker_num_dirty(block);
+    offset += (marker_num_clean(block) + num_dirty) * block_width;
+    marker += num_dirty + 1;
+  }
+}
 
-    assert(seq->offset + seq->length);
+std::pair<ewah_bitstream::size_type, ewah_bitstream::size_type>
+ewah_bitstream::locate(size_type i) const
+{
+  assert(! bits_.empty());
 
-    // Then we check the single sequence [a,b) | i >= a && i < b.
-    if (seq->data)
-    {
-      if (seq->is_fill())
-        return i;
-
-      auto idx = bitvector::bit_index(i);
-      auto bit =
-        // TODO: factor this type of lookup into a utility function.
-        idx == 0
-        ? bitvector::lowest_bit(seq->data)
-        : bitvector::next_bit(seq->data, idx - 1);
-
-      if (bit != npos)
-        return seq->offset + bit;
-    }
+  // Start at the closest indexed marker and walk the remaining markers.
+  auto s = std::upper_bound(
+      skips_.begin(), skips_.end(), i,
+      [](size_type x, std::pair<size_type, size_type> const& skip)
+      {
+        return x < skip.second;
+      });
 
-    ++seq;
-    break;
+  size_type marker = 0;
+  size_type offset = 0;
+  if (s != skips_.begin())
+  {
+    --s;
+    marker = s->first;
+    offset = s->second;
   }
 
-  // Finally we investigate the remaining sequences {[a,b) | i > b}.
-  while (seq != end)
+  auto last = bits_.blocks() - 1;
+  while (true)
   {
-    if (seq->data)
-      return seq->is_fill()
-        ? seq->offset
-        : seq->offset + bitvector::lowest_bit(seq->data);
+    auto block = bits_.block(marker);
+    auto num_dirty = marker_num_dirty(block);
+    auto run = (marker_num_clean(block) + num_dirty) * block_width;
+    auto next = marker + num_dirty + 1;
+    if (i < offset + run || next >= last)
+      break;
 
-    ++seq;
+    offset += run;
+    marker = next;
   }
 
-  return npos;
+  return {marker, offset};
 }
 
-ewah_bitstream::size_type ewah_bitstream::find_backward(size_type i) const
+ewah_bitstream::size_type
+ewah_bitstream::find_backward(size_type marker, size_type offset,
+                              size_type i) const
 {
-  size_type last = npos;
-  auto range = sequence_range{*this};
-
-  for (auto& seq : range)
+  assert(i >= offset);
+  auto block = bits_.block(marker);
+  auto clean_end = offset + marker_num_clean(block) * block_width;
+  if (i >= clean_end)
   {
-    if (seq.offset + seq.length > i)
+    auto dirty = std::min(marker_num_dirty(block),
+                          (i - clean_end) / block_width + 1);
+    for (auto b = dirty; b > 0; --b)
     {
-      if (! seq.data)
-        return last;
-
-      if (seq.is_fill())
-        return i;
-
-      auto idx = bitvector::bit_index(i);
-      if (idx == bitvector::block_width - 1)
-        return seq.offset + bitvector::highest_bit(seq.data);
+      auto pos = clean_end + (b - 1) * block_width;
+      auto dirty_block = bits_.block(marker + b);
+      if (i - pos < block_width - 1)
+        dirty_block &= ~(all_one << (i - pos + 1));
 
-      auto prev = bitvector::prev_bit(seq.data, idx + 1);
-      return prev == npos ? last : seq.offset + prev;
+      if (dirty_block)
+        return pos + bitvector::highest_bit(dirty_block);
     }
-
-    if (seq.data)
-      last = seq.offset +
-        (seq.is_fill() ? seq.length - 1 : bitvector::highest_bit(seq.data));
   }
 
-  return last;
+  if (clean_end > offset && marker_type(block))
+    return std::min(i, clean_end - 1);
+
+  return npos;
 }
 
-void ewah_bitstream::serialize(serializer& sink) const
+ewah_bitstream::size_type ewah_bitstream::find_forward(size_type i) const
+{
+  if (i >= num_bits_)
+    return npos;
+
+  auto loc = locate(i);
+  auto marker = loc.first;
+  auto offset = loc.second;
+  auto last = bits_.blocks() - 1;
+
+  // Scans a block starting at position *pos* for a 1-bit at or after *i*.
+  auto scan = [&](block_type block, size_type pos) -> size_type
+  {
+    if (pos < i)
+      block &= all_one << (i - pos);
+
+    return block ? pos + bitvector::lowest_bit(block) : npos;
+  };
+
+  while (marker < last)
+  {
+    auto block = bits_.block(marker);
+    auto num_clean = marker_num_clean(block);
+    auto num_dirty = marker_num_dirty(block);
+    auto clean_end = offset + num_clean * block_width;
+    if (num_clean > 0 && marker_type(block) && i < clean_end)
+      return std::max(i, offset);
+
+    auto first = i > clean_end ? (i - clean_end) / block_width : 0;
+    for (auto b = first; b < num_dirty; ++b)
+    {
+      auto pos = scan(bits_.block(marker + 1 + b),
+                      clean_end + b * block_width);
+      if (pos != npos)
+        return pos;
+    }
+
+    offset = clean_end + num_dirty * block_width;
+    marker += num_dirty + 1;
+  }
+
+  return scan(bits_.block(last), offset);
+}
+
+ewah_bitstream::size_type ewah_bitstream::find_backward(size_type i) const
+{
+  if (num_bits_ == 0)
+    return npos;
+
+  if (i >= num_bits_)
+    i = num_bits_ - 1;
+
+  auto loc = locate(i);
+  auto marker = loc.first;
+  auto offset = loc.second;
+  auto block = bits_.block(marker);
+  auto run_end = offset +
+    (marker_num_clean(block) + marker_num_dirty(block)) * block_width;
+
+  if (i >= run_end)
+  {
+    // The position lies in the last block.
+    auto last_block = bits_.last_block();
+    if (i - run_end < block_width - 1)
+      last_block &= ~(all_one << (i - run_end + 1));
+
+    if (last_block)
+      return run_end + bitvector::highest_bit(last_block);
+
+    if (run_end == 0)
+      return npos;
+
+    i = run_end - 1;
+  }
+
+  auto pos = i >= offset ? find_backward(marker, offset, i) : npos;
+  if (pos != npos)
+    return pos;
+
+  // Since we can only walk markers forward, we scan the preceding segments
+  // of the skip index in reverse order, each from front to back.
+  auto s = std::lower_bound(
+      skips_.begin(), skips_.end(), marker,
+      [](std::pair<size_type, size_type> const& skip, size_type x)
+      {
+        return skip.first < x;
+      });
+
+  auto end = marker;
+  while (true)
+  {
+    size_type m = 0;
+    size_type o = 0;
+    if (s != skips_.begin())
+    {
+      --s;
+      m = s->first;
+      o = s->second;
+    }
+
+    auto start = m;
+    while (m < end)
+    {
+      auto b = bits_.block(m);
+      auto run = (marker_num_clean(b) + marker_num_dirty(b)) * block_width;
+      if (run > 0)
+      {
+        auto p = find_backward(m, o, o + run - 1);
+        if (p != npos)
+          pos = p;
+      }
+
+      o += run;
+      m += marker_num_dirty(b) + 1;
+    }
+
+    if (pos != npos || start == 0)
+      return pos;
+
+    end = start;
+  }
+}
+
+class ewah_bitstream::run_cursor
+{
+public:
+  explicit run_cursor(ewah_bitstream const& bs)
+    : bits_{bs.bits_},
+      last_{bs.bits_.blocks() - 1}
+  {
+    assert(! bits_.empty());
+    next_marker();
+  }
+
+  /// Constructs a cursor which begins at a given position.
+  /// @param bs The bitstream to walk.
+  /// @param offset The block-aligned position, which must lie before the
+  ///               last block.
+  run_cursor(ewah_bitstream const& bs, size_type offset)
+    : run_cursor{bs}
+  {
+    assert(offset % block_width == 0);
+    if (offset == 0)
+      return;
+
+    auto loc = bs.locate(offset);
+    idx_ = loc.first;
+    clean_ = dirty_ = 0;
+    next_marker();
+    skip((offset - loc.second) / block_width);
+  }
+
+  /// Checks whether the cursor has reached the last block.
+  bool at_tail() const
+  {
+    return clean_ == 0 && dirty_ == 0;
+  }
+
+  /// Retrieves the number of remaining clean blocks in the current run.
+  size_type clean() const
+  {
+    return clean_;
+  }
+
+  /// Retrieves the type of the current clean run.
+  bool fill() const
+  {
+    return fill_;
+  }
+
+  /// Retrieves the number of remaining dirty blocks in the current run.
+  size_type dirty() const
+  {
+    return dirty_;
+  }
+
+  /// Retrieves a pointer to the remaining dirty blocks in the current run.
+  block_type const* dirty_blocks() const
+  {
+    return bits_.data() + idx_;
+  }
+
+  /// Retrieves the current block, i.e., either the current fill, the current
+  /// dirty block, or the last block.
+  block_type block() const
+  {
+    if (clean_ > 0)
+      return fill_ ? all_one : 0;
+
+    return bits_.block(dirty_ > 0 ? idx_ : last_);
+  }
+
+  /// Retrieves the number of valid bits in the last block.
+  size_type tail_bits() const
+  {
+    return bitvector::bit_index(bits_.size() - 1) + 1;
+  }
+
+  /// Advances the cursor, possibly across runs.
+  /// @param n The number of blocks to advance.
+  void skip(size_type n)
+  {
+    while (n > 0)
+    {
+      assert(! at_tail());
+      auto k = std::min(n, clean_ > 0 ? clean_ : dirty_);
+      consume(k);
+      n -= k;
+    }
+  }
+
+  /// Advances the cursor within the current run.
+  /// @param n The number of blocks to advance.
+  void consume(size_type n)
+  {
+    if (clean_ > 0)
+    {
+      assert(n <= clean_);
+      clean_ -= n;
+    }
+    else
+    {
+      assert(n <= dirty_);
+      dirty_ -= n;
+      idx_ += n;
+    }
+
+    if (at_tail())
+      next_marker();
+  }
+
+private:
+  void next_marker()
+  {
+    while (at_tail() && idx_ < last_)
+    {
+      auto marker = bits_.block(idx_++);
+      clean_ = marker_num_clean(marker);
+      dirty_ = marker_num_dirty(marker);
+      fill_ = marker_type(marker);
+    }
+  }
+
+  bitvector const& bits_;
+  size_type last_;
+  size_type idx_ = 0;
+  size_type clean_ = 0;
+  size_type dirty_ = 0;
+  bool fill_ = false;
+};
+
+namespace {
+
+// The configuration of parallel bitwise operations. See
+// ewah_bitstream::parallelize. Operations in flight keep the pool alive
+// when a reconfiguration replaces it.
+std::atomic<bitvector::size_type> parallel_threshold{
+  ewah_bitstream::default_parallel_threshold};
+std::shared_ptr<util::thread_pool> parallel_pool;
+
+// Creates the default pool on the first operation above the threshold,
+// unless ewah_bitstream::parallelize came first.
+std::once_flag parallel_init;
+
+std::shared_ptr<util::thread_pool> make_parallel_pool(
+    bitvector::size_type threshold, bitvector::size_type threads)
+{
+  if (threads == 0)
+    threads = std::thread::hardware_concurrency();
+
+  if (threshold == 0 || threads <= 1)
+    return {};
+
+  return std::make_shared<util::thread_pool>(threads - 1);
+}
+
+} // namespace <anonymous>
+
+constexpr ewah_bitstream::size_type ewah_bitstream::default_parallel_threshold;
+
+void ewah_bitstream::parallelize(size_type threshold, size_type threads)
+{
+  std::call_once(parallel_init, [] {});
+  std::atomic_store(&parallel_pool, make_parallel_pool(threshold, threads));
+  parallel_threshold = threshold;
+}
+
+template <typename Operation>
+ewah_bitstream ewah_bitstream::apply_runs(ewah_bitstream const& lhs,
+                                          ewah_bitstream const& rhs,
+                                          bool fill_lhs, bool fill_rhs)
+{
+  if (lhs.empty() && rhs.empty())
+    return {};
+  if (lhs.empty())
+    return rhs;
+  if (rhs.empty())
+    return lhs;
+
+  auto threshold = parallel_threshold.load();
+  if (threshold > 0 && lhs.bits_.blocks() + rhs.bits_.blocks() >= threshold)
+  {
+    std::call_once(parallel_init, [threshold]
+    {
+      std::atomic_store(&parallel_pool, make_parallel_pool(threshold, 0));
+    });
+
+    if (auto pool = std::atomic_load(&parallel_pool))
+    {
+      auto splits = find_splits(lhs, rhs, pool->size() + 1);
+      if (! splits.empty())
+        return apply_parallel<Operation>(*pool, lhs, rhs, fill_lhs, fill_rhs,
+                                         splits);
+    }
+  }
+
+  ewah_bitstream result;
+  run_cursor x{lhs};
+  run_cursor y{rhs};
+  combine_runs<Operation>(x, y, npos, result);
+  finish_runs<Operation>(x, y, fill_lhs, fill_rhs,
+                         std::max(lhs.size(), rhs.size()), result);
+
+  return result;
+}
+
+template <typename Operation>
+void ewah_bitstream::combine_runs(run_cursor& x, run_cursor& y, size_type n,
+                                  ewah_bitstream& result)
+{
+  std::vector<block_type> dirty;
+
+  // Combines a clean run with a run of dirty blocks. If the operation yields
+  // the same clean block irrespective of the dirty block, we get a fill.
+  auto clean_dirty = [&](block_type fill, block_type const* blocks,
+                         size_type num_blocks, bool fill_is_lhs)
+  {
+    auto op = [=](block_type block)
+    {
+      return fill_is_lhs ? Operation::apply(fill, block)
+                         : Operation::apply(block, fill);
+    };
+
+    auto zero = op(0);
+    if (zero == op(all_one) && (zero == 0 || zero == all_one))
+      result.append(num_blocks * block_width, zero != 0);
+    else
+      for (size_type i = 0; i < num_blocks; ++i)
+        result.append_block(op(blocks[i]));
+  };
+
+  while (n > 0 && ! (x.at_tail() || y.at_tail()))
+  {
+    size_type k;
+    if (x.clean() > 0 && y.clean() > 0)
+    {
+      k = std::min({x.clean(), y.clean(), n});
+      auto block = Operation::apply(x.block(), y.block());
+      result.append(k * block_width, block != 0);
+    }
+    else if (x.clean() > 0)
+    {
+      k = std::min({x.clean(), y.dirty(), n});
+      clean_dirty(x.block(), y.dirty_blocks(), k, true);
+    }
+    else if (y.clean() > 0)
+    {
+      k = std::min({x.dirty(), y.clean(), n});
+      clean_dirty(y.block(), x.dirty_blocks(), k, false);
+    }
+    else
+    {
+      k = std::min({x.dirty(), y.dirty(), n});
+      dirty.resize(k);
+      Operation::kernel(dirty.data(), x.dirty_blocks(), y.dirty_blocks(), k);
+      for (auto block : dirty)
+        result.append_block(block);
+    }
+
+    x.consume(k);
+    y.consume(k);
+    n -= k;
+  }
+}
+
+template <typename Operation>
+void ewah_bitstream::finish_runs(run_cursor& x, run_cursor& y,
+                                 bool fill_lhs, bool fill_rhs, size_type size,
+                                 ewah_bitstream& result)
+{
+  // At least one cursor sits now on its last block, which we combine with
+  // the current block of the other cursor.
+  auto block = Operation::apply(x.block(), y.block());
+  if (x.at_tail() && y.at_tail())
+  {
+    result.append_block(block, std::max(x.tail_bits(), y.tail_bits()));
+  }
+  else
+  {
+    result.append_block(block);
+    auto lhs_longer = ! x.at_tail();
+    auto& longer = lhs_longer ? x : y;
+    longer.consume(1);
+    if (lhs_longer ? fill_lhs : fill_rhs)
+    {
+      while (! longer.at_tail())
+      {
+        if (longer.clean() > 0)
+        {
+          auto n = longer.clean();
+          result.append(n * block_width, longer.fill());
+          longer.consume(n);
+        }
+        else
+        {
+          auto n = longer.dirty();
+          auto blocks = longer.dirty_blocks();
+          for (size_type i = 0; i < n; ++i)
+            result.append_block(blocks[i]);
+
+          longer.consume(n);
+        }
+      }
+
+      result.append_block(longer.block(), longer.tail_bits());
+    }
+  }
+
+  result.append(size - result.size(), false);
+}
+
+template <typename Operation>
+ewah_bitstream
+ewah_bitstream::apply_parallel(util::thread_pool& pool,
+                               ewah_bitstream const& lhs,
+                               ewah_bitstream const& rhs,
+                               bool fill_lhs, bool fill_rhs,
+                               std::vector<size_type> const& splits)
+{
+  std::vector<ewah_bitstream> segments(splits.size() + 1);
+  auto compute = [&](size_type i)
+  {
+    auto first = i == 0 ? 0 : splits[i - 1];
+    run_cursor x{lhs, first};
+    run_cursor y{rhs, first};
+    if (i < splits.size())
+    {
+      auto n = (splits[i] - first) / block_width;
+      combine_runs<Operation>(x, y, n, segments[i]);
+    }
+    else
+    {
+      auto size = std::max(lhs.size(), rhs.size()) - first;
+      combine_runs<Operation>(x, y, npos, segments[i]);
+      finish_runs<Operation>(x, y, fill_lhs, fill_rhs, size, segments[i]);
+    }
+  };
+
+  pool.parallel_for(segments.size(), compute);
+
+  auto result = std::move(segments[0]);
+  for (size_type i = 1; i < segments.size(); ++i)
+    result.splice(segments[i]);
+
+  return result;
+}
+
+std::vector<ewah_bitstream::size_type>
+ewah_bitstream::find_splits(ewah_bitstream const& lhs,
+                            ewah_bitstream const& rhs, size_type parts)
+{
+  // Segments must end before the last block of either operand, because
+  // ::finish_runs handles the last blocks.
+  auto last_block = [](ewah_bitstream const& bs)
+  {
+    return (bs.num_bits_ - 1) / block_width * block_width;
+  };
+
+  auto limit = std::min(last_block(lhs), last_block(rhs));
+  auto total = lhs.bits_.blocks() + rhs.bits_.blocks();
+
+  // We walk both skip indexes in the order of their positions. The sum of
+  // the most recent marker indexes approximates the amount of work up to a
+  // position.
+  std::vector<size_type> splits;
+  auto l = lhs.skips_.begin();
+  auto r = rhs.skips_.begin();
+  size_type work_lhs = 0;
+  size_type work_rhs = 0;
+  while (splits.size() + 1 < parts
+         && (l != lhs.skips_.end() || r != rhs.skips_.end()))
+  {
+    size_type offset;
+    if (r == rhs.skips_.end()
+        || (l != lhs.skips_.end() && l->second <= r->second))
+    {
+      work_lhs = l->first;
+      offset = l++->second;
+    }
+    else
+    {
+      work_rhs = r->first;
+      offset = r++->second;
+    }
+
+    if (offset >= limit)
+      break;
+
+    auto target = total * (splits.size() + 1) / parts;
+    if (offset > 0 && work_lhs + work_rhs >= target
+        && (splits.empty() || offset > splits.back()))
+      splits.push_back(offset);
+  }
+
+  return splits;
+}
+
+void ewah_bitstream::splice(ewah_bitstream const& other)
+{
+  assert(num_bits_ % block_width == 0);
+  if (other.empty())
+    return;
+
+  if (empty())
+  {
+    *this = other;
+    return;
+  }
+
+  // Only the first run of the other bitstream may merge with our last run,
+  // so we append it through the regular interface. A leading marker without
+  // any blocks does not count as run.
+  auto& bits = other.bits_;
+  auto last = bits.blocks() - 1;
+  size_type first = 0;
+  size_type offset = 0;
+  while (first < last)
+  {
+    auto marker = bits.block(first);
+    auto num_clean = marker_num_clean(marker);
+    auto num_dirty = marker_num_dirty(marker);
+    if (num_clean > 0)
+      append_impl(num_clean * block_width, marker_type(marker));
+
+    for (size_type i = 1; i <= num_dirty; ++i)
+      append_block_impl(bits.block(first + i), block_width);
+
+    first += num_dirty + 1;
+    offset += (num_clean + num_dirty) * block_width;
+    if (num_clean + num_dirty > 0)
+      break;
+  }
+
+  if (first == last)
+  {
+    append_block_impl(bits.last_block(), other.num_bits_ - offset);
+    return;
+  }
+
+  // The remaining blocks begin with a new marker, which we copy verbatim
+  // after incorporating our last block.
+  integrate_last_block();
+  auto base = bits_.blocks();
+  auto pos = num_bits_;
+  for (auto i = first; i < last; ++i)
+    bits_.append(bits.block(i));
+
+  bits_.append(bits.last_block(), bitvector::bit_index(bits.size() - 1) + 1);
+  num_bits_ += other.num_bits_ - offset;
+  last_marker_ = base + other.last_marker_ - first;
+
+  for (auto marker = base; marker < bits_.blocks() - 1; )
+  {
+    index_marker(marker, pos);
+    auto block = bits_.block(marker);
+    auto num_dirty = marker_num_dirty(block);
+    pos += (marker_num_clean(block) + num_dirty) * block_width;
+    marker += num_dirty + 1;
+  }
+}
+
+ewah_bitstream ewah_bitstream::encode(detail::block_run const* first,
+                                     detail::block_run const* last,
+                                     size_type base, size_type size)
+{
+  ewah_bitstream result;
+  if (size == 0)
+    return result;
+
+  auto words = encode_runs(first, last, base, size, nullptr);
+  result.bits_.reserve(words * block_width);
+  encode_runs(first, last, base, size, &result);
+  assert(result.bits_.blocks() == words);
+  return result;
+}
+
+ewah_bitstream::size_type
+ewah_bitstream::encode_runs(detail::block_run const* first,
+                            detail::block_run const* last,
+                            size_type base, size_type size,
+                            ewah_bitstream* result)
+{
+  // The last block remains a literal outside of any run; all blocks before
+  // it go through the same marker logic as ::integrate_last_block.
+  auto end = (size - 1) / block_width;
+  block_type marker = 0;
+  size_type marker_index = 0;
+  size_type words = 1;
+  size_type pos = 0;
+  if (result)
+    result->bits_.append(0);
+
+  auto new_marker = [&](block_type m)
+  {
+    if (result)
+    {
+      result->bits_.block(marker_index) = marker;
+      result->bits_.append(m);
+      result->index_marker(words, pos * block_width);
+    }
+
+    marker = m;
+    marker_index = words++;
+  };
+
+  auto clean = [&](bool bit, size_type n)
+  {
+    while (n > 0)
+    {
+      auto num_clean = marker_num_clean(marker);
+      if (marker_num_dirty(marker) > 0
+          || (num_clean > 0
+              && (marker_type(marker) != bit || num_clean == marker_clean_max)))
+      {
+        new_marker(marker_type(0, bit));
+        continue;
+      }
+
+      auto k = std::min(n, marker_clean_max - num_clean);
+      marker = marker_num_clean(marker_type(marker, bit), num_clean + k);
+      pos += k;
+      n -= k;
+    }
+  };
+
+  auto dirty = [&](block_type block)
+  {
+    auto num_dirty = marker_num_dirty(marker);
+    if (num_dirty == marker_dirty_max)
+      new_marker(marker_num_dirty(0, 1));
+    else
+      marker = marker_num_dirty(marker, num_dirty + 1);
+
+    if (result)
+      result->bits_.append(block);
+    ++words;
+    ++pos;
+  };
+
+  block_type literal = 0;
+  for (; first != last; ++first)
+  {
+    auto begin = first->first - base;
+    if (begin > pos)
+      clean(false, std::min(begin, end) - pos);
+
+    if (begin + first->length > end)
+      literal = first->block;
+
+    if (begin >= end)
+      break;
+
+    if (first->block == all_one)
+      clean(true, std::min(begin + first->length, end) - begin);
+    else
+      dirty(first->block);
+  }
+
+  if (pos < end)
+    clean(false, end - pos);
+
+  if (result)
+  {
+    result->bits_.block(marker_index) = marker;
+    result->bits_.append(literal, size - end * block_width);
+    result->num_bits_ = size;
+    result->last_marker_ = marker_index;
+  }
+
+  return words + 1;
+}
+
+void ewah_bitstream::serialize(serializer& sink) const
 {
   sink << num_bits_ << last_marker_ << bits_;
 }
@@ -1227,6 +2410,7 @@ void ewah_bitstream::serialize(serializer& sink) const
 void ewah_bitstream::deserialize(deserializer& source)
 {
   source >> num_bits_ >> last_marker_ >> bits_;
+  reindex();
 }
 
 bool operator==(ewah_bitstream const& x, ewah_bitstream const& y)
@@ -1239,4 +2423,958 @@ bool operator<(ewah_bitstream const& x, ewah_bitstream const& y)
   return x.bits_ < y.bits_;
 }
 
+namespace {
+
+struct and_blocks
+{
+  using block_type = bitvector::block_type;
+
+  static block_type apply(block_type x, block_type y)
+  {
+    return x & y;
+  }
+
+  static void kernel(block_type* out, block_type const* x,
+                     block_type const* y, size_t n)
+  {
+    detail::bitwise_and(out, x, y, n);
+  }
+};
+
+struct or_blocks
+{
+  using block_type = bitvector::block_type;
+
+  static block_type apply(block_type x, block_type y)
+  {
+    return x | y;
+  }
+
+  static void kernel(block_type* out, block_type const* x,
+                     block_type const* y, size_t n)
+  {
+    detail::bitwise_or(out, x, y, n);
+  }
+};
+
+struct xor_blocks
+{
+  using block_type = bitvector::block_type;
+
+  static block_type apply(block_type x, block_type y)
+  {
+    return x ^ y;
+  }
+
+  static void kernel(block_type* out, block_type const* x,
+                     block_type const* y, size_t n)
+  {
+    detail::bitwise_xor(out, x, y, n);
+  }
+};
+
+struct nand_blocks
+{
+  using block_type = bitvector::block_type;
+
+  static block_type apply(block_type x, block_type y)
+  {
+    return x & ~y;
+  }
+
+  static void kernel(block_type* out, block_type const* x,
+                     block_type const* y, size_t n)
+  {
+    detail::bitwise_and_not(out, x, y, n);
+  }
+};
+
+} // namespace <anonymous>
+
+ewah_bitstream and_(ewah_bitstream const& lhs, ewah_bitstream const& rhs)
+{
+  return ewah_bitstream::apply_runs<and_blocks>(lhs, rhs, false, false);
+}
+
+ewah_bitstream or_(ewah_bitstream const& lhs, ewah_bitstream const& rhs)
+{
+  return ewah_bitstream::apply_runs<or_blocks>(lhs, rhs, true, true);
+}
+
+ewah_bitstream xor_(ewah_bitstream const& lhs, ewah_bitstream const& rhs)
+{
+  return ewah_bitstream::apply_runs<xor_blocks>(lhs, rhs, true, true);
+}
+
+ewah_bitstream nand_(ewah_bitstream const& lhs, ewah_bitstream const& rhs)
+{
+  return ewah_bitstream::apply_runs<nand_blocks>(lhs, rhs, true, false);
+}
+
+
+constexpr ewah_bitstream_view::size_type ewah_bitstream_view::npos;
+constexpr ewah_bitstream_view::size_type ewah_bitstream_view::block_width;
+constexpr ewah_bitstream_view::block_type ewah_bitstream_view::all_one;
+constexpr ewah_bitstream_view::block_type ewah_bitstream_view::msb_one;
+
+namespace {
+
+// Finds the first 1-bit at or after position i in a bit sequence.
+bitvector::size_type first_one(bitseq const& seq, bitvector::size_type i)
+{
+  if (i >= seq.offset + seq.length)
+    return bitvector::npos;
+  auto skip = i > seq.offset ? i - seq.offset : 0;
+  if (seq.is_fill())
+    return seq.data ? seq.offset + skip : bitvector::npos;
+  auto block = seq.data & (bitvector::all_one << skip);
+  return block ? seq.offset + bitvector::lowest_bit(block) : bitvector::npos;
+}
+
+// Finds the last 1-bit at or before position i in a bit sequence.
+bitvector::size_type last_one(bitseq const& seq, bitvector::size_type i)
+{
+  if (i < seq.offset || seq.length == 0)
+    return bitvector::npos;
+  auto last = std::min(i - seq.offset, seq.length - 1);
+  if (seq.is_fill())
+    return seq.data ? seq.offset + last : bitvector::npos;
+  auto block = last == bitvector::block_width - 1
+    ? seq.data
+    : seq.data & ~(bitvector::all_one << (last + 1));
+  return block ? seq.offset + bitvector::highest_bit(block) : bitvector::npos;
+}
+
+} // namespace <anonymous>
+
+ewah_bitstream_view::cursor::cursor(ewah_bitstream_view const& view)
+  : view_{&view}
+{
+}
+
+bool ewah_bitstream_view::cursor::next(bitseq& seq)
+{
+  auto blocks = view_->blocks();
+  if (next_block_ >= blocks)
+    return false;
+
+  auto block = view_->block(next_block_++);
+  if (num_dirty_ > 0 || next_block_ == blocks)
+  {
+    // A dirty block, or the last block, which does not count as dirty.
+    if (num_dirty_ > 0)
+      --num_dirty_;
+    seq.type = bitseq::literal;
+    seq.data = block;
+    seq.offset += seq.length;
+    seq.length = next_block_ == blocks
+      ? bitvector::bit_index(view_->num_block_bits_ - 1) + 1
+      : block_width;
+    return true;
+  }
+
+  // A marker. Without clean blocks, it only announces dirty blocks.
+  auto clean = ewah_bitstream::marker_num_clean(block);
+  num_dirty_ = ewah_bitstream::marker_num_dirty(block);
+  if (clean == 0)
+    return next(seq);
+
+  seq.type = bitseq::fill;
+  seq.data = ewah_bitstream::marker_type(block) ? all_one : 0;
+  seq.offset += seq.length;
+  seq.length = clean * block_width;
+
+  // Merge subsequent markers of the same type without dirty blocks.
+  while (num_dirty_ == 0 && next_block_ + 1 < blocks)
+  {
+    auto next_marker = view_->block(next_block_);
+    if (ewah_bitstream::marker_type(next_marker) != (seq.data != 0))
+      break;
+    seq.length += ewah_bitstream::marker_num_clean(next_marker) * block_width;
+    num_dirty_ = ewah_bitstream::marker_num_dirty(next_marker);
+    ++next_block_;
+  }
+
+  return true;
+}
+
+ewah_bitstream_view::iterator
+ewah_bitstream_view::iterator::begin(ewah_bitstream_view const& view)
+{
+  return {view};
+}
+
+ewah_bitstream_view::iterator
+ewah_bitstream_view::iterator::end(ewah_bitstream_view const& /* view */)
+{
+  return {};
+}
+
+ewah_bitstream_view::iterator::iterator(ewah_bitstream_view const& view)
+  : cursor_{view},
+    pos_{0}
+{
+  if (cursor_.next(seq_))
+    scan();
+  else
+    pos_ = npos;
+}
+
+bool ewah_bitstream_view::iterator::equals(iterator const& other) const
+{
+  return pos_ == other.pos_;
+}
+
+void ewah_bitstream_view::iterator::increment()
+{
+  assert(pos_ != npos);
+  ++pos_;
+  scan();
+}
+
+ewah_bitstream_view::size_type
+ewah_bitstream_view::iterator::dereference() const
+{
+  return pos_;
+}
+
+void ewah_bitstream_view::iterator::scan()
+{
+  do
+  {
+    auto next = first_one(seq_, pos_);
+    if (next != npos)
+    {
+      pos_ = next;
+      return;
+    }
+  }
+  while (cursor_.next(seq_));
+
+  pos_ = npos;
+}
+
+ewah_bitstream_view::sequence_range::sequence_range(
+    ewah_bitstream_view const& view)
+  : cursor_{view}
+{
+  if (! view.empty())
+    next();
+}
+
+bool ewah_bitstream_view::sequence_range::next_sequence(bitseq& seq)
+{
+  return cursor_.next(seq);
+}
+
+ewah_bitstream_view::ewah_bitstream_view(ewah_bitstream const& bs)
+  : data_{reinterpret_cast<uint8_t const*>(bs.bits_.data())},
+    num_blocks_{bs.bits_.blocks()},
+    num_block_bits_{bs.bits_.size()},
+    num_bits_{bs.num_bits_},
+    last_marker_{bs.last_marker_}
+{
+}
+
+bool ewah_bitstream_view::operator[](size_type i) const
+{
+  if (i >= num_bits_)
+  {
+    auto msg = "EWAH view out-of-range element access at index ";
+    throw std::out_of_range{msg + std::to_string(i)};
+  }
+
+  cursor c{*this};
+  bitseq seq;
+  while (c.next(seq))
+    if (i < seq.offset + seq.length)
+      return seq.is_fill()
+        ? seq.data != 0
+        : (seq.data & bitvector::bit_mask(i - seq.offset)) != 0;
+
+  return false;
+}
+
+ewah_bitstream_view::size_type ewah_bitstream_view::size() const
+{
+  return num_bits_;
+}
+
+ewah_bitstream_view::size_type ewah_bitstream_view::count() const
+{
+  if (num_blocks_ == 0)
+    return 0;
+
+  size_type n = 0;
+  size_type i = 0;
+  auto last = num_blocks_ - 1;
+  while (i < last)
+  {
+    auto marker = block(i);
+    auto num_dirty = ewah_bitstream::marker_num_dirty(marker);
+    if (ewah_bitstream::marker_type(marker))
+      n += ewah_bitstream::marker_num_clean(marker) * block_width;
+
+    for (size_type j = i + 1; j <= i + num_dirty; ++j)
+      n += bitvector::count(block(j));
+
+    i += num_dirty + 1;
+  }
+
+  return n + bitvector::count(block(last));
+}
+
+bool ewah_bitstream_view::empty() const
+{
+  return num_bits_ == 0;
+}
+
+ewah_bitstream_view::const_iterator ewah_bitstream_view::begin() const
+{
+  return const_iterator::begin(*this);
+}
+
+ewah_bitstream_view::const_iterator ewah_bitstream_view::end() const
+{
+  return const_iterator::end(*this);
+}
+
+bool ewah_bitstream_view::back() const
+{
+  assert(! empty());
+  return (*this)[num_bits_ - 1];
+}
+
+ewah_bitstream_view::size_type ewah_bitstream_view::find_first() const
+{
+  return find_forward(0);
+}
+
+ewah_bitstream_view::size_type ewah_bitstream_view::find_next(size_type i) const
+{
+  return i == npos || i + 1 == npos ? npos : find_forward(i + 1);
+}
+
+ewah_bitstream_view::size_type ewah_bitstream_view::find_last() const
+{
+  return find_backward(npos);
+}
+
+ewah_bitstream_view::size_type ewah_bitstream_view::find_prev(size_type i) const
+{
+  return i == 0 ? npos : find_backward(i - 1);
+}
+
+ewah_bitstream_view::size_type
+ewah_bitstream_view::decode(size_type i, size_type* out, size_type n) const
+{
+  size_type k = 0;
+  cursor c{*this};
+  bitseq seq;
+  while (k < n && c.next(seq))
+  {
+    auto end = seq.offset + seq.length;
+    if (seq.data == 0 || i >= end)
+      continue;
+
+    auto first = std::max(i, seq.offset);
+    if (seq.is_fill())
+      k += decode_fill(first, end, out + k, n - k);
+    else
+      k += decode_block(seq.data & (all_one << (first - seq.offset)),
+                        seq.offset, out + k, n - k);
+  }
+
+  return k;
+}
+
+bool ewah_bitstream_view::all_zero() const
+{
+  return find_first() == npos;
+}
+
+ewah_bitstream_view::size_type ewah_bitstream_view::blocks() const
+{
+  return num_blocks_;
+}
+
+ewah_bitstream_view::block_type ewah_bitstream_view::block(size_type i) const
+{
+  assert(i < num_blocks_);
+  block_type block;
+  std::memcpy(&block, data_ + i * sizeof(block_type), sizeof(block_type));
+  return network_order_
+    ? util::byte_swap<network_endian, host_endian>(block)
+    : block;
+}
+
+ewah_bitstream_view::size_type
+ewah_bitstream_view::find_forward(size_type i) const
+{
+  cursor c{*this};
+  bitseq seq;
+  while (c.next(seq))
+  {
+    auto next = first_one(seq, i);
+    if (next != npos)
+      return next;
+  }
+
+  return npos;
+}
+
+ewah_bitstream_view::size_type
+ewah_bitstream_view::find_backward(size_type i) const
+{
+  auto result = npos;
+  cursor c{*this};
+  bitseq seq;
+  while (c.next(seq) && seq.offset <= i)
+  {
+    auto prev = last_one(seq, i);
+    if (prev != npos)
+      result = prev;
+  }
+
+  return result;
+}
+
+void ewah_bitstream_view::serialize(serializer& sink) const
+{
+  // We write the same format as ewah_bitstream, whose bitvector consists of
+  // its size followed by the sequence of blocks.
+  sink << num_bits_ << last_marker_ << num_block_bits_;
+  sink.begin_sequence(num_blocks_);
+  for (size_type i = 0; i < num_blocks_; ++i)
+    sink << block(i);
+  sink.end_sequence();
+}
+
+void ewah_bitstream_view::deserialize(deserializer& source)
+{
+  uint64_t n;
+  source >> num_bits_ >> last_marker_ >> num_block_bits_;
+  source.begin_sequence(n);
+  num_blocks_ = n;
+  void const* data;
+  if (n > 0 && source.read_view(&data, n * sizeof(block_type)))
+  {
+    data_ = reinterpret_cast<uint8_t const*>(data);
+    network_order_ = true;
+    storage_.reset();
+  }
+  else
+  {
+    storage_ = std::make_shared<std::vector<block_type>>(n);
+    for (auto& block : *storage_)
+      source >> block;
+    data_ = reinterpret_cast<uint8_t const*>(storage_->data());
+    network_order_ = false;
+  }
+  source.end_sequence();
+}
+
+bool operator==(ewah_bitstream_view const& x, ewah_bitstream_view const& y)
+{
+  if (x.num_block_bits_ != y.num_block_bits_ || x.num_blocks_ != y.num_blocks_)
+    return false;
+  for (ewah_bitstream_view::size_type i = 0; i < x.num_blocks_; ++i)
+    if (x.block(i) != y.block(i))
+      return false;
+  return true;
+}
+
+ewah_bitstream operator~(ewah_bitstream_view const& x)
+{
+  ewah_bitstream result{x};
+  result.flip();
+  return result;
+}
+
+ewah_bitstream operator&(ewah_bitstream_view const& x,
+                         ewah_bitstream_view const& y)
+{
+  return and_(x, y);
+}
+
+ewah_bitstream operator|(ewah_bitstream_view const& x,
+                         ewah_bitstream_view const& y)
+{
+  return or_(x, y);
+}
+
+ewah_bitstream operator^(ewah_bitstream_view const& x,
+                         ewah_bitstream_view const& y)
+{
+  return xor_(x, y);
+}
+
+ewah_bitstream operator-(ewah_bitstream_view const& x,
+                         ewah_bitstream_view const& y)
+{
+  return nand_(x, y);
+}
+
+
+
+roaring_bitstream::iterator
+roaring_bitstream::iterator::begin(roaring_bitstream const& roaring)
+{
+  return {roaring};
+}
+
+roaring_bitstream::iterator
+roaring_bitstream::iterator::end(roaring_bitstream const& /* roaring */)
+{
+  return {};
+}
+
+roaring_bitstream::iterator::iterator(roaring_bitstream const& roaring)
+  : roaring_{&roaring},
+    pos_{roaring.find_first()}
+{
+}
+
+bool roaring_bitstream::iterator::equals(iterator const& other) const
+{
+  return pos_ == other.pos_;
+}
+
+void roaring_bitstream::iterator::increment()
+{
+  assert(roaring_);
+  assert(pos_ != npos);
+  pos_ = roaring_->find_next(pos_);
+}
+
+roaring_bitstream::size_type roaring_bitstream::iterator::dereference() const
+{
+  assert(roaring_);
+  return pos_;
+}
+
+
+roaring_bitstream::sequence_range::sequence_range(roaring_bitstream const& bs)
+  : bs_{&bs}
+{
+  next();
+}
+
+bool roaring_bitstream::sequence_range::next_sequence(bitseq& seq)
+{
+  static constexpr auto chunk_blocks = container::bitmap_blocks;
+  auto blocks = bitvector::bits_to_blocks(bs_->num_bits_);
+  if (next_block_ >= blocks)
+    return false;
+
+  auto& keys = bs_->keys_;
+  auto key = next_block_ / chunk_blocks;
+  while (next_chunk_ < keys.size() && keys[next_chunk_] < key)
+    ++next_chunk_;
+
+  seq.offset = next_block_ * block_width;
+  if (next_chunk_ < keys.size() && keys[next_chunk_] == key)
+  {
+    // Within a chunk, we hand out literal blocks. Since fills always end at
+    // chunk boundaries, we enter each chunk at its first block.
+    if (next_block_ % chunk_blocks == 0)
+    {
+      blocks_.resize(chunk_blocks);
+      bs_->containers_[next_chunk_].materialize(blocks_.data());
+    }
+
+    seq.type = bitseq::literal;
+    seq.data = blocks_[next_block_ % chunk_blocks];
+    seq.length = std::min(block_width, bs_->num_bits_ - seq.offset);
+    ++next_block_;
+    return true;
+  }
+
+  // Between chunks, we have a 0-fill. A partial last block becomes a literal
+  // to ensure that fills always consist of complete blocks.
+  auto end = blocks;
+  if (next_chunk_ < keys.size())
+    end = std::min(end, keys[next_chunk_] * chunk_blocks);
+  else if (bitvector::bit_index(bs_->num_bits_) != 0)
+    --end;
+
+  seq.data = 0;
+  if (end == next_block_)
+  {
+    seq.type = bitseq::literal;
+    seq.length = bs_->num_bits_ - seq.offset;
+    ++next_block_;
+  }
+  else
+  {
+    seq.type = bitseq::fill;
+    seq.length = (end - next_block_) * block_width;
+    next_block_ = end;
+  }
+
+  return true;
+}
+
+
+roaring_bitstream::roaring_bitstream(size_type n, bool bit)
+{
+  append(n, bit);
+}
+
+bool roaring_bitstream::equals(roaring_bitstream const& other) const
+{
+  return *this == other;
+}
+
+void roaring_bitstream::bitwise_not()
+{
+  if (num_bits_ == 0)
+    return;
+
+  std::vector<size_type> keys;
+  std::vector<container> containers;
+  auto last_key = (num_bits_ - 1) / chunk_width;
+  size_type k = 0;
+  for (size_type key = 0; key <= last_key; ++key)
+  {
+    container c;
+    if (k < keys_.size() && keys_[k] == key)
+      c = std::move(containers_[k++]);
+
+    c.flip(key == last_key ? (num_bits_ - 1) % chunk_width + 1 : chunk_width);
+    if (! c.empty())
+    {
+      keys.push_back(key);
+      containers.push_back(std::move(c));
+    }
+  }
+
+  keys_ = std::move(keys);
+  containers_ = std::move(containers);
+}
+
+void roaring_bitstream::bitwise_and(roaring_bitstream const& other)
+{
+  merge(other, false, false,
+        [](container const& x, container const& y) { return x & y; });
+}
+
+void roaring_bitstream::bitwise_or(roaring_bitstream const& other)
+{
+  merge(other, true, true,
+        [](container const& x, container const& y) { return x | y; });
+}
+
+void roaring_bitstream::bitwise_xor(roaring_bitstream const& other)
+{
+  merge(other, true, true,
+        [](container const& x, container const& y) { return x ^ y; });
+}
+
+void roaring_bitstream::bitwise_subtract(roaring_bitstream const& other)
+{
+  merge(other, true, false,
+        [](container const& x, container const& y) { return x - y; });
+}
+
+void roaring_bitstream::append_impl(size_type n, bool bit)
+{
+  if (! bit)
+  {
+    num_bits_ += n;
+    return;
+  }
+
+  while (n > 0)
+  {
+    auto& c = tail();
+    auto first = num_bits_ % chunk_width;
+    auto last = std::min(chunk_width, first + n);
+    c.append(first, last);
+    n -= last - first;
+    num_bits_ += last - first;
+  }
+}
+
+void roaring_bitstream::append_block_impl(block_type block, size_type bits)
+{
+  if (bits < block_width)
+    block &= ~(all_one << bits);
+
+  // We append each run of 1-bits in the block as a whole.
+  auto base = num_bits_;
+  while (block)
+  {
+    auto first = bitvector::lowest_bit(block);
+    auto run = block >> first;
+    auto length = run == all_one >> first
+      ? block_width - first
+      : bitvector::lowest_bit(~run);
+
+    num_bits_ = base + first;
+    append_impl(length, true);
+    auto end = first + length;
+    block = end == block_width ? 0 : block & (all_one << end);
+  }
+
+  num_bits_ = base + bits;
+}
+
+void roaring_bitstream::push_back_impl(bool bit)
+{
+  if (bit)
+    tail().append(num_bits_ % chunk_width);
+
+  ++num_bits_;
+}
+
+void roaring_bitstream::trim_impl()
+{
+  auto last = find_last();
+  if (last == npos)
+    clear();
+  else
+    num_bits_ = last + 1;
+}
+
+void roaring_bitstream::clear_impl() noexcept
+{
+  keys_.clear();
+  containers_.clear();
+  num_bits_ = 0;
+}
+
+void roaring_bitstream::reserve_impl(size_type)
+{
+  // Containers get allocated lazily per 2^16 chunk, so a block count does
+  // not translate into a meaningful reservation.
+}
+
+bool roaring_bitstream::at(size_type i) const
+{
+  if (i >= num_bits_)
+  {
+    auto msg = "Roaring out-of-range element access at index ";
+    throw std::out_of_range{msg + std::to_string(i)};
+  }
+
+  auto key = i / chunk_width;
+  auto k = std::lower_bound(keys_.begin(), keys_.end(), key);
+  if (k == keys_.end() || *k != key)
+    return false;
+
+  return containers_[k - keys_.begin()].contains(i % chunk_width);
+}
+
+roaring_bitstream::size_type roaring_bitstream::size_impl() const
+{
+  return num_bits_;
+}
+
+roaring_bitstream::size_type roaring_bitstream::count_impl() const
+{
+  size_type n = 0;
+  for (auto& c : containers_)
+    n += c.count();
+
+  return n;
+}
+
+bool roaring_bitstream::empty_impl() const
+{
+  return num_bits_ == 0;
+}
+
+roaring_bitstream::const_iterator roaring_bitstream::begin_impl() const
+{
+  return const_iterator::begin(*this);
+}
+
+roaring_bitstream::const_iterator roaring_bitstream::end_impl() const
+{
+  return const_iterator::end(*this);
+}
+
+bool roaring_bitstream::back_impl() const
+{
+  return at(num_bits_ - 1);
+}
+
+roaring_bitstream::size_type roaring_bitstream::find_first_impl() const
+{
+  if (containers_.empty())
+    return npos;
+
+  return keys_.front() * chunk_width + containers_.front().find_next(0);
+}
+
+roaring_bitstream::size_type
+roaring_bitstream::find_next_impl(size_type i) const
+{
+  if (i == npos || i + 1 >= num_bits_)
+    return npos;
+
+  auto key = (i + 1) / chunk_width;
+  size_type k = std::lower_bound(keys_.begin(), keys_.end(), key)
+    - keys_.begin();
+  for ( ; k < keys_.size(); ++k)
+  {
+    auto start = keys_[k] == key ? (i + 1) % chunk_width : 0;
+    auto r = containers_[k].find_next(start);
+    if (r != container::npos)
+      return keys_[k] * chunk_width + r;
+  }
+
+  return npos;
+}
+
+roaring_bitstream::size_type roaring_bitstream::find_last_impl() const
+{
+  if (containers_.empty())
+    return npos;
+
+  auto last = containers_.back().find_prev(chunk_width - 1);
+  return keys_.back() * chunk_width + last;
+}
+
+roaring_bitstream::size_type
+roaring_bitstream::find_prev_impl(size_type i) const
+{
+  if (i == 0)
+    return npos;
+
+  auto key = (i - 1) / chunk_width;
+  size_type k = std::upper_bound(keys_.begin(), keys_.end(), key)
+    - keys_.begin();
+  while (k --> 0)
+  {
+    auto start = keys_[k] == key ? (i - 1) % chunk_width : chunk_width - 1;
+    auto r = containers_[k].find_prev(start);
+    if (r != container::npos)
+      return keys_[k] * chunk_width + r;
+  }
+
+  return npos;
+}
+
+roaring_bitstream::size_type
+roaring_bitstream::decode_impl(size_type i, size_type* out, size_type n) const
+{
+  if (i >= num_bits_)
+    return 0;
+
+  auto key = i / chunk_width;
+  size_type k = std::lower_bound(keys_.begin(), keys_.end(), key)
+    - keys_.begin();
+  size_type m = 0;
+  for ( ; k < keys_.size() && m < n; ++k)
+  {
+    auto start = keys_[k] == key ? i % chunk_width : 0;
+    m += containers_[k].decode(start, keys_[k] * chunk_width, out + m, n - m);
+  }
+
+  return m;
+}
+
+bitvector roaring_bitstream::bits_impl() const
+{
+  static constexpr auto chunk_blocks = container::bitmap_blocks;
+  bitvector bits(num_bits_);
+  std::vector<block_type> blocks(chunk_blocks);
+  for (size_type k = 0; k < keys_.size(); ++k)
+  {
+    containers_[k].materialize(blocks.data());
+    auto first = keys_[k] * chunk_blocks;
+    auto n = std::min(chunk_blocks, bits.blocks() - first);
+    for (size_type j = 0; j < n; ++j)
+      bits.block(first + j) = blocks[j];
+  }
+
+  return bits;
+}
+
+roaring_bitstream::container& roaring_bitstream::tail()
+{
+  auto key = num_bits_ / chunk_width;
+  if (keys_.empty() || keys_.back() != key)
+  {
+    // The previous chunk is complete, which allows us to pick its final
+    // representation.
+    if (! containers_.empty())
+      containers_.back().optimize();
+
+    keys_.push_back(key);
+    containers_.emplace_back();
+  }
+
+  return containers_.back();
+}
+
+template <typename Operation>
+void roaring_bitstream::merge(roaring_bitstream const& other,
+                              bool keep_lhs, bool keep_rhs, Operation op)
+{
+  std::vector<size_type> keys;
+  std::vector<container> containers;
+  auto add = [&](size_type key, container c)
+  {
+    if (! c.empty())
+    {
+      keys.push_back(key);
+      containers.push_back(std::move(c));
+    }
+  };
+
+  size_type i = 0;
+  size_type j = 0;
+  while (i < keys_.size() || j < other.keys_.size())
+  {
+    if (j == other.keys_.size()
+        || (i < keys_.size() && keys_[i] < other.keys_[j]))
+    {
+      if (keep_lhs)
+        add(keys_[i], std::move(containers_[i]));
+      ++i;
+    }
+    else if (i == keys_.size() || other.keys_[j] < keys_[i])
+    {
+      if (keep_rhs)
+        add(other.keys_[j], other.containers_[j]);
+      ++j;
+    }
+    else
+    {
+      add(keys_[i], op(containers_[i], other.containers_[j]));
+      ++i;
+      ++j;
+    }
+  }
+
+  keys_ = std::move(keys);
+  containers_ = std::move(containers);
+  num_bits_ = std::max(num_bits_, other.num_bits_);
+}
+
+void roaring_bitstream::serialize(serializer& sink) const
+{
+  sink << num_bits_ << keys_ << containers_;
+}
+
+void roaring_bitstream::deserialize(deserializer& source)
+{
+  source >> num_bits_ >> keys_ >> containers_;
+}
+
+bool operator==(roaring_bitstream const& x, roaring_bitstream const& y)
+{
+  return x.num_bits_ == y.num_bits_
+      && x.keys_ == y.keys_
+      && x.containers_ == y.containers_;
+}
+
+bool operator<(roaring_bitstream const& x, roaring_bitstream const& y)
+{
+  return std::lexicographical_compare(x.begin(), x.end(), y.begin(), y.end());
+}
+
 } // namespace vast
@@ -2,7 +2,12 @@
 #define VAST_BITSTREAM_H
 
 #include <algorithm>
+#include <deque>
+#include <memory>
+#include <vector>
+#include "vast/aliases.h"
 #include "vast/bitvector.h"
+#include "vast/detail/roaring_container.h"
 #include "vast/serialization/arithmetic.h"
 #include "vast/serialization/container.h"
 #include "vast/serialization/pointer.h"
@@ -14,15 +19,47 @@ namespace vast {
 class bitstream;
 class null_bitstream;
 class ewah_bitstream;
+class roaring_bitstream;
 
 /// Determines whether a type is a valid bitstream.
 template <typename Bitstream>
 using is_bitstream = util::any<
   std::is_same<Bitstream, bitstream>,
   std::is_same<Bitstream, null_bitstream>,
-  std::is_same<Bitstream, ewah_bitstream>
+  std::is_same<Bitstream, ewah_bitstream>,
+  std::is_same<Bitstream, roaring_bitstream>
 >;
 
+class ewah_bitstream_view;
+
+template <typename Bitstream>
+class bitstream_builder;
+
+namespace util { class thread_pool; }
+
+/// The number of positions a consumer of ::bitstream_base::decode should
+/// request per call, which amortizes the per-call overhead while keeping the
+/// buffer on the stack.
+constexpr size_t decode_batch_size = 1024;
+
+/// Maps a bitstream type to the type of the bitstreams which operations on
+/// it produce. Operations on read-only bitstream views yield their owning
+/// counterpart.
+template <typename Bitstream>
+struct owning_bitstream
+{
+  using type = Bitstream;
+};
+
+template <>
+struct owning_bitstream<ewah_bitstream_view>
+{
+  using type = ewah_bitstream;
+};
+
+template <typename Bitstream>
+using owning_bitstream_t = typename owning_bitstream<Bitstream>::type;
+
 // An abstraction over a contiguous sequence of bits in a bitstream. A bit
 // sequence can have two types: a *fill* sequence representing a homogenous
 // bits, typically greater than or equal to the block size, and a *literal*
@@ -202,6 +239,14 @@ public:
     derived().clear_impl();
   }
 
+  /// Reserves storage for a given number of blocks in the underlying
+  /// encoding. This is merely a hint and does not change the bitstream.
+  /// @param blocks The number of blocks to reserve.
+  void reserve(size_type blocks)
+  {
+    derived().reserve_impl(blocks);
+  }
+
   template <typename Hack = Derived>
   auto begin() const
     -> decltype(std::declval<Hack>().begin_impl())
@@ -264,6 +309,19 @@ public:
     return r;
   }
 
+  /// Decodes the positions of the one-bits at or after a given position in
+  /// bulk. In contrast to iterating, which yields one position at a time,
+  /// decoding scans entire blocks and expands 1-fills as a whole.
+  /// @param i The position at which to begin decoding.
+  /// @param out The buffer receiving the positions in ascending order.
+  /// @param n The capacity of *out*.
+  /// @returns The number of positions written to *out*. A value less than
+  ///          *n* means that there exist no further one-bits.
+  size_type decode(size_type i, size_type* out, size_type n) const
+  {
+    return n == 0 ? 0 : derived().decode_impl(i, out, n);
+  }
+
   /// Checks whether the bitstream consists only of zero.
   /// @returns `true` iff all bits in the bitstream are zero.
   bool all_zero() const
@@ -271,7 +329,10 @@ public:
     return find_first() == npos;
   }
 
-  bitvector const& bits() const
+  /// Retrieves the bits of the bitstream as a bitvector.
+  /// @returns A reference to the bitvector if the bitstream keeps one, and a
+  ///          materialized copy otherwise.
+  decltype(auto) bits() const
   {
     return derived().bits_impl();
   }
@@ -306,6 +367,15 @@ typename bitstream_base<Derived>::size_type const bitstream_base<Derived>::npos;
 
 namespace detail {
 
+/// A run of identical non-zero blocks, as collected by ::bitstream_builder.
+/// Only runs of all-one blocks span more than one block.
+struct block_run
+{
+  bitvector::size_type first;
+  bitvector::size_type length;
+  bitvector::block_type block;
+};
+
 /// The base class for bit sequence ranges.
 template <typename Derived>
 class sequence_range_base
@@ -328,6 +398,41 @@ private:
   bitseq seq_;
 };
 
+/// Computes the conjunction or disjunction of several bitstreams in a single
+/// pass. See ::and_all and ::or_all.
+/// @param xs The operands.
+/// @param conjunction `true` for AND and `false` for OR.
+/// @returns The combination of all operands in *xs*.
+template <typename Bitstream>
+owning_bitstream_t<Bitstream>
+apply_all(std::vector<Bitstream const*> const& xs, bool conjunction);
+
+bitstream apply_all(std::vector<bitstream const*> const& xs, bool conjunction);
+
+/// The bitwise operations whose result the count-only functions evaluate.
+/// See ::and_count, ::or_count, ::andnot_count, and ::intersects.
+enum class count_operation
+{
+  and_,
+  or_,
+  andnot,
+  intersects
+};
+
+/// Counts the 1-bits in the result of a bitwise operation between two
+/// bitstreams without materializing the result.
+/// @param lhs The LHS of the operation.
+/// @param rhs The RHS of the operation.
+/// @param op The operation. For count_operation::intersects, the function
+///           stops at the first 1-bit and thus returns either 0 or 1.
+/// @returns The population count of the result of *op*.
+template <typename LHS, typename RHS>
+typename LHS::size_type
+count_apply(LHS const& lhs, RHS const& rhs, count_operation op);
+
+bitvector::size_type count_apply(bitstream const& lhs, bitstream const& rhs,
+                                 count_operation op);
+
 /// The concept for bitstreams.
 class bitstream_concept
 {
@@ -432,11 +537,17 @@ public:
   virtual void bitwise_or(bitstream_concept const& other) = 0;
   virtual void bitwise_xor(bitstream_concept const& other) = 0;
   virtual void bitwise_subtract(bitstream_concept const& other) = 0;
+  virtual std::unique_ptr<bitstream_concept>
+  combine(std::vector<bitstream_concept const*> const& others,
+          bool conjunction) const = 0;
+  virtual size_type combine_count(bitstream_concept const& other,
+                                  count_operation op) const = 0;
   virtual void append_impl(size_type n, bool bit) = 0;
   virtual void append_block_impl(block_type block, size_type bits) = 0;
   virtual void push_back_impl(bool bit) = 0;
   virtual void trim_impl() = 0;
   virtual void clear_impl() noexcept = 0;
+  virtual void reserve_impl(size_type blocks) = 0;
   virtual bool at(size_type i) const = 0;
   virtual size_type size_impl() const = 0;
   virtual size_type count_impl() const = 0;
@@ -448,7 +559,9 @@ public:
   virtual size_type find_next_impl(size_type i) const = 0;
   virtual size_type find_last_impl() const = 0;
   virtual size_type find_prev_impl(size_type i) const = 0;
-  virtual bitvector const& bits_impl() const = 0;
+  virtual size_type decode_impl(size_type i, size_type* out,
+                                size_type n) const = 0;
+  virtual bitvector bits_impl() const = 0;
 
 protected:
   bitstream_concept() = default;
@@ -528,6 +641,25 @@ public:
     bitstream_.bitwise_subtract(cast(other));
   }
 
+  virtual std::unique_ptr<bitstream_concept>
+  combine(std::vector<bitstream_concept const*> const& others,
+          bool conjunction) const final
+  {
+    std::vector<Bitstream const*> xs;
+    xs.reserve(others.size() + 1);
+    xs.push_back(&bitstream_);
+    for (auto other : others)
+      xs.push_back(&cast(*other));
+    return std::make_unique<bitstream_model>(
+        detail::apply_all(xs, conjunction));
+  }
+
+  virtual size_type combine_count(bitstream_concept const& other,
+                                  count_operation op) const final
+  {
+    return count_apply(bitstream_, cast(other), op);
+  }
+
   virtual void append_impl(size_type n, bool bit) final
   {
     bitstream_.append_impl(n, bit);
@@ -553,6 +685,11 @@ public:
     bitstream_.clear_impl();
   }
 
+  virtual void reserve_impl(size_type blocks) final
+  {
+    bitstream_.reserve_impl(blocks);
+  }
+
   virtual bool at(size_type i) const final
   {
     return bitstream_.at(i);
@@ -608,7 +745,13 @@ public:
     return bitstream_.find_prev_impl(i);
   }
 
-  virtual bitvector const& bits_impl() const final
+  virtual size_type decode_impl(size_type i, size_type* out,
+                                size_type n) const final
+  {
+    return bitstream_.decode_impl(i, out, n);
+  }
+
+  virtual bitvector bits_impl() const final
   {
     return bitstream_.bits_impl();
   }
@@ -632,6 +775,7 @@ private:
 
 } // namespace detail
 
+#ifndef VAST_MONOMORPHIC_BITSTREAM
 /// A polymorphic bitstream with value semantics.
 class bitstream : public bitstream_base<bitstream>,
                   util::equality_comparable<bitstream>
@@ -674,6 +818,7 @@ private:
   void push_back_impl(bool bit);
   void trim_impl();
   void clear_impl() noexcept;
+  void reserve_impl(size_type blocks);
   bool at(size_type i) const;
   size_type size_impl() const;
   size_type count_impl() const;
@@ -685,10 +830,18 @@ private:
   size_type find_next_impl(size_type i) const;
   size_type find_last_impl() const;
   size_type find_prev_impl(size_type i) const;
-  bitvector const& bits_impl() const;
+  size_type decode_impl(size_type i, size_type* out, size_type n) const;
+  bitvector bits_impl() const;
 
   std::unique_ptr<detail::bitstream_concept> concept_;
 
+  friend bitstream detail::apply_all(std::vector<bitstream const*> const& xs,
+                                     bool conjunction);
+
+  friend size_type detail::count_apply(bitstream const& lhs,
+                                       bitstream const& rhs,
+                                       detail::count_operation op);
+
 private:
   friend access;
 
@@ -703,6 +856,7 @@ private:
 
   friend bool operator==(bitstream const& x, bitstream const& y);
 };
+#endif // VAST_MONOMORPHIC_BITSTREAM
 
 /// An uncompressed bitstream that simply forwards all operations to its
 /// underlying ::bitvector.
@@ -761,6 +915,7 @@ public:
 private:
   template <typename>
   friend class detail::bitstream_model;
+  friend bitstream;
   friend bitstream_base<null_bitstream>;
 
   bool equals(null_bitstream const& other) const;
@@ -774,6 +929,7 @@ private:
   void push_back_impl(bool bit);
   void trim_impl();
   void clear_impl() noexcept;
+  void reserve_impl(size_type blocks);
   bool at(size_type i) const;
   size_type size_impl() const;
   size_type count_impl() const;
@@ -785,6 +941,7 @@ private:
   size_type find_next_impl(size_type i) const;
   size_type find_last_impl() const;
   size_type find_prev_impl(size_type i) const;
+  size_type decode_impl(size_type i, size_type* out, size_type n) const;
   bitvector const& bits_impl() const;
 
   bitvector bits_;
@@ -880,10 +1037,36 @@ public:
   ewah_bitstream& operator=(ewah_bitstream const&) = default;
   ewah_bitstream& operator=(ewah_bitstream&&) = default;
 
+  /// Materializes a bitstream view by copying its blocks.
+  /// @param view The view to copy.
+  explicit ewah_bitstream(ewah_bitstream_view const& view);
+
+  /// The default value for the threshold of ::parallelize. Below it, the
+  /// cost of splitting and joining outweighs the gain of a second thread.
+  static constexpr size_type default_parallel_threshold = 1 << 14;
+
+  /// Configures when binary bitwise operations between EWAH bitstreams run
+  /// on multiple threads. An operation splits its operands into segments at
+  /// block-aligned positions, computes the segments concurrently, and
+  /// concatenates the results. All operations share one pool of threads,
+  /// and the calling thread computes segments as well. Without a call to
+  /// this function, operations above ::default_parallel_threshold use all
+  /// hardware threads.
+  /// @param threshold The minimum number of blocks both operands must have
+  ///                  in total to parallelize an operation, or 0 to disable
+  ///                  parallel operations.
+  /// @param threads The number of threads per operation including the
+  ///                calling one, or 0 for the number of hardware threads.
+  static void parallelize(size_type threshold, size_type threads = 0);
+
 private:
   template <typename>
   friend class detail::bitstream_model;
+  friend bitstream;
   friend bitstream_base<ewah_bitstream>;
+  friend ewah_bitstream_view;
+  template <typename>
+  friend class bitstream_builder;
 
   bool equals(ewah_bitstream const& other) const;
   void bitwise_not();
@@ -896,6 +1079,7 @@ private:
   void push_back_impl(bool bit);
   void trim_impl();
   void clear_impl() noexcept;
+  void reserve_impl(size_type blocks);
   bool at(size_type i) const;
   size_type size_impl() const;
   size_type count_impl() const;
@@ -907,6 +1091,7 @@ private:
   size_type find_next_impl(size_type i) const;
   size_type find_last_impl() const;
   size_type find_prev_impl(size_type i) const;
+  size_type decode_impl(size_type i, size_type* out, size_type n) const;
   bitvector const& bits_impl() const;
 
   /// The offset from the LSB which separates clean and dirty counters.
@@ -981,13 +1166,122 @@ private:
   /// @pre `num_bits_ % block_width == 0`
   void bump_dirty_count();
 
+  /// The minimum number of blocks between two entries in the skip index.
+  static constexpr size_type skip_interval = 128;
+
+  /// Records a marker in the skip index if it lies at least ::skip_interval
+  /// blocks after the most recent entry.
+  /// @param marker The block index of the marker.
+  /// @param offset The position of the first bit in the run of *marker*.
+  void index_marker(size_type marker, size_type offset);
+
+  /// Rebuilds the skip index by walking over all markers.
+  void reindex();
+
+  /// Locates the marker whose run contains a given bit. If the bit lies
+  /// beyond the last run, the function returns the last marker.
+  /// @param i The bit position.
+  /// @returns The block index of the marker and the position of the first bit
+  ///          in its run.
+  std::pair<size_type, size_type> locate(size_type i) const;
+
+  /// Finds the last 1-bit at or before a given position in the run of a
+  /// marker.
+  /// @param marker The block index of the marker.
+  /// @param offset The position of the first bit in the run of *marker*.
+  /// @param i The position to start at, which must not precede *offset*.
+  /// @returns The position of the last 1-bit at or before *i* or `npos`.
+  size_type find_backward(size_type marker, size_type offset,
+                          size_type i) const;
+
   size_type find_forward(size_type i) const;
   size_type find_backward(size_type i) const;
 
+  /// Walks the blocks of an EWAH bitstream run by run, where a run is either
+  /// a sequence of clean blocks or a sequence of dirty blocks. The last
+  /// (potentially partial) block does not belong to any run.
+  class run_cursor;
+
+  /// Performs a bitwise operation between two EWAH bitstreams run by run. It
+  /// has the same semantics as ::apply, but processes runs of dirty blocks
+  /// with the vectorized block kernels and entire fills at once.
+  template <typename Operation>
+  static ewah_bitstream apply_runs(ewah_bitstream const& lhs,
+                                   ewah_bitstream const& rhs,
+                                   bool fill_lhs, bool fill_rhs);
+
+  /// Combines the complete blocks of two run cursors until either cursor
+  /// reaches its last block or *n* blocks have been combined.
+  template <typename Operation>
+  static void combine_runs(run_cursor& x, run_cursor& y, size_type n,
+                           ewah_bitstream& result);
+
+  /// Combines the last blocks of two run cursors after ::combine_runs and
+  /// appends the remainder of the longer one according to *fill_lhs* and
+  /// *fill_rhs*. Finally, fills *result* up with 0s to *size* bits.
+  template <typename Operation>
+  static void finish_runs(run_cursor& x, run_cursor& y, bool fill_lhs,
+                          bool fill_rhs, size_type size,
+                          ewah_bitstream& result);
+
+  /// Performs ::apply_runs on multiple threads, with one segment per thread.
+  /// @param pool The threads which help the calling thread.
+  /// @param splits The bit positions at which segments begin, except for
+  ///               the first segment beginning at 0.
+  template <typename Operation>
+  static ewah_bitstream apply_parallel(util::thread_pool& pool,
+                                       ewah_bitstream const& lhs,
+                                       ewah_bitstream const& rhs,
+                                       bool fill_lhs, bool fill_rhs,
+                                       std::vector<size_type> const& splits);
+
+  /// Chooses the positions at which to split two bitstreams for
+  /// ::apply_parallel. Based on the skip indexes of the operands, it
+  /// balances the number of encoded blocks per segment. All positions are
+  /// block-aligned and lie before the last block of either operand.
+  /// @param parts The maximum number of segments.
+  /// @returns The beginning of each segment except for the first.
+  static std::vector<size_type> find_splits(ewah_bitstream const& lhs,
+                                            ewah_bitstream const& rhs,
+                                            size_type parts);
+
+  /// Appends another bitstream, producing the same encoding as appending it
+  /// block by block. All but the first run get copied verbatim.
+  /// @param other The bitstream to append.
+  /// @pre `size() % block_width == 0`
+  void splice(ewah_bitstream const& other);
+
+  /// Encodes a bitstream directly from runs of non-zero blocks, producing
+  /// the same encoding as appending the blocks one by one. A first pass
+  /// counts the words, so that the second one writes the markers and dirty
+  /// words into a buffer of exactly that size.
+  /// @param first The first run.
+  /// @param last One past the last run.
+  /// @param base The block index at which the result begins.
+  /// @param size The number of bits of the result.
+  /// @pre The runs are sorted, disjoint, and lie within *size* bits.
+  static ewah_bitstream encode(detail::block_run const* first,
+                               detail::block_run const* last,
+                               size_type base, size_type size);
+
+  /// Performs a pass of ::encode.
+  /// @param result The bitstream to write into or `nullptr` to only count.
+  /// @returns The number of words of the encoding.
+  static size_type encode_runs(detail::block_run const* first,
+                               detail::block_run const* last,
+                               size_type base, size_type size,
+                               ewah_bitstream* result);
+
   bitvector bits_;
   size_type num_bits_ = 0;
   size_type last_marker_ = 0;
 
+  // A sparse index over the markers which maps the block index of every
+  // few markers to the first bit position of its run. It allows for random
+  // access without walking all markers from the beginning. We maintain it
+  // while appending and do not serialize it.
+  std::vector<std::pair<size_type, size_type>> skips_;
+
 private:
   friend access;
   void serialize(serializer& sink) const;
@@ -1024,216 +1318,1019 @@ private:
 
   friend bool operator==(ewah_bitstream const& x, ewah_bitstream const& y);
   friend bool operator<(ewah_bitstream const& x, ewah_bitstream const& y);
+
+  // Overloads of the generic bitwise operations below, which take precedence
+  // for EWAH bitstreams.
+  friend ewah_bitstream and_(ewah_bitstream const& lhs,
+                             ewah_bitstream const& rhs);
+  friend ewah_bitstream or_(ewah_bitstream const& lhs,
+                            ewah_bitstream const& rhs);
+  friend ewah_bitstream xor_(ewah_bitstream const& lhs,
+                             ewah_bitstream const& rhs);
+  friend ewah_bitstream nand_(ewah_bitstream const& lhs,
+                              ewah_bitstream const& rhs);
 };
 
-/// Performs a bitwise operation on two bitstreams.
-/// The algorithm traverses the two bitstreams side by side.
-///
-/// @param lhs The LHS of the operation.
-///
-/// @param rhs The RHS of the operation
-///
-/// @param fill_lhs A boolean flag that controls the algorithm behavior after
-/// one sequence has reached its end. If `true`, the algorithm will append the
-/// remaining bits of *lhs* to the result iff *lhs* is the longer bitstream. If
-/// `false`, the algorithm returns the result after the first sequence has
-/// reached an end.
-///
-/// @param fill_rhs The same as *fill_lhs*, except that it concerns *rhs*.
-///
-/// @param op The bitwise operation as block-wise lambda, e.g., for XOR:
+/// A read-only view of an EWAH bitstream. It does not own its blocks but
+/// points to blocks which live elsewhere, e.g., in a memory-mapped index file
+/// or in an ::ewah_bitstream. When deserialized through a deserializer which
+/// provides zero-copy access to its input (see ::deserializer::read_view),
+/// the view refers directly into the input buffer, which must therefore
+/// outlive the view. Otherwise, the view falls back to reading its blocks
+/// into shared storage.
 ///
-///     [](block_type lhs, block_type rhs) { return lhs ^ rhs; }
+/// A view supports all const operations of an ::ewah_bitstream and can act
+/// as LHS of ::apply and as operand of ::and_all and ::or_all. Operations
+/// which produce new bitstreams yield an ::ewah_bitstream. A view has the
+/// same serialization format as an ::ewah_bitstream, so that one can read
+/// the serialized bitstream of either type as the other.
 ///
-/// @returns The result of a bitwise operation between *lhs* and *rhs*
-/// according to *op*.
-template <typename Bitstream, typename Operation>
-Bitstream apply(Bitstream const& lhs, Bitstream const& rhs,
-                bool fill_lhs, bool fill_rhs, Operation op)
+/// @note Random access (::at and the finding functions) walks the markers
+/// from the beginning, since a view does not maintain a skip index.
+class ewah_bitstream_view : util::equality_comparable<ewah_bitstream_view>
 {
-  auto rx = typename Bitstream::sequence_range{lhs};
-  auto ry = typename Bitstream::sequence_range{rhs};
-  auto ix = rx.begin();
-  auto iy = ry.begin();
+  // Walks the blocks of a view sequence by sequence.
+  class cursor
+  {
+  public:
+    cursor() = default;
+    cursor(ewah_bitstream_view const& view);
 
-  if (ix == rx.end() && iy == ry.end())
-    return {};
-  if (ix == rx.end())
-    return rhs;
-  if (iy == ry.end())
-    return lhs;
+    bool next(bitseq& seq);
 
-  Bitstream result;
-  auto first = std::min(ix->offset, iy->offset);
-  if (first > 0)
-    result.append(first, false);
+  private:
+    ewah_bitstream_view const* view_ = nullptr;
+    bitvector::size_type next_block_ = 0;
+    bitvector::size_type num_dirty_ = 0;
+  };
 
-  auto lx = ix->length;
-  auto ly = iy->length;
-  while (ix != rx.end() && iy != rx.end())
+public:
+  using size_type = bitvector::size_type;
+  using block_type = bitvector::block_type;
+  static constexpr size_type npos = bitvector::npos;
+  static constexpr size_type block_width = bitvector::block_width;
+  static constexpr block_type all_one = bitvector::all_one;
+  static constexpr block_type msb_one = bitvector::msb_one;
+
+  using const_iterator = class iterator
+    : public util::iterator_facade<
+               iterator, std::forward_iterator_tag, size_type, size_type
+             >
   {
-    auto min = std::min(lx, ly);
-    auto block = op(ix->data, iy->data);
+  public:
+    iterator() = default;
 
-    if (ix->is_fill() && iy->is_fill())
-    {
-      result.append(min, block != 0);
-      lx -= min;
-      ly -= min;
-    }
-    else if (ix->is_fill())
-    {
-      result.append_block(block);
-      lx -= Bitstream::block_width;
-      ly = 0;
-    }
-    else if (iy->is_fill())
-    {
-      result.append_block(block);
-      ly -= Bitstream::block_width;
-      lx = 0;
-    }
-    else
-    {
-      result.append_block(block, std::max(lx, ly));
-      lx = ly = 0;
-    }
+    static iterator begin(ewah_bitstream_view const& view);
+    static iterator end(ewah_bitstream_view const& view);
 
-    if (lx == 0 && ++ix != rx.end())
-      lx = ix->length;
+  private:
+    friend util::iterator_access;
 
-    if (ly == 0 && ++iy != ry.end())
-      ly = iy->length;
-  }
+    iterator(ewah_bitstream_view const& view);
 
-  if (fill_lhs)
-  {
-    while (ix != rx.end())
-    {
-      if (ix->is_fill())
-        result.append(lx, ix->data);
-      else
-        result.append_block(ix->data, ix->length);
+    bool equals(iterator const& other) const;
+    void increment();
+    size_type dereference() const;
 
-      if (++ix != rx.end())
-        lx = ix->length;
-    }
-  }
+    // Advances to the next 1-bit at or after the current position.
+    void scan();
 
-  if (fill_rhs)
+    cursor cursor_;
+    bitseq seq_;
+    size_type pos_ = npos;
+  };
+
+  class sequence_range : public detail::sequence_range_base<sequence_range>
   {
-    while (iy != ry.end())
-    {
-      if (iy->is_fill())
-        result.append(ly, iy->data);
-      else
-        result.append_block(iy->data, iy->length);
+  public:
+    explicit sequence_range(ewah_bitstream_view const& view);
 
-      if (++iy != ry.end())
-        ly = iy->length;
-    }
-  }
+  private:
+    friend detail::sequence_range_base<sequence_range>;
 
-  // If the result has not yet been filled with the remaining bits of either
-  // LHS or RHS, we have to fill it up with zeros. This is necessary, for
-  // example, to ensure that the complement of the result can still be used in
-  // further bitwise operations with bitstreams having the size of
-  // max(size(LHS), size(RHS)).
-  result.append(std::max(lhs.size(), rhs.size()) - result.size(), false);
+    bool next_sequence(bitseq& seq);
 
-  return result;
-}
+    cursor cursor_;
+  };
 
-template <typename Bitstream>
-Bitstream and_(Bitstream const& lhs, Bitstream const& rhs)
-{
-  using block_type = typename Bitstream::block_type;
-  return apply(lhs, rhs, false, false,
-               [](block_type x, block_type y) { return x & y; });
-}
+  ewah_bitstream_view() = default;
 
-template <typename Bitstream>
-Bitstream or_(Bitstream const& lhs, Bitstream const& rhs)
-{
-  using block_type = typename Bitstream::block_type;
-  return apply(lhs, rhs, true, true,
-               [](block_type x, block_type y) { return x | y; });
-}
+  /// Constructs a view of an EWAH bitstream.
+  /// @param bs The bitstream to view, which must outlive the view and must
+  ///           not change while the view exists.
+  explicit ewah_bitstream_view(ewah_bitstream const& bs);
 
-template <typename Bitstream>
-Bitstream xor_(Bitstream const& lhs, Bitstream const& rhs)
-{
-  using block_type = typename Bitstream::block_type;
-  return apply(lhs, rhs, true, true,
-               [](block_type x, block_type y) { return x ^ y; });
-}
+  /// Inspects a bit at a given position.
+  /// @param i The bit position to check.
+  /// @returns `true` if bit *i* is set.
+  /// @throws std::out_of_range if `i >= size()`.
+  bool operator[](size_type i) const;
 
-template <typename Bitstream>
-Bitstream nand_(Bitstream const& lhs, Bitstream const& rhs)
-{
-  using block_type = typename Bitstream::block_type;
-  return apply(lhs, rhs, true, false,
-               [](block_type x, block_type y) { return x & ~y; });
-}
+  /// Retrieves the number of bits in the viewed bitstream.
+  /// @returns The number of bits.
+  size_type size() const;
 
-template <typename Bitstream>
-Bitstream nor_(Bitstream const& lhs, Bitstream const& rhs)
-{
-  using block_type = typename Bitstream::block_type;
-  return apply(lhs, rhs, true, true,
-               [](block_type x, block_type y) { return x | ~y; });
-}
+  /// Retrieves the population count of the viewed bitstream.
+  /// @returns The number of set bits.
+  size_type count() const;
 
-/// Transposes a vector of bitstreams into a character matrix of 0s and 1s.
-/// @param out The output iterator.
-/// @param v A vector of bitstreams.
-template <
-  typename Iterator,
-  typename Bitstream,
-  typename = std::enable_if_t<is_bitstream<Bitstream>::value>
->
-trial<void> print(std::vector<Bitstream> const& v, Iterator&& out)
-{
-  if (v.empty())
-    return nothing;
+  /// Checks whether the viewed bitstream has no bits.
+  /// @returns `true` iff `size() == 0`.
+  bool empty() const;
 
-  using const_iterator = typename Bitstream::const_iterator;
-  using ipair = std::pair<const_iterator, const_iterator>;
-  std::vector<ipair> is(v.size());
-  for (size_t i = 0; i < v.size(); ++i)
-    is[i] = {v[i].begin(), v[i].end()};
+  const_iterator begin() const;
+  const_iterator end() const;
 
-  auto const zero_row = std::string(v.size(), '0') + '\n';
-  typename Bitstream::size_type last = 0;
-  bool done = false;
-  while (! done)
-  {
-    // Compute the minimum.
-    typename Bitstream::size_type min = Bitstream::npos;
-    for (auto& p : is)
-      if (p.first != p.second && *p.first < min)
-        min = *p.first;
+  /// Accesses the last bit of the viewed bitstream.
+  /// @returns The bit value of the last bit.
+  bool back() const;
 
-    if (min == Bitstream::npos)
-      break;
+  /// The counterparts of the finding functions of ::bitstream_base.
+  size_type find_first() const;
+  size_type find_next(size_type i) const;
+  size_type find_last() const;
+  size_type find_prev(size_type i) const;
 
-    // Fill up the distance to the last row with 0 rows.
-    auto distance = min - last;
-    for (decltype(min) i = 0; i < distance; ++i)
-      std::copy(zero_row.begin(), zero_row.end(), out);
-    last = min + 1;
+  /// The counterpart of ::bitstream_base::decode.
+  size_type decode(size_type i, size_type* out, size_type n) const;
 
-    // Print the current transposed row.
-    done = true;
-    for (auto& p : is)
-    {
-      if (p.first != p.second && *p.first == min)
-      {
-        *out++ = '1';
-        done = false;
-        ++p.first;
-      }
-      else
+  /// Checks whether the viewed bitstream consists only of zeros.
+  /// @returns `true` iff all bits are zero.
+  bool all_zero() const;
+
+  /// Retrieves the number of (encoded) blocks of the viewed bitstream.
+  /// @returns The number of blocks.
+  size_type blocks() const;
+
+  /// Retrieves a block of the viewed bitstream.
+  /// @param i The block index.
+  /// @returns The block at index *i*.
+  /// @pre `i < blocks()`
+  block_type block(size_type i) const;
+
+private:
+  // Finds the first 1-bit at or after a given position.
+  size_type find_forward(size_type i) const;
+
+  // Finds the last 1-bit at or before a given position.
+  size_type find_backward(size_type i) const;
+
+  // Points to the blocks. Since blocks in a serialized bitstream are neither
+  // aligned nor in host byte order, we load them with memcpy and swap them
+  // if necessary.
+  uint8_t const* data_ = nullptr;
+  bool network_order_ = false;
+  size_type num_blocks_ = 0;
+  size_type num_block_bits_ = 0; // The size of the underlying bitvector.
+  size_type num_bits_ = 0;
+  size_type last_marker_ = 0;
+  std::shared_ptr<std::vector<block_type>> storage_;
+
+private:
+  friend ewah_bitstream;
+  friend access;
+  void serialize(serializer& sink) const;
+  void deserialize(deserializer& source);
+
+  friend bool operator==(ewah_bitstream_view const& x,
+                         ewah_bitstream_view const& y);
+};
+
+ewah_bitstream operator~(ewah_bitstream_view const& x);
+ewah_bitstream operator&(ewah_bitstream_view const& x,
+                         ewah_bitstream_view const& y);
+ewah_bitstream operator|(ewah_bitstream_view const& x,
+                         ewah_bitstream_view const& y);
+ewah_bitstream operator^(ewah_bitstream_view const& x,
+                         ewah_bitstream_view const& y);
+ewah_bitstream operator-(ewah_bitstream_view const& x,
+                         ewah_bitstream_view const& y);
+
+/// A bitstream encoded as *Roaring bitmap*. The bitstream partitions the bit
+/// positions into chunks of 2^16 bits and only stores the chunks which have
+/// at least one 1-bit. Each chunk uses the most compact of three
+/// representations: a sorted array of positions for sparse chunks, an
+/// uncompressed bitmap for dense chunks, or a list of runs for clustered
+/// chunks.
+class roaring_bitstream : public bitstream_base<roaring_bitstream>,
+                          util::totally_ordered<roaring_bitstream>
+{
+public:
+  using const_iterator = class iterator
+    : public util::iterator_facade<
+               iterator, std::forward_iterator_tag, size_type, size_type
+             >
+  {
+  public:
+    iterator() = default;
+
+    static iterator begin(roaring_bitstream const& roaring);
+    static iterator end(roaring_bitstream const& roaring);
+
+  private:
+    friend util::iterator_access;
+
+    iterator(roaring_bitstream const& roaring);
+
+    bool equals(iterator const& other) const;
+    void increment();
+    size_type dereference() const;
+
+    static constexpr auto npos = bitvector::npos;
+
+    roaring_bitstream const* roaring_ = nullptr;
+    size_type pos_ = npos;
+  };
+
+  class ones_range : public util::iterator_range<iterator>
+  {
+  public:
+    explicit ones_range(roaring_bitstream const& bs)
+      : util::iterator_range<iterator>{iterator::begin(bs), iterator::end(bs)}
+    {
+    }
+  };
+
+  class sequence_range : public detail::sequence_range_base<sequence_range>
+  {
+  public:
+    explicit sequence_range(roaring_bitstream const& bs);
+
+  private:
+    friend detail::sequence_range_base<sequence_range>;
+
+    bool next_sequence(bitseq& seq);
+
+    roaring_bitstream const* bs_;
+    size_type next_block_ = 0;
+    size_type next_chunk_ = 0;
+    std::vector<block_type> blocks_; // The current chunk, uncompressed.
+  };
+
+  roaring_bitstream() = default;
+  roaring_bitstream(size_type n, bool bit);
+
+private:
+  template <typename>
+  friend class detail::bitstream_model;
+  friend bitstream;
+  friend bitstream_base<roaring_bitstream>;
+
+  using container = detail::roaring_container;
+
+  /// The number of bits per chunk.
+  static constexpr size_type chunk_width = container::universe;
+
+  bool equals(roaring_bitstream const& other) const;
+  void bitwise_not();
+  void bitwise_and(roaring_bitstream const& other);
+  void bitwise_or(roaring_bitstream const& other);
+  void bitwise_xor(roaring_bitstream const& other);
+  void bitwise_subtract(roaring_bitstream const& other);
+  void append_impl(size_type n, bool bit);
+  void append_block_impl(block_type block, size_type bits);
+  void push_back_impl(bool bit);
+  void trim_impl();
+  void clear_impl() noexcept;
+  void reserve_impl(size_type blocks);
+  bool at(size_type i) const;
+  size_type size_impl() const;
+  size_type count_impl() const;
+  bool empty_impl() const;
+  const_iterator begin_impl() const;
+  const_iterator end_impl() const;
+  bool back_impl() const;
+  size_type find_first_impl() const;
+  size_type find_next_impl(size_type i) const;
+  size_type find_last_impl() const;
+  size_type find_prev_impl(size_type i) const;
+  size_type decode_impl(size_type i, size_type* out, size_type n) const;
+  bitvector bits_impl() const;
+
+  /// Retrieves the container for the chunk of the next bit to append. All
+  /// previous containers get finalized.
+  container& tail();
+
+  /// Combines this bitstream with another one chunk by chunk.
+  /// @param other The other bitstream.
+  /// @param keep_lhs Whether to keep chunks which only exist in this one.
+  /// @param keep_rhs Whether to keep chunks which only exist in *other*.
+  /// @param op The operation to perform on chunks which exist in both.
+  template <typename Operation>
+  void merge(roaring_bitstream const& other, bool keep_lhs, bool keep_rhs,
+             Operation op);
+
+  std::vector<size_type> keys_;
+  std::vector<container> containers_;
+  size_type num_bits_ = 0;
+
+private:
+  friend access;
+  void serialize(serializer& sink) const;
+  void deserialize(deserializer& source);
+
+  template <typename Iterator>
+  friend trial<void> print(roaring_bitstream const& bs, Iterator&& out)
+  {
+    return print(bs.bits(), out, false, false, 0);
+  };
+
+  friend bool operator==(roaring_bitstream const& x,
+                         roaring_bitstream const& y);
+  friend bool operator<(roaring_bitstream const& x,
+                        roaring_bitstream const& y);
+};
+
+#ifdef VAST_MONOMORPHIC_BITSTREAM
+/// A bitstream with the interface of the polymorphic variant which always
+/// wraps a ::default_bitstream. Operations dispatch statically and copies do
+/// not allocate a model. The serialized form equals the one of a polymorphic
+/// bitstream holding a ::default_bitstream.
+class bitstream : public bitstream_base<bitstream>,
+                  util::equality_comparable<bitstream>
+{
+public:
+  using iterator = default_bitstream::const_iterator;
+  using const_iterator = default_bitstream::const_iterator;
+
+  bitstream() = default;
+
+  template <
+    typename Bitstream,
+    typename = util::disable_if_same_or_derived_t<bitstream, Bitstream>
+  >
+  explicit bitstream(Bitstream&& bs)
+    : bitstream_{std::forward<Bitstream>(bs)},
+      valid_{true}
+  {
+    static_assert(std::is_same<std::decay_t<Bitstream>,
+                               default_bitstream>::value,
+                  "monomorphic bitstreams require the default bitstream");
+  }
+
+  explicit operator bool() const;
+
+private:
+  friend bitstream_base<bitstream>;
+
+  bool equals(bitstream const& other) const;
+  void bitwise_not();
+  void bitwise_and(bitstream const& other);
+  void bitwise_or(bitstream const& other);
+  void bitwise_xor(bitstream const& other);
+  void bitwise_subtract(bitstream const& other);
+  void append_impl(size_type n, bool bit);
+  void append_block_impl(block_type block, size_type bits);
+  void push_back_impl(bool bit);
+  void trim_impl();
+  void clear_impl() noexcept;
+  void reserve_impl(size_type blocks);
+  bool at(size_type i) const;
+  size_type size_impl() const;
+  size_type count_impl() const;
+  bool empty_impl() const;
+  const_iterator begin_impl() const;
+  const_iterator end_impl() const;
+  bool back_impl() const;
+  size_type find_first_impl() const;
+  size_type find_next_impl(size_type i) const;
+  size_type find_last_impl() const;
+  size_type find_prev_impl(size_type i) const;
+  size_type decode_impl(size_type i, size_type* out, size_type n) const;
+  bitvector bits_impl() const;
+
+  default_bitstream bitstream_;
+  bool valid_ = false;
+
+  friend bitstream detail::apply_all(std::vector<bitstream const*> const& xs,
+                                     bool conjunction);
+
+  friend size_type detail::count_apply(bitstream const& lhs,
+                                       bitstream const& rhs,
+                                       detail::count_operation op);
+
+private:
+  friend access;
+
+  void serialize(serializer& sink) const;
+  void deserialize(deserializer& source);
+
+  template <typename Iterator>
+  friend trial<void> print(bitstream const& bs, Iterator&& out)
+  {
+    return print(bs.bits(), out, false, false, 0);
+  }
+
+  friend bool operator==(bitstream const& x, bitstream const& y);
+};
+#endif // VAST_MONOMORPHIC_BITSTREAM
+
+/// Performs a bitwise operation on two bitstreams.
+/// The algorithm traverses the two bitstreams side by side.
+///
+/// @param lhs The LHS of the operation.
+///
+/// @param rhs The RHS of the operation
+///
+/// @param fill_lhs A boolean flag that controls the algorithm behavior after
+/// one sequence has reached its end. If `true`, the algorithm will append the
+/// remaining bits of *lhs* to the result iff *lhs* is the longer bitstream. If
+/// `false`, the algorithm returns the result after the first sequence has
+/// reached an end.
+///
+/// @param fill_rhs The same as *fill_lhs*, except that it concerns *rhs*.
+///
+/// @param op The bitwise operation as block-wise lambda, e.g., for XOR:
+///
+///     [](block_type lhs, block_type rhs) { return lhs ^ rhs; }
+///
+/// @returns The result of a bitwise operation between *lhs* and *rhs*
+/// according to *op*.
+///
+/// @note The operands may have different types as long as they have the same
+/// owning bitstream type, e.g., an ::ewah_bitstream_view and an
+/// ::ewah_bitstream. The result has that owning type.
+template <typename LHS, typename RHS, typename Operation>
+owning_bitstream_t<LHS> apply(LHS const& lhs, RHS const& rhs,
+                              bool fill_lhs, bool fill_rhs, Operation op)
+{
+  using Bitstream = owning_bitstream_t<LHS>;
+  static_assert(std::is_same<Bitstream, owning_bitstream_t<RHS>>::value,
+                "operands must have the same owning bitstream type");
+
+  auto rx = typename LHS::sequence_range{lhs};
+  auto ry = typename RHS::sequence_range{rhs};
+  auto ix = rx.begin();
+  auto iy = ry.begin();
+
+  if (ix == rx.end() && iy == ry.end())
+    return {};
+  if (ix == rx.end())
+    return Bitstream{rhs};
+  if (iy == ry.end())
+    return Bitstream{lhs};
+
+  Bitstream result;
+  auto first = std::min(ix->offset, iy->offset);
+  if (first > 0)
+    result.append(first, false);
+
+  auto lx = ix->length;
+  auto ly = iy->length;
+  while (ix != rx.end() && iy != ry.end())
+  {
+    auto min = std::min(lx, ly);
+    auto block = op(ix->data, iy->data);
+
+    if (ix->is_fill() && iy->is_fill())
+    {
+      result.append(min, block != 0);
+      lx -= min;
+      ly -= min;
+    }
+    else if (ix->is_fill())
+    {
+      result.append_block(block);
+      lx -= Bitstream::block_width;
+      ly = 0;
+    }
+    else if (iy->is_fill())
+    {
+      result.append_block(block);
+      ly -= Bitstream::block_width;
+      lx = 0;
+    }
+    else
+    {
+      result.append_block(block, std::max(lx, ly));
+      lx = ly = 0;
+    }
+
+    if (lx == 0 && ++ix != rx.end())
+      lx = ix->length;
+
+    if (ly == 0 && ++iy != ry.end())
+      ly = iy->length;
+  }
+
+  if (fill_lhs)
+  {
+    while (ix != rx.end())
+    {
+      if (ix->is_fill())
+        result.append(lx, ix->data);
+      else
+        result.append_block(ix->data, ix->length);
+
+      if (++ix != rx.end())
+        lx = ix->length;
+    }
+  }
+
+  if (fill_rhs)
+  {
+    while (iy != ry.end())
+    {
+      if (iy->is_fill())
+        result.append(ly, iy->data);
+      else
+        result.append_block(iy->data, iy->length);
+
+      if (++iy != ry.end())
+        ly = iy->length;
+    }
+  }
+
+  // If the result has not yet been filled with the remaining bits of either
+  // LHS or RHS, we have to fill it up with zeros. This is necessary, for
+  // example, to ensure that the complement of the result can still be used in
+  // further bitwise operations with bitstreams having the size of
+  // max(size(LHS), size(RHS)).
+  result.append(std::max(lhs.size(), rhs.size()) - result.size(), false);
+
+  return result;
+}
+
+template <typename LHS, typename RHS>
+owning_bitstream_t<LHS> and_(LHS const& lhs, RHS const& rhs)
+{
+  using block_type = typename LHS::block_type;
+  return apply(lhs, rhs, false, false,
+               [](block_type x, block_type y) { return x & y; });
+}
+
+template <typename LHS, typename RHS>
+owning_bitstream_t<LHS> or_(LHS const& lhs, RHS const& rhs)
+{
+  using block_type = typename LHS::block_type;
+  return apply(lhs, rhs, true, true,
+               [](block_type x, block_type y) { return x | y; });
+}
+
+template <typename LHS, typename RHS>
+owning_bitstream_t<LHS> xor_(LHS const& lhs, RHS const& rhs)
+{
+  using block_type = typename LHS::block_type;
+  return apply(lhs, rhs, true, true,
+               [](block_type x, block_type y) { return x ^ y; });
+}
+
+template <typename LHS, typename RHS>
+owning_bitstream_t<LHS> nand_(LHS const& lhs, RHS const& rhs)
+{
+  using block_type = typename LHS::block_type;
+  return apply(lhs, rhs, true, false,
+               [](block_type x, block_type y) { return x & ~y; });
+}
+
+template <typename LHS, typename RHS>
+owning_bitstream_t<LHS> nor_(LHS const& lhs, RHS const& rhs)
+{
+  using block_type = typename LHS::block_type;
+  return apply(lhs, rhs, true, true,
+               [](block_type x, block_type y) { return x | ~y; });
+}
+
+namespace detail {
+
+/// Counts the 1-bits in the result of a bitwise operation on two bitstreams.
+/// The algorithm traverses the two bitstreams side by side like ::apply, but
+/// accumulates population counts instead of appending to a result.
+///
+/// @param lhs The LHS of the operation.
+///
+/// @param rhs The RHS of the operation
+///
+/// @param fill_lhs If `true`, the algorithm counts the remaining bits of
+/// *lhs* iff *lhs* is the longer bitstream. See ::apply.
+///
+/// @param fill_rhs The same as *fill_lhs*, except that it concerns *rhs*.
+///
+/// @param any If `true`, the algorithm returns as soon as it found a 1-bit.
+///
+/// @param op The bitwise operation as block-wise lambda. It must map two
+/// 0-blocks to a 0-block, since the bits of partial blocks beyond the end of
+/// a bitstream are 0.
+///
+/// @returns The population count of the result of a bitwise operation
+/// between *lhs* and *rhs* according to *op*, or a value greater than 0 if
+/// *any* is `true` and a 1-bit exists.
+template <typename LHS, typename RHS, typename Operation>
+typename LHS::size_type apply_count(LHS const& lhs, RHS const& rhs,
+                                    bool fill_lhs, bool fill_rhs, bool any,
+                                    Operation op)
+{
+  static_assert(std::is_same<owning_bitstream_t<LHS>,
+                             owning_bitstream_t<RHS>>::value,
+                "operands must have the same owning bitstream type");
+
+  using size_type = typename LHS::size_type;
+  using block_type = typename LHS::block_type;
+
+  auto popcount = [](block_type block) -> size_type
+  {
+    return __builtin_popcountll(block);
+  };
+
+  // Counts the remaining bits of a bitstream, where *n* is the number of
+  // bits left in the current sequence.
+  auto remainder = [&](auto& i, auto end, size_type n) -> size_type
+  {
+    size_type result = 0;
+    while (i != end && ! (any && result > 0))
+    {
+      result += i->is_fill() ? (i->data ? n : 0) : popcount(i->data);
+      if (++i != end)
+        n = i->length;
+    }
+
+    return result;
+  };
+
+  auto rx = typename LHS::sequence_range{lhs};
+  auto ry = typename RHS::sequence_range{rhs};
+  auto ix = rx.begin();
+  auto iy = ry.begin();
+
+  if (ix == rx.end() && iy == ry.end())
+    return 0;
+  if (ix == rx.end())
+    return fill_rhs ? remainder(iy, ry.end(), iy->length) : 0;
+  if (iy == ry.end())
+    return fill_lhs ? remainder(ix, rx.end(), ix->length) : 0;
+
+  size_type result = 0;
+  auto lx = ix->length;
+  auto ly = iy->length;
+  while (ix != rx.end() && iy != ry.end())
+  {
+    auto min = std::min(lx, ly);
+    auto block = op(ix->data, iy->data);
+
+    if (ix->is_fill() && iy->is_fill())
+    {
+      if (block != 0)
+        result += min;
+      lx -= min;
+      ly -= min;
+    }
+    else if (ix->is_fill())
+    {
+      result += popcount(block);
+      lx -= LHS::block_width;
+      ly = 0;
+    }
+    else if (iy->is_fill())
+    {
+      result += popcount(block);
+      ly -= LHS::block_width;
+      lx = 0;
+    }
+    else
+    {
+      result += popcount(block);
+      lx = ly = 0;
+    }
+
+    if (any && result > 0)
+      return result;
+
+    if (lx == 0 && ++ix != rx.end())
+      lx = ix->length;
+
+    if (ly == 0 && ++iy != ry.end())
+      ly = iy->length;
+  }
+
+  if (fill_lhs)
+    result += remainder(ix, rx.end(), lx);
+
+  if (fill_rhs)
+    result += remainder(iy, ry.end(), ly);
+
+  return result;
+}
+
+template <typename LHS, typename RHS>
+typename LHS::size_type
+count_apply(LHS const& lhs, RHS const& rhs, count_operation op)
+{
+  using block_type = typename LHS::block_type;
+  auto and_op = [](block_type x, block_type y) { return x & y; };
+  switch (op)
+  {
+    case count_operation::and_:
+      return apply_count(lhs, rhs, false, false, false, and_op);
+    case count_operation::or_:
+      return apply_count(lhs, rhs, true, true, false,
+                         [](block_type x, block_type y) { return x | y; });
+    case count_operation::andnot:
+      return apply_count(lhs, rhs, true, false, false,
+                         [](block_type x, block_type y) { return x & ~y; });
+    case count_operation::intersects:
+      return apply_count(lhs, rhs, false, false, true, and_op) > 0 ? 1 : 0;
+  }
+
+  return 0;
+}
+
+} // namespace detail
+
+/// Computes the population count of the conjunction of two bitstreams
+/// without materializing the conjunction.
+/// @param lhs The LHS of the conjunction.
+/// @param rhs The RHS of the conjunction.
+/// @returns `and_(lhs, rhs).count()`
+template <typename LHS, typename RHS>
+typename LHS::size_type and_count(LHS const& lhs, RHS const& rhs)
+{
+  return detail::count_apply(lhs, rhs, detail::count_operation::and_);
+}
+
+/// Computes the population count of the disjunction of two bitstreams
+/// without materializing the disjunction.
+/// @param lhs The LHS of the disjunction.
+/// @param rhs The RHS of the disjunction.
+/// @returns `or_(lhs, rhs).count()`
+template <typename LHS, typename RHS>
+typename LHS::size_type or_count(LHS const& lhs, RHS const& rhs)
+{
+  return detail::count_apply(lhs, rhs, detail::count_operation::or_);
+}
+
+/// Computes the population count of the difference of two bitstreams
+/// without materializing the difference.
+/// @param lhs The LHS of the difference.
+/// @param rhs The RHS of the difference.
+/// @returns `nand_(lhs, rhs).count()`
+template <typename LHS, typename RHS>
+typename LHS::size_type andnot_count(LHS const& lhs, RHS const& rhs)
+{
+  return detail::count_apply(lhs, rhs, detail::count_operation::andnot);
+}
+
+/// Checks whether two bitstreams have a 1-bit in common. The check stops at
+/// the first common 1-bit.
+/// @param lhs The first bitstream.
+/// @param rhs The second bitstream.
+/// @returns `and_count(lhs, rhs) > 0`
+template <typename LHS, typename RHS>
+bool intersects(LHS const& lhs, RHS const& rhs)
+{
+  return detail::count_apply(lhs, rhs, detail::count_operation::intersects);
+}
+
+namespace detail {
+
+// Walks over the sequences of a bitstream for the n-ary bitwise operations.
+// After the last sequence, the cursor behaves like an infinite 0-fill.
+template <typename Bitstream>
+class sequence_cursor
+{
+public:
+  using size_type = typename Bitstream::size_type;
+  using block_type = typename Bitstream::block_type;
+  using range = typename Bitstream::sequence_range;
+
+  explicit sequence_cursor(range& rng)
+    : i_{rng.begin()},
+      end_{rng.end()},
+      remaining_{i_->length}
+  {
+  }
+
+  bool is_fill() const
+  {
+    return i_ == end_ || i_->is_fill();
+  }
+
+  bool fill_bit() const
+  {
+    return i_ != end_ && i_->data != 0;
+  }
+
+  block_type block() const
+  {
+    if (i_ == end_)
+      return 0;
+    if (i_->is_fill())
+      return i_->data != 0 ? Bitstream::all_one : 0;
+    return i_->data;
+  }
+
+  size_type remaining() const
+  {
+    return i_ == end_ ? Bitstream::npos : remaining_;
+  }
+
+  void advance(size_type n)
+  {
+    while (n > 0 && i_ != end_)
+    {
+      if (n < remaining_)
+      {
+        remaining_ -= n;
+        return;
+      }
+
+      n -= remaining_;
+      if (++i_ != end_)
+        remaining_ = i_->length;
+    }
+  }
+
+private:
+  typename range::iterator i_;
+  typename range::iterator end_;
+  size_type remaining_;
+};
+
+template <typename Bitstream>
+owning_bitstream_t<Bitstream>
+apply_all(std::vector<Bitstream const*> const& xs, bool conjunction)
+{
+  using size_type = typename Bitstream::size_type;
+  using block_type = typename Bitstream::block_type;
+  using result_type = owning_bitstream_t<Bitstream>;
+
+  // The cursors point into their ranges, which therefore must not move.
+  std::deque<typename Bitstream::sequence_range> ranges;
+  std::vector<sequence_cursor<Bitstream>> cursors;
+  Bitstream const* last = nullptr;
+  size_type size = 0;
+  for (auto x : xs)
+    if (! x->empty())
+    {
+      size = std::max(size, x->size());
+      ranges.emplace_back(*x);
+      cursors.emplace_back(ranges.back());
+      last = x;
+    }
+
+  if (cursors.empty())
+    return {};
+  if (cursors.size() == 1)
+    return result_type{*last};
+
+  // A fill of the absorbing bit (0 for AND, 1 for OR) determines the result
+  // irrespective of the other operands, so we can skip over its entire
+  // length. Fills of the neutral bit only matter if all operands are fills.
+  // Otherwise we combine one block of each operand.
+  auto absorbing = ! conjunction;
+  result_type result;
+  size_type n = 0;
+  for (size_type pos = 0; pos < size; pos += n)
+  {
+    size_type absorb = 0;
+    size_type neutral = Bitstream::npos;
+    auto literal = false;
+    for (auto& c : cursors)
+      if (! c.is_fill())
+        literal = true;
+      else if (c.fill_bit() == absorbing)
+        absorb = std::max(absorb, c.remaining());
+      else
+        neutral = std::min(neutral, c.remaining());
+
+    if (absorb > 0)
+    {
+      n = std::min(absorb, size - pos);
+      result.append(n, absorbing);
+    }
+    else if (! literal)
+    {
+      n = std::min(neutral, size - pos);
+      result.append(n, ! absorbing);
+    }
+    else
+    {
+      block_type block = conjunction ? Bitstream::all_one : 0;
+      for (auto& c : cursors)
+        block = conjunction ? block & c.block() : block | c.block();
+      n = std::min(Bitstream::block_width, size - pos);
+      result.append_block(block, n);
+    }
+
+    for (auto& c : cursors)
+      c.advance(n);
+  }
+
+  return result;
+}
+
+template <typename Bitstream>
+Bitstream const& operand(Bitstream const& x)
+{
+  return x;
+}
+
+template <typename Bitstream>
+Bitstream const& operand(Bitstream const* x)
+{
+  return *x;
+}
+
+template <typename Iterator>
+using operand_type =
+  std::decay_t<decltype(operand(*std::declval<Iterator>()))>;
+
+template <typename Iterator>
+std::vector<operand_type<Iterator> const*> operands(Iterator begin,
+                                                    Iterator end)
+{
+  std::vector<operand_type<Iterator> const*> xs;
+  for ( ; begin != end; ++begin)
+    xs.push_back(&operand(*begin));
+  return xs;
+}
+
+} // namespace detail
+
+/// Computes the conjunction of several bitstreams. In contrast to folding
+/// the operands with `&=`, which materializes an intermediate result per
+/// operand, this function traverses all operands side by side in a single
+/// pass and skips over 0-fills of any operand.
+///
+/// The result has the size of the longest operand, with shorter operands
+/// considered as padded with 0s. Operands of polymorphic type ::bitstream
+/// must have the same concrete type; an invalid one yields an invalid result,
+/// as with `&=`.
+///
+/// @param begin An iterator to the first bitstream or bitstream pointer.
+/// @param end An iterator one past the last operand.
+/// @returns The conjunction of all operands in *[begin, end)*.
+template <typename Iterator>
+owning_bitstream_t<detail::operand_type<Iterator>>
+and_all(Iterator begin, Iterator end)
+{
+  return detail::apply_all(detail::operands(begin, end), true);
+}
+
+/// Computes the disjunction of several bitstreams in a single pass. This is
+/// the counterpart to ::and_all, where 1-fills of any operand get skipped.
+/// Invalid operands of polymorphic type ::bitstream do not contribute, as
+/// with `|=`.
+///
+/// @param begin An iterator to the first bitstream or bitstream pointer.
+/// @param end An iterator one past the last operand.
+/// @returns The disjunction of all operands in *[begin, end)*.
+template <typename Iterator>
+owning_bitstream_t<detail::operand_type<Iterator>>
+or_all(Iterator begin, Iterator end)
+{
+  return detail::apply_all(detail::operands(begin, end), false);
+}
+
+/// Transposes a vector of bitstreams into a character matrix of 0s and 1s.
+/// @param out The output iterator.
+/// @param v A vector of bitstreams.
+template <
+  typename Iterator,
+  typename Bitstream,
+  typename = std::enable_if_t<is_bitstream<Bitstream>::value>
+>
+trial<void> print(std::vector<Bitstream> const& v, Iterator&& out)
+{
+  if (v.empty())
+    return nothing;
+
+  using const_iterator = typename Bitstream::const_iterator;
+  using ipair = std::pair<const_iterator, const_iterator>;
+  std::vector<ipair> is(v.size());
+  for (size_t i = 0; i < v.size(); ++i)
+    is[i] = {v[i].begin(), v[i].end()};
+
+  auto const zero_row = std::string(v.size(), '0') + '\n';
+  typename Bitstream::size_type last = 0;
+  bool done = false;
+  while (! done)
+  {
+    // Compute the minimum.
+    typename Bitstream::size_type min = Bitstream::npos;
+    for (auto& p : is)
+      if (p.first != p.second && *p.first < min)
+        min = *p.first;
+
+    if (min == Bitstream::npos)
+      break;
+
+    // Fill up the distance to the last row with 0 rows.
+    auto distance = min - last;
+    for (decltype(min) i = 0; i < distance; ++i)
+      std::copy(zero_row.begin(), zero_row.end(), out);
+    last = min + 1;
+
+    // Print the current transposed row.
+    done = true;
+    for (auto& p : is)
+    {
+      if (p.first != p.second && *p.first == min)
+      {
+        *out++ = '1';
+        done = false;
+        ++p.first;
+      }
+      else
       {
         *out++ = '0';
       }
@@ -1245,6 +2342,242 @@ trial<void> print(std::vector<Bitstream> const& v, Iterator&& out)
   return nothing;
 }
 
+/// Builds a bitstream from strictly increasing positions or ranges in a
+/// single pass. Instead of going bit by bit, the builder collects the
+/// non-zero blocks as runs and encodes them at once when finishing. Positions
+/// appended with the builder must lie at or beyond the size of the bitstream
+/// it starts from.
+template <typename Bitstream>
+class bitstream_builder
+{
+public:
+  using size_type = typename Bitstream::size_type;
+  using block_type = typename Bitstream::block_type;
+
+  /// Constructs a builder that appends to a given bitstream.
+  /// @param bs The bitstream to continue.
+  explicit bitstream_builder(Bitstream bs = {})
+    : bits_{std::move(bs)},
+      base_{bits_.size() / block_width * block_width},
+      end_{bits_.size()}
+  {
+  }
+
+  /// Sets a single bit.
+  /// @param i The position of the bit, which must be larger than all
+  ///          positions added so far.
+  /// @returns `true` on success.
+  bool add(size_type i)
+  {
+    if (i == Bitstream::npos)
+      return false;
+
+    return add(i, i + 1);
+  }
+
+  /// Sets all bits in a half-open range.
+  /// @param first The first position of the range, which must not precede
+  ///              the end of the previously added range.
+  /// @param last One past the last position of the range.
+  /// @returns `true` on success.
+  bool add(size_type first, size_type last)
+  {
+    if (first >= last || first < end_ || last == Bitstream::npos)
+      return false;
+
+    // Move the pending block up to the one containing *first*.
+    if (first - base_ >= block_width)
+    {
+      flush();
+      base_ = first / block_width * block_width;
+    }
+
+    if (last - base_ <= block_width)
+    {
+      block_ |= mask(first - base_, last - base_);
+    }
+    else
+    {
+      block_ |= mask(first - base_, block_width);
+      flush();
+      base_ += block_width;
+
+      auto full = (last - base_) / block_width;
+      if (full > 0)
+      {
+        push(base_ / block_width, full, all_one);
+        base_ += full * block_width;
+      }
+
+      block_ = last == base_ ? 0 : mask(0, last - base_);
+    }
+
+    end_ = last;
+    return true;
+  }
+
+  /// Retrieves the minimum size of the bitstream under construction.
+  /// @returns One past the last position added.
+  size_type size() const
+  {
+    return end_;
+  }
+
+  /// Completes the bitstream and resets the builder.
+  /// @param size The size of the resulting bitstream. Values smaller than
+  ///             `size()` have no effect.
+  /// @returns The finished bitstream.
+  Bitstream finish(size_type size = 0)
+  {
+    size = std::max(size, end_);
+    flush();
+
+    auto result = encode(std::is_same<Bitstream, ewah_bitstream>{}, size);
+
+    bits_ = Bitstream{};
+    runs_.clear();
+    base_ = end_ = 0;
+    return result;
+  }
+
+private:
+  static constexpr auto block_width = Bitstream::block_width;
+  static constexpr auto all_one = ~block_type{0};
+
+  static block_type mask(size_type first, size_type last)
+  {
+    assert(first < last && last <= block_width);
+    auto hi = last == block_width ? all_one : (block_type{1} << last) - 1;
+    return hi & ~((block_type{1} << first) - 1);
+  }
+
+  // Records a run of blocks, merging adjacent runs of 1s.
+  void push(size_type first, size_type length, block_type block)
+  {
+    if (block == all_one && ! runs_.empty())
+    {
+      auto& prev = runs_.back();
+      if (prev.block == all_one && prev.first + prev.length == first)
+      {
+        prev.length += length;
+        return;
+      }
+    }
+
+    runs_.push_back({first, length, block});
+  }
+
+  // Moves the pending block into the runs.
+  void flush()
+  {
+    if (block_ != 0)
+      push(base_ / block_width, 1, block_);
+
+    block_ = 0;
+  }
+
+  // Appends a run to the bitstream, where the first block of the run may
+  // overlap with the bitstream.
+  void append(Bitstream& bs, detail::block_run const& run, size_type size)
+  {
+    auto offset = run.first * block_width;
+    if (offset > bs.size())
+      bs.append(offset - bs.size(), false);
+
+    auto skip = bs.size() - offset;
+    if (run.block == all_one)
+    {
+      bs.append(run.length * block_width - skip, true);
+    }
+    else
+    {
+      auto n = std::min(block_width - skip, size - bs.size());
+      bs.append_block(run.block >> skip, n);
+    }
+  }
+
+  // Replays the runs through the regular interface of the bitstream.
+  Bitstream encode(std::false_type, size_type size)
+  {
+    if (std::is_same<Bitstream, null_bitstream>::value)
+      bits_.reserve(bitvector::bits_to_blocks(size));
+
+    for (auto& run : runs_)
+      append(bits_, run, size);
+
+    if (size > bits_.size())
+      bits_.append(size - bits_.size(), false);
+
+    return std::move(bits_);
+  }
+
+  // Encodes the runs directly. The blocks which we continue get spliced
+  // onto the bitstream after completing its last block.
+  Bitstream encode(std::true_type, size_type size)
+  {
+    auto first = runs_.data();
+    auto last = first + runs_.size();
+    if (bits_.size() % block_width != 0)
+    {
+      if (first != last && first->first * block_width < bits_.size())
+        append(bits_, *first++, size);
+      else
+        bits_.append(std::min(block_width - bits_.size() % block_width,
+                              size - bits_.size()), false);
+
+      if (bits_.size() == size)
+        return std::move(bits_);
+    }
+
+    auto base = bits_.size() / block_width;
+    auto tail = Bitstream::encode(first, last, base, size - bits_.size());
+    if (bits_.empty())
+      return tail;
+
+    bits_.splice(tail);
+    return std::move(bits_);
+  }
+
+  Bitstream bits_;
+  std::vector<detail::block_run> runs_;
+  size_type base_ = 0;
+  size_type end_ = 0;
+  block_type block_ = 0;
+};
+
+/// Constructs a bitstream from a sorted sequence of positions.
+/// @param first An iterator to the first position.
+/// @param last An iterator one past the last position.
+/// @param size The size of the result, or 0 to end after the last position.
+/// @returns A bitstream with exactly the bits in *[first, last)* set.
+template <typename Bitstream, typename Iterator>
+trial<Bitstream> from_positions(Iterator first, Iterator last,
+                                typename Bitstream::size_type size = 0)
+{
+  bitstream_builder<Bitstream> builder;
+  for (; first != last; ++first)
+    if (! builder.add(*first))
+      return error{"positions not strictly increasing at ", *first};
+  return builder.finish(size);
+}
+
+/// Constructs a bitstream from a sorted sequence of half-open ranges.
+/// @param first An iterator to the first range of type `std::pair`.
+/// @param last An iterator one past the last range.
+/// @param size The size of the result, or 0 to end after the last range.
+/// @returns A bitstream with exactly the bits in the given ranges set.
+template <typename Bitstream, typename Iterator>
+trial<Bitstream> from_runs(Iterator first, Iterator last,
+                           typename Bitstream::size_type size = 0)
+{
+  bitstream_builder<Bitstream> builder;
+  for (; first != last; ++first)
+    if (! builder.add(first->first, first->second))
+      return error{"invalid or unsorted range [",
+                   first->first, ',', first->second, ')'};
+  return builder.finish(size);
+}
+
 } // namespace vast
 
 #endif
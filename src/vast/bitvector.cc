@@ -1,5 +1,6 @@
 #include "vast/bitvector.h"
 
+#include "vast/detail/bitwise.h"
 #include "vast/serialization/arithmetic.h"
 #include "vast/serialization/container.h"
 
@@ -14,25 +15,6 @@ constexpr bitvector::block_type bitvector::msb_one;
 constexpr bitvector::size_type bitvector::block_width;
 constexpr bitvector::size_type bitvector::npos;
 
-namespace {
-
-uint8_t count_table[] =
-{
-  0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 1, 2, 2, 3, 2, 3, 3, 4, 2,
-  3, 3, 4, 3, 4, 4, 5, 1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5, 2, 3,
-  3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3,
-  4, 3, 4, 4, 5, 2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 2, 3, 3, 4,
-  3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5,
-  6, 6, 7, 1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5, 2, 3, 3, 4, 3, 4,
-  4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5,
-  6, 3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7, 2, 3, 3, 4, 3, 4, 4, 5,
-  3, 4, 4, 5, 4, 5, 5, 6, 3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7, 3,
-  4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7, 4, 5, 5, 6, 5, 6, 6, 7, 5, 6,
-  6, 7, 6, 7, 7, 8
-};
-
-} // namespace <anonymous>
-
 bitvector::reference::reference(block_type& block, block_type i)
   : block_(block)
   , mask_(block_type{1} << i)
@@ -104,31 +86,20 @@ block_type bitvector::flip(block_type block, size_type start)
 
 size_type bitvector::count(block_type block)
 {
-  size_type n = 0;
-  while (block)
-  {
-    // TODO: use __popcnt if available.
-    n += count_table[block & ((1u << 8) - 1)];
-    block >>= 8;
-  }
-  return n;
+  return __builtin_popcountll(block);
 }
 
 size_type bitvector::lowest_bit(block_type block)
 {
-  auto x = block - (block & (block - 1)); // Extract right-most 1-bit.
-  size_type log = 0;
-  while (x >>= 1)
-    ++log;
-  return log;
+  return block ? __builtin_ctzll(block) : 0;
 }
 
 size_type bitvector::highest_bit(block_type block)
 {
-  size_type log = 0;
-  while (block >>= 1)
-    ++log;
-  return log;
+  return block
+    ? std::numeric_limits<unsigned long long>::digits - 1
+      - __builtin_clzll(block)
+    : 0;
 }
 
 size_type bitvector::next_bit(block_type block, size_type i)
@@ -248,32 +219,32 @@ bitvector& bitvector::operator>>=(size_type n)
 bitvector& bitvector::operator&=(bitvector const& other)
 {
   assert(size() >= other.size());
-  for (size_type i = 0; i < other.blocks(); ++i)
-    bits_[i] &= other.bits_[i];
+  detail::bitwise_and(bits_.data(), bits_.data(), other.bits_.data(),
+                      other.blocks());
   return *this;
 }
 
 bitvector& bitvector::operator|=(bitvector const& other)
 {
   assert(size() >= other.size());
-  for (size_type i = 0; i < other.blocks(); ++i)
-    bits_[i] |= other.bits_[i];
+  detail::bitwise_or(bits_.data(), bits_.data(), other.bits_.data(),
+                     other.blocks());
   return *this;
 }
 
 bitvector& bitvector::operator^=(bitvector const& other)
 {
   assert(size() >= other.size());
-  for (size_type i = 0; i < other.blocks(); ++i)
-    bits_[i] ^= other.bits_[i];
+  detail::bitwise_xor(bits_.data(), bits_.data(), other.bits_.data(),
+                      other.blocks());
   return *this;
 }
 
 bitvector& bitvector::operator-=(bitvector const& other)
 {
   assert(size() >= other.size());
-  for (size_type i = 0; i < other.blocks(); ++i)
-    bits_[i] &= ~other.bits_[i];
+  detail::bitwise_and_not(bits_.data(), bits_.data(), other.bits_.data(),
+                          other.blocks());
   return *this;
 }
 
@@ -301,6 +272,11 @@ bitvector operator-(bitvector const& x, bitvector const& y)
   return b -= y;
 }
 
+void bitvector::reserve(size_type n)
+{
+  bits_.reserve(bits_to_blocks(n));
+}
+
 void bitvector::resize(size_type n, bool value)
 {
   auto old = blocks();
@@ -436,6 +412,11 @@ block_type& bitvector::block_at_bit(size_type i)
   return bits_[block_index(i)];
 }
 
+block_type const* bitvector::data() const
+{
+  return bits_.data();
+}
+
 block_type bitvector::first_block() const
 {
   assert(! bits_.empty());
@@ -462,16 +443,7 @@ block_type& bitvector::last_block()
 
 size_type bitvector::count() const
 {
-  auto i = bits_.begin();
-  size_type n = 0;
-  auto length = blocks();
-  while (length)
-  {
-    n += count(*i);
-    ++i;
-    --length;
-  }
-  return n;
+  return detail::popcount(bits_.data(), blocks());
 }
 
 size_type bitvector::blocks() const
@@ -439,6 +439,10 @@ public:
   /// Clears all bits in the bitvector.
   void clear() noexcept;
 
+  /// Reserves storage for a given number of bits without changing the size.
+  /// @param n The number of bits to reserve.
+  void reserve(size_type n);
+
   /// Resizes the bit vector to a new number of bits.
   /// @param n The new number of bits of the bit vector.
   /// @param value The bit value of new values, if the vector expands.
@@ -508,6 +512,10 @@ public:
   /// @pre *i < bits()*
   block_type& block_at_bit(size_type i);
 
+  /// Retrieves a pointer to the contiguous block storage.
+  /// @returns A pointer to the first of `blocks()` blocks.
+  block_type const* data() const;
+
   /// Retrieves the first block of the bitvector.
   /// @returns The first block.
   /// @pre *! empty()*
@@ -25,7 +25,11 @@ bool operator==(chunk::meta_data const& x, chunk::meta_data const& y)
 
 chunk::writer::writer(chunk& chk)
   : meta_{&chk.get_meta()},
-    block_writer_{std::make_unique<block::writer>(chk.block())}
+    block_writer_{std::make_unique<block::writer>(chk.block())},
+    first_{meta_->first},
+    last_{meta_->last},
+    schema_{meta_->schema},
+    ids_{meta_->ids}
 {
 }
 
@@ -39,26 +43,20 @@ bool chunk::writer::write(event const& e)
   if (! block_writer_)
     return false;
 
-  if (! meta_->schema.find_type(e.type().name()))
-    if (! meta_->schema.add(e.type()))
+  if (! schema_.find_type(e.type().name()))
+    if (! schema_.add(e.type()))
       return false;
 
-  if (meta_->first == time_duration{} || e.timestamp() < meta_->first)
-    meta_->first = e.timestamp();
+  if (first_ == time_duration{} || e.timestamp() < first_)
+    first_ = e.timestamp();
 
-  if (meta_->last == time_duration{} || e.timestamp() > meta_->last)
-    meta_->last = e.timestamp();
+  if (last_ == time_duration{} || e.timestamp() > last_)
+    last_ = e.timestamp();
 
-  if (e.id() != invalid_event_id || ! meta_->ids.empty())
-  {
-    if (e.id() < meta_->ids.size() || e.id() == invalid_event_id)
+  if (e.id() != invalid_event_id || ids_.size() > 0)
+    if (e.id() == invalid_event_id || ! ids_.add(e.id()))
       return false;
 
-    auto delta = e.id() - meta_->ids.size();
-    meta_->ids.append(delta, false);
-    meta_->ids.push_back(true);
-  }
-
   return block_writer_->write(e.type().name(), 0)
       && block_writer_->write(e.timestamp(), 0)
       && block_writer_->write(e.data());
@@ -66,18 +64,24 @@ bool chunk::writer::write(event const& e)
 
 void chunk::writer::flush()
 {
+  if (! block_writer_)
+    return;
+
+  meta_->first = first_;
+  meta_->last = last_;
+  meta_->schema = std::move(schema_);
+  meta_->ids = ids_.finish();
   block_writer_.reset();
 }
 
 
 chunk::reader::reader(chunk const& chk)
   : chunk_{&chk},
-    block_reader_{std::make_unique<block::reader>(chunk_->block())},
-    ids_begin_{chunk_->meta().ids.begin()},
-    ids_end_{chunk_->meta().ids.end()}
+    block_reader_{std::make_unique<block::reader>(chunk_->block())}
 {
-  if (ids_begin_ != ids_end_)
-    first_ = *ids_begin_;
+  decode_ids(0);
+  if (! ids_.empty())
+    first_ = ids_.front();
 }
 
 result<event> chunk::reader::read(event_id id)
@@ -90,31 +94,49 @@ result<event> chunk::reader::read(event_id id)
     if (id < first_)
       return error{"chunk begins at id ", first_};
 
-    if (ids_begin_ == ids_end_ || id < *ids_begin_)
+    if (next_id_ == ids_.size() || id < ids_[next_id_])
     {
       block_reader_ = std::make_unique<block::reader>(chunk_->block());
-      ids_begin_ = chunk_->meta().ids.begin();
+      decode_ids(0);
     }
 
-    while (ids_begin_ != ids_end_ && *ids_begin_ < id)
+    while (next_id_ < ids_.size() && ids_[next_id_] < id)
     {
       auto e = materialize(true);
       if (e.failed())
         return e.error();
-      ++ids_begin_;
+      advance();
     }
 
-    if (ids_begin_ == ids_end_ || *ids_begin_ != id)
+    if (next_id_ == ids_.size() || ids_[next_id_] != id)
       return error{"no event with id ", id};
   }
 
   auto e = materialize(false);
-  if (e && ids_begin_ != ids_end_)
-    e->id(*ids_begin_++);
+  if (e && next_id_ < ids_.size())
+  {
+    e->id(ids_[next_id_]);
+    advance();
+  }
 
   return e;
 };
 
+void chunk::reader::decode_ids(event_id from)
+{
+  ids_.resize(decode_batch_size);
+  ids_.resize(chunk_->meta().ids.decode(from, ids_.data(), ids_.size()));
+  next_id_ = 0;
+}
+
+void chunk::reader::advance()
+{
+  assert(next_id_ < ids_.size());
+  // A full batch may have more IDs after it, an incomplete one not.
+  if (++next_id_ == ids_.size() && ids_.size() == decode_batch_size)
+    decode_ids(ids_.back() + 1);
+}
+
 result<event> chunk::reader::materialize(bool discard)
 {
   if (block_reader_->available() == 0)
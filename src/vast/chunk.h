@@ -34,7 +34,10 @@ public:
     friend bool operator==(meta_data const& x, meta_data const& y);
   };
 
-  /// A proxy class to write events into the chunk.
+  /// A proxy class to write events into the chunk. The writer accumulates
+  /// the meta data of the written events separately and updates the chunk
+  /// meta data only in ::flush, so that the meta data always describes the
+  /// events up to the last flush.
   class writer
   {
   public:
@@ -59,6 +62,10 @@ public:
   private:
     meta_data* meta_;
     std::unique_ptr<block::writer> block_writer_;
+    time_point first_;
+    time_point last_;
+    vast::schema schema_;
+    bitstream_builder<default_bitstream> ids_;
   };
 
   /// A proxy class to read events from the chunk.
@@ -78,10 +85,16 @@ public:
   private:
     result<event> materialize(bool discard);
 
+    // Decodes the next batch of IDs, beginning at a given ID.
+    void decode_ids(event_id from);
+
+    // Moves to the next ID, decoding a new batch if necessary.
+    void advance();
+
     chunk const* chunk_;
     std::unique_ptr<block::reader> block_reader_;
-    default_bitstream::const_iterator ids_begin_;
-    default_bitstream::const_iterator ids_end_;
+    std::vector<default_bitstream::size_type> ids_;
+    size_t next_id_ = 0;
     event_id first_ = invalid_event_id;
   };
 
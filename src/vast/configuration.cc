@@ -1,4 +1,5 @@
 #include "vast/configuration.h"
+#include "vast/bitstream.h"
 #include "vast/file_system.h"
 #include "vast/logger.h"
 #include "vast/detail/type_manager.h"
@@ -107,6 +108,9 @@ void configuration::initialize()
   idx.add('e', "max-events", "maximum number of events per partition").init(1 << 20);
   idx.add('p', "max-parts", "maximum number of partitions in memory").init(10);
   idx.add('a', "active-parts", "number of active partitions").init(5);
+  idx.add("parallel-threshold", "minimum bitstream blocks for parallel "
+          "bitwise operations, 0 to disable")
+    .init(ewah_bitstream::default_parallel_threshold);
   idx.add("rebuild", "delete and rebuild index from archive");
   idx.add("host", "hostname/address of the archive").init("127.0.0.1");
   idx.add("port", "TCP port of the index").init(42004);
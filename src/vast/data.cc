@@ -105,10 +105,16 @@ struct in_visitor
     return rhs.contains(lhs);
   }
 
+  // Nil does not partake in the ordering, which rules out binary search.
+  bool operator()(none, set const& rhs) const
+  {
+    return std::find(rhs.begin(), rhs.end(), nil) != rhs.end();
+  }
+
   template <typename T>
   bool operator()(T const& lhs, set const& rhs) const
   {
-    return std::find(rhs.begin(), rhs.end(), lhs) != rhs.end();
+    return rhs.find(lhs) != rhs.end();
   }
 
   template <typename T>
@@ -117,6 +123,35 @@ struct in_visitor
     return std::find(rhs.begin(), rhs.end(), lhs) != rhs.end();
   }
 
+  // A table operand holds entries which must all exist, where a nil key
+  // matches any key.
+  bool operator()(table const& lhs, table const& rhs) const
+  {
+    for (auto& entry : lhs)
+    {
+      if (is<none>(entry.first))
+      {
+        auto pred = [&](auto& p) { return p.second == entry.second; };
+        if (std::none_of(rhs.begin(), rhs.end(), pred))
+          return false;
+      }
+      else
+      {
+        auto i = rhs.find(entry.first);
+        if (i == rhs.end() || i->second != entry.second)
+          return false;
+      }
+    }
+
+    return ! lhs.empty();
+  }
+
+  template <typename T>
+  bool operator()(T const& lhs, table const& rhs) const
+  {
+    return rhs.find(lhs) != rhs.end();
+  }
+
   template <typename T, typename U>
   bool operator()(T const&, U const&) const
   {
@@ -0,0 +1,286 @@
+#include "vast/detail/bitwise.h"
+
+#include <cstdint>
+#include "vast/config.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#  define VAST_BITWISE_X86
+#  include <immintrin.h>
+#endif
+
+namespace vast {
+namespace detail {
+
+namespace {
+
+#ifdef VAST_BITWISE_X86
+#  define VAST_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+struct and_op
+{
+  static bitwise_block scalar(bitwise_block x, bitwise_block y)
+  {
+    return x & y;
+  }
+
+#ifdef VAST_BITWISE_X86
+  VAST_TARGET("sse4.2") static __m128i sse(__m128i x, __m128i y)
+  {
+    return _mm_and_si128(x, y);
+  }
+
+  VAST_TARGET("avx2") static __m256i avx(__m256i x, __m256i y)
+  {
+    return _mm256_and_si256(x, y);
+  }
+#endif
+};
+
+struct or_op
+{
+  static bitwise_block scalar(bitwise_block x, bitwise_block y)
+  {
+    return x | y;
+  }
+
+#ifdef VAST_BITWISE_X86
+  VAST_TARGET("sse4.2") static __m128i sse(__m128i x, __m128i y)
+  {
+    return _mm_or_si128(x, y);
+  }
+
+  VAST_TARGET("avx2") static __m256i avx(__m256i x, __m256i y)
+  {
+    return _mm256_or_si256(x, y);
+  }
+#endif
+};
+
+struct xor_op
+{
+  static bitwise_block scalar(bitwise_block x, bitwise_block y)
+  {
+    return x ^ y;
+  }
+
+#ifdef VAST_BITWISE_X86
+  VAST_TARGET("sse4.2") static __m128i sse(__m128i x, __m128i y)
+  {
+    return _mm_xor_si128(x, y);
+  }
+
+  VAST_TARGET("avx2") static __m256i avx(__m256i x, __m256i y)
+  {
+    return _mm256_xor_si256(x, y);
+  }
+#endif
+};
+
+struct and_not_op
+{
+  static bitwise_block scalar(bitwise_block x, bitwise_block y)
+  {
+    return x & ~y;
+  }
+
+#ifdef VAST_BITWISE_X86
+  // Note that the ANDNOT instructions negate their *first* operand.
+  VAST_TARGET("sse4.2") static __m128i sse(__m128i x, __m128i y)
+  {
+    return _mm_andnot_si128(y, x);
+  }
+
+  VAST_TARGET("avx2") static __m256i avx(__m256i x, __m256i y)
+  {
+    return _mm256_andnot_si256(y, x);
+  }
+#endif
+};
+
+template <typename Op>
+void scalar_kernel(bitwise_block* out, bitwise_block const* x,
+                   bitwise_block const* y, size_t n)
+{
+  for (size_t i = 0; i < n; ++i)
+    out[i] = Op::scalar(x[i], y[i]);
+}
+
+size_t scalar_popcount(bitwise_block const* x, size_t n)
+{
+  size_t result = 0;
+  for (size_t i = 0; i < n; ++i)
+    result += __builtin_popcountll(x[i]);
+  return result;
+}
+
+#ifdef VAST_BITWISE_X86
+
+template <typename Op>
+VAST_TARGET("sse4.2")
+void sse_kernel(bitwise_block* out, bitwise_block const* x,
+                bitwise_block const* y, size_t n)
+{
+  static constexpr auto step = sizeof(__m128i) / sizeof(bitwise_block);
+  size_t i = 0;
+  for ( ; i + step <= n; i += step)
+  {
+    auto a = _mm_loadu_si128(reinterpret_cast<__m128i const*>(x + i));
+    auto b = _mm_loadu_si128(reinterpret_cast<__m128i const*>(y + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), Op::sse(a, b));
+  }
+
+  for ( ; i < n; ++i)
+    out[i] = Op::scalar(x[i], y[i]);
+}
+
+template <typename Op>
+VAST_TARGET("avx2")
+void avx_kernel(bitwise_block* out, bitwise_block const* x,
+                bitwise_block const* y, size_t n)
+{
+  static constexpr auto step = sizeof(__m256i) / sizeof(bitwise_block);
+  size_t i = 0;
+  for ( ; i + step <= n; i += step)
+  {
+    auto a = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(x + i));
+    auto b = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(y + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), Op::avx(a, b));
+  }
+
+  for ( ; i < n; ++i)
+    out[i] = Op::scalar(x[i], y[i]);
+}
+
+VAST_TARGET("sse4.2,popcnt")
+size_t sse_popcount(bitwise_block const* x, size_t n)
+{
+  // With the POPCNT instruction available, the compiler emits a single
+  // instruction per block for the builtin.
+  size_t result = 0;
+  for (size_t i = 0; i < n; ++i)
+    result += __builtin_popcountll(x[i]);
+  return result;
+}
+
+// Computes the population count with the nibble-lookup algorithm by Wojciech
+// Mula: each byte gets split into two nibbles whose counts come from an
+// in-register table, and SAD against zero sums up the byte counts per lane.
+VAST_TARGET("avx2,popcnt")
+size_t avx_popcount(bitwise_block const* x, size_t n)
+{
+  static constexpr auto step = sizeof(__m256i) / sizeof(bitwise_block);
+  auto lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  auto low_mask = _mm256_set1_epi8(0x0f);
+  auto acc = _mm256_setzero_si256();
+  size_t i = 0;
+  for ( ; i + step <= n; i += step)
+  {
+    auto v = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(x + i));
+    auto lo = _mm256_and_si256(v, low_mask);
+    auto hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask);
+    auto cnt = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo),
+                               _mm256_shuffle_epi8(lookup, hi));
+    acc = _mm256_add_epi64(acc, _mm256_sad_epu8(cnt, _mm256_setzero_si256()));
+  }
+
+  alignas(32) uint64_t lanes[4];
+  _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), acc);
+  size_t result = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+  for ( ; i < n; ++i)
+    result += __builtin_popcountll(x[i]);
+
+  return result;
+}
+
+#endif // VAST_BITWISE_X86
+
+using binary_kernel = void (*)(bitwise_block*, bitwise_block const*,
+                               bitwise_block const*, size_t);
+
+using popcount_kernel = size_t (*)(bitwise_block const*, size_t);
+
+struct kernel_table
+{
+  bitwise_isa isa;
+  binary_kernel and_;
+  binary_kernel or_;
+  binary_kernel xor_;
+  binary_kernel and_not;
+  popcount_kernel popcount;
+};
+
+kernel_table make_kernel_table()
+{
+#ifdef VAST_BITWISE_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt"))
+    return {bitwise_isa::avx2,
+            avx_kernel<and_op>,
+            avx_kernel<or_op>,
+            avx_kernel<xor_op>,
+            avx_kernel<and_not_op>,
+            avx_popcount};
+
+  if (__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt"))
+    return {bitwise_isa::sse42,
+            sse_kernel<and_op>,
+            sse_kernel<or_op>,
+            sse_kernel<xor_op>,
+            sse_kernel<and_not_op>,
+            sse_popcount};
+#endif
+
+  return {bitwise_isa::scalar,
+          scalar_kernel<and_op>,
+          scalar_kernel<or_op>,
+          scalar_kernel<xor_op>,
+          scalar_kernel<and_not_op>,
+          scalar_popcount};
+}
+
+kernel_table const& kernels()
+{
+  static auto const table = make_kernel_table();
+  return table;
+}
+
+} // namespace <anonymous>
+
+bitwise_isa bitwise_kernel_isa()
+{
+  return kernels().isa;
+}
+
+void bitwise_and(bitwise_block* out, bitwise_block const* x,
+                 bitwise_block const* y, size_t n)
+{
+  kernels().and_(out, x, y, n);
+}
+
+void bitwise_or(bitwise_block* out, bitwise_block const* x,
+                bitwise_block const* y, size_t n)
+{
+  kernels().or_(out, x, y, n);
+}
+
+void bitwise_xor(bitwise_block* out, bitwise_block const* x,
+                 bitwise_block const* y, size_t n)
+{
+  kernels().xor_(out, x, y, n);
+}
+
+void bitwise_and_not(bitwise_block* out, bitwise_block const* x,
+                     bitwise_block const* y, size_t n)
+{
+  kernels().and_not(out, x, y, n);
+}
+
+size_t popcount(bitwise_block const* x, size_t n)
+{
+  return kernels().popcount(x, n);
+}
+
+} // namespace detail
+} // namespace vast
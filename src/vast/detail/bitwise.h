@@ -0,0 +1,56 @@
+#ifndef VAST_DETAIL_BITWISE_H
+#define VAST_DETAIL_BITWISE_H
+
+#include <cstddef>
+
+namespace vast {
+namespace detail {
+
+/// The block type the bitwise kernels operate on. Equals
+/// `bitvector::block_type`.
+using bitwise_block = size_t;
+
+/// The instruction set extensions available to the bitwise block kernels.
+/// The kernels pick the best implementation once at runtime, based on what
+/// the executing CPU supports.
+enum class bitwise_isa
+{
+  scalar,
+  sse42,
+  avx2
+};
+
+/// Retrieves the instruction set used by the bitwise block kernels.
+/// @returns The ISA chosen at runtime.
+bitwise_isa bitwise_kernel_isa();
+
+/// Computes `out[i] = x[i] & y[i]` for all *i* in `[0, n)`.
+/// @param out The result blocks, which may alias with *x* or *y*.
+/// @param x The LHS blocks.
+/// @param y The RHS blocks.
+/// @param n The number of blocks.
+void bitwise_and(bitwise_block* out, bitwise_block const* x,
+                 bitwise_block const* y, size_t n);
+
+/// Computes `out[i] = x[i] | y[i]` for all *i* in `[0, n)`.
+void bitwise_or(bitwise_block* out, bitwise_block const* x,
+                bitwise_block const* y, size_t n);
+
+/// Computes `out[i] = x[i] ^ y[i]` for all *i* in `[0, n)`.
+void bitwise_xor(bitwise_block* out, bitwise_block const* x,
+                 bitwise_block const* y, size_t n);
+
+/// Computes `out[i] = x[i] & ~y[i]` for all *i* in `[0, n)`.
+void bitwise_and_not(bitwise_block* out, bitwise_block const* x,
+                     bitwise_block const* y, size_t n);
+
+/// Computes the population count over a sequence of blocks.
+/// @param x The blocks to inspect.
+/// @param n The number of blocks.
+/// @returns The number of 1-bits in `x[0]` through `x[n-1]`.
+size_t popcount(bitwise_block const* x, size_t n);
+
+} // namespace detail
+} // namespace vast
+
+#endif
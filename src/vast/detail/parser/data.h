@@ -31,11 +31,20 @@ struct sequence_inserter
   {
     v.push_back(std::forward<T>(x));
   }
+};
 
-  template <typename T>
-  void operator()(set& s, T&& x) const
+struct set_factory
+{
+  template <typename>
+  struct result
+  {
+    using type = set;
+  };
+
+  template <typename Vector>
+  set operator()(Vector const& v) const
   {
-    s.insert(std::forward<T>(x));
+    return set(v.begin(), v.end());
   }
 };
 
@@ -90,7 +99,8 @@ struct data : qi::grammar<Iterator, vast::data(), skipper<Iterator>>
     qi::uint_type uint;
     qi::real_parser<double, qi::strict_real_policies<double>> strict_double;
 
-    boost::phoenix::function<sequence_inserter> vector_insert, set_insert;
+    boost::phoenix::function<sequence_inserter> vector_insert;
+    boost::phoenix::function<set_factory> make_set;
     boost::phoenix::function<map_inserter> map_insert;
     boost::phoenix::function<data_factory> make_data;
 
@@ -125,9 +135,10 @@ struct data : qi::grammar<Iterator, vast::data(), skipper<Iterator>>
       >>  ']'
       ;
 
-    st 
+    // Large sets, e.g., lists of indicators, get sorted at once.
+    st
       =   '{'
-      >>  dta [set_insert(_val, _1)] % ','
+      >>  (dta % ',') [_val = make_set(_1)]
       >>  '}'
       ;
 
@@ -0,0 +1,699 @@
+#include "vast/detail/roaring_container.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+
+namespace vast {
+namespace detail {
+
+namespace {
+
+using block_type = roaring_container::block_type;
+using interval = roaring_container::interval;
+
+constexpr size_t block_width = sizeof(block_type) * 8;
+constexpr block_type all_one = ~block_type{0};
+
+// The maximum number of runs before a run container becomes larger than the
+// equivalent bitmap container.
+constexpr size_t max_runs =
+  roaring_container::bitmap_blocks * sizeof(block_type) / 4;
+
+void set_range(block_type* blocks, uint32_t first, uint32_t last)
+{
+  assert(first < last);
+  auto i = first / block_width;
+  auto j = (last - 1) / block_width;
+  auto lo = all_one << (first % block_width);
+  auto hi = all_one >> (block_width - 1 - (last - 1) % block_width);
+  if (i == j)
+  {
+    blocks[i] |= lo & hi;
+    return;
+  }
+
+  blocks[i] |= lo;
+  for (++i; i < j; ++i)
+    blocks[i] = all_one;
+  blocks[j] |= hi;
+}
+
+// Finds the first 1-bit at or after position *i* in a bitmap, or the first
+// 0-bit if *flip* is true.
+size_t scan_forward(block_type const* blocks, uint32_t i, bool flip)
+{
+  auto b = i / block_width;
+  if (b >= roaring_container::bitmap_blocks)
+    return roaring_container::npos;
+
+  auto mask = flip ? all_one : 0;
+  auto block = (blocks[b] ^ mask) & (all_one << (i % block_width));
+  while (! block)
+  {
+    if (++b == roaring_container::bitmap_blocks)
+      return roaring_container::npos;
+    block = blocks[b] ^ mask;
+  }
+
+  return b * block_width + __builtin_ctzll(block);
+}
+
+// Combines two sorted lists of disjoint intervals by sweeping over their
+// boundaries.
+template <typename Operation>
+std::vector<interval> combine(std::vector<interval> const& xs,
+                              std::vector<interval> const& ys,
+                              Operation op)
+{
+  std::vector<interval> result;
+  size_t i = 0;
+  size_t j = 0;
+  uint32_t pos = 0;
+  while (pos < roaring_container::universe)
+  {
+    while (i < xs.size() && xs[i].second <= pos)
+      ++i;
+    while (j < ys.size() && ys[j].second <= pos)
+      ++j;
+
+    auto in_x = i < xs.size() && xs[i].first <= pos;
+    auto in_y = j < ys.size() && ys[j].first <= pos;
+    uint32_t next_x = roaring_container::universe;
+    uint32_t next_y = roaring_container::universe;
+    if (i < xs.size())
+      next_x = in_x ? xs[i].second : xs[i].first;
+    if (j < ys.size())
+      next_y = in_y ? ys[j].second : ys[j].first;
+
+    auto next = std::min(next_x, next_y);
+    if (op(in_x, in_y))
+    {
+      if (! result.empty() && result.back().second == pos)
+        result.back().second = next;
+      else
+        result.emplace_back(pos, next);
+    }
+
+    pos = next;
+  }
+
+  return result;
+}
+
+// Applies a bitwise block kernel to the uncompressed representations of two
+// containers.
+template <typename Kernel>
+void apply_kernel(roaring_container const& x, roaring_container const& y,
+                  std::vector<block_type>& result, Kernel kernel)
+{
+  std::vector<block_type> xs(roaring_container::bitmap_blocks);
+  std::vector<block_type> ys(roaring_container::bitmap_blocks);
+  x.materialize(xs.data());
+  y.materialize(ys.data());
+  result.resize(roaring_container::bitmap_blocks);
+  kernel(result.data(), xs.data(), ys.data(), result.size());
+}
+
+} // namespace <anonymous>
+
+constexpr size_t roaring_container::universe;
+constexpr size_t roaring_container::bitmap_blocks;
+constexpr size_t roaring_container::max_array_size;
+constexpr size_t roaring_container::npos;
+
+roaring_container::kind roaring_container::type() const
+{
+  return type_;
+}
+
+size_t roaring_container::count() const
+{
+  return count_;
+}
+
+bool roaring_container::empty() const
+{
+  return count_ == 0;
+}
+
+bool roaring_container::contains(uint32_t i) const
+{
+  switch (type_)
+  {
+    case array:
+      return std::binary_search(values_.begin(), values_.end(), i);
+    case bitmap:
+      return (blocks_[i / block_width] >> (i % block_width)) & 1;
+    case runs:
+      {
+        auto r = find_prev(i);
+        return r == i;
+      }
+  }
+
+  return false;
+}
+
+void roaring_container::append(uint32_t i)
+{
+  assert(i < universe);
+  assert(count_ == 0 || find_prev(universe - 1) < i);
+  if (type_ == array && count_ >= max_array_size)
+    to_bitmap();
+  else if (type_ == runs)
+  {
+    auto n = values_.size();
+    if (n > 0 && uint32_t{values_[n - 2]} + values_[n - 1] + 1 == i)
+    {
+      ++values_[n - 1];
+      ++count_;
+      return;
+    }
+
+    if (n / 2 >= max_runs)
+      to_bitmap();
+  }
+
+  switch (type_)
+  {
+    case array:
+      values_.push_back(i);
+      break;
+    case bitmap:
+      blocks_[i / block_width] |= block_type{1} << (i % block_width);
+      break;
+    case runs:
+      values_.push_back(i);
+      values_.push_back(0);
+      break;
+  }
+
+  ++count_;
+}
+
+void roaring_container::append(uint32_t first, uint32_t last)
+{
+  assert(first < last && last <= universe);
+  assert(count_ == 0 || find_prev(universe - 1) < first);
+  if (type_ == array)
+  {
+    if (count_ + (last - first) <= max_array_size)
+    {
+      for (auto i = first; i < last; ++i)
+        values_.push_back(i);
+      count_ += last - first;
+      return;
+    }
+
+    // A long range makes the array representation unsuitable. We switch to
+    // runs for now and let optimize() decide later.
+    assign(intervals());
+  }
+
+  if (type_ == runs)
+  {
+    auto n = values_.size();
+    if (n > 0 && uint32_t{values_[n - 2]} + values_[n - 1] + 1 == first)
+    {
+      values_[n - 1] += last - first;
+      count_ += last - first;
+      return;
+    }
+
+    if (n / 2 < max_runs)
+    {
+      values_.push_back(first);
+      values_.push_back(last - first - 1);
+      count_ += last - first;
+      return;
+    }
+
+    to_bitmap();
+  }
+
+  set_range(blocks_.data(), first, last);
+  count_ += last - first;
+}
+
+size_t roaring_container::find_next(uint32_t i) const
+{
+  if (i >= universe)
+    return npos;
+
+  switch (type_)
+  {
+    case array:
+      {
+        auto v = std::lower_bound(values_.begin(), values_.end(), i);
+        return v == values_.end() ? npos : *v;
+      }
+    case bitmap:
+      return scan_forward(blocks_.data(), i, false);
+    case runs:
+      {
+        // Binary search for the first run that ends at or after i.
+        size_t lo = 0;
+        size_t hi = values_.size() / 2;
+        while (lo < hi)
+        {
+          auto mid = (lo + hi) / 2;
+          if (uint32_t{values_[2 * mid]} + values_[2 * mid + 1] < i)
+            lo = mid + 1;
+          else
+            hi = mid;
+        }
+
+        if (lo == values_.size() / 2)
+          return npos;
+
+        return std::max(uint32_t{values_[2 * lo]}, i);
+      }
+  }
+
+  return npos;
+}
+
+size_t roaring_container::find_prev(uint32_t i) const
+{
+  if (i >= universe)
+    i = universe - 1;
+
+  switch (type_)
+  {
+    case array:
+      {
+        auto v = std::upper_bound(values_.begin(), values_.end(), i);
+        return v == values_.begin() ? npos : *--v;
+      }
+    case bitmap:
+      {
+        auto b = i / block_width;
+        auto shift = block_width - 1 - i % block_width;
+        auto block = blocks_[b] & (all_one >> shift);
+        while (! block)
+        {
+          if (b == 0)
+            return npos;
+          block = blocks_[--b];
+        }
+
+        return b * block_width + block_width - 1 - __builtin_clzll(block);
+      }
+    case runs:
+      {
+        // Binary search for the last run that starts at or before i.
+        size_t lo = 0;
+        size_t hi = values_.size() / 2;
+        while (lo < hi)
+        {
+          auto mid = (lo + hi) / 2;
+          if (values_[2 * mid] <= i)
+            lo = mid + 1;
+          else
+            hi = mid;
+        }
+
+        if (lo == 0)
+          return npos;
+
+        uint32_t start = values_[2 * (lo - 1)];
+        return std::min(i, start + values_[2 * (lo - 1) + 1]);
+      }
+  }
+
+  return npos;
+}
+
+size_t roaring_container::decode(uint32_t i, size_t base, size_t* out,
+                                 size_t n) const
+{
+  if (i >= universe)
+    return 0;
+
+  size_t k = 0;
+  switch (type_)
+  {
+    case array:
+      {
+        auto v = std::lower_bound(values_.begin(), values_.end(), i);
+        for ( ; v != values_.end() && k < n; ++v)
+          out[k++] = base + *v;
+      }
+      break;
+    case bitmap:
+      {
+        auto b = i / block_width;
+        auto block = blocks_[b] & (all_one << (i % block_width));
+        while (true)
+        {
+          while (block && k < n)
+          {
+            out[k++] = base + b * block_width + __builtin_ctzll(block);
+            block &= block - 1;
+          }
+
+          if (k == n || ++b == bitmap_blocks)
+            break;
+
+          block = blocks_[b];
+        }
+      }
+      break;
+    case runs:
+      for (size_t r = 0; r < values_.size() / 2 && k < n; ++r)
+      {
+        uint32_t last = uint32_t{values_[2 * r]} + values_[2 * r + 1] + 1;
+        if (last <= i)
+          continue;
+
+        for (auto v = std::max(uint32_t{values_[2 * r]}, i);
+             v < last && k < n; ++v)
+          out[k++] = base + v;
+      }
+      break;
+  }
+
+  return k;
+}
+
+void roaring_container::flip(uint32_t end)
+{
+  assert(end <= universe);
+  std::vector<interval> complement;
+  uint32_t pos = 0;
+  for (auto& x : intervals())
+  {
+    assert(x.second <= end);
+    if (x.first > pos)
+      complement.emplace_back(pos, x.first);
+    pos = x.second;
+  }
+
+  if (pos < end)
+    complement.emplace_back(pos, end);
+
+  assign(complement);
+  optimize();
+}
+
+void roaring_container::optimize()
+{
+  if (count_ == 0)
+  {
+    type_ = array;
+    values_.clear();
+    blocks_.clear();
+    return;
+  }
+
+  // We pick the representation with the smallest footprint, preferring the
+  // array over the bitmap when they tie.
+  auto array_size = count_ * sizeof(uint16_t);
+  auto bitmap_size = bitmap_blocks * sizeof(block_type);
+  auto runs_size = num_runs() * 2 * sizeof(uint16_t);
+  auto best = count_ <= max_array_size ? array : bitmap;
+  auto best_size = best == array ? array_size : bitmap_size;
+  if (runs_size < best_size)
+    best = runs;
+
+  if (best == type_)
+    return;
+
+  switch (best)
+  {
+    case array:
+      {
+        std::vector<uint16_t> values;
+        values.reserve(count_);
+        for (auto& x : intervals())
+          for (auto i = x.first; i < x.second; ++i)
+            values.push_back(i);
+        values_ = std::move(values);
+        blocks_.clear();
+        blocks_.shrink_to_fit();
+        type_ = array;
+      }
+      break;
+    case bitmap:
+      to_bitmap();
+      break;
+    case runs:
+      assign(intervals());
+      break;
+  }
+}
+
+void roaring_container::materialize(block_type* out) const
+{
+  if (type_ == bitmap)
+  {
+    std::copy(blocks_.begin(), blocks_.end(), out);
+    return;
+  }
+
+  std::fill_n(out, bitmap_blocks, block_type{0});
+  if (type_ == array)
+    for (auto i : values_)
+      out[i / block_width] |= block_type{1} << (i % block_width);
+  else
+    for (size_t r = 0; r < values_.size(); r += 2)
+      set_range(out, values_[r], uint32_t{values_[r]} + values_[r + 1] + 1);
+}
+
+std::vector<roaring_container::interval> roaring_container::intervals() const
+{
+  std::vector<interval> result;
+  switch (type_)
+  {
+    case array:
+      for (uint32_t i : values_)
+        if (! result.empty() && result.back().second == i)
+          ++result.back().second;
+        else
+          result.emplace_back(i, i + 1);
+      break;
+    case bitmap:
+      {
+        auto first = scan_forward(blocks_.data(), 0, false);
+        while (first != npos)
+        {
+          auto last = scan_forward(blocks_.data(), first, true);
+          if (last == npos)
+            last = universe;
+          result.emplace_back(first, last);
+          first = scan_forward(blocks_.data(), last, false);
+        }
+      }
+      break;
+    case runs:
+      result.reserve(values_.size() / 2);
+      for (size_t r = 0; r < values_.size(); r += 2)
+      {
+        uint32_t start = values_[r];
+        result.emplace_back(start, start + values_[r + 1] + 1);
+      }
+      break;
+  }
+
+  return result;
+}
+
+void roaring_container::to_bitmap()
+{
+  if (type_ == bitmap)
+    return;
+
+  std::vector<block_type> blocks(bitmap_blocks);
+  materialize(blocks.data());
+  blocks_ = std::move(blocks);
+  values_.clear();
+  values_.shrink_to_fit();
+  type_ = bitmap;
+}
+
+void roaring_container::assign(std::vector<interval> const& intervals)
+{
+  type_ = runs;
+  count_ = 0;
+  values_.clear();
+  blocks_.clear();
+  blocks_.shrink_to_fit();
+  values_.reserve(intervals.size() * 2);
+  for (auto& x : intervals)
+  {
+    assert(x.first < x.second);
+    values_.push_back(x.first);
+    values_.push_back(x.second - x.first - 1);
+    count_ += x.second - x.first;
+  }
+}
+
+size_t roaring_container::num_runs() const
+{
+  switch (type_)
+  {
+    case array:
+      {
+        size_t n = values_.empty() ? 0 : 1;
+        for (size_t i = 1; i < values_.size(); ++i)
+          if (values_[i] != values_[i - 1] + 1)
+            ++n;
+        return n;
+      }
+    case bitmap:
+      {
+        // A run starts at every 1-bit whose predecessor is a 0-bit.
+        size_t n = 0;
+        block_type carry = 0;
+        for (auto block : blocks_)
+        {
+          n += __builtin_popcountll(block & ~((block << 1) | carry));
+          carry = block >> (block_width - 1);
+        }
+        return n;
+      }
+    case runs:
+      return values_.size() / 2;
+  }
+
+  return 0;
+}
+
+roaring_container operator&(roaring_container const& x,
+                            roaring_container const& y)
+{
+  roaring_container result;
+  if (x.type_ == roaring_container::array
+      || y.type_ == roaring_container::array)
+  {
+    auto& a = x.type_ == roaring_container::array ? x : y;
+    auto& b = &a == &x ? y : x;
+    if (b.type_ == roaring_container::array)
+      std::set_intersection(a.values_.begin(), a.values_.end(),
+                            b.values_.begin(), b.values_.end(),
+                            std::back_inserter(result.values_));
+    else
+      for (auto i : a.values_)
+        if (b.contains(i))
+          result.values_.push_back(i);
+
+    result.count_ = result.values_.size();
+  }
+  else if (x.type_ == roaring_container::runs
+           && y.type_ == roaring_container::runs)
+  {
+    result.assign(combine(x.intervals(), y.intervals(),
+                          [](bool a, bool b) { return a && b; }));
+  }
+  else
+  {
+    apply_kernel(x, y, result.blocks_, bitwise_and);
+    result.type_ = roaring_container::bitmap;
+    result.count_ = popcount(result.blocks_.data(), result.blocks_.size());
+  }
+
+  result.optimize();
+  return result;
+}
+
+roaring_container operator|(roaring_container const& x,
+                            roaring_container const& y)
+{
+  roaring_container result;
+  if (x.type_ == roaring_container::array
+      && y.type_ == roaring_container::array)
+  {
+    std::set_union(x.values_.begin(), x.values_.end(),
+                   y.values_.begin(), y.values_.end(),
+                   std::back_inserter(result.values_));
+    result.count_ = result.values_.size();
+  }
+  else if (x.type_ == roaring_container::runs
+           && y.type_ == roaring_container::runs)
+  {
+    result.assign(combine(x.intervals(), y.intervals(),
+                          [](bool a, bool b) { return a || b; }));
+  }
+  else
+  {
+    apply_kernel(x, y, result.blocks_, bitwise_or);
+    result.type_ = roaring_container::bitmap;
+    result.count_ = popcount(result.blocks_.data(), result.blocks_.size());
+  }
+
+  result.optimize();
+  return result;
+}
+
+roaring_container operator^(roaring_container const& x,
+                            roaring_container const& y)
+{
+  roaring_container result;
+  if (x.type_ == roaring_container::array
+      && y.type_ == roaring_container::array)
+  {
+    std::set_symmetric_difference(x.values_.begin(), x.values_.end(),
+                                  y.values_.begin(), y.values_.end(),
+                                  std::back_inserter(result.values_));
+    result.count_ = result.values_.size();
+  }
+  else if (x.type_ == roaring_container::runs
+           && y.type_ == roaring_container::runs)
+  {
+    result.assign(combine(x.intervals(), y.intervals(),
+                          [](bool a, bool b) { return a != b; }));
+  }
+  else
+  {
+    apply_kernel(x, y, result.blocks_, bitwise_xor);
+    result.type_ = roaring_container::bitmap;
+    result.count_ = popcount(result.blocks_.data(), result.blocks_.size());
+  }
+
+  result.optimize();
+  return result;
+}
+
+roaring_container operator-(roaring_container const& x,
+                            roaring_container const& y)
+{
+  roaring_container result;
+  if (x.type_ == roaring_container::array)
+  {
+    for (auto i : x.values_)
+      if (! y.contains(i))
+        result.values_.push_back(i);
+
+    result.count_ = result.values_.size();
+  }
+  else if (x.type_ == roaring_container::runs
+           && y.type_ == roaring_container::runs)
+  {
+    result.assign(combine(x.intervals(), y.intervals(),
+                          [](bool a, bool b) { return a && ! b; }));
+  }
+  else
+  {
+    apply_kernel(x, y, result.blocks_, bitwise_and_not);
+    result.type_ = roaring_container::bitmap;
+    result.count_ = popcount(result.blocks_.data(), result.blocks_.size());
+  }
+
+  result.optimize();
+  return result;
+}
+
+bool operator==(roaring_container const& x, roaring_container const& y)
+{
+  if (x.count_ != y.count_)
+    return false;
+
+  if (x.type_ == y.type_)
+    return x.values_ == y.values_ && x.blocks_ == y.blocks_;
+
+  return x.intervals() == y.intervals();
+}
+
+} // namespace detail
+} // namespace vast
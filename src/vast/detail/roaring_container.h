@@ -0,0 +1,145 @@
+#ifndef VAST_DETAIL_ROARING_CONTAINER_H
+#define VAST_DETAIL_ROARING_CONTAINER_H
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "vast/detail/bitwise.h"
+#include "vast/serialization/arithmetic.h"
+#include "vast/serialization/container.h"
+#include "vast/util/operators.h"
+
+namespace vast {
+namespace detail {
+
+/// A set of 16-bit values representing one chunk of a Roaring bitmap. The
+/// container adapts its representation to the data: a sorted array of values
+/// for sparse chunks, an uncompressed bitmap for dense chunks, or a sorted
+/// list of runs for clustered chunks.
+class roaring_container : util::equality_comparable<roaring_container>
+{
+public:
+  using block_type = bitwise_block;
+
+  /// The representation of a container.
+  enum kind : uint8_t
+  {
+    array,
+    bitmap,
+    runs
+  };
+
+  /// The number of values a container can hold.
+  static constexpr size_t universe = size_t{1} << 16;
+
+  /// The number of blocks in the bitmap representation.
+  static constexpr size_t bitmap_blocks = universe / (sizeof(block_type) * 8);
+
+  /// The maximum cardinality of an array container.
+  static constexpr size_t max_array_size = 4096;
+
+  /// Returned by the finding functions when there exists no such value.
+  static constexpr size_t npos = universe;
+
+  /// A half-open interval `[first, second)` of values.
+  using interval = std::pair<uint32_t, uint32_t>;
+
+  /// Retrieves the representation of the container.
+  kind type() const;
+
+  /// Retrieves the cardinality of the container.
+  size_t count() const;
+
+  /// Checks whether the container has no values.
+  bool empty() const;
+
+  /// Checks whether the container holds a given value.
+  /// @param i The value to test.
+  /// @returns `true` iff *i* exists in the container.
+  bool contains(uint32_t i) const;
+
+  /// Adds a value which must be greater than all existing values.
+  /// @param i The value to add.
+  void append(uint32_t i);
+
+  /// Adds a range of values which must be greater than all existing values.
+  /// @param first The first value to add.
+  /// @param last One past the last value to add.
+  void append(uint32_t first, uint32_t last);
+
+  /// Finds the smallest value greater than or equal to a given value.
+  /// @param i The value to start at.
+  /// @returns The smallest value *v* with *v >= i* or ::npos.
+  size_t find_next(uint32_t i) const;
+
+  /// Finds the largest value less than or equal to a given value.
+  /// @param i The value to start at.
+  /// @returns The largest value *v* with *v <= i* or ::npos.
+  size_t find_prev(uint32_t i) const;
+
+  /// Writes the values greater than or equal to a given value into a
+  /// buffer, in ascending order.
+  /// @param i The value to start at.
+  /// @param base The offset to add to each value.
+  /// @param out The buffer receiving the values.
+  /// @param n The capacity of *out*.
+  /// @returns The number of values written to *out*.
+  size_t decode(uint32_t i, size_t base, size_t* out, size_t n) const;
+
+  /// Complements the container with respect to a prefix of the universe.
+  /// @param end One past the last value to consider.
+  void flip(uint32_t end = universe);
+
+  /// Switches to the representation with the smallest size.
+  void optimize();
+
+  /// Writes the container as uncompressed bitmap.
+  /// @param out An array of ::bitmap_blocks blocks.
+  void materialize(block_type* out) const;
+
+  /// Computes the intervals of consecutive values.
+  /// @returns The sorted list of intervals.
+  std::vector<interval> intervals() const;
+
+  friend roaring_container operator&(roaring_container const& x,
+                                     roaring_container const& y);
+  friend roaring_container operator|(roaring_container const& x,
+                                     roaring_container const& y);
+  friend roaring_container operator^(roaring_container const& x,
+                                     roaring_container const& y);
+  friend roaring_container operator-(roaring_container const& x,
+                                     roaring_container const& y);
+
+  friend bool operator==(roaring_container const& x,
+                         roaring_container const& y);
+
+private:
+  void to_bitmap();
+  void assign(std::vector<interval> const& intervals);
+  size_t num_runs() const;
+
+  kind type_ = array;
+  uint32_t count_ = 0;
+  std::vector<uint16_t> values_; // Sorted values, or (start, length - 1).
+  std::vector<block_type> blocks_;
+
+private:
+  friend access;
+
+  void serialize(serializer& sink) const
+  {
+    sink << static_cast<uint8_t>(type_) << count_ << values_ << blocks_;
+  }
+
+  void deserialize(deserializer& source)
+  {
+    uint8_t type;
+    source >> type >> count_ >> values_ >> blocks_;
+    type_ = static_cast<kind>(type);
+  }
+};
+
+} // namespace detail
+} // namespace vast
+
+#endif
@@ -1,5 +1,9 @@
 #include "vast/expr/resolver.h"
 
+#include <algorithm>
+#include <array>
+#include <limits>
+
 namespace vast {
 namespace expr {
 
@@ -222,5 +226,148 @@ expression type_resolver::operator()(predicate const& p)
   return {p};
 }
 
+trial<std::vector<offset>> find_connections(type::record const& r,
+                                            key const& k)
+{
+  // Connection records only show up as prefix of their leaves.
+  auto leaf = k;
+  leaf.push_back("orig_h");
+
+  std::vector<offset> offsets;
+  for (auto& p : r.find_suffix(leaf))
+  {
+    auto o = p.first;
+    o.pop_back();
+    auto t = r.at(o);
+    if (! (t && is<type::record>(*t)
+           && t->find_attribute(type::attribute::connection)))
+      return error{"no connection index for ", k, " in ", r.name()};
+
+    if (std::find(offsets.begin(), offsets.end(), o) == offsets.end())
+      offsets.push_back(std::move(o));
+  }
+
+  return std::move(offsets);
+}
+
+connection_resolver::connection_resolver(schema const& sch)
+  : schema_{sch}
+{
+}
+
+expression connection_resolver::operator()(none)
+{
+  return {};
+}
+
+expression connection_resolver::operator()(conjunction const& c)
+{
+  conjunction copy;
+  for (auto& op : c)
+    copy.push_back(visit(*this, op));
+
+  // Group the operands which constrain a tuple field by the key of their
+  // connection record.
+  static std::string const fields[] = {"orig_h", "orig_p", "resp_h", "resp_p"};
+  static constexpr auto unused = std::numeric_limits<size_t>::max();
+  std::vector<std::pair<key, std::array<size_t, 4>>> tuples;
+  for (size_t i = 0; i < copy.size(); ++i)
+  {
+    auto p = get<predicate>(copy[i]);
+    if (! p || p->op != equal)
+      continue;
+
+    auto e = get<schema_extractor>(p->lhs);
+    if (! e || ! is<data>(p->rhs) || e->key.size() < 2)
+      continue;
+
+    auto f = std::find(std::begin(fields), std::end(fields), e->key.back());
+    if (f == std::end(fields))
+      continue;
+
+    auto k = e->key;
+    k.pop_back();
+    auto t = std::find_if(tuples.begin(), tuples.end(),
+                          [&](auto& x) { return x.first == k; });
+    if (t == tuples.end())
+      t = tuples.emplace(tuples.end(), std::move(k),
+                         std::array<size_t, 4>{{unused, unused,
+                                                unused, unused}});
+
+    auto& slot = t->second[f - std::begin(fields)];
+    if (slot == unused)
+      slot = i;
+  }
+
+  std::vector<bool> routed(copy.size(), false);
+  conjunction result;
+  for (auto& t : tuples)
+  {
+    auto& slots = t.second;
+    if (slots[0] == unused || slots[2] == unused || slots[3] == unused)
+      continue;
+
+    // Partitions without a composite index for the key fall back to the
+    // field predicates, so it suffices that some record has one.
+    auto found = false;
+    for (auto& x : schema_)
+      if (auto r = get<type::record>(x))
+      {
+        auto offsets = find_connections(*r, t.first);
+        if (offsets && ! offsets->empty())
+          found = true;
+      }
+
+    if (! found)
+      continue;
+
+    record tuple;
+    for (auto i : slots)
+      if (i == unused)
+      {
+        tuple.emplace_back();
+      }
+      else
+      {
+        tuple.push_back(*get<data>(get<predicate>(copy[i])->rhs));
+        routed[i] = true;
+      }
+
+    result.push_back(
+        predicate{schema_extractor{t.first}, equal, data{std::move(tuple)}});
+  }
+
+  if (result.empty())
+    return {std::move(copy)};
+
+  for (size_t i = 0; i < copy.size(); ++i)
+    if (! routed[i])
+      result.push_back(std::move(copy[i]));
+
+  if (result.size() == 1)
+    return {std::move(result[0])};
+  else
+    return {std::move(result)};
+}
+
+expression connection_resolver::operator()(disjunction const& d)
+{
+  disjunction copy;
+  for (auto& op : d)
+    copy.push_back(visit(*this, op));
+
+  return {std::move(copy)};
+}
+
+expression connection_resolver::operator()(negation const& n)
+{
+  return {negation{visit(*this, n[0])}};
+}
+
+expression connection_resolver::operator()(predicate const& p)
+{
+  return {p};
+}
+
 } // namespace expr
 } // namespace vast
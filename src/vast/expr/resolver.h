@@ -49,6 +49,35 @@ struct type_resolver
   type const& type_;
 };
 
+/// Finds the connection records which a key denotes, i.e., the nested records
+/// carrying the `connection` attribute which have a composite index.
+/// @param r The record type to search.
+/// @param k The key of the connection record, e.g., `id`.
+/// @returns The offsets of the connection records in *r*, or an error if *k*
+///          also denotes a record without a composite index.
+trial<std::vector<offset>> find_connections(type::record const& r,
+                                            key const& k);
+
+/// Routes conjunctions of equality predicates on the fields of a connection
+/// record to the composite connection index. Specifically, it replaces the
+/// predicates `K.orig_h == A`, `K.resp_h == B`, and `K.resp_p == P`, plus an
+/// optional `K.orig_p == Q`, with a single predicate `K == (A, Q, B, P)` if
+/// *K* denotes a connection record in the schema. Each partition then decides
+/// whether it can answer the predicate from its composite indexes or has to
+/// evaluate the original field predicates.
+struct connection_resolver
+{
+  connection_resolver(schema const& sch);
+
+  expression operator()(none);
+  expression operator()(conjunction const& c);
+  expression operator()(disjunction const& d);
+  expression operator()(negation const& n);
+  expression operator()(predicate const& p);
+
+  schema const& schema_;
+};
+
 } // namespace expr
 } // namespace vast
 
@@ -13,6 +13,7 @@
 #  include <dirent.h>
 #  include <fcntl.h>
 #  include <unistd.h>
+#  include <sys/mman.h>
 #  include <sys/stat.h>
 #  include <sys/types.h>
 #  define VAST_ERRNO errno
@@ -473,6 +474,121 @@ path const& file::path() const
   return path_;
 }
 
+
+mapped_file::mapped_file(vast::path p)
+  : path_{std::move(p)}
+{
+}
+
+mapped_file::mapped_file(mapped_file&& other) noexcept
+  : data_{other.data_},
+    size_{other.size_},
+    is_open_{other.is_open_},
+    path_{std::move(other.path_)}
+{
+  other.data_ = nullptr;
+  other.size_ = 0;
+  other.is_open_ = false;
+}
+
+mapped_file::~mapped_file()
+{
+  close();
+}
+
+mapped_file& mapped_file::operator=(mapped_file&& other) noexcept
+{
+  close();
+  data_ = other.data_;
+  size_ = other.size_;
+  is_open_ = other.is_open_;
+  path_ = std::move(other.path_);
+  other.data_ = nullptr;
+  other.size_ = 0;
+  other.is_open_ = false;
+  return *this;
+}
+
+trial<void> mapped_file::open()
+{
+  if (is_open_)
+    return error{"file already mapped"};
+
+#ifdef VAST_POSIX
+  auto fd = ::open(path_.str().data(), O_RDONLY);
+  if (fd < 0)
+    return error{std::strerror(VAST_ERRNO)};
+
+  struct stat st;
+  if (::fstat(fd, &st) < 0)
+  {
+    auto e = error{std::strerror(VAST_ERRNO)};
+    ::close(fd);
+    return e;
+  }
+
+  // The mapping persists after closing the descriptor. Since mmap rejects
+  // empty mappings, we represent an empty file without one.
+  size_ = static_cast<size_t>(st.st_size);
+  if (size_ > 0)
+  {
+    auto addr = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED)
+    {
+      auto e = error{std::strerror(VAST_ERRNO)};
+      ::close(fd);
+      size_ = 0;
+      return e;
+    }
+
+    data_ = reinterpret_cast<char const*>(addr);
+  }
+
+  ::close(fd);
+  is_open_ = true;
+  return nothing;
+#else
+  return error{"not yet implemented"};
+#endif // VAST_POSIX
+}
+
+bool mapped_file::close()
+{
+#ifdef VAST_POSIX
+  if (! is_open_)
+    return false;
+  auto result = true;
+  if (data_)
+    result = ::munmap(const_cast<char*>(data_), size_) == 0;
+  data_ = nullptr;
+  size_ = 0;
+  is_open_ = false;
+  return result;
+#else
+  return false;
+#endif // VAST_POSIX
+}
+
+bool mapped_file::is_open() const
+{
+  return is_open_;
+}
+
+char const* mapped_file::data() const
+{
+  return data_;
+}
+
+size_t mapped_file::size() const
+{
+  return size_;
+}
+
+path const& mapped_file::path() const
+{
+  return path_;
+}
+
 bool exists(path const& p)
 {
 #ifdef VAST_POSIX
@@ -500,6 +616,11 @@ bool rm(const path& p)
   return false;
 }
 
+bool mv(path const& from, path const& to)
+{
+  return VAST_MOVE_FILE(from.str().data(), to.str().data());
+}
+
 trial<void> mkdir(path const& p)
 {
   auto components = p.split();
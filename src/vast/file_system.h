@@ -238,6 +238,64 @@ private:
   vast::path path_;
 };
 
+/// A read-only memory mapping of an entire file. The operating system loads
+/// the pages of the file on first access, so that readers pay only for the
+/// parts of the file they touch.
+class mapped_file
+{
+  mapped_file(mapped_file const&) = delete;
+  mapped_file& operator=(mapped_file const&) = delete;
+
+public:
+  /// Default-constructs a mapped file.
+  mapped_file() = default;
+
+  /// Constructs a mapped file from a path.
+  /// @param p The file path.
+  mapped_file(vast::path p);
+
+  /// Move-constructs a mapped file.
+  /// @param other The mapped file to move.
+  mapped_file(mapped_file&& other) noexcept;
+
+  /// Destroys a mapped file and unmaps it.
+  ~mapped_file();
+
+  /// Move-assigns a mapped file to this instance.
+  /// @param other The RHS of the assignment.
+  mapped_file& operator=(mapped_file&& other) noexcept;
+
+  /// Maps the file into memory.
+  /// @returns `nothing` on success.
+  trial<void> open();
+
+  /// Unmaps the file. Any pointer into the mapping becomes invalid.
+  /// @returns `true` on success.
+  bool close();
+
+  /// Checks whether the file is mapped.
+  /// @returns `true` iff the file is mapped.
+  bool is_open() const;
+
+  /// Retrieves the beginning of the mapping.
+  /// @returns A pointer to the first byte of the file.
+  char const* data() const;
+
+  /// Retrieves the size of the mapping.
+  /// @returns The number of bytes of the file.
+  size_t size() const;
+
+  /// Retrieves the ::path for this file.
+  /// @returns The ::path for this file.
+  vast::path const& path() const;
+
+private:
+  char const* data_ = nullptr;
+  size_t size_ = 0;
+  bool is_open_ = false;
+  vast::path path_;
+};
+
 /// Checks whether the path exists on the filesystem.
 /// @param p The path to check for existance.
 /// @returns `true` if *p* exists.
@@ -248,6 +306,13 @@ bool exists(path const& p);
 /// @returns `true` if *p* has been successfully deleted.
 bool rm(path const& p);
 
+/// Renames a path on the filesystem, replacing an existing file at the
+/// destination.
+/// @param from The path to rename.
+/// @param to The new path.
+/// @returns `true` if *from* has been successfully renamed to *to*.
+bool mv(path const& from, path const& to);
+
 /// If the path does not exist, create it as directory.
 /// @param p The path to a directory to create.
 /// @returns `true` on success or if *p* exists already.
@@ -29,6 +29,7 @@ class table;
 class bitstream;
 class null_bitstream;
 class ewah_bitstream;
+class roaring_bitstream;
 
 namespace expr {
 class ast;
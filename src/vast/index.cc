@@ -294,20 +294,17 @@ public:
     if (is<none>(root_))
       root_ = con;
 
-    auto hits = visit(*this, con[0]);
-    if (! hits)
-      return {};
-
-    for (size_t i = 1; i < con.size(); ++i)
+    std::vector<bitstream> operands;
+    operands.reserve(con.size());
+    for (auto& op : con)
     {
-      if (hits &= visit(*this, con[i]))
-        continue;
-      else
+      operands.push_back(visit(*this, op));
+      if (! operands.back())
         return {};  // short-circuit evaluation
     }
 
     auto& state = index_.queries_[root_].predicates[con];
-    state.hits = std::move(hits);
+    state.hits = and_all(operands.begin(), operands.end());
     return state.hits;
   }
 
@@ -316,12 +313,13 @@ public:
     if (is<none>(root_))
       root_ = dis;
 
-    bitstream hits;
+    std::vector<bitstream> operands;
+    operands.reserve(dis.size());
     for (auto& op : dis)
-      hits |= visit(*this, op);
+      operands.push_back(visit(*this, op));
 
     auto& state = index_.queries_[root_].predicates[dis];
-    state.hits = std::move(hits);
+    state.hits = or_all(operands.begin(), operands.end());
     return state.hits;
   }
 
@@ -344,16 +342,19 @@ public:
       root_ = pred;
 
     auto& state = index_.queries_[root_].predicates[pred];
-    bitstream hits;
+    std::vector<bitstream const*> operands{&state.hits};
     for (auto& part : state.restrictions)
     {
       auto& status = index_.partitions_[part].status;
       auto i = status.find(pred);
       if (i != status.end())
-        hits |= i->second.hits;
+      {
+        operands.push_back(&i->second.hits);
+        state.exact = state.exact && i->second.exact;
+      }
     }
 
-    state.hits |= hits;
+    state.hits = or_all(operands.begin(), operands.end());
     return state.hits;
   }
 
@@ -387,13 +388,21 @@ public:
         auto& now = preds[con].hits;
         auto prev = now;
 
-        now = preds[con[0]].hits;
-        for (size_t i = 0; i < con.size(); ++i)
-          if (now &= preds[con[i]].hits)
-            continue;
-          else
+        std::vector<bitstream const*> operands;
+        operands.reserve(con.size());
+        for (auto& x : con)
+        {
+          auto& hits = preds[x].hits;
+          if (! hits)
+          {
+            now = {};
             return false; // short-circuit evaluation
+          }
+
+          operands.push_back(&hits);
+        }
 
+        now = and_all(operands.begin(), operands.end());
         return now && (! prev || now != prev);
       }
 
@@ -446,6 +455,61 @@ public:
   expression root_;
 };
 
+// Determines whether the hits of a query consist of matching events only, in
+// which case the query can skip checking the candidates. Conjunctions and
+// disjunctions of exact predicates yield exact hits. A negation flips the
+// hits of partitions that have yet to answer, so it never counts as exact.
+struct index::exactness
+{
+public:
+  exactness(index const& idx, expression const& root)
+    : index_{idx},
+      root_{root}
+  {
+  }
+
+  bool operator()(none)
+  {
+    return false;
+  }
+
+  bool operator()(conjunction const& con)
+  {
+    for (auto& op : con)
+      if (! visit(*this, op))
+        return false;
+
+    return true;
+  }
+
+  bool operator()(disjunction const& dis)
+  {
+    for (auto& op : dis)
+      if (! visit(*this, op))
+        return false;
+
+    return true;
+  }
+
+  bool operator()(negation const&)
+  {
+    return false;
+  }
+
+  bool operator()(predicate const& pred)
+  {
+    auto q = index_.queries_.find(root_);
+    if (q == index_.queries_.end())
+      return false;
+
+    auto i = q->second.predicates.find(pred);
+    return i == q->second.predicates.end() || i->second.exact;
+  }
+
+  index const& index_;
+  expression const& root_;
+};
+
 void index::partition_state::serialize(serializer& sink) const
 {
   sink << events << first_event << last_event << last_modified;
@@ -818,7 +882,7 @@ message_handler index::act()
 
       auto& hits = queries_[ast].predicates[ast].hits;
       if (hits && ! hits.all_zero())
-        send(sink, hits);
+        send(sink, hits, visit(exactness{*this, ast}, ast));
 
       send(sink, atom("progress"), progress(ast), hits ? hits.count() : 0);
     },
@@ -836,15 +900,17 @@ message_handler index::act()
       if (status.got == n)
         consolidate(part, *get<predicate>(pred));
     },
-    [=](expression const& pred, uuid const& part, bitstream const& hits)
+    [=](expression const& pred, uuid const& part, bitstream const& hits,
+        bool exact)
     {
       VAST_LOG_ACTOR_DEBUG(
-          "received " << (hits ? hits.count() : 0) <<
+          "received " << (hits ? hits.count() : 0) << (exact ? " exact" : "") <<
           " hits from " << part << " for predicate " << pred);
 
       assert(partitions_[part].status.count(pred));
       auto& status = partitions_[part].status[pred];
       status.hits |= hits;
+      status.exact = status.exact && exact;
       ++status.got;
 
       // Once we have received all hits from a partition, we remove it from
@@ -859,15 +925,20 @@ message_handler index::act()
         auto& root = *i->second;
         VAST_LOG_ACTOR_DEBUG("evaluates " << root);
         auto& qs = queries_[root];
-        qs.predicates[pred].hits |= hits;
+        auto& ps = qs.predicates[pred];
+        ps.hits |= hits;
+        ps.exact = ps.exact && exact;
         auto changed = visit(propagator{*this, i->first}, root);
         auto& query_hits = qs.predicates[root].hits;
         if (changed)
         {
           assert(query_hits);
           if (! query_hits.all_zero())
+          {
+            auto e = visit(exactness{*this, root}, root);
             for (auto& sink : qs.subscribers)
-              send(sink, query_hits);
+              send(sink, query_hits, e);
+          }
         }
 
         auto count = query_hits ? query_hits.count() : 0;
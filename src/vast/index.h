@@ -22,12 +22,14 @@ public:
   struct dispatcher;
   struct evaluator;
   struct propagator;
+  struct exactness;
 
   struct partition_state
   {
     struct predicate_status
     {
       bitstream hits;
+      bool exact = true;
       uint64_t got = 0;
       optional<uint64_t> expected;
     };
@@ -50,6 +52,7 @@ public:
     struct predicate_state
     {
       bitstream hits;
+      bool exact = true;
       std::vector<uuid> restrictions;
     };
 
@@ -1,9 +1,12 @@
 #ifndef VAST_INDEXER_H
 #define VAST_INDEXER_H
 
+#include <algorithm>
+#include <cstdlib>
 #include <caf/all.hpp>
 #include "vast/actor.h"
 #include "vast/bitmap_index.h"
+#include "vast/bitmap_index_store.h"
 #include "vast/event.h"
 #include "vast/expression.h"
 #include "vast/file_system.h"
@@ -14,7 +17,18 @@
 
 namespace vast {
 
-/// Indexes a certain aspect of events with a single bitmap index.
+/// Indexes a certain aspect of events with a single bitmap index. The name
+/// and time indexers receive entire batches of events, from which the CRTP
+/// client extracts the relevant aspect. Data indexers receive a column of
+/// values along with the IDs of their events.
+///
+/// An indexer persists its bitmap index through a ::bitmap_index_store. It
+/// loads the bitmap index only when it receives the first message which
+/// needs it. If that message is a lookup, the indexer maps the checkpoint
+/// into memory, whereupon the bitmap index decodes only the bitstreams which
+/// lookups touch. Indexers of passive partitions thus never pay for the parts
+/// of their index that no query asks for. Before appending to a mapped index,
+/// the indexer reloads it in full.
 /// @tparam Derived The CRTP client.
 /// @tparam BitmapIndex The bitmap index type.
 template <typename Derived, typename BitmapIndex>
@@ -25,8 +39,7 @@ public:
   /// @param path The absolute file path on the file system.
   /// @param bmi The bitmap index.
   indexer(path path, BitmapIndex bmi = {})
-    : path_{std::move(path)},
-      bmi_{std::move(bmi)},
+    : store_{std::move(path), std::move(bmi)},
       stats_{std::chrono::seconds{1}}
   {
   }
@@ -37,46 +50,44 @@ public:
 
     this->trap_exit(true);
 
-    if (exists(path_))
+    auto flush = [=]
     {
-      auto attempt = io::unarchive(path_, last_flush_, bmi_);
+      auto n = store_.unflushed();
+      if (n == 0)
+        return;
+
+      auto& p = store_.checkpoint_due() ? store_.checkpoint_path()
+                                        : store_.log_path();
+      auto attempt = store_.flush();
       if (! attempt)
-        VAST_LOG_ACTOR_ERROR("failed to load bitmap index from " << path_ <<
+      {
+        VAST_LOG_ACTOR_ERROR("failed to flush " << n << " bits to " << p <<
                              ": " << attempt.error());
+        quit(exit::error);
+      }
       else
-        VAST_LOG_ACTOR_DEBUG("loaded bitmap index from " << path_ <<
-                             " (" << bmi_.size() << " bits)");
-    }
-
-    auto flush = [=]
-    {
-      auto size = static_cast<decltype(last_flush_)>(bmi_.size());
-      if (size > last_flush_)
       {
-        auto attempt = io::archive(path_, size, bmi_);
-        if (! attempt)
-        {
-          VAST_LOG_ACTOR_ERROR("failed to flush " << (size - last_flush_) <<
-                               " bits to " << path_ << ": " <<
-                               attempt.error());
-          quit(exit::error);
-        }
-        else
-        {
-          VAST_LOG_ACTOR_DEBUG(
-              "flushed bitmap index to " << path_ << " (" <<
-              (size - last_flush_) << '/' << size << " new/total bits)");
-
-          last_flush_ = size;
-        }
+        VAST_LOG_ACTOR_DEBUG(
+            "flushed bitmap index to " << p << " (" << n << '/' <<
+            store_.bitmap_index().size() << " new/total bits)");
       }
     };
 
     attach_functor(
         [=](uint32_t reason)
         {
-          if (reason != exit::kill)
-            flush();
+          // Indexers of passive partitions only answer lookups, possibly on
+          // a mapped checkpoint, which they must neither decode nor write.
+          if (reason == exit::kill || ! store_.modified())
+            return;
+
+          // The index replaces a partition with exit::stop once it reaches
+          // its maximum number of events, at which point the bitmap index
+          // can settle on its final encoding.
+          if (reason == exit::stop)
+            store_.optimize();
+
+          flush();
         });
 
     return
@@ -92,11 +103,14 @@ public:
       },
       [=](std::vector<event> const& events)
       {
+        load(false);
+        ensure_writable();
+
         uint64_t n = 0;
         uint64_t total = events.size();
         for (auto& e : events)
         {
-          auto t = static_cast<Derived*>(this)->append(bmi_, e);
+          auto t = static_cast<Derived*>(this)->append(e);
           if (t)
             ++n;
           else
@@ -108,28 +122,94 @@ public:
 
         return make_message(total, n, stats_.last(), stats_.mean());
       },
+      [=](std::vector<event_id> const& ids, std::vector<data> const& values)
+      {
+        assert(ids.size() == values.size());
+
+        load(false);
+        ensure_writable();
+
+        uint64_t n = 0;
+        uint64_t total = ids.size();
+        for (size_t i = 0; i < ids.size(); ++i)
+          if (push_back(values[i], ids[i]))
+            ++n;
+          else
+            VAST_LOG_ACTOR_ERROR("failed to append value " << values[i] <<
+                                 " of event " << ids[i]);
+
+        stats_.increment(n);
+
+        return make_message(total, n, stats_.last(), stats_.mean());
+      },
       [=](expression const& pred, uuid const& part, actor sink)
       {
         auto p = get<predicate>(pred);
         assert(p);
 
-        auto r = bmi_.lookup(p->op, *get<data>(p->rhs));
+        load(true);
+        auto& bmi = store_.bitmap_index();
+        auto r = bmi.lookup(p->op, *get<data>(p->rhs));
         if (! r)
         {
           VAST_LOG_ACTOR_ERROR(r.error());
-          send(sink, pred, part, bitstream{});
+          send(sink, pred, part, bitstream{}, false);
           return;
         }
 
-        send(sink, pred, part, bitstream{std::move(*r)});
+        send(sink, pred, part, bitstream{std::move(*r)},
+             bmi.exact(p->op));
       }
     };
   }
 
+protected:
+  /// Extracts the relevant aspect of an event and appends it. Only CRTP
+  /// clients which receive entire batches of events override this.
+  /// @param e The event to append.
+  /// @returns `nothing` on success.
+  trial<void> append(event const& e)
+  {
+    return error{"indexer expects a column of values, not event ", e.id()};
+  }
+
+  /// Appends a value to the bitmap index and records it for the next flush.
+  /// @param x The value to append.
+  /// @param id The ID of the event which *x* belongs to.
+  /// @returns `true` on success.
+  bool push_back(data x, event_id id)
+  {
+    return store_.push_back(std::move(x), id);
+  }
+
 private:
-  path const path_;
-  BitmapIndex bmi_;
-  uint64_t last_flush_ = 1;
+  // Loads the bitmap index, once. With *mapped*, the bitmap index refers to
+  // the checkpoint in memory instead of copying it.
+  void load(bool mapped)
+  {
+    if (store_.loaded())
+      return;
+
+    auto attempt = store_.load(mapped);
+    if (! attempt)
+      VAST_LOG_ACTOR_ERROR("failed to load bitmap index from " <<
+                           store_.checkpoint_path() << ": " << attempt.error());
+    else
+      VAST_LOG_ACTOR_DEBUG((mapped ? "mapped" : "loaded") <<
+                           " bitmap index from " << store_.checkpoint_path() <<
+                           " (" << store_.bitmap_index().size() << " bits)");
+  }
+
+  // Reloads a mapped bitmap index without the mapping before appending.
+  void ensure_writable()
+  {
+    auto attempt = store_.unmap();
+    if (! attempt)
+      VAST_LOG_ACTOR_ERROR("failed to reload bitmap index from " <<
+                           store_.checkpoint_path() << ": " << attempt.error());
+  }
+
+  bitmap_index_store<BitmapIndex> store_;
   util::rate_accumulator<uint64_t> stats_;
 };
 
@@ -137,18 +217,17 @@ template <typename Bitstream>
 struct event_name_indexer
   : indexer<
       event_name_indexer<Bitstream>,
-      string_bitmap_index<Bitstream>
+      dictionary_bitmap_index<Bitstream>
     >
 {
   using indexer<
     event_name_indexer<Bitstream>,
-    string_bitmap_index<Bitstream>
+    dictionary_bitmap_index<Bitstream>
   >::indexer;
 
-  template <typename BitmapIndex>
-  trial<void> append(BitmapIndex& bmi, event const& e)
+  trial<void> append(event const& e)
   {
-    if (bmi.push_back(e.type().name(), e.id()))
+    if (this->push_back(e.type().name(), e.id()))
       return nothing;
     else
       return error{"failed to append event name: ", e.type().name()};
@@ -164,18 +243,17 @@ template <typename Bitstream>
 struct event_time_indexer
   : indexer<
       event_time_indexer<Bitstream>,
-      arithmetic_bitmap_index<Bitstream, time_point>
+      time_bitmap_index<Bitstream>
     >
 {
   using indexer<
     event_time_indexer<Bitstream>,
-    arithmetic_bitmap_index<Bitstream, time_point>
+    time_bitmap_index<Bitstream>
   >::indexer;
 
-  template <typename BitmapIndex>
-  trial<void> append(BitmapIndex& bmi, event const& e)
+  trial<void> append(event const& e)
   {
-    if (bmi.push_back(e.timestamp(), e.id()))
+    if (this->push_back(e.timestamp(), e.id()))
       return nothing;
     else
       return error{"failed to append event timestamp: ", e.timestamp()};
@@ -187,59 +265,26 @@ struct event_time_indexer
   }
 };
 
+/// Indexes the values of one field of one event type. The partition splits
+/// each batch into columns and sends every data indexer only the IDs and
+/// values of its field, so that data indexers never see entire events.
 template <typename BitmapIndex>
 struct event_data_indexer
   : indexer<event_data_indexer<BitmapIndex>, BitmapIndex>
 {
   using super = indexer<event_data_indexer<BitmapIndex>, BitmapIndex>;
 
-  event_data_indexer(type t, path p, offset o, BitmapIndex bmi = {})
+  event_data_indexer(path p, offset o, BitmapIndex bmi = {})
     : super{std::move(p), std::move(bmi)},
-      event_type_{std::move(t)},
       offset_{std::move(o)}
   {
   }
 
-  trial<void> append(BitmapIndex& bmi, event const& e)
-  {
-    // Bail out if we're not responsible.
-    if (e.type() != event_type_)
-      return nothing;
-
-    auto r = get<record>(e);
-    if (! r)
-    {
-      assert(offset_.empty());
-      if (bmi.push_back(e.data(), e.id()))
-        return nothing;
-      else
-        return error{"push_back failed for ", e.data(), ", id", e.id()};
-    }
-
-    if (auto d = r->at(offset_))
-    {
-      if (bmi.push_back(*d, e.id()))
-        return nothing;
-      else
-        return error{"push_back failed for ", *d, ", id", e.id()};
-    }
-    else
-    {
-      // If there is no data at a given offset, it means that an intermediate
-      // record is nil but we're trying to access a deeper field.
-      if (bmi.push_back(nil, e.id()))
-        return nothing;
-      else
-        return error{"push_back failed for nil, id ", e.id()};
-    }
-  }
-
   std::string describe() const final
   {
     return "data-bitmap-indexer(" + to_string(offset_) + ')';
   }
 
-  type event_type_;
   offset offset_;
 };
 
@@ -248,10 +293,9 @@ namespace detail {
 template <typename Bitstream>
 struct event_data_index_factory
 {
-  event_data_index_factory(path const& p, offset const& o, type const& t)
+  event_data_index_factory(path const& p, offset const& o)
     : path_{p},
-      off_{o},
-      event_type_{t}
+      off_{o}
   {
   }
 
@@ -261,9 +305,10 @@ struct event_data_index_factory
     return spawn<arithmetic_bitmap_index<Bitstream, type::to_data<T>>>();
   }
 
-  trial<caf::actor> operator()(type::address const&) const
+  trial<caf::actor> operator()(type::address const& t) const
   {
-    return spawn<address_bitmap_index<Bitstream>>();
+    auto prefixes = t.find_attribute(type::attribute::prefix) != nullptr;
+    return spawn<address_bitmap_index<Bitstream>>(prefixes);
   }
 
   trial<caf::actor> operator()(type::subnet const&) const
@@ -276,9 +321,22 @@ struct event_data_index_factory
     return spawn<port_bitmap_index<Bitstream>>();
   }
 
-  trial<caf::actor> operator()(type::string const&) const
+  trial<caf::actor> operator()(type::string const& t) const
   {
-    return spawn<string_bitmap_index<Bitstream>>();
+    auto a = t.find_attribute(type::attribute::ngram);
+    if (! a)
+      return spawn<dictionary_bitmap_index<Bitstream>>();
+
+    auto n = ngram_bitmap_index<Bitstream>::default_n;
+    if (! a->value.empty())
+    {
+      char* end;
+      n = std::strtoull(a->value.c_str(), &end, 10);
+      if (*end != '\0' || n == 0 || n > ngram_bitmap_index<Bitstream>::max_n)
+        return error{"invalid n-gram length: ", a->value};
+    }
+
+    return spawn<ngram_bitmap_index<Bitstream>>(n);
   }
 
   trial<caf::actor> operator()(type::enumeration const&) const
@@ -288,12 +346,14 @@ struct event_data_index_factory
 
   trial<caf::actor> operator()(type::vector const& t) const
   {
-    return spawn<sequence_bitmap_index<Bitstream>>(t.elem());
+    auto positional = ! t.find_attribute(type::attribute::membership);
+    return spawn<sequence_bitmap_index<Bitstream>>(t.elem(), positional);
   }
 
   trial<caf::actor> operator()(type::set const& t) const
   {
-    return spawn<sequence_bitmap_index<Bitstream>>(t.elem());
+    auto positional = ! t.find_attribute(type::attribute::membership);
+    return spawn<sequence_bitmap_index<Bitstream>>(t.elem(), positional);
   }
 
   trial<caf::actor> operator()(none const&) const
@@ -306,14 +366,33 @@ struct event_data_index_factory
     return error{"regular expressions not yet supported"};
   }
 
-  trial<caf::actor> operator()(type::table const&) const
+  trial<caf::actor> operator()(type::table const& t) const
   {
-    return error{"tables not yet supported"};
+    return spawn<table_bitmap_index<Bitstream>>(t.key(), t.value());
   }
 
-  trial<caf::actor> operator()(type::record const&) const
+  trial<caf::actor> operator()(type::record const& t) const
   {
-    return error{"records shall be unrolled"};
+    if (! t.find_attribute(type::attribute::connection))
+      return error{"records shall be unrolled"};
+
+    using bmi_type = connection_bitmap_index<Bitstream>;
+    typename bmi_type::field_positions fields;
+    auto i = fields.begin();
+    for (auto name : {"orig_h", "orig_p", "resp_h", "resp_p"})
+    {
+      auto f = std::find_if(
+          t.fields().begin(),
+          t.fields().end(),
+          [&](type::record::field const& x) { return x.name == name; });
+
+      if (f == t.fields().end())
+        return error{"connection record lacks field ", name};
+
+      *i++ = f - t.fields().begin();
+    }
+
+    return spawn<bmi_type>(fields);
   }
 
   trial<caf::actor> operator()(type::alias const& a) const
@@ -326,12 +405,11 @@ struct event_data_index_factory
   {
     using indexer_type = event_data_indexer<BitmapIndex>;
     return caf::spawn<indexer_type>(
-        event_type_, path_, off_, BitmapIndex{std::forward<Args>(args)...});
+        path_, off_, BitmapIndex{std::forward<Args>(args)...});
   }
 
   path const& path_;
   offset const& off_;
-  type const& event_type_;
 };
 
 } // namespace detail
@@ -339,10 +417,9 @@ struct event_data_index_factory
 /// Factory to construct an indexer based on a given type.
 template <typename Bitstream>
 trial<caf::actor>
-make_event_data_indexer(path const& p, type const& et, type const& t,
-                        offset const& o)
+make_event_data_indexer(path const& p, type const& t, offset const& o)
 {
-  return visit(detail::event_data_index_factory<Bitstream>{p, o, et}, t);
+  return visit(detail::event_data_index_factory<Bitstream>{p, o}, t);
 }
 
 } // namespace vast
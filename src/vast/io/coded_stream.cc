@@ -40,6 +40,17 @@ bool coded_input_stream::raw(void const** data, size_t* size)
   return true;
 }
 
+bool coded_input_stream::view(void const** data, size_t size)
+{
+  if (buffer_.size() == 0 && ! refresh())
+    return false;
+  if (buffer_.size() < size)
+    return false;
+  *data = buffer_.get();
+  buffer_.advance(size);
+  return true;
+}
+
 size_t coded_input_stream::read_raw(void* sink, size_t size)
 {
   VAST_ENTER(VAST_ARG(sink, size));
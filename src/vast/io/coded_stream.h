@@ -42,6 +42,17 @@ public:
   /// underlying buffer was not empty.
   bool raw(void const** data, size_t* size);
 
+  /// Consumes a given number of bytes without copying them, which requires
+  /// that the current buffer of the wrapped stream holds all of them.
+  ///
+  /// @param data Set to the beginning of the consumed bytes.
+  ///
+  /// @param size The number of bytes to consume.
+  ///
+  /// @returns `true` if *data* points to *size* contiguous bytes of the
+  /// wrapped stream. Upon failure, the function consumes nothing.
+  bool view(void const** data, size_t size);
+
   /// Reads an arithmetic type from the input.
   /// @tparam T an arithmetic type.
   /// @param x The value to read into.
@@ -107,6 +107,22 @@ trial<void> unarchive(path const& filename, Ts&... xs)
   return nothing;
 }
 
+// Deserializes from a memory-mapped file without copying where possible:
+// read-only views, such as ewah_bitstream_view, point straight into the
+// mapping, which must therefore outlive them.
+template <typename... Ts>
+trial<void> unarchive(mapped_file const& file, Ts&... xs)
+{
+  if (! file.is_open())
+    return error{"file not mapped: ", file.path().str()};
+
+  array_input_stream source{file.data(), file.size()};
+  binary_deserializer d{source, true};
+  detail::do_deserialize(d, xs...);
+
+  return nothing;
+}
+
 template <typename... Ts, typename Container>
 auto compress(compression method, Container& c, Ts const&... xs)
   -> decltype(detail::is_byte_container<Container>(), trial<void>())
@@ -1,8 +1,10 @@
 #include "vast/partition.h"
 
+#include <algorithm>
 #include <caf/all.hpp>
 #include "vast/event.h"
 #include "vast/indexer.h"
+#include "vast/expr/resolver.h"
 #include "vast/task_tree.h"
 #include "vast/io/serialization.h"
 #include "vast/source/dechunkifier.h"
@@ -91,6 +93,9 @@ struct partition::dispatcher
 
   std::vector<actor> operator()(schema_extractor const& e, data const& d)
   {
+    if (auto tuple = get<record>(d))
+      return connections(e, *tuple);
+
     std::vector<actor> indexes;
     for (auto& t : part_.schema_)
       if (auto r = get<type::record>(t))
@@ -137,8 +142,59 @@ struct partition::dispatcher
     return (*this)(e, d);
   }
 
+  // Finds the composite indexes of the connection records a key denotes. If
+  // the key also denotes records without a composite index, or if this
+  // partition predates some of the composite indexes, we record the
+  // predicates on the tuple fields instead.
+  std::vector<actor> connections(schema_extractor const& e,
+                                 record const& tuple)
+  {
+    std::vector<actor> indexes;
+    for (auto& t : part_.schema_)
+      if (auto r = get<type::record>(t))
+      {
+        auto offsets = expr::find_connections(*r, e.key);
+        if (! offsets)
+          return fields(e, tuple);
+
+        for (auto& o : *offsets)
+        {
+          auto a = part_.find_data_indexer(t, *r->at(o), o);
+          if (! a)
+          {
+            VAST_LOG_ERROR(a.error());
+            return {};
+          }
+
+          if (! *a)
+            return fields(e, tuple);
+
+          indexes.push_back(std::move(*a));
+        }
+      }
+
+    return indexes;
+  }
+
+  // Splits a connection predicate into the predicates on its tuple fields,
+  // where a nil originator port imposes no constraint.
+  std::vector<actor> fields(schema_extractor const& e, record const& tuple)
+  {
+    static std::string const names[] = {"orig_h", "orig_p", "resp_h", "resp_p"};
+    for (size_t i = 0; i < tuple.size() && i < 4; ++i)
+      if (! is<none>(tuple[i]))
+      {
+        auto k = e.key;
+        k.push_back(names[i]);
+        fields_.emplace_back(schema_extractor{std::move(k)}, equal, tuple[i]);
+      }
+
+    return {};
+  }
+
   relational_operator op_;
   partition& part_;
+  std::vector<predicate> fields_;
 };
 
 
@@ -174,11 +230,40 @@ message_handler partition::act()
         for (auto& p : indexers_)
           anon_send_exit(p.second, reason);
         indexers_.clear();
+        columns_.clear();
       });
 
 
   send(this, atom("stats"), atom("show"));
 
+  // Hands the hits of a tuple field to the connection predicates awaiting
+  // them and relays the conjunction of all fields of a predicate to the
+  // index once complete.
+  auto complete_field = [=](expression const& field)
+  {
+    auto i = field_lookups_.find(field);
+    assert(i != field_lookups_.end());
+    auto fl = std::move(i->second);
+    field_lookups_.erase(i);
+
+    for (auto& pred : fl.tuples)
+    {
+      auto j = tuple_lookups_.find(pred);
+      assert(j != tuple_lookups_.end());
+      auto& tl = j->second;
+      tl.hits.push_back(fl.hits);
+      tl.exact = tl.exact && fl.exact;
+      if (--tl.pending > 0)
+        continue;
+
+      auto hits = and_all(tl.hits.begin(), tl.hits.end());
+      for (auto& sink : tl.sinks)
+        send(sink, pred, id_, hits, tl.exact);
+
+      tuple_lookups_.erase(j);
+    }
+  };
+
   return
   {
     [=](exit_msg const& e)
@@ -228,20 +313,69 @@ message_handler partition::act()
             indexers_.erase(i);
             break;
           }
+
+        for (auto& p : columns_)
+        {
+          auto& cols = p.second;
+          cols.erase(std::remove_if(cols.begin(), cols.end(),
+                                    [&](column const& c)
+                                    {
+                                      return c.indexer == last_sender();
+                                    }),
+                     cols.end());
+        }
       }
     },
     [=](expression const& pred, actor idx)
     {
       VAST_LOG_ACTOR_DEBUG("got predicate " << pred);
 
-      auto indexers = visit(dispatcher{*this}, pred);
+      dispatcher d{*this};
+      auto indexers = visit(d, pred);
+      if (! d.fields_.empty())
+      {
+        VAST_LOG_ACTOR_DEBUG("evaluates " << pred << " through its fields");
+        send(idx, pred, id_, uint64_t{1});
+
+        auto& tl = tuple_lookups_[pred];
+        tl.sinks.push_back(idx);
+        if (tl.sinks.size() > 1)
+          return;
+
+        // We register all fields before dispatching any of them, because a
+        // field without indexers completes right away.
+        tl.pending = d.fields_.size();
+        std::vector<expression> idle;
+        for (auto& f : d.fields_)
+        {
+          expression field{std::move(f)};
+          auto& fl = field_lookups_[field];
+          fl.tuples.push_back(pred);
+          if (fl.tuples.size() > 1)
+            continue;
+
+          auto field_indexers = visit(dispatcher{*this}, field);
+          fl.pending = field_indexers.size();
+          if (field_indexers.empty())
+            idle.push_back(std::move(field));
+          else
+            for (auto& a : field_indexers)
+              send(a, field, id_, this);
+        }
+
+        for (auto& field : idle)
+          complete_field(field);
+
+        return;
+      }
+
       uint64_t n = indexers.size();
       send(idx, pred, id_, n);
 
       if (n == 0)
       {
         VAST_LOG_ACTOR_DEBUG("did not find a matching indexer for " << pred);
-        send(idx, pred, id_, bitstream{});
+        send(idx, pred, id_, bitstream{}, true);
       }
       else
       {
@@ -250,6 +384,17 @@ message_handler partition::act()
           send_tuple(a, t);
       }
     },
+    [=](expression const& field, uuid const&, bitstream const& hits,
+        bool exact)
+    {
+      auto i = field_lookups_.find(field);
+      assert(i != field_lookups_.end());
+      auto& fl = i->second;
+      fl.hits |= hits;
+      fl.exact = fl.exact && exact;
+      if (--fl.pending == 0)
+        complete_field(field);
+    },
     on(atom("flush"), arg_match) >> [=](actor tree)
     {
       VAST_LOG_ACTOR_DEBUG("got request to flush indexes");
@@ -299,6 +444,17 @@ message_handler partition::act()
             auto attempt = r->each(
                 [&](type::record::trace const& t, offset const& o) -> trial<void>
                 {
+                  // Connection records get a composite index in addition to
+                  // the indexes of their fields.
+                  for (size_t i = 0; i + 1 < t.size(); ++i)
+                    if (t[i]->type.find_attribute(type::attribute::connection))
+                    {
+                      offset prefix(o.begin(), o.begin() + i + 1);
+                      auto a = create_data_indexer(tp, t[i]->type, prefix);
+                      if (! a)
+                        return a.error();
+                    }
+
                   if (t.back()->type.find_attribute(type::attribute::skip))
                     return nothing;
 
@@ -332,11 +488,51 @@ message_handler partition::act()
     },
     [=](std::vector<event> const& events)
     {
-      for (auto& p : indexers_)
-        send_tuple(p.second, last_dequeued());
+      // The meta indexers consume entire events.
+      for (auto& a : {load_time_indexer(), load_name_indexer()})
+      {
+        send_tuple(a, last_dequeued());
+        stats_[a.address()].backlog += events.size();
+      }
+
+      // Each data indexer only gets the values at its offset from the events
+      // of its type, which we extract here in a single pass per type.
+      std::unordered_map<type, std::vector<event const*>> by_type;
+      for (auto& e : events)
+        by_type[e.type()].push_back(&e);
+
+      for (auto& p : by_type)
+      {
+        auto c = columns_.find(p.first);
+        if (c == columns_.end())
+          continue;
+
+        std::vector<event_id> ids;
+        ids.reserve(p.second.size());
+        for (auto e : p.second)
+          ids.push_back(e->id());
+
+        for (auto& col : c->second)
+        {
+          std::vector<data> values;
+          values.reserve(p.second.size());
+          for (auto e : p.second)
+            if (auto r = get<record>(*e))
+            {
+              // No data at the offset means that an intermediate record is
+              // nil.
+              auto d = r->at(col.off);
+              values.push_back(d ? *d : nil);
+            }
+            else
+            {
+              values.push_back(e->data());
+            }
 
-      for (auto& p : stats_)
-        p.second.backlog += events.size();
+          send(col.indexer, ids, std::move(values));
+          stats_[col.indexer.address()].backlog += ids.size();
+        }
+      }
     },
     on(atom("unpack")) >> [=]
     {
@@ -475,8 +671,19 @@ trial<actor> partition::load_data_indexer(
   return create_data_indexer(et, t, o);
 }
 
-trial<actor> partition::create_data_indexer(
+trial<actor> partition::find_data_indexer(
     type const& et, type const& t, offset const& o)
+{
+  auto abs = data_indexer_path(et, o);
+  auto log = abs;
+  log += ".log";
+  if (indexers_.count(abs) || exists(abs) || exists(log))
+    return create_data_indexer(et, t, o);
+
+  return actor{invalid_actor};
+}
+
+path partition::data_indexer_path(type const& et, offset const& o) const
 {
   auto abs = dir_ / path{"types"} / et.name();
 
@@ -490,18 +697,24 @@ trial<actor> partition::create_data_indexer(
       abs /= f;
   }
 
-  abs /= "index";
+  return abs / "index";
+}
 
+trial<actor> partition::create_data_indexer(
+    type const& et, type const& t, offset const& o)
+{
+  auto abs = data_indexer_path(et, o);
   auto& s = indexers_[abs];
   if (! s)
   {
-    auto a = make_event_data_indexer<default_bitstream>(abs, et, t, o);
+    auto a = make_event_data_indexer<default_bitstream>(abs, t, o);
     if (! a)
       return a;
 
     s = *a;
     monitor(s);
     stats_[s.address()];
+    columns_[et].push_back({o, s});
   }
 
   return s;
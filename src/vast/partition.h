@@ -1,10 +1,14 @@
 #ifndef VAST_PARTITION_H
 #define VAST_PARTITION_H
 
+#include <map>
 #include <queue>
 #include "vast/actor.h"
+#include "vast/bitstream.h"
 #include "vast/chunk.h"
+#include "vast/expression.h"
 #include "vast/file_system.h"
+#include "vast/offset.h"
 #include "vast/schema.h"
 #include "vast/time.h"
 #include "vast/trial.h"
@@ -48,6 +52,33 @@ private:
     uint64_t value_rate_mean = 0; // Mean indexing rate (values/sec).
   };
 
+  // A data indexer along with the offset of the values it receives.
+  struct column
+  {
+    offset off;
+    caf::actor indexer;
+  };
+
+  // A connection predicate which the partition evaluates as conjunction of
+  // the predicates on its tuple fields, for lack of composite indexes.
+  struct tuple_lookup
+  {
+    std::vector<caf::actor> sinks;
+    std::vector<bitstream> hits;
+    uint64_t pending = 0;
+    bool exact = true;
+  };
+
+  // A predicate on a tuple field along with the connection predicates
+  // awaiting its hits.
+  struct field_lookup
+  {
+    std::vector<expression> tuples;
+    bitstream hits;
+    uint64_t pending = 0;
+    bool exact = true;
+  };
+
   struct dispatcher;
 
   caf::actor load_time_indexer();
@@ -58,6 +89,14 @@ private:
 
   trial<caf::actor> create_data_indexer(type const& et, type const& t,
                                         offset const& o);
+
+  // Loads a data indexer only if it exists already, in memory or on the
+  // file system, and yields an invalid actor otherwise.
+  trial<caf::actor> find_data_indexer(type const& et, type const& t,
+                                      offset const& o);
+
+  path data_indexer_path(type const& et, offset const& o) const;
+
   path dir_;
   uuid id_;
   bool updated_ = false;
@@ -66,8 +105,11 @@ private:
   uint32_t exit_reason_ = 0;
   schema schema_;
   std::unordered_map<path, caf::actor> indexers_;
+  std::unordered_map<type, std::vector<column>> columns_;
   std::unordered_map<caf::actor_addr, statistics> stats_;
   std::queue<chunk> chunks_;
+  std::map<expression, tuple_lookup> tuple_lookups_;
+  std::map<expression, field_lookup> field_lookups_;
   caf::actor dechunkifier_;
 };
 
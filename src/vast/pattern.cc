@@ -23,6 +23,18 @@ bool pattern::match(std::string const& str) const
   return std::regex_match(str.begin(), str.end(), std::regex{str_});
 }
 
+std::vector<size_t>
+pattern::match(std::vector<std::string> const& strs) const
+{
+  std::regex rx{str_};
+  std::vector<size_t> result;
+  for (size_t i = 0; i < strs.size(); ++i)
+    if (std::regex_match(strs[i].begin(), strs[i].end(), rx))
+      result.push_back(i);
+
+  return result;
+}
+
 bool pattern::search(std::string const& str) const
 {
   return std::regex_search(str.begin(), str.end(), std::regex{str_});
@@ -2,6 +2,7 @@
 #define VAST_PATTERN_H
 
 #include <string>
+#include <vector>
 #include "vast/parse.h"
 #include "vast/print.h"
 #include "vast/util/operators.h"
@@ -35,6 +36,12 @@ public:
   /// @returns `true` if the pattern matches exactly *str*.
   bool match(std::string const& str) const;
 
+  /// Matches several strings against the pattern, compiling it only once.
+  /// @param strs The strings to match.
+  /// @returns The indices of the strings in *strs* which the pattern matches
+  ///          exactly.
+  std::vector<size_t> match(std::vector<std::string> const& strs) const;
+
   /// Searches a pattern in a string.
   /// @param str The string to search.
   /// @returns `true` if the pattern matches inside *str*.
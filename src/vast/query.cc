@@ -1,5 +1,6 @@
 #include "vast/query.h"
 
+#include <array>
 #include <caf/all.hpp>
 #include "vast/event.h"
 #include "vast/logger.h"
@@ -59,16 +60,21 @@ query::query(actor archive, actor sink, expression ast)
     }
   };
 
-  auto incorporate_hits = [=](bitstream const& hits)
+  // Exact hits consist of matching events only, which therefore need no
+  // candidate check.
+  auto incorporate_hits = [=](bitstream const& hits, bool exact)
   {
     assert(hits);
     assert(! hits.all_zero());
 
-    VAST_LOG_ACTOR_DEBUG("got index hit covering [" << hits.find_first()
-                         << ',' << hits.find_last() << ']');
+    VAST_LOG_ACTOR_DEBUG("got " << (exact ? "exact " : "") <<
+                         "index hit covering [" << hits.find_first() <<
+                         ',' << hits.find_last() << ']');
 
     hits_ |= hits;
     unprocessed_ = hits_ - processed_;
+    if (exact)
+      exact_ |= hits;
 
     prefetch();
   };
@@ -92,9 +98,9 @@ query::query(actor archive, actor sink, expression ast)
 
   idle_ = (
     handle_progress,
-    [=](bitstream const& hits)
+    [=](bitstream const& hits, bool exact)
     {
-      incorporate_hits(hits);
+      incorporate_hits(hits, exact);
 
       if (inflight_)
         become(waiting_);
@@ -155,44 +161,77 @@ query::query(actor archive, actor sink, expression ast)
       mask &= unprocessed_;
       assert(mask.count() > 0);
 
+      // Both the hits and the exact hits ascend, so we walk them in lockstep.
+      auto exact = mask & exact_;
+      auto next_exact = exact.find_first();
+
+      // We decode the hits in batches rather than iterating over them one at
+      // a time, which would go through a virtual call per hit.
       uint64_t n = 0;
       event_id last = 0;
-      for (auto id : mask)
+      std::array<bitstream::size_type, decode_batch_size> ids;
+      bitstream::size_type next = 0;
+      auto done = false;
+      while (! done)
       {
-        last = id;
-        auto e = reader_->read(id);
-        if (e)
+        auto hits = mask.decode(next, ids.data(), ids.size());
+        for (size_t i = 0; i < hits; ++i)
         {
-          auto& checker = checkers_[e->type()];
-          if (is<none>(checker))
+          auto id = ids[i];
+          last = id;
+          auto certain = id == next_exact;
+          if (certain)
+            next_exact = exact.find_next(id);
+
+          auto e = reader_->read(id);
+          if (e)
           {
-            checker = visit(expr::type_resolver{e->type()}, ast_);
-            VAST_LOG_ACTOR_DEBUG("constructed candidate checker for new event "
-                                 << e->type() << ": " << checker);
-          }
-
-          if (visit(expr::evaluator{*e}, checker))
-          {
-            send(sink_, std::move(*e));
-            if (++n == requested_)
-              break;
+            auto match = certain;
+            if (! match)
+            {
+              auto& checker = checkers_[e->type()];
+              if (is<none>(checker))
+              {
+                checker = visit(expr::type_resolver{e->type()}, ast_);
+                VAST_LOG_ACTOR_DEBUG("constructed candidate checker for new "
+                                     "event " << e->type() << ": " <<
+                                     checker);
+              }
+
+              match = visit(expr::evaluator{*e}, checker);
+            }
+
+            if (match)
+            {
+              send(sink_, std::move(*e));
+              if (++n == requested_)
+              {
+                done = true;
+                break;
+              }
+            }
+            else
+            {
+              VAST_LOG_ACTOR_WARN("ignores false positive : " << *e);
+            }
           }
           else
           {
-            VAST_LOG_ACTOR_WARN("ignores false positive : " << *e);
+            if (e.empty())
+              VAST_LOG_ACTOR_ERROR("failed to extract event " << id);
+            else
+              VAST_LOG_ACTOR_ERROR("failed to extract event " << id << ": " <<
+                                   e.error());
+
+            quit(exit::error);
+            return;
           }
         }
-        else
-        {
-          if (e.empty())
-            VAST_LOG_ACTOR_ERROR("failed to extract event " << id);
-          else
-            VAST_LOG_ACTOR_ERROR("failed to extract event " << id << ": " <<
-                                 e.error());
 
-          quit(exit::error);
-          return;
-        }
+        if (hits < ids.size())
+          break;
+
+        next = ids[hits - 1] + 1;
       }
 
       requested_ -= n;
@@ -201,13 +240,16 @@ query::query(actor archive, actor sink, expression ast)
       partial &= mask;
       processed_ |= partial;
       unprocessed_ -= partial;
-      mask -= partial;
+
+      // We only need to know how many hits remain in the chunk, but not
+      // which ones.
+      auto remaining = andnot_count(mask, partial);
 
       VAST_LOG_ACTOR_DEBUG("extracted " << n << " events (" <<
-                           partial.count() << '/' << mask.count() <<
+                           partial.count() << '/' << remaining <<
                            " processed/remaining hits)");
 
-      if (! mask.all_zero())
+      if (remaining > 0)
       {
         // We continue extracting until we have processed all requested
         // events.
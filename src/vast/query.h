@@ -39,6 +39,7 @@ private:
   bitstream hits_ = bitstream{bitstream_type{}};
   bitstream processed_ = bitstream{bitstream_type{}};
   bitstream unprocessed_ = bitstream{bitstream_type{}};
+  bitstream exact_ = bitstream{bitstream_type{}};
   std::unordered_map<type, expression> checkers_;
   std::unique_ptr<chunk::reader> reader_;
   chunk chunk_;
@@ -80,10 +80,9 @@ message_handler receiver::act()
                   return;
                 }
 
-                default_bitstream ids;
-                ids.append(from, false);
-                ids.append(n, true);
-                c.ids(std::move(ids));
+                bitstream_builder<default_bitstream> ids;
+                ids.add(from, to);
+                c.ids(ids.finish(to));
 
                 auto t = make_message(std::move(c));
                 send_tuple(archive_, t);
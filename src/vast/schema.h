@@ -105,6 +105,14 @@ inline std::vector<type::attribute> make_attrs(
       key = type::attribute::skip;
     else if (a.key == "default")
       key = type::attribute::default_;
+    else if (a.key == "ngram")
+      key = type::attribute::ngram;
+    else if (a.key == "prefix")
+      key = type::attribute::prefix;
+    else if (a.key == "membership")
+      key = type::attribute::membership;
+    else if (a.key == "connection")
+      key = type::attribute::connection;
 
     std::string value;
     if (a.value)
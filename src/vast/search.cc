@@ -127,7 +127,8 @@ message_handler search_actor::act()
       monitor(client);
       auto qry = spawn<query>(archive_, client, std::move(*resolved));
       clients_[client.address()].queries.insert(qry);
-      send(index_, atom("query"), *ast, qry);
+      auto routed = visit(expr::connection_resolver{schema_}, *ast);
+      send(index_, atom("query"), std::move(routed), qry);
 
       return make_message(*ast, qry);
     }
@@ -93,6 +93,13 @@ bool deserializer::read_string(char* data, size_t size)
   VAST_RETURN(read_raw(data, size));
 }
 
+bool deserializer::read_view(void const** /* data */, size_t /* size */)
+{
+  // Zero-copy access is not available by default.
+  VAST_ENTER();
+  VAST_RETURN(false);
+}
+
 bool deserializer::read_type(global_type_info const*& gti)
 {
   VAST_ENTER();
@@ -203,8 +210,10 @@ size_t binary_serializer::bytes() const
 }
 
 
-binary_deserializer::binary_deserializer(io::input_stream& source)
-  : source_(source)
+binary_deserializer::binary_deserializer(io::input_stream& source,
+                                         bool views)
+  : source_(source),
+    views_{views}
 {
 }
 
@@ -293,6 +302,15 @@ bool binary_deserializer::read_raw(void* data, size_t size)
   VAST_RETURN(source_.read_raw(data, size));
 }
 
+bool binary_deserializer::read_view(void const** data, size_t size)
+{
+  VAST_ENTER(VAST_ARG(size));
+  if (! views_ || ! source_.view(data, size))
+    VAST_RETURN(false);
+  bytes_ += size;
+  VAST_RETURN(true);
+}
+
 size_t binary_deserializer::bytes() const
 {
   return bytes_;
@@ -479,19 +497,21 @@ void announce_builtin_types()
     uuid,
 
     std::vector<data>, std::vector<value>, std::vector<event>,
-    std::vector<uuid>,
+    std::vector<uuid>, std::vector<event_id>,
 
     arithmetic_operator, boolean_operator, relational_operator,
     bitstream,
     bitmap_index<null_bitstream>,
     bitmap_index<ewah_bitstream>,
+    bitmap_index<roaring_bitstream>,
     expression,
     schema
   >;
 
   using bitstream_models = util::type_list<
     detail::bitstream_model<ewah_bitstream>,
-    detail::bitstream_model<null_bitstream>
+    detail::bitstream_model<null_bitstream>,
+    detail::bitstream_model<roaring_bitstream>
   >;
 
   using bmi_types = util::type_list<
@@ -501,22 +521,48 @@ void announce_builtin_types()
     arithmetic_bitmap_index<null_bitstream, real>,
     arithmetic_bitmap_index<null_bitstream, time_point>,
     arithmetic_bitmap_index<null_bitstream, time_duration>,
+    time_bitmap_index<null_bitstream>,
     address_bitmap_index<null_bitstream>,
     subnet_bitmap_index<null_bitstream>,
     port_bitmap_index<null_bitstream>,
+    connection_bitmap_index<null_bitstream>,
     string_bitmap_index<null_bitstream>,
+    dictionary_bitmap_index<null_bitstream>,
+    ngram_bitmap_index<null_bitstream>,
     sequence_bitmap_index<null_bitstream>,
+    table_bitmap_index<null_bitstream>,
     arithmetic_bitmap_index<ewah_bitstream, boolean>,
     arithmetic_bitmap_index<ewah_bitstream, integer>,
     arithmetic_bitmap_index<ewah_bitstream, count>,
     arithmetic_bitmap_index<ewah_bitstream, real>,
     arithmetic_bitmap_index<ewah_bitstream, time_point>,
     arithmetic_bitmap_index<ewah_bitstream, time_duration>,
+    time_bitmap_index<ewah_bitstream>,
     address_bitmap_index<ewah_bitstream>,
     subnet_bitmap_index<ewah_bitstream>,
     port_bitmap_index<ewah_bitstream>,
+    connection_bitmap_index<ewah_bitstream>,
     string_bitmap_index<ewah_bitstream>,
-    sequence_bitmap_index<ewah_bitstream>
+    dictionary_bitmap_index<ewah_bitstream>,
+    ngram_bitmap_index<ewah_bitstream>,
+    sequence_bitmap_index<ewah_bitstream>,
+    table_bitmap_index<ewah_bitstream>,
+    arithmetic_bitmap_index<roaring_bitstream, boolean>,
+    arithmetic_bitmap_index<roaring_bitstream, integer>,
+    arithmetic_bitmap_index<roaring_bitstream, count>,
+    arithmetic_bitmap_index<roaring_bitstream, real>,
+    arithmetic_bitmap_index<roaring_bitstream, time_point>,
+    arithmetic_bitmap_index<roaring_bitstream, time_duration>,
+    time_bitmap_index<roaring_bitstream>,
+    address_bitmap_index<roaring_bitstream>,
+    subnet_bitmap_index<roaring_bitstream>,
+    port_bitmap_index<roaring_bitstream>,
+    connection_bitmap_index<roaring_bitstream>,
+    string_bitmap_index<roaring_bitstream>,
+    dictionary_bitmap_index<roaring_bitstream>,
+    ngram_bitmap_index<roaring_bitstream>,
+    sequence_bitmap_index<roaring_bitstream>,
+    table_bitmap_index<roaring_bitstream>
   >;
 
   using all = util::tl_concat<
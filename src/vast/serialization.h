@@ -134,6 +134,21 @@ public:
   /// @returns `true` on success.
   virtual bool read_raw(void* data, size_t size) = 0;
 
+  /// Provides direct access to the next raw bytes of the input instead of
+  /// copying them. Read-only views, such as ::ewah_bitstream_view, use this
+  /// function to refer to the input beyond the lifetime of the deserializer.
+  /// The bytes have the encoding of ::binary_serializer.
+  ///
+  /// @param data Set to the beginning of the next *size* bytes.
+  ///
+  /// @param size The number of bytes to access.
+  ///
+  /// @returns `true` if *data* points to *size* bytes which remain valid after
+  /// the deserializer has gone. Upon failure, the function consumes nothing.
+  ///
+  /// @note The default implementation returns `false`.
+  virtual bool read_view(void const** data, size_t size);
+
   /// Reads type information.
   ///
   /// @param gti The result parameter which receives either a pointer to an
@@ -179,8 +194,14 @@ class binary_deserializer : public deserializer
 {
 public:
   /// Constructs a deserializer with an input stream.
+  ///
   /// @param source The input stream to read from.
-  binary_deserializer(io::input_stream& source);
+  ///
+  /// @param views If `true`, ::read_view hands out pointers into the buffers
+  /// of *source*, which must therefore remain valid and unchanged as long as
+  /// any object read from the deserializer exists. This holds, for example,
+  /// for an ::io::array_input_stream over a memory-mapped file.
+  binary_deserializer(io::input_stream& source, bool views = false);
 
   virtual bool begin_sequence(uint64_t& size) override;
   virtual bool read_bool(bool& x) override;
@@ -194,11 +215,13 @@ public:
   virtual bool read_uint64(uint64_t& x) override;
   virtual bool read_double(double& x) override;
   virtual bool read_raw(void* data, size_t size) override;
+  virtual bool read_view(void const** data, size_t size) override;
   virtual size_t bytes() const;
 
 private:
   io::coded_input_stream source_;
   size_t bytes_ = 0;
+  bool views_;
 };
 
 /// Provides clean access of private class internals to the serialization
@@ -6,50 +6,8 @@
 #include <unordered_map>
 #include <random>
 #include "vast/schema.h"
+#include "vast/detail/connection.h"
 #include "vast/source/synchronous.h"
-#include "vast/util/hash_combine.h"
-#include "vast/util/operators.h"
-
-namespace vast {
-namespace detail {
-
-struct connection : util::equality_comparable<connection>
-{
-  address src;
-  address dst;
-  port sport;
-  port dport;
-
-  friend bool operator==(connection const& lhs, connection const& rhs)
-  {
-    return lhs.src == rhs.src && lhs.dst == rhs.dst
-        && lhs.sport == rhs.sport && lhs.dport == rhs.dport;
-  }
-};
-
-} // namespace detail
-} // namespace vast
-
-namespace std {
-
-template <>
-struct hash<vast::detail::connection>
-{
-  size_t operator()(vast::detail::connection const& c) const
-  {
-    auto src0 = *reinterpret_cast<uint64_t const*>(&c.src.data()[0]);
-    auto src1 = *reinterpret_cast<uint64_t const*>(&c.src.data()[8]);
-    auto dst0 = *reinterpret_cast<uint64_t const*>(&c.dst.data()[0]);
-    auto dst1 = *reinterpret_cast<uint64_t const*>(&c.dst.data()[8]);
-    auto sprt = c.sport.number();
-    auto dprt = c.dport.number();
-    auto proto = static_cast<uint8_t>(c.sport.type());
-
-    return vast::util::hash_combine(src0, src1, dst0, dst1, sprt, dprt, proto);
-  }
-};
-
-} // namespace std
 
 namespace vast {
 namespace source {
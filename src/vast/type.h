@@ -52,7 +52,11 @@ public:
     {
       invalid,
       skip,
-      default_
+      default_,
+      ngram,
+      prefix,
+      membership,
+      connection
     };
 
     attribute(key_type k = invalid, std::string v = {})
@@ -104,6 +108,21 @@ public:
 
             return print('"', out);
           }
+        case ngram:
+          {
+            auto t = print("ngram", out);
+            if (! t || a.value.empty())
+              return t;
+
+            *out++ = '=';
+            return print(a.value, out);
+          }
+        case prefix:
+          return print("prefix", out);
+        case membership:
+          return print("membership", out);
+        case connection:
+          return print("connection", out);
       }
     }
   };
@@ -1,6 +1,7 @@
 #ifndef VAST_UTIL_FLAT_SET_H
 #define VAST_UTIL_FLAT_SET_H
 
+#include <algorithm>
 #include <vector>
 #include "vast/util/operators.h"
 
@@ -222,14 +223,29 @@ public:
       return {i, false};
   };
 
+  /// Inserts a range of values. Rather than inserting one value at a time,
+  /// this function appends the range, sorts it, and merges it with the
+  /// existing values, which keeps bulk construction at *O(n log n)*.
+  /// @param first The beginning of the range.
+  /// @param last The end of the range.
+  /// @returns `true` if all values were inserted, i.e., none existed.
   template <typename InputIterator>
   bool insert(InputIterator first, InputIterator last)
   {
-    bool all = true;
-    while (first != last)
-      if (! insert(*first++).second)
-        all = false;
+    auto n = v_.size();
+    v_.insert(v_.end(), first, last);
+    auto mid = v_.begin() + n;
+    std::stable_sort(mid, v_.end(), compare{});
+    std::inplace_merge(v_.begin(), mid, v_.end(), compare{});
 
+    auto equivalent = [](T const& x, T const& y)
+    {
+      return ! compare{}(x, y) && ! compare{}(y, x);
+    };
+
+    auto i = std::unique(v_.begin(), v_.end(), equivalent);
+    auto all = i == v_.end();
+    v_.erase(i, v_.end());
     return all;
   }
 
@@ -0,0 +1,147 @@
+#ifndef VAST_UTIL_THREAD_POOL_H
+#define VAST_UTIL_THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace vast {
+namespace util {
+
+/// A fixed set of worker threads which share the execution of data-parallel
+/// loops. Since the number of workers does not depend on the number of
+/// concurrent callers, the pool bounds the threads a process spends on such
+/// loops.
+class thread_pool
+{
+  thread_pool(thread_pool const&) = delete;
+  thread_pool& operator=(thread_pool const&) = delete;
+
+public:
+  /// Starts the worker threads.
+  /// @param n The number of worker threads.
+  explicit thread_pool(size_t n)
+  {
+    workers_.reserve(n);
+    for (size_t i = 0; i < n; ++i)
+      workers_.emplace_back([=] { run(); });
+  }
+
+  /// Waits for the workers to finish their current tasks and joins them.
+  ~thread_pool()
+  {
+    {
+      std::lock_guard<std::mutex> lock{mutex_};
+      done_ = true;
+    }
+
+    cond_.notify_all();
+    for (auto& w : workers_)
+      w.join();
+  }
+
+  /// Retrieves the number of worker threads.
+  /// @returns The number of worker threads.
+  size_t size() const
+  {
+    return workers_.size();
+  }
+
+  /// Invokes a function for each index in *[0, n)*, distributed over the
+  /// workers and the calling thread. The caller claims indexes along with
+  /// the workers, so that the loop completes even if all workers are busy
+  /// with the loops of other callers.
+  /// @param n The number of indexes.
+  /// @param f The function to invoke with each index.
+  void parallel_for(size_t n, std::function<void(size_t)> f)
+  {
+    // Workers may pick up a task after the loop has completed, so they must
+    // not touch any state of the caller other than through *f*, which they
+    // only invoke for indexes they claimed before completion.
+    struct loop
+    {
+      std::function<void(size_t)> f;
+      size_t n;
+      std::atomic<size_t> next{0};
+      size_t done = 0;
+      std::mutex mutex;
+      std::condition_variable cond;
+    };
+
+    auto l = std::make_shared<loop>();
+    l->f = std::move(f);
+    l->n = n;
+
+    auto work = [l]
+    {
+      size_t i;
+      size_t k = 0;
+      while ((i = l->next++) < l->n)
+      {
+        l->f(i);
+        ++k;
+      }
+
+      if (k == 0)
+        return;
+
+      std::lock_guard<std::mutex> lock{l->mutex};
+      l->done += k;
+      if (l->done == l->n)
+        l->cond.notify_all();
+    };
+
+    auto helpers = n > 0 ? std::min(n - 1, workers_.size()) : 0;
+    if (helpers > 0)
+    {
+      {
+        std::lock_guard<std::mutex> lock{mutex_};
+        for (size_t i = 0; i < helpers; ++i)
+          tasks_.push(work);
+      }
+
+      cond_.notify_all();
+    }
+
+    work();
+
+    std::unique_lock<std::mutex> lock{l->mutex};
+    l->cond.wait(lock, [&] { return l->done == l->n; });
+  }
+
+private:
+  void run()
+  {
+    while (true)
+    {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock{mutex_};
+        cond_.wait(lock, [&] { return done_ || ! tasks_.empty(); });
+        if (tasks_.empty())
+          return;
+
+        task = std::move(tasks_.front());
+        tasks_.pop();
+      }
+
+      task();
+    }
+  }
+
+  std::vector<std::thread> workers_;
+  std::queue<std::function<void()>> tasks_;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  bool done_ = false;
+};
+
+} // namespace util
+} // namespace vast
+
+#endif
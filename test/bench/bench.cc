@@ -0,0 +1,1209 @@
+#include <unistd.h>  // getpid
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "vast/bitmap.h"
+#include "vast/bitmap_index.h"
+#include "vast/bitmap_index_store.h"
+#include "vast/bitstream.h"
+#include "vast/event.h"
+#include "vast/file_system.h"
+#include "vast/optional.h"
+#include "vast/pattern.h"
+#include "vast/detail/bitwise.h"
+#include "vast/io/serialization.h"
+
+using namespace vast;
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+// Consumes benchmark results so that the compiler cannot drop the work.
+uint64_t volatile sink;
+
+// Runs a function several times and returns the mean duration of a run in
+// microseconds.
+template <typename F>
+double measure(F f, size_t runs = 10)
+{
+  auto start = clock_type::now();
+  for (size_t i = 0; i < runs; ++i)
+    f();
+
+  std::chrono::duration<double, std::micro> d = clock_type::now() - start;
+  return d.count() / runs;
+}
+
+struct options
+{
+  path log_dir = VAST_BENCH_LOG_DIR;
+  size_t scale = 100;
+};
+
+// A Bro log with all values as strings.
+struct bro_log
+{
+  std::vector<std::string> fields;
+  std::vector<std::vector<std::string>> rows;
+
+  // Retrieves a column, repeated *scale* times, with nil for unset values.
+  std::vector<optional<std::string>> column(std::string const& name,
+                                            size_t scale) const
+  {
+    std::vector<optional<std::string>> result;
+    auto i = std::find(fields.begin(), fields.end(), name);
+    if (i == fields.end())
+      return result;
+
+    auto f = static_cast<size_t>(i - fields.begin());
+    result.reserve(rows.size() * scale);
+    for (size_t s = 0; s < scale; ++s)
+      for (auto& row : rows)
+        if (f < row.size() && row[f] != "-")
+          result.emplace_back(row[f]);
+        else
+          result.emplace_back();
+
+    return result;
+  }
+};
+
+std::vector<std::string> split(std::string const& line)
+{
+  std::vector<std::string> result;
+  std::string::size_type begin = 0;
+  while (true)
+  {
+    auto end = line.find('\t', begin);
+    result.push_back(line.substr(begin, end - begin));
+    if (end == std::string::npos)
+      break;
+
+    begin = end + 1;
+  }
+
+  return result;
+}
+
+bro_log read_log(options const& opts, std::string const& name)
+{
+  bro_log log;
+  auto p = opts.log_dir / (name + ".log");
+  std::ifstream in{p.str()};
+  if (! in)
+  {
+    std::cerr << "failed to open " << p << std::endl;
+    std::exit(1);
+  }
+
+  std::string line;
+  while (std::getline(in, line))
+    if (line.compare(0, 8, "#fields\t") == 0)
+    {
+      log.fields = split(line.substr(8));
+    }
+    else if (! line.empty() && line[0] != '#')
+    {
+      log.rows.push_back(split(line));
+    }
+
+  return log;
+}
+
+std::vector<optional<count>> counts(
+    std::vector<optional<std::string>> const& xs, double factor = 1)
+{
+  std::vector<optional<count>> result;
+  result.reserve(xs.size());
+  for (auto& x : xs)
+    if (x)
+      result.emplace_back(static_cast<count>(std::stod(*x) * factor));
+    else
+      result.emplace_back();
+
+  return result;
+}
+
+template <typename T>
+T median(std::vector<optional<T>> const& xs)
+{
+  std::vector<T> values;
+  for (auto& x : xs)
+    if (x)
+      values.push_back(*x);
+
+  if (values.empty())
+    return T{};
+
+  std::nth_element(values.begin(), values.begin() + values.size() / 2,
+                   values.end());
+  return values[values.size() / 2];
+}
+
+template <typename T>
+size_t serialized_size(T const& x)
+{
+  std::vector<uint8_t> buf;
+  io::archive(buf, x);
+  return buf.size();
+}
+
+size_t file_size(path const& p)
+{
+  if (! exists(p))
+    return 0;
+
+  std::ifstream in{p.str(), std::ios::binary | std::ios::ate};
+  return static_cast<size_t>(in.tellg());
+}
+
+//
+// Bitwise block kernels versus the block-by-block path.
+//
+
+char const* isa_name(detail::bitwise_isa isa)
+{
+  switch (isa)
+  {
+    case detail::bitwise_isa::avx2:
+      return "avx2";
+    case detail::bitwise_isa::sse42:
+      return "sse4.2";
+    default:
+      return "scalar";
+  }
+}
+
+template <typename Kernel, typename Loop>
+void kernel_row(char const* name, Kernel kernel, Loop loop)
+{
+  auto k = measure(kernel);
+  auto l = measure(loop);
+  std::cout << std::setw(10) << name
+            << std::setw(12) << l
+            << std::setw(12) << k
+            << std::setw(10) << l / k << '\n';
+}
+
+template <typename Bitstream>
+void stream_row(char const* name, Bitstream const& x, Bitstream const& y)
+{
+  using block_type = typename Bitstream::block_type;
+  auto generic = measure([&]
+  {
+    sink = apply(x, y, false, false,
+                 [](block_type l, block_type r) { return l & r; }).size();
+  });
+  auto kernel = measure([&] { sink = (x & y).size(); });
+  std::cout << std::setw(10) << name
+            << std::setw(12) << generic
+            << std::setw(12) << kernel
+            << std::setw(10) << generic / kernel << '\n';
+}
+
+void kernels(options const& opts)
+{
+  using detail::bitwise_block;
+  auto n = size_t{10000} * opts.scale;
+  std::mt19937_64 gen{42};
+  std::vector<bitwise_block> x(n), y(n), out(n);
+  for (size_t i = 0; i < n; ++i)
+  {
+    x[i] = gen();
+    y[i] = gen();
+  }
+
+  std::cout << "kernels over " << n << " random blocks, ISA "
+            << isa_name(detail::bitwise_kernel_isa()) << " (us)\n"
+            << std::setw(10) << "op"
+            << std::setw(12) << "loop"
+            << std::setw(12) << "kernel"
+            << std::setw(10) << "speedup" << '\n';
+
+  auto xp = x.data();
+  auto yp = y.data();
+  auto op = out.data();
+  kernel_row("and",
+             [&] { detail::bitwise_and(op, xp, yp, n); sink = op[n - 1]; },
+             [&]
+             {
+               for (size_t i = 0; i < n; ++i)
+                 op[i] = xp[i] & yp[i];
+               sink = op[n - 1];
+             });
+  kernel_row("or",
+             [&] { detail::bitwise_or(op, xp, yp, n); sink = op[n - 1]; },
+             [&]
+             {
+               for (size_t i = 0; i < n; ++i)
+                 op[i] = xp[i] | yp[i];
+               sink = op[n - 1];
+             });
+  kernel_row("xor",
+             [&] { detail::bitwise_xor(op, xp, yp, n); sink = op[n - 1]; },
+             [&]
+             {
+               for (size_t i = 0; i < n; ++i)
+                 op[i] = xp[i] ^ yp[i];
+               sink = op[n - 1];
+             });
+  kernel_row("and_not",
+             [&] { detail::bitwise_and_not(op, xp, yp, n); sink = op[n - 1]; },
+             [&]
+             {
+               for (size_t i = 0; i < n; ++i)
+                 op[i] = xp[i] & ~yp[i];
+               sink = op[n - 1];
+             });
+  kernel_row("popcount",
+             [&] { sink = detail::popcount(xp, n); },
+             [&]
+             {
+               size_t c = 0;
+               for (size_t i = 0; i < n; ++i)
+                 c += bitvector::count(xp[i]);
+               sink = c;
+             });
+
+  // The same blocks as literal runs in bitstreams, combined through the
+  // generic apply() versus the bitwise operators.
+  null_bitstream nx, ny;
+  ewah_bitstream ex, ey;
+  for (size_t i = 0; i < n; ++i)
+  {
+    nx.append_block(x[i]);
+    ny.append_block(y[i]);
+    ex.append_block(x[i]);
+    ey.append_block(y[i]);
+  }
+
+  std::cout << '\n'
+            << std::setw(10) << "AND"
+            << std::setw(12) << "apply"
+            << std::setw(12) << "operator"
+            << std::setw(10) << "speedup" << '\n';
+  stream_row("null", nx, ny);
+  stream_row("ewah", ex, ey);
+}
+
+//
+// Roaring versus EWAH bitstreams on hit sets of real columns.
+//
+
+// Retrieves the most frequent value of a column.
+std::string most_frequent(std::vector<optional<std::string>> const& xs)
+{
+  std::unordered_map<std::string, size_t> freq;
+  for (auto& x : xs)
+    if (x)
+      ++freq[*x];
+
+  auto max = std::max_element(
+      freq.begin(), freq.end(),
+      [](std::pair<std::string const, size_t> const& a,
+         std::pair<std::string const, size_t> const& b)
+      {
+        return a.second < b.second;
+      });
+
+  return max == freq.end() ? std::string{} : max->first;
+}
+
+// Computes the rows of a column which have its most frequent value.
+std::vector<size_t> top_hits(bro_log const& log, std::string const& field,
+                             size_t scale)
+{
+  auto xs = log.column(field, scale);
+  auto v = most_frequent(xs);
+  std::vector<size_t> result;
+  for (size_t i = 0; i < xs.size(); ++i)
+    if (xs[i] && *xs[i] == v)
+      result.push_back(i);
+
+  return result;
+}
+
+template <typename Bitstream>
+void container_row(char const* name, std::vector<size_t> const& x,
+                   std::vector<size_t> const& y, size_t size)
+{
+  auto bx = *from_positions<Bitstream>(x.begin(), x.end(), size);
+  auto by = *from_positions<Bitstream>(y.begin(), y.end(), size);
+  auto and_time = measure([&] { sink = (bx & by).count(); });
+  auto or_time = measure([&] { sink = (bx | by).count(); });
+  auto next_time = measure([&]
+  {
+    size_t n = 0;
+    for (auto i = bx.find_first(); i != Bitstream::npos; i = bx.find_next(i))
+      ++n;
+    sink = n;
+  });
+
+  std::cout << std::setw(10) << name
+            << std::setw(12) << and_time
+            << std::setw(12) << or_time
+            << std::setw(12) << next_time
+            << std::setw(12) << serialized_size(bx) + serialized_size(by)
+            << '\n';
+}
+
+void containers(options const& opts)
+{
+  auto log = read_log(opts, "conn");
+  auto size = log.rows.size() * opts.scale;
+  std::pair<char const*, char const*> const pairs[] = {
+    {"id.resp_p", "id.orig_h"},
+    {"proto", "conn_state"},
+    {"service", "id.resp_h"}
+  };
+
+  for (auto& p : pairs)
+  {
+    auto x = top_hits(log, p.first, opts.scale);
+    auto y = top_hits(log, p.second, opts.scale);
+    std::cout << p.first << " (" << x.size() << " hits) with "
+              << p.second << " (" << y.size() << " hits) over "
+              << size << " rows (us, bytes)\n"
+              << std::setw(10) << "bitstream"
+              << std::setw(12) << "and"
+              << std::setw(12) << "or"
+              << std::setw(12) << "find_next"
+              << std::setw(12) << "size" << '\n';
+    container_row<ewah_bitstream>("ewah", x, y, size);
+    container_row<roaring_bitstream>("roaring", x, y, size);
+  }
+}
+
+//
+// Random access on large EWAH bitstreams with and without the skip index.
+//
+
+template <typename Bitstream>
+void access_row(char const* name, Bitstream const& bs,
+                std::vector<size_t> const& positions)
+{
+  auto at = measure([&]
+  {
+    size_t n = 0;
+    for (auto i : positions)
+      n += bs[i];
+    sink = n;
+  }, 1);
+  auto next = measure([&]
+  {
+    size_t n = 0;
+    for (auto i : positions)
+      n += bs.find_next(i);
+    sink = n;
+  }, 1);
+  auto prev = measure([&]
+  {
+    size_t n = 0;
+    for (auto i : positions)
+      n += bs.find_prev(i);
+    sink = n;
+  }, 1);
+
+  auto k = static_cast<double>(positions.size());
+  std::cout << std::setw(10) << name
+            << std::setw(12) << at / k
+            << std::setw(12) << next / k
+            << std::setw(12) << prev / k << '\n';
+}
+
+void access(options const& opts)
+{
+  // Clusters of hits, as a conjunction over a few columns would produce
+  // them, spread over 100M bits.
+  auto size = size_t{1000000} * opts.scale;
+  std::mt19937_64 gen{42};
+  bitstream_builder<ewah_bitstream> builder;
+  for (size_t i = gen() % 1000; i < size; i += 1000 + gen() % 10000)
+    for (size_t j = i; j < std::min(i + 100, size); j += 1 + gen() % 5)
+      builder.add(j);
+
+  auto bs = builder.finish(size);
+  std::vector<size_t> positions(1000);
+  for (auto& p : positions)
+    p = gen() % size;
+
+  // The view walks the same encoding from the beginning for every access,
+  // which is what the bitstream did before it had a skip index.
+  ewah_bitstream_view view{bs};
+  std::cout << "random access on " << size << " bits with " << bs.count()
+            << " hits (us per access)\n"
+            << std::setw(10) << "index"
+            << std::setw(12) << "at"
+            << std::setw(12) << "find_next"
+            << std::setw(12) << "find_prev" << '\n';
+  access_row("skips", bs, positions);
+  access_row("linear", view, positions);
+}
+
+//
+// Parallel bitwise operations on EWAH bitstreams of growing size.
+//
+
+// Alternates fills and literal stretches, as the bitstreams of a partition
+// with many events would.
+ewah_bitstream make_mixed(std::mt19937_64& gen, size_t bits)
+{
+  ewah_bitstream bs;
+  while (bs.size() < bits)
+  {
+    bs.append(gen() % (1 << 14), gen() % 2 == 0);
+    for (auto i = 0; i < 4096; ++i)
+      bs.push_back(gen() % 2 == 0);
+  }
+
+  return bs;
+}
+
+void parallel(options const& opts)
+{
+  auto threads = std::max(std::thread::hardware_concurrency(), 2u);
+  std::cout << "AND of two EWAH bitstreams, serial versus " << threads
+            << " threads (us)\n"
+            << std::setw(12) << "blocks"
+            << std::setw(12) << "serial"
+            << std::setw(12) << "parallel"
+            << std::setw(12) << "overhead" << '\n';
+
+  std::mt19937_64 gen{42};
+  auto max = size_t{1} << 26;
+  auto runs = std::max<size_t>(opts.scale / 10, 1);
+  for (auto bits = size_t{1} << 14; bits <= max; bits *= 4)
+  {
+    auto x = make_mixed(gen, bits);
+    auto y = make_mixed(gen, bits);
+    auto blocks = x.bits().blocks() + y.bits().blocks();
+
+    ewah_bitstream::parallelize(0);
+    auto serial = measure([&] { sink = (x & y).size(); }, runs);
+
+    // Every operand qualifies for parallel execution.
+    ewah_bitstream::parallelize(1, threads);
+    auto par = measure([&] { sink = (x & y).size(); }, runs);
+
+    // With all threads on separate cores, an operation takes the serial
+    // time divided by the number of threads plus the overhead of splitting
+    // and joining. We estimate the latter from the total CPU time beyond
+    // the serial time, which does not depend on the available cores.
+    auto cores = std::min<double>(threads, std::thread::hardware_concurrency());
+    auto overhead = par - serial / std::max(cores, 1.0);
+    std::cout << std::setw(12) << blocks
+              << std::setw(12) << serial
+              << std::setw(12) << par
+              << std::setw(12) << overhead << '\n';
+  }
+
+  ewah_bitstream::parallelize(ewah_bitstream::default_parallel_threshold);
+}
+
+//
+// Bulk construction from sorted IDs versus appending bit by bit.
+//
+
+template <typename Bitstream>
+void build_row(char const* name, std::vector<size_t> const& ids, size_t size)
+{
+  auto appending = measure([&]
+  {
+    Bitstream bs;
+    for (auto i : ids)
+    {
+      bs.append(i - bs.size(), false);
+      bs.push_back(true);
+    }
+
+    bs.append(size - bs.size(), false);
+    sink = bs.size();
+  });
+  auto building = measure([&]
+  {
+    bitstream_builder<Bitstream> builder;
+    for (auto i : ids)
+      builder.add(i);
+    sink = builder.finish(size).size();
+  });
+
+  std::cout << std::setw(10) << name
+            << std::setw(12) << appending
+            << std::setw(12) << building
+            << std::setw(10) << appending / building << '\n';
+}
+
+void builder(options const& opts)
+{
+  auto log = read_log(opts, "conn");
+  auto size = log.rows.size() * opts.scale;
+  std::mt19937_64 gen{42};
+  std::vector<size_t> sparse;
+  for (size_t i = gen() % 100; i < size; i += 1 + gen() % 200)
+    sparse.push_back(i);
+
+  std::pair<char const*, std::vector<size_t>> const inputs[] = {
+    {"sparse random", sparse},
+    {"id.resp_p", top_hits(log, "id.resp_p", opts.scale)},
+    {"proto", top_hits(log, "proto", opts.scale)}
+  };
+
+  for (auto& in : inputs)
+  {
+    std::cout << in.first << ": " << in.second.size() << " IDs in " << size
+              << " rows (us)\n"
+              << std::setw(10) << "bitstream"
+              << std::setw(12) << "push_back"
+              << std::setw(12) << "builder"
+              << std::setw(10) << "speedup" << '\n';
+    build_row<null_bitstream>("null", in.second, size);
+    build_row<ewah_bitstream>("ewah", in.second, size);
+  }
+}
+
+//
+// Type-erased versus concrete bitstreams in the query hot path.
+//
+
+template <typename Bitstream>
+Bitstream wrap(default_bitstream const& bs)
+{
+  return Bitstream{bs};
+}
+
+template <>
+default_bitstream wrap<default_bitstream>(default_bitstream const& bs)
+{
+  return bs;
+}
+
+// Combines the hits of a conjunction and of a disjunction over a few
+// predicates, as index::propagator does for every incoming hit set.
+template <typename Bitstream>
+void propagate(std::vector<Bitstream> const& hits)
+{
+  std::vector<Bitstream const*> operands;
+  for (auto& h : hits)
+    operands.push_back(&h);
+
+  auto now = hits[0];
+  for (size_t i = 0; i < 100; ++i)
+  {
+    auto prev = now;
+    now = and_all(operands.begin(), operands.end());
+    now |= hits[i % hits.size()];
+    sink = now != prev;
+  }
+}
+
+// Masks the hits with the IDs of a chunk and walks them in batches, as
+// query::extract does for every batch of events.
+template <typename Bitstream>
+void extract(std::vector<Bitstream> const& chunks, Bitstream const& hits,
+             Bitstream const& exact)
+{
+  std::array<size_t, decode_batch_size> ids;
+  for (auto& chunk : chunks)
+  {
+    auto mask = chunk;
+    mask &= hits;
+    auto exact_mask = mask & exact;
+    size_t n = 0;
+    size_t next = 0;
+    while (auto k = mask.decode(next, ids.data(), ids.size()))
+    {
+      for (size_t j = 0; j < k; ++j)
+        n += exact_mask.find_next(ids[j] - (ids[j] > 0)) == ids[j];
+      next = ids[k - 1] + 1;
+    }
+
+    sink = n;
+  }
+}
+
+// The operations of the hot path on their own, in nanoseconds each.
+template <typename Bitstream>
+void dispatch_row(char const* name, std::vector<default_bitstream> const& xs)
+{
+  std::vector<Bitstream> bs;
+  for (auto& x : xs)
+    bs.push_back(wrap<Bitstream>(x));
+
+  auto n = static_cast<double>(bs.size());
+  auto per_op = [&](double us) { return us * 1e3 / n; };
+  auto copy = measure([&]
+  {
+    for (auto& b : bs)
+    {
+      auto c = b;
+      sink = c.size();
+    }
+  }, 100);
+  auto and_op = measure([&]
+  {
+    for (size_t i = 1; i < bs.size(); ++i)
+      sink = (bs[i - 1] & bs[i]).size();
+  }, 100);
+  auto or_op = measure([&]
+  {
+    auto r = bs[0];
+    for (size_t i = 1; i < bs.size(); ++i)
+      r |= bs[i];
+    sink = r.size();
+  }, 100);
+  auto next = measure([&]
+  {
+    size_t k = 0;
+    for (auto& b : bs)
+      k += b.find_next(b.size() / 2);
+    sink = k;
+  }, 100);
+
+  // The composite paths of the index and the query.
+  std::vector<Bitstream> preds(bs.begin(), bs.begin() + 4);
+  auto p = measure([&] { propagate(preds); }, 100);
+  auto e = measure([&] { extract(bs, bs[0], bs[1]); }, 100);
+
+  std::cout << std::setw(12) << name
+            << std::setw(10) << per_op(copy)
+            << std::setw(10) << per_op(and_op)
+            << std::setw(10) << per_op(or_op)
+            << std::setw(10) << per_op(next)
+            << std::setw(12) << p
+            << std::setw(12) << e << '\n';
+}
+
+void dispatch(options const& opts)
+{
+  // The small hit sets of the chunks of a partition, each of which covers
+  // the same range of 1000 events.
+  std::mt19937_64 gen{42};
+  std::vector<default_bitstream> hits;
+  for (size_t i = 0; i < 10 * opts.scale; ++i)
+  {
+    bitstream_builder<default_bitstream> builder;
+    for (size_t j = gen() % 100; j < 1000; j += 1 + gen() % 100)
+      builder.add(j);
+    hits.push_back(builder.finish(1000));
+  }
+
+#ifdef VAST_MONOMORPHIC_BITSTREAM
+  auto mode = "monomorphic";
+#else
+  auto mode = "polymorphic";
+#endif
+  std::cout << hits.size() << " hit sets of 1000 bits, " << mode
+            << " build (ns per operation, us per path)\n"
+            << std::setw(12) << "type"
+            << std::setw(10) << "copy"
+            << std::setw(10) << "and"
+            << std::setw(10) << "or"
+            << std::setw(10) << "find_next"
+            << std::setw(12) << "propagate"
+            << std::setw(12) << "extract" << '\n';
+  dispatch_row<default_bitstream>("concrete", hits);
+  dispatch_row<bitstream>("bitstream", hits);
+}
+
+//
+// Pattern predicates on strings: dictionary lookup versus candidate scan.
+//
+
+void patterns(options const& opts)
+{
+  auto hosts = read_log(opts, "http").column("host", opts.scale);
+  dictionary_bitmap_index<ewah_bitstream> bmi;
+  for (auto& h : hosts)
+    if (h)
+      bmi.push_back(*h);
+    else
+      bmi.push_back(nil);
+
+  std::cout << "pattern lookups on http.host with " << hosts.size()
+            << " values (us)\n"
+            << std::setw(24) << "pattern"
+            << std::setw(10) << "hits"
+            << std::setw(12) << "index"
+            << std::setw(12) << "scan" << '\n';
+
+  for (auto str : {".*\\.com", ".*google.*", "www\\..*\\.org", "nope"})
+  {
+    pattern rx{str};
+    uint64_t hits = 0;
+    auto index = measure(
+        [&]
+        {
+          auto r = bmi.lookup(match, data{rx});
+          hits = r ? r->count() : 0;
+        });
+
+    // Without index support, the query checks every candidate event.
+    auto scan = measure(
+        [&]
+        {
+          uint64_t n = 0;
+          for (auto& h : hosts)
+            if (h && rx.match(*h))
+              ++n;
+          sink = n;
+        });
+
+    std::cout << std::setw(24) << str
+              << std::setw(10) << hits
+              << std::setw(12) << index
+              << std::setw(12) << scan << '\n';
+  }
+}
+
+//
+// Size versus lookup latency per coder.
+//
+
+template <template <typename, typename> class Coder>
+bitmap<count, ewah_bitstream, Coder>
+make_bitmap(std::vector<optional<count>> const& xs)
+{
+  bitmap<count, ewah_bitstream, Coder> bm;
+  for (auto& x : xs)
+    if (x)
+      bm.push_back(*x);
+    else
+      bm.append(1, false);
+
+  return bm;
+}
+
+template <typename Bitmap>
+void coder_row(std::string const& name, Bitmap const& bm, count x)
+{
+  std::cout << std::setw(14) << name
+            << std::setw(12) << serialized_size(bm);
+
+  for (auto op : {equal, less, greater_equal})
+    std::cout << std::setw(12) << measure(
+        [&]
+        {
+          auto r = bm.lookup(op, x);
+          sink = r ? r->count() : 0;
+        });
+
+  std::cout << '\n';
+}
+
+template <template <typename, typename> class Coder>
+void coder_row(std::string const& name, std::vector<optional<count>> const& xs)
+{
+  coder_row(name, make_bitmap<Coder>(xs), median(xs));
+}
+
+void coder_header(std::string const& column, size_t n)
+{
+  std::cout << column << " (" << n << " values)\n"
+            << std::setw(14) << "coder"
+            << std::setw(12) << "bytes"
+            << std::setw(12) << "=="
+            << std::setw(12) << "<"
+            << std::setw(12) << ">=" << '\n';
+}
+
+void coders(options const& opts)
+{
+  auto conn = read_log(opts, "conn");
+  std::cout << "size and lookup latency per coder on conn.log columns, "
+               "* = adaptive after optimize() (bytes, us)\n";
+
+  for (auto name : {"orig_bytes", "resp_bytes", "orig_pkts", "missed_bytes"})
+  {
+    auto xs = counts(conn.column(name, opts.scale));
+    coder_header(name, xs.size());
+    coder_row<equality_coder>("equality", xs);
+    coder_row<range_bitslice_coder>("range", xs);
+    coder_row<binary_bitslice_coder>("binary", xs);
+    auto adaptive = make_bitmap<adaptive_coder>(xs);
+    coder_row("adaptive", adaptive, median(xs));
+    adaptive.coder().optimize();
+    coder_row("adaptive*", adaptive, median(xs));
+  }
+}
+
+//
+// Range versus interval bit-slice coding.
+//
+
+void intervals(options const& opts)
+{
+  auto conn = read_log(opts, "conn");
+  std::cout << "range versus interval bit-slice coding on conn.log columns "
+               "(bytes, us)\n";
+
+  auto columns = {
+    std::make_pair("duration (us)", counts(conn.column("duration", opts.scale),
+                                          1e6)),
+    std::make_pair("orig_bytes", counts(conn.column("orig_bytes", opts.scale))),
+    std::make_pair("resp_bytes", counts(conn.column("resp_bytes", opts.scale)))
+  };
+
+  for (auto& c : columns)
+  {
+    coder_header(c.first, c.second.size());
+    coder_row<range_bitslice_coder>("range", c.second);
+    coder_row<interval_bitslice_coder>("interval", c.second);
+  }
+}
+
+//
+// Exact versus binned indexes on real values.
+//
+
+void reals(options const& opts)
+{
+  auto durations = read_log(opts, "conn").column("duration", opts.scale);
+  arithmetic_bitmap_index<ewah_bitstream, real> exact;
+  arithmetic_bitmap_index<ewah_bitstream, real> binned;
+  binned.binner(-2);
+  for (auto& d : durations)
+  {
+    auto x = d ? data{std::stod(*d)} : data{nil};
+    exact.push_back(x);
+    binned.push_back(x);
+  }
+
+  std::cout << "exact versus binned real indexes on conn.log duration with "
+            << durations.size() << " values, binned to two decimal places "
+            << "(us)\n"
+            << std::setw(14) << "predicate"
+            << std::setw(10) << "hits"
+            << std::setw(16) << "false pos."
+            << std::setw(16) << "false neg."
+            << std::setw(12) << "exact"
+            << std::setw(12) << "binned" << '\n';
+
+  for (auto x : {0.001, 0.0155, 0.5, 1.0, 30.0})
+  {
+    auto e = exact.lookup(greater, real{x});
+    auto b = binned.lookup(greater, real{x});
+    if (! e || ! b)
+      continue;
+
+    auto fp = (*b - *e).count();
+    auto fn = (*e - *b).count();
+    auto te = measure([&] { sink = exact.lookup(greater, real{x})->count(); });
+    auto tb = measure([&] { sink = binned.lookup(greater, real{x})->count(); });
+    std::ostringstream rate;
+    rate << fp << " (" << std::setprecision(3)
+         << (b->count() > 0 ? 100.0 * fp / b->count() : 0.0) << "%)";
+
+    std::cout << std::setw(14) << ("> " + std::to_string(x).substr(0, 6))
+              << std::setw(10) << e->count()
+              << std::setw(16) << rate.str()
+              << std::setw(16) << fn
+              << std::setw(12) << te
+              << std::setw(12) << tb << '\n';
+  }
+}
+
+//
+// Fan-out of event batches to data indexers.
+//
+
+void fanout(options const& opts)
+{
+  // Interleave the events of several logs, as a partition sees them.
+  std::vector<bro_log> logs;
+  std::vector<type> types;
+  for (auto name : {"conn", "dns", "http"})
+  {
+    logs.push_back(read_log(opts, name));
+    std::vector<type::record::field> fields;
+    for (auto& f : logs.back().fields)
+      fields.emplace_back(f, type::string{});
+
+    type::record tr{std::move(fields)};
+    tr.name(name);
+    types.push_back(tr);
+  }
+
+  std::vector<event> events;
+  event_id id = 1;
+  for (size_t s = 0; s < std::max<size_t>(opts.scale / 10, 1); ++s)
+    for (size_t i = 0; ; ++i)
+    {
+      auto done = true;
+      for (size_t l = 0; l < logs.size(); ++l)
+        if (i < logs[l].rows.size())
+        {
+          done = false;
+          record r;
+          for (auto& x : logs[l].rows[i])
+            if (x == "-")
+              r.emplace_back(nil);
+            else
+              r.emplace_back(x);
+
+          auto e = event::make(std::move(r), types[l]);
+          e.id(id++);
+          events.push_back(std::move(e));
+        }
+
+      if (done)
+        break;
+    }
+
+  struct column
+  {
+    type t;
+    offset off;
+    dictionary_bitmap_index<ewah_bitstream> bmi;
+  };
+
+  auto make_columns = [&]
+  {
+    std::vector<column> columns;
+    for (auto& t : types)
+      for (size_t f = 0; f < get<type::record>(t)->fields().size(); ++f)
+        columns.push_back({t, offset{f}, {}});
+
+    return columns;
+  };
+
+  static constexpr size_t batch_size = 5000;
+
+  // Each indexer walks the entire batch and picks out the values at its
+  // offset from the events of its type.
+  auto per_indexer = [&]
+  {
+    auto columns = make_columns();
+    for (size_t b = 0; b < events.size(); b += batch_size)
+    {
+      auto end = std::min(b + batch_size, events.size());
+      for (auto& c : columns)
+        for (auto i = b; i < end; ++i)
+          if (events[i].type() == c.t)
+          {
+            auto d = get<record>(events[i])->at(c.off);
+            c.bmi.push_back(d ? *d : nil, events[i].id());
+          }
+    }
+  };
+
+  // The partition splits the batch by type once and hands each indexer the
+  // column of its values.
+  auto per_column = [&]
+  {
+    auto columns = make_columns();
+    for (size_t b = 0; b < events.size(); b += batch_size)
+    {
+      auto end = std::min(b + batch_size, events.size());
+      std::unordered_map<type, std::vector<event const*>> by_type;
+      for (auto i = b; i < end; ++i)
+        by_type[events[i].type()].push_back(&events[i]);
+
+      for (auto& c : columns)
+      {
+        auto i = by_type.find(c.t);
+        if (i == by_type.end())
+          continue;
+
+        std::vector<event_id> ids;
+        std::vector<data> values;
+        for (auto e : i->second)
+        {
+          auto d = get<record>(*e)->at(c.off);
+          ids.push_back(e->id());
+          values.push_back(d ? *d : nil);
+        }
+
+        for (size_t j = 0; j < ids.size(); ++j)
+          c.bmi.push_back(values[j], ids[j]);
+      }
+    }
+  };
+
+  auto before = measure(per_indexer, 1);
+  auto after = measure(per_column, 1);
+  std::cout << "fan-out of " << events.size() << " conn/dns/http events in "
+            << "batches of " << batch_size << " to "
+            << make_columns().size() << " indexers\n"
+            << std::setw(14) << "fan-out"
+            << std::setw(16) << "events/sec" << '\n'
+            << std::setw(14) << "per indexer"
+            << std::setw(16) << static_cast<uint64_t>(events.size() / before * 1e6)
+            << '\n'
+            << std::setw(14) << "per column"
+            << std::setw(16) << static_cast<uint64_t>(events.size() / after * 1e6)
+            << '\n';
+}
+
+//
+// Flush latency over the lifetime of a partition.
+//
+
+void flushes(options const& opts)
+{
+  using index_type = arithmetic_bitmap_index<ewah_bitstream, count>;
+
+  auto xs = counts(read_log(opts, "conn").column("orig_bytes", opts.scale));
+  path dir{"/tmp"};
+  dir /= "vast-bench-" + std::to_string(::getpid());
+  if (! mkdir(dir))
+  {
+    std::cerr << "failed to create " << dir << std::endl;
+    std::exit(1);
+  }
+
+  static constexpr size_t flushes = 100;
+  auto batch = std::max<size_t>(xs.size() / flushes, 1);
+
+  std::vector<double> latency_log;
+  std::vector<double> latency_full;
+  size_t written_log = 0;
+  size_t written_full = 0;
+
+  // Incremental: the store appends to its log and checkpoints occasionally.
+  {
+    bitmap_index_store<index_type> store{dir / "incremental"};
+    store.load(false);
+    for (size_t i = 0; i < xs.size(); ++i)
+    {
+      store.push_back(xs[i] ? data{*xs[i]} : data{nil}, i + 1);
+      if ((i + 1) % batch == 0 || i + 1 == xs.size())
+      {
+        auto full = store.checkpoint_due();
+        auto log_size = file_size(store.log_path());
+        latency_log.push_back(measure([&] { store.flush(); }, 1));
+        written_log += full ? file_size(store.checkpoint_path())
+                            : file_size(store.log_path()) - log_size;
+      }
+    }
+  }
+
+  // Full: every flush rewrites the entire bitmap index.
+  {
+    index_type bmi;
+    auto p = dir / "full";
+    for (size_t i = 0; i < xs.size(); ++i)
+    {
+      bmi.push_back(xs[i] ? data{*xs[i]} : data{nil}, i + 1);
+      if ((i + 1) % batch == 0 || i + 1 == xs.size())
+      {
+        if (exists(p))
+          rm(p);
+
+        uint64_t size = bmi.size();
+        latency_full.push_back(measure([&] { io::archive(p, size, bmi); }, 1));
+        written_full += file_size(p);
+      }
+    }
+  }
+
+  rm(dir);
+
+  std::cout << "flush latency on conn.log orig_bytes with " << xs.size()
+            << " values and " << latency_log.size() << " flushes (us)\n"
+            << std::setw(12) << "lifetime"
+            << std::setw(18) << "incremental"
+            << std::setw(14) << "full" << '\n';
+
+  auto mean = [](std::vector<double> const& v, size_t begin, size_t end)
+  {
+    double sum = 0;
+    for (auto i = begin; i < end; ++i)
+      sum += v[i];
+    return end > begin ? sum / (end - begin) : 0;
+  };
+
+  auto n = latency_log.size();
+  for (size_t q = 0; q < 4; ++q)
+    std::cout << std::setw(9) << (q * 25) << "-" << ((q + 1) * 25) << '%'
+              << std::setw(18) << mean(latency_log, n * q / 4, n * (q + 1) / 4)
+              << std::setw(14) << mean(latency_full, n * q / 4, n * (q + 1) / 4)
+              << '\n';
+
+  std::cout << std::setw(12) << "bytes"
+            << std::setw(18) << written_log
+            << std::setw(14) << written_full << '\n';
+}
+
+struct benchmark
+{
+  char const* name;
+  char const* request;
+  void (*run)(options const&);
+};
+
+// The benchmarks, one per optimization, in the order of the backlog.
+std::vector<benchmark> const benchmarks = {
+  {"kernels", "SIMD block kernels", kernels},
+  {"roaring", "Roaring versus EWAH bitstreams", containers},
+  {"access", "skip index for random access", access},
+  {"parallel", "multi-threaded EWAH operations", parallel},
+  {"builder", "bulk bitstream construction", builder},
+  {"dispatch", "devirtualized bitstreams", dispatch},
+  {"pattern", "pattern lookups on string columns", patterns},
+  {"coders", "adaptive coder selection", coders},
+  {"interval", "interval bit-slice coding", intervals},
+  {"real", "exact indexes for real values", reals},
+  {"fanout", "column-wise fan-out to indexers", fanout},
+  {"flush", "incremental indexer persistence", flushes}
+};
+
+void usage()
+{
+  std::cerr << "usage: vast-bench [-d log-dir] [-s scale] [benchmark...]\n\n"
+            << "benchmarks:\n";
+  for (auto& b : benchmarks)
+    std::cerr << "  " << std::left << std::setw(10) << b.name << b.request
+              << '\n';
+}
+
+} // namespace <anonymous>
+
+int main(int argc, char* argv[])
+{
+  options opts;
+  std::vector<std::string> selected;
+  for (auto i = 1; i < argc; ++i)
+  {
+    std::string arg = argv[i];
+    if (arg == "-d" && i + 1 < argc)
+      opts.log_dir = argv[++i];
+    else if (arg == "-s" && i + 1 < argc)
+      opts.scale = std::max(std::atoi(argv[++i]), 1);
+    else if (arg == "-h")
+      return usage(), 0;
+    else
+      selected.push_back(arg);
+  }
+
+  for (auto& s : selected)
+    if (std::none_of(benchmarks.begin(), benchmarks.end(),
+                     [&](benchmark const& b) { return s == b.name; }))
+    {
+      std::cerr << "unknown benchmark: " << s << "\n\n";
+      usage();
+      return 1;
+    }
+
+  for (auto& b : benchmarks)
+    if (selected.empty()
+        || std::find(selected.begin(), selected.end(), b.name)
+           != selected.end())
+    {
+      b.run(opts);
+      std::cout << std::endl;
+    }
+
+  return 0;
+}
@@ -191,9 +191,10 @@ TEST("basic actor integrity")
 
   bool done = false;
   self->do_receive(
-      on_arg_match >> [&](bitstream const& hits)
+      on_arg_match >> [&](bitstream const& hits, bool exact)
       {
         CHECK(hits.count() > 0);
+        CHECK(exact); // Port indexes have no false positives.
       },
       on(atom("progress"), arg_match) >> [&](double progress, uint64_t hits)
       {
@@ -46,6 +46,13 @@ TEST("bitwise total ordering")
   i = 4;
   CHECK(detail::order(i) == 2147483652);
 
+  std::vector<double> xs{-1111.2, -10.0, -2.4, -2.2, -2.0, -1.0, -0.1,
+                         -0.001, 0.0, 0.001, 0.1, 1.0, 1.0 + 1e-15, 1e300};
+  for (size_t j = 1; j < xs.size(); ++j)
+    CHECK(detail::order(xs[j - 1]) < detail::order(xs[j]));
+
+  CHECK(detail::order(-0.0) == detail::order(0.0));
+
   //print(-1111.2);
   //print(-10.0);
   //print(-2.4);
@@ -282,6 +289,79 @@ TEST("range encoded bitmap (EWAH)")
   CHECK(*bm.lookup(greater, 31338) == all_zeros);
 }
 
+TEST("interval encoded bitmap (null)")
+{
+  bitmap<int8_t, null_bitstream, interval_bitslice_coder> bm, bm2;
+  REQUIRE(bm.push_back(42));
+  REQUIRE(bm.push_back(84));
+  REQUIRE(bm.push_back(42));
+  REQUIRE(bm.push_back(21));
+  REQUIRE(bm.push_back(30));
+
+  CHECK(to_string(*bm.lookup(not_equal, 13)) == "11111");
+  CHECK(to_string(*bm.lookup(not_equal, 42)) == "01011");
+  CHECK(to_string(*bm.lookup(equal, 21)) == "00010");
+  CHECK(to_string(*bm.lookup(equal, 30)) == "00001");
+  CHECK(to_string(*bm.lookup(equal, 42)) == "10100");
+  CHECK(to_string(*bm.lookup(equal, 84)) == "01000");
+  CHECK(to_string(*bm.lookup(less_equal, 21)) == "00010");
+  CHECK(to_string(*bm.lookup(less_equal, 30)) == "00011");
+  CHECK(to_string(*bm.lookup(less_equal, 42)) == "10111");
+  CHECK(to_string(*bm.lookup(less_equal, 84)) == "11111");
+  CHECK(to_string(*bm.lookup(less_equal, 25)) == "00010");
+  CHECK(to_string(*bm.lookup(less_equal, 80)) == "10111");
+  CHECK(to_string(*bm.lookup(not_equal, 30)) == "11110");
+  CHECK(to_string(*bm.lookup(greater, 42)) == "01000");
+  CHECK(to_string(*bm.lookup(greater, 13)) == "11111");
+  CHECK(to_string(*bm.lookup(greater, 84)) == "00000");
+  CHECK(to_string(*bm.lookup(less, 42)) == "00011");
+  CHECK(to_string(*bm.lookup(less, 84)) == "10111");
+  CHECK(to_string(*bm.lookup(greater_equal, 84)) == "01000");
+  CHECK(to_string(*bm.lookup(greater_equal, -42)) == "11111");
+  CHECK(to_string(*bm.lookup(greater_equal, 22)) == "11101");
+
+  std::vector<uint8_t> buf;
+  io::archive(buf, bm);
+  io::unarchive(buf, bm2);
+  CHECK(bm == bm2);
+  CHECK(to_string(bm) == to_string(bm2));
+  CHECK(to_string(*bm2.lookup(greater, 84)) == "00000");
+  CHECK(to_string(*bm2.lookup(less, 84)) == "10111");
+  CHECK(to_string(*bm2.lookup(greater_equal, -42)) == "11111");
+}
+
+TEST("interval coding with odd and even bases")
+{
+  // The base covers the values [0, 120).
+  interval_bitslice_coder<uint16_t, null_bitstream> c{{2, 3, 4, 5}};
+  for (uint16_t i = 0; i < 120; ++i)
+    REQUIRE(c.encode((i * 7) % 120));
+
+  size_t failures = 0;
+  for (auto op : {equal, not_equal, less, less_equal, greater, greater_equal})
+    for (uint16_t x = 0; x < 120; ++x)
+    {
+      std::string expected;
+      for (uint16_t i = 0; i < 120; ++i)
+      {
+        auto y = (i * 7) % 120;
+        auto hit = op == equal ? y == x
+          : op == not_equal ? y != x
+          : op == less ? y < x
+          : op == less_equal ? y <= x
+          : op == greater ? y > x
+          : y >= x;
+        expected += hit ? '1' : '0';
+      }
+
+      auto r = c.decode(x, op);
+      if (! r || to_string(*r) != expected)
+        ++failures;
+    }
+
+  CHECK(failures == 0);
+}
+
 TEST("binary encoded bitmap")
 {
   bitmap<int8_t, null_bitstream, binary_bitslice_coder> bm, bm2;
@@ -384,3 +464,206 @@ TEST("precision binning (double, positive)")
   CHECK(to_string(*bm[40.0]) == "101110");
   CHECK(to_string(*bm[50.0]) == "010001");
 }
+
+namespace {
+
+// Looks up values in a bitmap and in the same bitmap deserialized over
+// read-only views without copying, and counts the differing results.
+template <template <typename, typename> class Coder>
+size_t compare_views(std::vector<relational_operator> const& ops)
+{
+  bitmap<uint16_t, ewah_bitstream, Coder> bm;
+  for (uint16_t i = 0; i < 1000; ++i)
+    bm.push_back(i % 7 == 0 ? 4242 : (i * 31) % 509);
+
+  std::vector<uint8_t> buf;
+  io::archive(buf, bm);
+  bitmap<uint16_t, ewah_bitstream_view, Coder> view;
+  io::array_input_stream source{buf.data(), buf.size()};
+  binary_deserializer d{source, true};
+  d >> view;
+
+  size_t failures = 0;
+  for (auto op : ops)
+    for (uint16_t x : {0, 1, 42, 100, 508, 509, 4242, 65535})
+    {
+      auto expected = bm.lookup(op, x);
+      auto actual = view.lookup(op, x);
+      if (! expected || ! actual || *actual != *expected)
+        ++failures;
+    }
+
+  return failures;
+}
+
+} // namespace <anonymous>
+
+TEST("bitmap over read-only views (EWAH)")
+{
+  CHECK(compare_views<equality_coder>({equal, not_equal}) == 0);
+  CHECK(compare_views<binary_bitslice_coder>(
+          {equal, not_equal, less, less_equal, greater, greater_equal}) == 0);
+  CHECK(compare_views<equality_bitslice_coder>({equal, not_equal}) == 0);
+  CHECK(compare_views<range_bitslice_coder>(
+          {equal, not_equal, less, less_equal, greater, greater_equal}) == 0);
+  CHECK(compare_views<interval_bitslice_coder>(
+          {equal, not_equal, less, less_equal, greater, greater_equal}) == 0);
+}
+
+TEST("lazy bitstream decoding")
+{
+  ewah_bitstream bs;
+  bs.append(100, true);
+  bs.push_back(false);
+  bs.append(42, true);
+
+  detail::lazy_bitstream<ewah_bitstream> x{bs}, y;
+  CHECK(! x.encoded());
+  std::vector<uint8_t> buf;
+  io::archive(buf, x);
+  io::unarchive(buf, y);
+  CHECK(y.encoded());
+
+  // Reading decodes but retains the serialized form.
+  auto const& z = y;
+  CHECK(z.get() == bs);
+  CHECK(! y.encoded());
+  std::vector<uint8_t> buf2;
+  io::archive(buf2, y);
+  CHECK(buf == buf2);
+
+  // Modifying discards the serialized form.
+  y.get().push_back(true);
+  buf2.clear();
+  io::archive(buf2, y);
+  detail::lazy_bitstream<ewah_bitstream> w;
+  io::unarchive(buf2, w);
+  CHECK(w.get().size() == 144);
+  CHECK(w == y);
+  CHECK(w != x);
+}
+
+TEST("optimal range-encoding base")
+{
+  using coder = adaptive_coder<uint64_t, null_bitstream>;
+  using base = coder::value_list;
+  CHECK(coder::optimal_base(0) == base{2});
+  CHECK(coder::optimal_base(99) == (base{5, 5, 4}));
+  CHECK(coder::optimal_base(1023) == (base{4, 4, 4, 4, 4}));
+  CHECK(coder::optimal_base(~0ull).size() == 32);
+}
+
+TEST("adaptive coding")
+{
+  adaptive_coder<uint64_t, null_bitstream> c{4}, c2;
+  for (auto x : {5, 3, 5})
+    REQUIRE(c.encode(x));
+  REQUIRE(c.append(1, false));
+  for (auto x : {3, 3, 5, 7, 9, 3, 5})
+    REQUIRE(c.encode(x));
+
+  // Up to 4 distinct values, the coder sticks to equality encoding and
+  // evaluates range predicates over all values.
+  CHECK(c.encoding() == equality_encoding);
+  CHECK(to_string(*c.decode(5, equal)) ==     "10100010001");
+  CHECK(to_string(*c.decode(7, less)) ==      "11101110011");
+  CHECK(to_string(*c.decode(5, greater)) ==   "00000001100");
+  CHECK(to_string(*c.decode(3, not_equal)) == "10110011101");
+
+  // The fifth distinct value switches to a range encoding, because values
+  // repeat frequently.
+  REQUIRE(c.encode(100));
+  CHECK(c.encoding() == range_encoding);
+  CHECK(to_string(*c.decode(5, equal)) ==        "101000100010");
+  CHECK(to_string(*c.decode(7, less)) ==         "111011100110");
+  CHECK(to_string(*c.decode(5, greater)) ==      "000000011001");
+  CHECK(to_string(*c.decode(3, not_equal)) ==    "101100111011");
+  CHECK(to_string(*c.decode(2, less)) ==         "000000000000");
+  CHECK(to_string(*c.decode(2, greater)) ==      "111011111111");
+  CHECK(to_string(*c.decode(100, equal)) ==      "000000000001");
+  CHECK(to_string(*c.decode(5000, less)) ==      "111011111111");
+  CHECK(to_string(*c.decode(5000, not_equal)) == "111111111111");
+
+  // A value beyond the range re-encodes all rows.
+  REQUIRE(c.encode(1000000));
+  REQUIRE(c.encode(1));
+  CHECK(to_string(*c.decode(5, equal)) ==        "10100010001000");
+  CHECK(to_string(*c.decode(100, greater)) ==    "00000000000010");
+  CHECK(to_string(*c.decode(5, less_equal)) ==   "11101110011001");
+
+  // Optimizing counts the distinct values of all rows. With 7 of 13 values
+  // distinct, binary encoding wins, sized for the exact range, once.
+  CHECK(c.optimize());
+  CHECK(! c.optimize());
+  CHECK(c.encoding() == binary_encoding);
+  CHECK(c.cardinality() == 20);
+  CHECK(to_string(*c.decode(5, equal)) ==        "10100010001000");
+  CHECK(to_string(*c.decode(100, greater)) ==    "00000000000010");
+  CHECK(to_string(*c.decode(5, less_equal)) ==   "11101110011001");
+
+  std::vector<uint8_t> buf;
+  io::archive(buf, c);
+  io::unarchive(buf, c2);
+  CHECK(c == c2);
+  CHECK(c2.encoding() == binary_encoding);
+  CHECK(to_string(*c2.decode(100, greater)) ==   "00000000000010");
+}
+
+TEST("adaptive coding over a whole partition")
+{
+  // The first values are all distinct, so the coder switches to binary
+  // encoding. Later values repeat the same few, after which the partition as
+  // a whole calls for a range encoding.
+  adaptive_coder<uint64_t, null_bitstream> c{4};
+  for (uint64_t i = 0; i < 10; ++i)
+    REQUIRE(c.encode(i * 10));
+  CHECK(c.encoding() == binary_encoding);
+  for (uint64_t i = 0; i < 1000; ++i)
+    REQUIRE(c.encode(i % 3 * 10));
+  CHECK(c.encoding() == binary_encoding);
+
+  CHECK(c.optimize());
+  CHECK(c.encoding() == range_encoding);
+  CHECK(c.base() == c.optimal_base(90));
+  CHECK(c.decode(0, equal)->count() == 335);
+  CHECK(c.decode(20, greater)->count() == 7);
+  CHECK(c.decode(90, equal)->find_first() == 9);
+}
+
+TEST("adaptive coding of descending values")
+{
+  // Each value lies below all previous ones. Re-encoding must leave room
+  // below the observed range, or every value would re-encode all rows.
+  adaptive_coder<uint64_t, null_bitstream> c{2};
+  uint64_t const n = 20000;
+  for (auto i = n; i > 0; --i)
+    REQUIRE(c.encode(1000000 + i));
+
+  CHECK(c.encoding() == binary_encoding);
+  CHECK(c.decode(1000000 + n, equal)->find_first() == 0);
+  CHECK(c.decode(1000001, equal)->find_first() == n - 1);
+  CHECK(c.decode(1000000 + n / 2, less_equal)->count() == n / 2);
+  CHECK(c.decode(1000000, greater)->count() == n);
+}
+
+TEST("adaptive coding of unique values")
+{
+  adaptive_coder<int64_t, null_bitstream> c{2};
+  for (auto x : {-10, 20})
+    REQUIRE(c.encode(x));
+  REQUIRE(c.append(1, false));
+  for (auto x : {30, 40, -5})
+    REQUIRE(c.encode(x));
+
+  // Nearly every value is distinct, which calls for binary encoding.
+  CHECK(c.encoding() == binary_encoding);
+  CHECK(c.optimize());
+  CHECK(! c.optimize());
+  CHECK(c.cardinality() == 6);
+  CHECK(to_string(*c.decode(30, equal)) ==        "000100");
+  CHECK(to_string(*c.decode(20, less)) ==         "100001");
+  CHECK(to_string(*c.decode(20, greater_equal)) == "010110");
+  CHECK(to_string(*c.decode(-5, not_equal)) ==    "111110");
+  CHECK(to_string(*c.decode(-100, greater)) ==    "110111");
+  CHECK(to_string(*c.decode(100, less_equal)) ==  "110111");
+}
@@ -84,6 +84,58 @@ TEST("floating point with binning")
   CHECK(to_string(*bmi.lookup(not_equal, 4711.14)) == "1110111");
 }
 
+TEST("exact floating point")
+{
+  arithmetic_bitmap_index<null_bitstream, real> bmi, bmi2;
+  CHECK(bmi.exact(equal));
+
+  REQUIRE(bmi.push_back(-7.8));
+  REQUIRE(bmi.push_back(42.123));
+  REQUIRE(bmi.push_back(42.1230001));
+  REQUIRE(bmi.push_back(-0.0));
+  REQUIRE(bmi.push_back(1e-300));
+  REQUIRE(bmi.push_back(42.12299));
+
+  CHECK(to_string(*bmi.lookup(equal, 42.123)) == "010000");
+  CHECK(to_string(*bmi.lookup(greater, 42.123)) == "001000");
+  CHECK(to_string(*bmi.lookup(less, 42.123)) == "100111");
+  CHECK(to_string(*bmi.lookup(less_equal, 0.0)) == "100100");
+  CHECK(to_string(*bmi.lookup(greater, 0.0)) == "011011");
+  CHECK(to_string(*bmi.lookup(not_equal, -7.8)) == "011111");
+
+  // Binning gives up exactness.
+  arithmetic_bitmap_index<null_bitstream, real> binned;
+  binned.binner(-2);
+  CHECK(! binned.exact(equal));
+
+  std::vector<uint8_t> buf;
+  io::archive(buf, bmi);
+  io::unarchive(buf, bmi2);
+  CHECK(bmi == bmi2);
+  CHECK(bmi2.exact(equal));
+}
+
+TEST("exact time_duration")
+{
+  arithmetic_bitmap_index<null_bitstream, time_duration> bmi;
+  CHECK(bmi.exact(equal));
+
+  REQUIRE(bmi.push_back(std::chrono::nanoseconds(1000000001)));
+  REQUIRE(bmi.push_back(std::chrono::nanoseconds(1000000000)));
+  REQUIRE(bmi.push_back(std::chrono::nanoseconds(999999999)));
+
+  auto r = bmi.lookup(greater, std::chrono::seconds(1));
+  REQUIRE(r);
+  CHECK(to_string(*r) == "100");
+  r = bmi.lookup(equal, std::chrono::seconds(1));
+  REQUIRE(r);
+  CHECK(to_string(*r) == "010");
+
+  bmi.binner(8);
+  CHECK(! bmi.exact(equal));
+  CHECK((arithmetic_bitmap_index<null_bitstream, count>{}.exact(less)));
+}
+
 TEST("time_range")
 {
   arithmetic_bitmap_index<null_bitstream, time_duration> bmi, bmi2;
@@ -143,6 +195,142 @@ TEST("time_point")
   CHECK(bmi == bmi2);
 }
 
+TEST("multi-resolution time")
+{
+  time_bitmap_index<null_bitstream> bmi, bmi2;
+  std::vector<time_point> xs{
+    time_point{"2014-01-16+05:30:15"},
+    time_point{"2014-01-16+05:30:12"},
+    time_point{"2014-01-16+05:31:15"},
+    time_point{"2014-01-16+06:00:00"},
+    time_point{"2014-01-17+05:30:15"},
+    time_point{"2014-01-15+23:59:59"},
+    time_point{"2014-01-16+05:30:15"} + std::chrono::nanoseconds(1),
+    time_point{"1969-12-31+23:59:30"}};
+
+  for (auto& x : xs)
+    REQUIRE(bmi.push_back(x));
+  REQUIRE(bmi.push_back(nil));
+
+  // Compare every lookup against a scan of the values.
+  auto ops = {equal, not_equal, less, less_equal, greater, greater_equal};
+  size_t mismatches = 0;
+  for (auto op : ops)
+    for (auto& y : xs)
+    {
+      auto r = bmi.lookup(op, y);
+      REQUIRE(r);
+      std::string expected;
+      for (auto& x : xs)
+        expected += data::evaluate(x, op, y) ? '1' : '0';
+      expected += op == not_equal ? '1' : '0';
+      if (to_string(*r) != expected)
+        ++mismatches;
+    }
+
+  CHECK(mismatches == 0);
+  CHECK(bmi.exact(equal));
+
+  auto days = bmi.histogram(time_bitmap_index<null_bitstream>::days);
+  REQUIRE(days.size() == 4);
+  CHECK(days[time_point{"2014-01-16+00:00:00"}] == 5);
+  CHECK(days[time_point{"2014-01-17+00:00:00"}] == 1);
+  auto minutes = bmi.histogram(time_bitmap_index<null_bitstream>::minutes);
+  CHECK(minutes[time_point{"2014-01-16+05:30:00"}] == 3);
+  CHECK(minutes[time_point{"1969-12-31+23:59:00"}] == 1);
+
+  std::vector<uint8_t> buf;
+  io::archive(buf, bmi);
+  io::unarchive(buf, bmi2);
+  CHECK(bmi == bmi2);
+
+  // Fine lookups map the rows of a minute bucket back to the index rows.
+  time_bitmap_index<ewah_bitstream> ewah;
+  auto start = time_point{"2014-01-16+05:30:00"};
+  for (int i = 0; i < 2000; ++i)
+    if (i % 10 == 3)
+      REQUIRE(ewah.push_back(nil));
+    else
+      REQUIRE(ewah.push_back(start + std::chrono::seconds(i * 7 % 3600)));
+
+  auto y = start + std::chrono::seconds(1234);
+  for (auto op : ops)
+  {
+    auto r = ewah.lookup(op, y);
+    REQUIRE(r);
+    REQUIRE(r->size() == 2000);
+    for (int i = 0; i < 2000; ++i)
+    {
+      auto x = start + std::chrono::seconds(i * 7 % 3600);
+      auto expected = i % 10 == 3 ? op == not_equal
+                                  : data::evaluate(x, op, y);
+      if ((*r)[i] != expected)
+        ++mismatches;
+    }
+  }
+
+  CHECK(mismatches == 0);
+}
+
+TEST("adaptive encoding")
+{
+  arithmetic_bitmap_index<null_bitstream, count> bmi, bmi2;
+  for (count i = 0; i < 4000; ++i)
+    if (i % 100 == 7)
+      REQUIRE(bmi.push_back(nil));
+    else
+      REQUIRE(bmi.push_back(i / 3));
+
+  auto failures = [](arithmetic_bitmap_index<null_bitstream, count> const& b)
+  {
+    size_t n = 0;
+    for (auto op : {equal, not_equal, less, less_equal, greater, greater_equal})
+      for (count x : {0, 1, 500, 1332, 1333, 5000})
+      {
+        std::string expected;
+        for (count i = 0; i < 4000; ++i)
+        {
+          auto y = i / 3;
+          auto hit = false;
+          if (i % 100 == 7)
+            hit = op == not_equal;
+          else if (op == equal)
+            hit = y == x;
+          else if (op == not_equal)
+            hit = y != x;
+          else if (op == less)
+            hit = y < x;
+          else if (op == less_equal)
+            hit = y <= x;
+          else if (op == greater)
+            hit = y > x;
+          else
+            hit = y >= x;
+
+          expected += hit ? '1' : '0';
+        }
+
+        auto r = b.lookup(op, x);
+        if (! r || to_string(*r) != expected)
+          ++n;
+      }
+
+    return n;
+  };
+
+  // More than 1024 distinct values cause a switch to range encoding.
+  CHECK(failures(bmi) == 0);
+  CHECK(bmi.optimize());
+  CHECK(! bmi.optimize());
+  CHECK(failures(bmi) == 0);
+
+  std::vector<uint8_t> buf;
+  io::archive(buf, bmi);
+  io::unarchive(buf, bmi2);
+  CHECK(bmi == bmi2);
+  CHECK(failures(bmi2) == 0);
+}
+
 TEST("string")
 {
   string_bitmap_index<null_bitstream> bmi, bmi2;
@@ -236,6 +424,112 @@ TEST("IP address")
   CHECK(bmi == bmi2);
 }
 
+TEST("IP address with prefixes")
+{
+  address_bitmap_index<null_bitstream> bmi{true}, bmi2;
+  REQUIRE(bmi.push_back(*address::from_v4("10.1.2.3")));
+  REQUIRE(bmi.push_back(*address::from_v4("10.1.3.4")));
+  REQUIRE(bmi.push_back(nil));
+  REQUIRE(bmi.push_back(*address::from_v4("10.2.2.3")));
+  REQUIRE(bmi.push_back(*address::from_v6("2001:db8::1")));
+  REQUIRE(bmi.push_back(*address::from_v4("11.1.2.3")));
+  REQUIRE(bmi.push_back(*address::from_v6("::1")));
+
+  auto lookup = [&](relational_operator op, char const* str)
+  {
+    auto x = to<subnet>(str);
+    REQUIRE(x);
+    auto bs = bmi.lookup(op, *x);
+    REQUIRE(bs);
+    return to_string(*bs);
+  };
+
+  CHECK(lookup(in, "10.0.0.0/8") ==      "1101000");
+  CHECK(lookup(in, "10.1.0.0/16") ==     "1100000");
+  CHECK(lookup(in, "10.1.2.0/24") ==     "1000000");
+  CHECK(lookup(in, "10.1.2.0/23") ==     "1100000");
+  CHECK(lookup(in, "10.1.2.3/32") ==     "1000000");
+  CHECK(lookup(in, "10.0.0.0/7") ==      "1101010");
+  CHECK(lookup(not_in, "10.1.0.0/16") == "0011111");
+  CHECK(lookup(in, "2001:db8::/32") ==   "0000100");
+  CHECK(lookup(in, "::/64") ==           "1101011");
+  CHECK(lookup(in, "::/96") ==           "0000001");
+
+  auto bs = bmi.lookup(equal, *address::from_v6("::1"));
+  REQUIRE(bs);
+  CHECK(to_string(*bs) == "0000001");
+  bs = bmi.lookup(equal, *address::from_v4("11.1.2.3"));
+  REQUIRE(bs);
+  CHECK(to_string(*bs) == "0000010");
+  bs = bmi.lookup(equal, nil);
+  REQUIRE(bs);
+  CHECK(to_string(*bs) == "0010000");
+
+  std::vector<uint8_t> buf;
+  io::archive(buf, bmi);
+  io::unarchive(buf, bmi2);
+  CHECK(bmi == bmi2);
+  bs = bmi2.lookup(in, *to<subnet>("10.1.0.0/16"));
+  REQUIRE(bs);
+  CHECK(to_string(*bs) == "1100000");
+}
+
+TEST("IP address set membership")
+{
+  std::vector<data> xs;
+  for (auto i = 0u; i < 200; ++i)
+  {
+    auto str = "10." + std::to_string(i % 3) + ".0." + std::to_string(i % 97);
+    xs.push_back(*address::from_v4(str.data()));
+  }
+
+  xs.push_back(nil);
+  xs.push_back(*address::from_v6("2001:db8::1"));
+  xs.push_back(*address::from_v6("::1"));
+
+  set s{*address::from_v4("10.0.0.1"),
+        *address::from_v4("10.0.0.2"),
+        *address::from_v4("10.1.0.42"),
+        *address::from_v4("10.2.0.96"),
+        *address::from_v4("10.2.0.97"),
+        *address::from_v4("192.168.0.1"),
+        *address::from_v6("::1")};
+
+  for (auto prefixes : {false, true})
+  {
+    address_bitmap_index<null_bitstream> bmi{prefixes};
+    for (auto& x : xs)
+      REQUIRE(bmi.push_back(x));
+
+    for (auto op : {in, not_in})
+    {
+      auto bs = bmi.lookup(op, s);
+      REQUIRE(bs);
+      REQUIRE(bs->size() == xs.size());
+      for (size_t i = 0; i < xs.size(); ++i)
+        CHECK((*bs)[i] == data::evaluate(xs[i], op, s));
+    }
+
+    CHECK(! bmi.lookup(in, set{"foo"}));
+  }
+
+  for (auto prefixes : {false, true})
+  {
+    address_bitmap_index<ewah_bitstream> bmi{prefixes};
+    for (auto& x : xs)
+      REQUIRE(bmi.push_back(x));
+
+    for (auto op : {in, not_in})
+    {
+      auto bs = bmi.lookup(op, s);
+      REQUIRE(bs);
+      REQUIRE(bs->size() == xs.size());
+      for (size_t i = 0; i < xs.size(); ++i)
+        CHECK((*bs)[i] == data::evaluate(xs[i], op, s));
+    }
+  }
+}
+
 TEST("subnet")
 {
   subnet_bitmap_index<null_bitstream> bmi, bmi2;
@@ -376,6 +670,128 @@ TEST("container")
   CHECK(bmi.push_back(*strings));
 }
 
+TEST("container membership")
+{
+  sequence_bitmap_index<null_bitstream> bmi{type::string{}, false};
+  CHECK(bmi.push_back(vector{"foo", "bar"}));
+  CHECK(bmi.push_back(vector{"qux", "foo", "baz", "corge", "foo"}));
+  CHECK(bmi.push_back(vector{}));
+  CHECK(bmi.push_back(data{}));
+  CHECK(bmi.push_back(set{"bar"}));
+  CHECK(bmi.push_back(vector{"corge"}, 7));
+
+  auto lookup = [&](relational_operator op, data const& d)
+  {
+    auto r = bmi.lookup(op, d);
+    REQUIRE(r);
+    return to_string(*r);
+  };
+
+  CHECK(lookup(in, "foo") == "11000000");
+  CHECK(lookup(ni, "bar") == "10001000");
+  CHECK(lookup(in, "corge") == "01000001");
+  CHECK(lookup(not_in, "foo") == "00111001");
+  CHECK(lookup(in, "not") == "00000000");
+  CHECK(! bmi.lookup(equal, "foo"));
+
+  // Rows of many containers, some empty, map back from compressed markers.
+  sequence_bitmap_index<ewah_bitstream> ewah{type::count{}, false};
+  for (count i = 0; i < 1000; ++i)
+  {
+    vector v;
+    for (count j = 0; j < i % 5; ++j)
+      v.emplace_back(j * i % 7);
+    REQUIRE(ewah.push_back(std::move(v)));
+  }
+
+  auto threes = ewah.lookup(in, count{3});
+  REQUIRE(threes);
+  for (count i = 0; i < 1000; ++i)
+  {
+    auto expected = false;
+    for (count j = 0; j < i % 5; ++j)
+      expected = expected || j * i % 7 == 3;
+    CHECK((*threes)[i] == expected);
+  }
+
+  // The single element index covers all elements.
+  sequence_bitmap_index<null_bitstream> positional{type::string{}};
+  CHECK(positional.push_back(vector{"qux", "foo", "baz", "corge", "foo"}));
+  CHECK(positional.push_back(vector{"foo"}));
+  CHECK(to_string(*positional.lookup(in, "foo")) == "11");
+}
+
+TEST("table")
+{
+  table_bitmap_index<null_bitstream> bmi{type::string{}, type::count{}};
+  CHECK(bmi.push_back(table{{"foo", 1u}, {"bar", 2u}}));
+  CHECK(bmi.push_back(table{{"baz", 2u}}));
+  CHECK(bmi.push_back(table{}));
+  CHECK(bmi.push_back(data{}));
+  CHECK(bmi.push_back(table{{"foo", 2u}, {"qux", 3u}}));
+
+  auto lookup = [&](relational_operator op, data const& d)
+  {
+    auto r = bmi.lookup(op, d);
+    REQUIRE(r);
+    return to_string(*r);
+  };
+
+  // Key membership.
+  CHECK(lookup(ni, "foo") == "10001");
+  CHECK(lookup(in, "baz") == "01000");
+  CHECK(lookup(not_ni, "foo") == "01110");
+  CHECK(lookup(ni, "corge") == "00000");
+
+  // Key/value equality.
+  CHECK(lookup(ni, table{{"foo", 1u}}) == "10000");
+  CHECK(lookup(ni, table{{"foo", 2u}}) == "00001");
+  CHECK(lookup(ni, table{{"foo", 2u}, {"qux", 3u}}) == "00001");
+  CHECK(lookup(ni, table{{"foo", 1u}, {"qux", 3u}}) == "00000");
+
+  // Value membership.
+  CHECK(lookup(ni, table{{nil, 2u}}) == "11001");
+  CHECK(lookup(ni, table{{nil, 3u}}) == "00001");
+
+  CHECK(! bmi.lookup(equal, "foo"));
+  CHECK(! bmi.lookup(ni, table{}));
+}
+
+TEST("connection")
+{
+  // Fields in the order resp_h, resp_p, orig_h, orig_p.
+  connection_bitmap_index<null_bitstream> bmi{{{2, 3, 0, 1}}};
+  auto a = *address::from_v4("10.0.0.1");
+  auto b = *address::from_v4("10.0.0.2");
+  auto c = *address::from_v4("192.168.0.1");
+  CHECK(bmi.push_back(record{c, port{80, port::tcp}, a, port{4242, port::tcp}}));
+  CHECK(bmi.push_back(record{c, port{80, port::tcp}, b, port{4242, port::tcp}}));
+  CHECK(bmi.push_back(record{c, port{80, port::tcp}, a, port{1337, port::tcp}}));
+  CHECK(bmi.push_back(record{c, port{53, port::udp}, a, port{4242, port::udp}}));
+  CHECK(bmi.push_back(record{c, nil, a, port{4242, port::tcp}}));
+  CHECK(bmi.push_back(data{}));
+
+  auto lookup = [&](relational_operator op, data const& d)
+  {
+    auto r = bmi.lookup(op, d);
+    REQUIRE(r);
+    return to_string(*r);
+  };
+
+  // Full 5-tuple.
+  auto x = record{a, port{4242, port::tcp}, c, port{80, port::tcp}};
+  CHECK(lookup(equal, x) == "100000");
+  CHECK(lookup(not_equal, x) == "011111");
+
+  // Service tuple with the originator port left open.
+  CHECK(lookup(equal, record{a, nil, c, port{80, port::tcp}}) == "101000");
+  CHECK(lookup(equal, record{a, nil, c, port{53, port::udp}}) == "000100");
+  CHECK(lookup(equal, record{a, nil, c, port{80, port::udp}}) == "000000");
+
+  CHECK(! bmi.lookup(less, x));
+  CHECK(! bmi.lookup(equal, record{a, nil, c}));
+}
+
 TEST("offset push-back")
 {
   string_bitmap_index<null_bitstream> bmi;
@@ -404,3 +820,166 @@ TEST("offset push-back")
   REQUIRE(r);
   CHECK(to_string(*r) == "00110001");
 }
+
+TEST("dictionary-encoded string")
+{
+  dictionary_bitmap_index<null_bitstream> bmi, bmi2;
+  REQUIRE(bmi.push_back("foo"));
+  REQUIRE(bmi.push_back("bar"));
+  REQUIRE(bmi.push_back("baz"));
+  REQUIRE(bmi.push_back("foo"));
+  REQUIRE(bmi.push_back("foo"));
+  REQUIRE(bmi.push_back("bar"));
+  REQUIRE(bmi.push_back(""));
+  REQUIRE(bmi.push_back("qux"));
+  REQUIRE(bmi.push_back("corge"));
+  REQUIRE(bmi.push_back("bazz"));
+  CHECK(bmi.cardinality() == 7);
+
+  CHECK(to_string(*bmi.lookup(equal, "foo")) ==   "1001100000");
+  CHECK(to_string(*bmi.lookup(equal, "bar")) ==   "0100010000");
+  CHECK(to_string(*bmi.lookup(equal, "")) ==      "0000001000");
+  CHECK(to_string(*bmi.lookup(equal, "bazz")) ==  "0000000001");
+  CHECK(to_string(*bmi.lookup(equal, "nope")) ==  "0000000000");
+  CHECK(to_string(*bmi.lookup(not_equal, "foo")) == "0110011111");
+
+  CHECK(to_string(*bmi.lookup(ni, "")) ==     "1111111111");
+  CHECK(to_string(*bmi.lookup(ni, "o")) ==    "1001100010");
+  CHECK(to_string(*bmi.lookup(ni, "z")) ==    "0010000001");
+  CHECK(to_string(*bmi.lookup(not_ni, "z")) == "1101111110");
+
+  // Membership in a set of strings and substring of a string.
+  auto xs = set{"foo", "qux", "nope"};
+  CHECK(to_string(*bmi.lookup(in, xs)) ==     "1001100100");
+  CHECK(to_string(*bmi.lookup(not_in, xs)) == "0110011011");
+  CHECK(to_string(*bmi.lookup(in, "bazooka")) == "0010001000");
+
+  CHECK(! bmi.lookup(match, "foo"));
+
+  std::vector<uint8_t> buf;
+  io::archive(buf, bmi);
+  io::unarchive(buf, bmi2);
+  CHECK(bmi == bmi2);
+  CHECK(to_string(*bmi2.lookup(equal, "foo")) == "1001100000");
+  REQUIRE(bmi2.push_back("bar"));
+  CHECK(bmi2.cardinality() == 7);
+  CHECK(to_string(*bmi2.lookup(equal, "bar")) == "01000100001");
+}
+
+TEST("dictionary-encoded string set membership")
+{
+  dictionary_bitmap_index<null_bitstream> bmi;
+  REQUIRE(bmi.push_back("foo"));
+  REQUIRE(bmi.push_back("bar"));
+  REQUIRE(bmi.push_back(nil));
+  REQUIRE(bmi.push_back("baz"));
+  REQUIRE(bmi.push_back("foo"));
+
+  auto bs = bmi.lookup(in, set{"foo", "baz", "qux"});
+  REQUIRE(bs);
+  CHECK(to_string(*bs) == "10011");
+  bs = bmi.lookup(not_in, set{"foo", "baz", "qux"});
+  REQUIRE(bs);
+  CHECK(to_string(*bs) == "01100");
+  bs = bmi.lookup(in, set{});
+  REQUIRE(bs);
+  CHECK(to_string(*bs) == "00000");
+  CHECK(! bmi.lookup(in, set{42u}));
+}
+
+TEST("dictionary-encoded string fallback")
+{
+  dictionary_bitmap_index<null_bitstream> bmi{3}, bmi2;
+  REQUIRE(bmi.push_back("foo", 1));
+  REQUIRE(bmi.push_back(nil));
+  REQUIRE(bmi.push_back("bar"));
+  REQUIRE(bmi.push_back("foo"));
+  REQUIRE(bmi.push_back("baz"));
+  CHECK(bmi.dictionary_encoded());
+  CHECK(bmi.exact(equal));
+  REQUIRE(bmi.push_back("qux"));
+  CHECK(! bmi.dictionary_encoded());
+  CHECK(! bmi.exact(equal));
+  REQUIRE(bmi.push_back("foo"));
+
+  CHECK(to_string(*bmi.lookup(equal, "foo")) == "01001001");
+  CHECK(to_string(*bmi.lookup(equal, "qux")) == "00000010");
+  CHECK(to_string(*bmi.lookup(equal, nil)) ==   "00100000");
+  CHECK(to_string(*bmi.lookup(ni, "a")) ==      "00010100");
+  CHECK(to_string(*bmi.lookup(in, set{"bar", "qux"})) == "00010010");
+
+  std::vector<uint8_t> buf;
+  io::archive(buf, bmi);
+  io::unarchive(buf, bmi2);
+  CHECK(bmi == bmi2);
+  CHECK(to_string(*bmi2.lookup(equal, "foo")) == "01001001");
+}
+
+TEST("n-gram substring search")
+{
+  ngram_bitmap_index<null_bitstream> bmi, bmi2;
+  REQUIRE(bmi.push_back("/index.html"));
+  REQUIRE(bmi.push_back("/images/logo.png"));
+  REQUIRE(bmi.push_back(nil));
+  REQUIRE(bmi.push_back("/index.php?q=foo"));
+  REQUIRE(bmi.push_back("abcab"));
+  REQUIRE(bmi.push_back("/index.html", 7));
+
+  CHECK(to_string(*bmi.lookup(ni, "index")) ==    "10010001");
+  CHECK(to_string(*bmi.lookup(ni, ".png")) ==     "01000000");
+  CHECK(to_string(*bmi.lookup(ni, "nothing")) ==  "00000000");
+  CHECK(to_string(*bmi.lookup(not_ni, "index")) == "01101000");
+
+  // Search strings shorter than n resort to the exact lookup.
+  CHECK(to_string(*bmi.lookup(ni, "ph")) == "00010000");
+
+  // The postings yield candidates, which the query verifies subsequently.
+  CHECK(to_string(*bmi.lookup(ni, "abcabc")) == "00001000");
+
+  CHECK(to_string(*bmi.lookup(equal, "/index.html")) == "10000001");
+  CHECK(to_string(*bmi.lookup(equal, nil)) == "00100000");
+
+  std::vector<uint8_t> buf;
+  io::archive(buf, bmi);
+  io::unarchive(buf, bmi2);
+  CHECK(bmi == bmi2);
+  CHECK(to_string(*bmi2.lookup(ni, "index")) == "10010001");
+
+  ngram_bitmap_index<null_bitstream> bigrams{2};
+  REQUIRE(bigrams.push_back("foo"));
+  REQUIRE(bigrams.push_back("bar"));
+  CHECK(to_string(*bigrams.lookup(ni, "ar")) == "01");
+}
+
+TEST("pattern lookup on strings")
+{
+  dictionary_bitmap_index<null_bitstream> bmi;
+  REQUIRE(bmi.push_back("evil.com"));
+  REQUIRE(bmi.push_back("www.example.org"));
+  REQUIRE(bmi.push_back("very-evil.com"));
+  REQUIRE(bmi.push_back(nil));
+  REQUIRE(bmi.push_back("evil.com.example.org"));
+  REQUIRE(bmi.push_back("evil.com"));
+
+  auto rx = pattern{"evil.*\\.com"};
+  CHECK(to_string(*bmi.lookup(match, data{rx})) ==     "100001");
+  CHECK(to_string(*bmi.lookup(not_match, data{rx})) == "011110");
+  CHECK(to_string(*bmi.lookup(match, data{pattern{".*evil.*"}})) == "101011");
+  CHECK(to_string(*bmi.lookup(match, data{pattern{"nope"}})) == "000000");
+  CHECK(! bmi.lookup(equal, data{rx}));
+  CHECK(bmi.exact(match));
+
+  ngram_bitmap_index<null_bitstream> ngrams;
+  REQUIRE(ngrams.push_back("evil.com"));
+  REQUIRE(ngrams.push_back("good.com"));
+  CHECK(to_string(*ngrams.lookup(match, data{rx})) == "10");
+  CHECK(ngrams.exact(match));
+  CHECK(! ngrams.exact(ni));
+
+  // Without the dictionary, all rows are candidates for the query to check.
+  dictionary_bitmap_index<null_bitstream> migrated{1};
+  REQUIRE(migrated.push_back("evil.com"));
+  REQUIRE(migrated.push_back("good.com"));
+  CHECK(to_string(*migrated.lookup(match, data{rx})) == "11");
+  CHECK(! migrated.exact(match));
+}
@@ -0,0 +1,207 @@
+#include "framework/unit.h"
+
+#include <unistd.h>  // getpid
+#include "vast/bitmap_index.h"
+#include "vast/bitmap_index_store.h"
+
+using namespace vast;
+
+SUITE("bitmap index store")
+
+namespace {
+
+using store = bitmap_index_store<arithmetic_bitmap_index<ewah_bitstream, count>>;
+
+path make_test_dir()
+{
+  using std::to_string;
+  path p{"/tmp"};
+  p /= path{"vast-unit-test-bitmap-index-store"} / to_string(::getpid());
+  return p;
+}
+
+} // namespace <anonymous>
+
+TEST("checkpoint and log")
+{
+  auto dir = make_test_dir();
+  REQUIRE(mkdir(dir));
+  auto p = dir / "index";
+
+  store s{p};
+  REQUIRE(s.load(false));
+  for (count i = 1; i <= 3; ++i)
+    REQUIRE(s.push_back(i * 10, i));
+
+  // The first flush writes a checkpoint, without leaving a temporary file.
+  CHECK(s.checkpoint_due());
+  REQUIRE(s.flush());
+  CHECK(exists(p));
+  CHECK(! exists(s.log_path()));
+  auto tmp = p;
+  tmp += ".tmp";
+  CHECK(! exists(tmp));
+
+  // Subsequent flushes append to the log as long as it stays smaller than
+  // the checkpoint.
+  for (count i = 4; i <= 5; ++i)
+    REQUIRE(s.push_back(i * 10, i));
+  CHECK(! s.checkpoint_due());
+  REQUIRE(s.flush());
+  REQUIRE(s.push_back(count{60}, 6));
+  REQUIRE(s.flush());
+  CHECK(exists(s.log_path()));
+  CHECK(s.unflushed() == 0);
+
+  // Loading replays the log on top of the checkpoint.
+  store replayed{p};
+  REQUIRE(replayed.load(false));
+  CHECK(replayed.bitmap_index().size() == 7);
+  auto fifty = replayed.bitmap_index().lookup(equal, count{50});
+  REQUIRE(fifty);
+  CHECK(fifty->count() == 1);
+  CHECK(fifty->find_first() == 5);
+  auto above = replayed.bitmap_index().lookup(greater, count{20});
+  REQUIRE(above);
+  CHECK(above->count() == 4);
+  CHECK(above->find_first() == 3);
+
+  // A log which survives the checkpoint covering it must not apply twice.
+  auto log = load(s.log_path());
+  REQUIRE(log);
+  for (count i = 7; i <= 14; ++i)
+    REQUIRE(s.push_back(i * 10, i));
+  CHECK(s.checkpoint_due());
+  REQUIRE(s.flush());
+  CHECK(! exists(s.log_path()));
+  {
+    file f{s.log_path()};
+    REQUIRE(f.open(file::write_only));
+    REQUIRE(f.write(log->data(), log->size()));
+  }
+
+  store stale{p};
+  REQUIRE(stale.load(false));
+  CHECK(stale.bitmap_index().size() == 15);
+  CHECK(stale.bitmap_index().lookup(equal, count{50})->count() == 1);
+  CHECK(stale.bitmap_index().lookup(equal, count{140})->count() == 1);
+
+  // Lookups on a mapped checkpoint see the same values.
+  store mapped{p};
+  REQUIRE(mapped.load(true));
+  CHECK(mapped.mapped());
+  CHECK(mapped.bitmap_index().lookup(equal, count{140})->count() == 1);
+  REQUIRE(mapped.unmap());
+  CHECK(! mapped.mapped());
+  CHECK(mapped.bitmap_index().size() == 15);
+
+  CHECK(rm(dir.parent()));
+}
+
+TEST("read-only stores")
+{
+  auto dir = make_test_dir();
+  REQUIRE(mkdir(dir));
+  auto p = dir / "index";
+
+  // With many distinct values, the encoding has room to settle.
+  {
+    store s{p};
+    REQUIRE(s.load(false));
+    for (count i = 1; i <= 2000; ++i)
+      REQUIRE(s.push_back(i * 3, i));
+    REQUIRE(s.flush());
+  }
+
+  auto before = load(p);
+  REQUIRE(before);
+
+  // A mapped store which only answers lookups keeps its mapping and leaves
+  // the checkpoint as it is, rather than settling the encoding.
+  store mapped{p};
+  REQUIRE(mapped.load(true));
+  CHECK(mapped.bitmap_index().lookup(equal, count{300})->count() == 1);
+  CHECK(! mapped.modified());
+  CHECK(! mapped.optimize());
+  REQUIRE(mapped.flush());
+  CHECK(mapped.mapped());
+  CHECK(! exists(mapped.log_path()));
+  auto after = load(p);
+  REQUIRE(after);
+  CHECK(*before == *after);
+
+  // Once it appends, the store settles the encoding.
+  REQUIRE(mapped.unmap());
+  REQUIRE(mapped.push_back(count{42}, 2001));
+  CHECK(mapped.modified());
+  CHECK(mapped.optimize());
+  CHECK(mapped.checkpoint_due());
+
+  CHECK(rm(dir.parent()));
+}
+
+TEST("truncated log")
+{
+  auto dir = make_test_dir();
+  REQUIRE(mkdir(dir));
+  auto p = dir / "index";
+
+  store s{p};
+  REQUIRE(s.load(false));
+  for (count i = 1; i <= 3; ++i)
+    REQUIRE(s.push_back(i * 10, i));
+  REQUIRE(s.flush());
+  for (count i = 4; i <= 5; ++i)
+    REQUIRE(s.push_back(i * 10, i));
+  REQUIRE(s.flush());
+  auto intact = load(s.log_path());
+  REQUIRE(intact);
+  REQUIRE(s.push_back(count{60}, 6));
+  REQUIRE(s.flush());
+
+  // A crash in the middle of a flush leaves the last frame incomplete.
+  // Files open without truncation, so we write them from scratch.
+  auto log = load(s.log_path());
+  REQUIRE(log);
+  REQUIRE(log->size() > intact->size() + 1);
+  REQUIRE(rm(s.log_path()));
+  {
+    file f{s.log_path()};
+    REQUIRE(f.open(file::write_only));
+    REQUIRE(f.write(log->data(), log->size() - 1));
+  }
+
+  // Replaying stops after the last complete frame and cuts off the rest.
+  store replayed{p};
+  REQUIRE(replayed.load(false));
+  CHECK(replayed.bitmap_index().size() == 6);
+  CHECK(replayed.bitmap_index().lookup(equal, count{50})->find_first() == 5);
+  CHECK(replayed.bitmap_index().lookup(equal, count{60})->count() == 0);
+  auto truncated = load(s.log_path());
+  REQUIRE(truncated);
+  CHECK(*truncated == *intact);
+
+  // Subsequent flushes append after the last complete frame.
+  REQUIRE(replayed.push_back(count{70}, 6));
+  REQUIRE(replayed.flush());
+  store reloaded{p};
+  REQUIRE(reloaded.load(false));
+  CHECK(reloaded.bitmap_index().size() == 7);
+  CHECK(reloaded.bitmap_index().lookup(equal, count{70})->find_first() == 6);
+
+  // A corrupt frame counts as incomplete as well.
+  auto corrupt = *load(s.log_path());
+  corrupt.back() ^= 0xff;
+  REQUIRE(rm(s.log_path()));
+  {
+    file f{s.log_path()};
+    REQUIRE(f.open(file::write_only));
+    REQUIRE(f.write(corrupt.data(), corrupt.size()));
+  }
+
+  store checked{p};
+  REQUIRE(checked.load(false));
+  CHECK(checked.bitmap_index().size() == 6);
+
+  CHECK(rm(dir.parent()));
+}
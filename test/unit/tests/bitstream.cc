@@ -1,4 +1,7 @@
 #include "framework/unit.h"
+
+#include <random>
+#include <thread>
 #include "vast/convert.h"
 #include "vast/bitstream.h"
 #include "vast/io/serialization.h"
@@ -206,6 +209,7 @@ TEST("EWAH algorithm")
   REQUIRE(to_string(ewah3) == str);
 }
 
+#ifndef VAST_MONOMORPHIC_BITSTREAM
 TEST("polymorphic")
 {
   bitstream empty;
@@ -221,6 +225,7 @@ TEST("polymorphic")
   io::unarchive(buf, y);
   CHECK(y.size() == 3);
 }
+#endif
 
 TEST("bitwise operations (null)")
 {
@@ -744,6 +749,7 @@ TEST("block appending (EWAH)")
   CHECK(to_string(ebs) == str);
 }
 
+#ifndef VAST_MONOMORPHIC_BITSTREAM
 TEST("polymorphic iteration")
 {
   bitstream bs{null_bitstream{}};
@@ -770,6 +776,7 @@ TEST("polymorphic iteration")
   CHECK(*++i == 424);
   CHECK(++i == bs.end());
 }
+#endif
 
 TEST("sequence iteration (NULL)")
 {
@@ -828,3 +835,854 @@ TEST("pop-count (NULL)")
   ebs.append(47, false);
   CHECK(ebs.count() == 575);
 }
+
+TEST("bitwise operations with block kernels (EWAH)")
+{
+  using block_type = bitvector::block_type;
+
+  // Produces a mix of clean and dirty runs, including partial last blocks.
+  auto make = [](size_t seed, ewah_bitstream& ebs, null_bitstream& nbs)
+  {
+    std::mt19937_64 gen{seed};
+    for (auto i = 0; i < 40; ++i)
+    {
+      auto bits = gen() % 300 + 1;
+      switch (gen() % 3)
+      {
+        default:
+          {
+            auto bit = gen() % 2 == 0;
+            ebs.append(bits, bit);
+            nbs.append(bits, bit);
+          }
+          break;
+        case 2:
+          for (size_t j = 0; j < bits; ++j)
+          {
+            auto bit = gen() % 3 == 0;
+            ebs.push_back(bit);
+            nbs.push_back(bit);
+          }
+          break;
+      }
+    }
+  };
+
+  for (size_t i = 0; i < 20; ++i)
+  {
+    ewah_bitstream ex, ey;
+    null_bitstream nx, ny;
+    make(i, ex, nx);
+    make(i + 42, ey, ny);
+    CHECK(ex.count() == nx.count());
+
+    // NULL bitstreams do not zero-extend the shorter operand.
+    auto max = std::max(nx.size(), ny.size());
+    nx.append(max - nx.size(), false);
+    ny.append(max - ny.size(), false);
+
+    auto check = [&](ewah_bitstream const& e, null_bitstream const& n)
+    {
+      REQUIRE(e.size() == n.size());
+      CHECK(e.count() == n.count());
+      CHECK(std::equal(e.begin(), e.end(), n.begin(), n.end()));
+    };
+
+    check(ex & ey, nx & ny);
+    check(ex | ey, nx | ny);
+    check(ex ^ ey, nx ^ ny);
+    check(ex - ey, nx - ny);
+    check(ey - ex, ny - nx);
+
+    // The run-based implementation yields the same encoding as the generic
+    // one.
+    auto op = [](block_type x, block_type y) { return x ^ y; };
+    CHECK((ex ^ ey) == apply(ex, ey, true, true, op));
+  }
+}
+
+TEST("Roaring algorithm")
+{
+  roaring_bitstream rbs;
+  CHECK(rbs.empty());
+  CHECK(rbs.find_first() == roaring_bitstream::npos);
+
+  rbs.push_back(false);
+  rbs.push_back(true);
+  rbs.append(100, false);
+  rbs.append(42, true);
+  CHECK(rbs.size() == 144);
+  CHECK(rbs.count() == 43);
+  CHECK(! rbs[0]);
+  CHECK(rbs[1]);
+  CHECK(! rbs[101]);
+  CHECK(rbs[102]);
+  CHECK(rbs[143]);
+
+  // Cross a chunk boundary with a long run of 1s.
+  rbs.append(1 << 20, false);
+  rbs.append(200000, true);
+  rbs.append_block(0xf0f0, 16);
+  CHECK(rbs.size() == 144 + (1 << 20) + 200000 + 16);
+  CHECK(rbs.count() == 43 + 200000 + 8);
+  CHECK(rbs.back() == true);
+
+  CHECK(rbs.find_first() == 1);
+  CHECK(rbs.find_next(1) == 102);
+  CHECK(rbs.find_next(143) == 144 + (1 << 20));
+  CHECK(rbs.find_prev(144 + (1 << 20)) == 143);
+  CHECK(rbs.find_prev(102) == 1);
+  CHECK(rbs.find_prev(1) == roaring_bitstream::npos);
+  CHECK(rbs.find_last() == rbs.size() - 1);
+
+  auto last = rbs.size() - 1;
+  rbs.append(1000, false);
+  CHECK(rbs.find_next(last) == roaring_bitstream::npos);
+  rbs.trim();
+  CHECK(rbs.size() == last + 1);
+
+  auto i = rbs.begin();
+  CHECK(*i == 1);
+  CHECK(*++i == 102);
+  CHECK(std::distance(rbs.begin(), rbs.end()) == 43 + 200000 + 8);
+
+  auto comp = ~rbs;
+  CHECK(comp.size() == rbs.size());
+  CHECK(comp.count() == rbs.size() - rbs.count());
+  CHECK(comp.find_first() == 0);
+  CHECK((comp & rbs).count() == 0);
+  CHECK((comp | rbs).count() == rbs.size());
+  CHECK(~comp == rbs);
+
+  roaring_bitstream rbs2;
+  std::vector<uint8_t> buf;
+  io::archive(buf, rbs);
+  io::unarchive(buf, rbs2);
+  CHECK(rbs == rbs2);
+
+#ifndef VAST_MONOMORPHIC_BITSTREAM
+  bitstream x{rbs}, y;
+  buf.clear();
+  io::archive(buf, x);
+  io::unarchive(buf, y);
+  CHECK(x == y);
+  CHECK(y.count() == rbs.count());
+#endif
+}
+
+TEST("bitwise operations (Roaring)")
+{
+  // Produces sparse, dense, and clustered chunks.
+  auto make = [](size_t seed, roaring_bitstream& rbs, null_bitstream& nbs)
+  {
+    std::mt19937_64 gen{seed};
+    for (auto i = 0; i < 60; ++i)
+    {
+      auto bits = gen() % 20000 + 1;
+      switch (gen() % 4)
+      {
+        default:
+          {
+            auto bit = gen() % 2 == 0;
+            rbs.append(bits, bit);
+            nbs.append(bits, bit);
+          }
+          break;
+        case 2:
+          for (size_t j = 0; j < bits; ++j)
+          {
+            auto bit = gen() % 2 == 0;
+            rbs.push_back(bit);
+            nbs.push_back(bit);
+          }
+          break;
+        case 3:
+          for (size_t j = 0; j < bits; ++j)
+          {
+            auto bit = gen() % 64 == 0;
+            rbs.push_back(bit);
+            nbs.push_back(bit);
+          }
+          break;
+      }
+    }
+  };
+
+  for (size_t i = 0; i < 5; ++i)
+  {
+    roaring_bitstream rx, ry;
+    null_bitstream nx, ny;
+    make(i, rx, nx);
+    make(i + 42, ry, ny);
+    CHECK(rx.count() == nx.count());
+
+    auto check = [&](roaring_bitstream const& r, null_bitstream const& n)
+    {
+      REQUIRE(r.size() == n.size());
+      CHECK(r.count() == n.count());
+      CHECK(r.bits() == n.bits());
+    };
+
+    check(rx, nx);
+    check(~rx, ~nx);
+
+    // The generic algorithms work on the sequence representation.
+    ewah_bitstream ex, ey;
+    for (size_t j = 0; j < nx.size(); ++j)
+      ex.push_back(nx[j]);
+    for (size_t j = 0; j < ny.size(); ++j)
+      ey.push_back(ny[j]);
+    auto rnor = nor_(rx, ry);
+    auto enor = nor_(ex, ey);
+    CHECK(rnor.size() == enor.size());
+    CHECK(std::equal(rnor.begin(), rnor.end(), enor.begin(), enor.end()));
+
+    // NULL bitstreams do not zero-extend the shorter operand.
+    auto max = std::max(nx.size(), ny.size());
+    nx.append(max - nx.size(), false);
+    ny.append(max - ny.size(), false);
+
+    check(rx & ry, nx & ny);
+    check(rx | ry, nx | ny);
+    check(rx ^ ry, nx ^ ny);
+    check(rx - ry, nx - ny);
+    check(ry - rx, ny - nx);
+  }
+}
+
+TEST("n-ary bitwise operations")
+{
+  // Produces bitstreams of different length with long fills and literals.
+  auto make = [](size_t seed, ewah_bitstream& ebs, roaring_bitstream& rbs)
+  {
+    std::mt19937_64 gen{seed};
+    auto sequences = gen() % 50 + 1;
+    for (size_t i = 0; i < sequences; ++i)
+    {
+      auto bits = gen() % 1000 + 1;
+      if (gen() % 2 == 0)
+      {
+        auto bit = gen() % 4 != 0;
+        ebs.append(bits, bit);
+        rbs.append(bits, bit);
+      }
+      else
+      {
+        for (size_t j = 0; j < bits; ++j)
+        {
+          auto bit = gen() % 2 == 0;
+          ebs.push_back(bit);
+          rbs.push_back(bit);
+        }
+      }
+    }
+  };
+
+  for (size_t i = 0; i < 10; ++i)
+  {
+    std::vector<ewah_bitstream> ebs(i % 5 + 1);
+    std::vector<roaring_bitstream> rbs(ebs.size());
+    for (size_t j = 0; j < ebs.size(); ++j)
+      make(i * 10 + j, ebs[j], rbs[j]);
+
+    auto conj = ebs[0];
+    auto disj = ebs[0];
+    for (size_t j = 1; j < ebs.size(); ++j)
+    {
+      conj &= ebs[j];
+      disj |= ebs[j];
+    }
+
+    auto ea = and_all(ebs.begin(), ebs.end());
+    auto eo = or_all(ebs.begin(), ebs.end());
+    CHECK(ea == conj);
+    CHECK(eo == disj);
+
+    auto ra = and_all(rbs.begin(), rbs.end());
+    auto ro = or_all(rbs.begin(), rbs.end());
+    REQUIRE(ra.size() == conj.size());
+    REQUIRE(ro.size() == disj.size());
+    CHECK(std::equal(ra.begin(), ra.end(), conj.begin(), conj.end()));
+    CHECK(std::equal(ro.begin(), ro.end(), disj.begin(), disj.end()));
+
+    // Operands can also come as pointers.
+    std::vector<ewah_bitstream const*> ptrs;
+    for (auto& bs : ebs)
+      ptrs.push_back(&bs);
+    CHECK(and_all(ptrs.begin(), ptrs.end()) == conj);
+  }
+
+  // NULL bitstreams produce fills that extend beyond their size.
+  null_bitstream nx, ny, nz;
+  nx.append(100, true);
+  ny.append(130, true);
+  nz.append(70, false);
+  nz.append(60, true);
+  std::vector<null_bitstream> nbs{nx, ny, nz};
+  auto na = and_all(nbs.begin(), nbs.end());
+  REQUIRE(na.size() == 130);
+  CHECK(na.count() == 30);
+  CHECK(na.find_first() == 70);
+  auto no = or_all(nbs.begin(), nbs.end());
+  REQUIRE(no.size() == 130);
+  CHECK(no.count() == 130);
+
+#ifndef VAST_MONOMORPHIC_BITSTREAM
+  // Polymorphic bitstreams follow the semantics of the binary operators with
+  // respect to invalid bitstreams.
+  std::vector<bitstream> bs{bitstream{nx}, bitstream{ny}, bitstream{nz}};
+  CHECK(and_all(bs.begin(), bs.end()) == bitstream{na});
+  CHECK(or_all(bs.begin(), bs.end()) == bitstream{no});
+  bs.emplace_back();
+  CHECK(! and_all(bs.begin(), bs.end()));
+  CHECK(or_all(bs.begin(), bs.end()) == bitstream{no});
+  CHECK(! or_all(bs.end(), bs.end()));
+#endif
+}
+
+TEST("random access with skip index (EWAH)")
+{
+  // Produces enough markers to populate the skip index.
+  std::mt19937_64 gen{7};
+  ewah_bitstream ebs;
+  std::vector<bool> ref;
+  for (auto i = 0; i < 3000; ++i)
+  {
+    auto bits = gen() % 300 + 1;
+    if (gen() % 2 == 0)
+    {
+      auto bit = gen() % 3 == 0;
+      ebs.append(bits, bit);
+      ref.insert(ref.end(), bits, bit);
+    }
+    else
+    {
+      for (size_t j = 0; j < bits; ++j)
+      {
+        auto bit = gen() % 8 == 0;
+        ebs.push_back(bit);
+        ref.push_back(bit);
+      }
+    }
+  }
+
+  ebs.append(100000, false);
+  ref.insert(ref.end(), 100000, false);
+  ebs.push_back(true);
+  ref.push_back(true);
+
+  auto check = [&](ewah_bitstream const& bs)
+  {
+    REQUIRE(bs.size() == ref.size());
+    using size_type = ewah_bitstream::size_type;
+    size_type next = ewah_bitstream::npos;
+    std::vector<size_type> prev(ref.size());
+    size_type last = ewah_bitstream::npos;
+    for (size_t i = 0; i < ref.size(); ++i)
+    {
+      prev[i] = last;
+      if (ref[i])
+        last = i;
+    }
+
+    auto failures = 0;
+    for (auto i = ref.size(); i > 0; --i)
+    {
+      auto j = i - 1;
+      if (bs[j] != ref[j]
+          || bs.find_next(j) != next
+          || bs.find_prev(j) != prev[j])
+        ++failures;
+
+      if (ref[j])
+        next = j;
+    }
+
+    CHECK(failures == 0);
+    CHECK(bs.find_first() == next);
+    CHECK(bs.find_last() == ref.size() - 1);
+  };
+
+  check(ebs);
+
+  // The skip index survives serialization and bitwise operations.
+  ewah_bitstream copy;
+  std::vector<uint8_t> buf;
+  io::archive(buf, ebs);
+  io::unarchive(buf, copy);
+  check(copy);
+  check(ebs & ebs);
+
+  ebs.append(1000000, false);
+  ebs.trim();
+  check(ebs);
+}
+
+TEST("read-only view (EWAH)")
+{
+  std::mt19937_64 gen{42};
+  ewah_bitstream ebs;
+  ewah_bitstream other;
+  for (auto i = 0; i < 500; ++i)
+  {
+    auto bits = gen() % 500 + 1;
+    auto bit = gen() % 2 == 0;
+    if (gen() % 2 == 0)
+      ebs.append(bits, bit);
+    else
+      for (size_t j = 0; j < bits; ++j)
+        ebs.push_back(gen() % 4 == 0);
+    other.append(bits, ! bit);
+  }
+
+  auto check = [&](ewah_bitstream_view const& view)
+  {
+    REQUIRE(view.size() == ebs.size());
+    CHECK(view == ewah_bitstream_view{ebs});
+    CHECK(ewah_bitstream{view} == ebs);
+    CHECK(view.count() == ebs.count());
+    CHECK(std::equal(view.begin(), view.end(), ebs.begin(), ebs.end()));
+
+    auto rx = ewah_bitstream_view::sequence_range{view};
+    auto ry = ewah_bitstream::sequence_range{ebs};
+    auto ix = rx.begin();
+    auto iy = ry.begin();
+    for ( ; ix != rx.end() && iy != ry.end(); ++ix, ++iy)
+      if (ix->type != iy->type || ix->offset != iy->offset
+          || ix->data != iy->data || ix->length != iy->length)
+        break;
+    CHECK(ix == rx.end());
+    CHECK(iy == ry.end());
+
+    auto failures = 0;
+    for (size_t i = 0; i < ebs.size(); i += 97)
+      if (view[i] != ebs[i]
+          || view.find_next(i) != ebs.find_next(i)
+          || view.find_prev(i) != ebs.find_prev(i))
+        ++failures;
+    CHECK(failures == 0);
+    CHECK(view.find_first() == ebs.find_first());
+    CHECK(view.find_last() == ebs.find_last());
+
+    // Views serve as LHS of bitwise operations and as n-ary operands.
+    CHECK(and_(view, other) == and_(ebs, other));
+    CHECK(or_(view, other) == or_(ebs, other));
+    CHECK((view ^ view) == (ebs ^ ebs));
+    CHECK(~view == ~ebs);
+    std::vector<ewah_bitstream_view> views{view, ewah_bitstream_view{other}};
+    std::vector<ewah_bitstream> streams{ebs, other};
+    CHECK(and_all(views.begin(), views.end())
+          == and_all(streams.begin(), streams.end()));
+    CHECK(or_all(views.begin(), views.end())
+          == or_all(streams.begin(), streams.end()));
+  };
+
+  check(ewah_bitstream_view{ebs});
+
+  // Without zero-copy access, the view reads the blocks into own storage.
+  std::vector<uint8_t> buf;
+  io::archive(buf, ebs);
+  ewah_bitstream_view copied;
+  io::unarchive(buf, copied);
+  check(copied);
+
+  // With zero-copy access, the view points into the input buffer.
+  ewah_bitstream_view borrowed;
+  {
+    io::array_input_stream source{buf.data(), buf.size()};
+    binary_deserializer d{source, true};
+    d >> borrowed;
+  }
+  check(borrowed);
+  CHECK(borrowed == copied);
+
+  // A view has the serialization format of an EWAH bitstream.
+  std::vector<uint8_t> buf2;
+  io::archive(buf2, borrowed);
+  CHECK(buf2 == buf);
+
+  // Memory-mapped files hand out views straight into the mapping.
+  auto dir = path{"vast-unit-test"};
+  auto file = dir / "ewah-view";
+  REQUIRE(io::archive(file, ebs));
+  mapped_file mapping{file};
+  REQUIRE(mapping.open());
+  ewah_bitstream_view mapped;
+  REQUIRE(io::unarchive(mapping, mapped));
+  check(mapped);
+  CHECK(rm(dir));
+}
+
+TEST("bulk decoding")
+{
+  std::mt19937_64 gen{1337};
+  null_bitstream nbs;
+  ewah_bitstream ebs;
+  roaring_bitstream rbs;
+  for (auto i = 0; i < 300; ++i)
+  {
+    auto bits = gen() % 1000 + 1;
+    if (gen() % 2 == 0)
+    {
+      auto bit = gen() % 2 == 0;
+      nbs.append(bits, bit);
+      ebs.append(bits, bit);
+      rbs.append(bits, bit);
+    }
+    else
+    {
+      for (size_t j = 0; j < bits; ++j)
+      {
+        auto bit = gen() % 5 == 0;
+        nbs.push_back(bit);
+        ebs.push_back(bit);
+        rbs.push_back(bit);
+      }
+    }
+  }
+
+  std::vector<null_bitstream::size_type> ref(nbs.begin(), nbs.end());
+  REQUIRE(ref.size() > 10000);
+
+  // Decodes all positions at or after *first* in batches of size *n*.
+  auto decode_all = [](auto const& bs, size_t first, size_t n)
+  {
+    std::vector<null_bitstream::size_type> result;
+    std::vector<null_bitstream::size_type> buf(n);
+    while (true)
+    {
+      auto k = bs.decode(first, buf.data(), n);
+      result.insert(result.end(), buf.begin(), buf.begin() + k);
+      if (k < n)
+        break;
+      first = buf[k - 1] + 1;
+    }
+    return result;
+  };
+
+  auto check = [&](auto const& bs)
+  {
+    auto failures = 0;
+    for (auto n : {1, 7, 64, 1000, 100000})
+      if (decode_all(bs, 0, n) != ref)
+        ++failures;
+    for (size_t i = 0; i < bs.size(); i += 997)
+    {
+      auto first = std::lower_bound(ref.begin(), ref.end(), i);
+      std::vector<null_bitstream::size_type> tail(first, ref.end());
+      if (decode_all(bs, i, 333) != tail)
+        ++failures;
+    }
+    CHECK(failures == 0);
+    null_bitstream::size_type x;
+    CHECK(bs.decode(bs.size(), &x, 1) == 0);
+    CHECK(bs.decode(0, &x, 0) == 0);
+  };
+
+  check(nbs);
+  check(ebs);
+  check(rbs);
+#ifndef VAST_MONOMORPHIC_BITSTREAM
+  check(bitstream{ebs});
+#endif
+  check(ewah_bitstream_view{ebs});
+}
+
+TEST("count-only operations")
+{
+  std::mt19937_64 gen{4711};
+  auto make = [&](size_t runs, auto& a, auto& b, auto& c)
+  {
+    for (size_t i = 0; i < runs; ++i)
+    {
+      auto bits = gen() % 400 + 1;
+      if (gen() % 2 == 0)
+      {
+        auto bit = gen() % 2 == 0;
+        a.append(bits, bit);
+        b.append(bits, bit);
+        c.append(bits, bit);
+      }
+      else
+      {
+        for (size_t j = 0; j < bits; ++j)
+        {
+          auto bit = gen() % 3 == 0;
+          a.push_back(bit);
+          b.push_back(bit);
+          c.push_back(bit);
+        }
+      }
+    }
+  };
+
+  null_bitstream nx, ny;
+  ewah_bitstream ex, ey;
+  roaring_bitstream rx, ry;
+  make(300, nx, ex, rx);
+  make(200, ny, ey, ry);
+  REQUIRE(nx.size() != ny.size());
+
+  auto check = [&](auto const& x, auto const& y)
+  {
+    CHECK(and_count(x, y) == and_(x, y).count());
+    CHECK(and_count(y, x) == and_(y, x).count());
+    CHECK(or_count(x, y) == or_(x, y).count());
+    CHECK(andnot_count(x, y) == nand_(x, y).count());
+    CHECK(andnot_count(y, x) == nand_(y, x).count());
+    CHECK(and_count(x, x) == x.count());
+    CHECK(or_count(x, x) == x.count());
+    CHECK(andnot_count(x, x) == 0);
+    CHECK(intersects(x, y) == (and_(x, y).count() > 0));
+    CHECK(intersects(x, x) == (x.count() > 0));
+  };
+
+  check(nx, ny);
+  check(ex, ey);
+  check(rx, ry);
+
+  // Disjoint bitstreams do not intersect.
+  ewah_bitstream lo, hi;
+  lo.append(1000, true);
+  hi.append(1000, false);
+  hi.append(1000, true);
+  CHECK(! intersects(lo, hi));
+  CHECK(or_count(lo, hi) == 2000);
+  CHECK(andnot_count(hi, lo) == 1000);
+  CHECK(and_count(lo, ewah_bitstream{}) == 0);
+  CHECK(or_count(lo, ewah_bitstream{}) == 1000);
+
+  // Views and polymorphic bitstreams.
+  CHECK(and_count(ewah_bitstream_view{ex}, ey) == and_(ex, ey).count());
+  CHECK(andnot_count(ewah_bitstream_view{ex}, ewah_bitstream_view{ey})
+        == nand_(ex, ey).count());
+#ifndef VAST_MONOMORPHIC_BITSTREAM
+  auto x = bitstream{ex};
+  auto y = bitstream{ey};
+  CHECK(and_count(x, y) == (x & y).count());
+  CHECK(or_count(x, y) == (x | y).count());
+  CHECK(andnot_count(x, y) == (x - y).count());
+  CHECK(intersects(x, y) == ! (x & y).all_zero());
+  CHECK(and_count(x, bitstream{}) == 0);
+  CHECK(or_count(bitstream{}, y) == y.count());
+#endif
+}
+
+TEST("parallel bitwise operations (EWAH)")
+{
+  // Produces enough markers to populate the skip indexes, which determine
+  // the segments.
+  std::mt19937_64 gen{99};
+  auto make = [&](size_t runs)
+  {
+    ewah_bitstream bs;
+    for (size_t i = 0; i < runs; ++i)
+    {
+      auto bits = gen() % 500 + 1;
+      if (gen() % 2 == 0)
+        bs.append(bits, gen() % 2 == 0);
+      else
+        for (size_t j = 0; j < bits; ++j)
+          bs.push_back(gen() % 4 == 0);
+    }
+    return bs;
+  };
+
+  auto x = make(3000);
+  auto y = make(2500);
+  auto z = make(3000);
+  REQUIRE(x.size() != y.size());
+
+  ewah_bitstream::parallelize(0);
+  auto and_xy = and_(x, y);
+  auto or_xy = or_(x, y);
+  auto xor_xy = xor_(x, y);
+  auto nand_xy = nand_(x, y);
+  auto nand_yx = nand_(y, x);
+  auto and_xz = and_(x, z);
+  auto or_zx = or_(z, x);
+
+  // With a tiny threshold, all operations run in parallel. The results
+  // must have the same encoding as sequential ones.
+  ewah_bitstream::parallelize(64, 4);
+  CHECK(and_(x, y) == and_xy);
+  CHECK(or_(x, y) == or_xy);
+  CHECK(xor_(x, y) == xor_xy);
+  CHECK(nand_(x, y) == nand_xy);
+  CHECK(nand_(y, x) == nand_yx);
+  CHECK(and_(x, z) == and_xz);
+  CHECK(or_(z, x) == or_zx);
+  CHECK((x & y) == and_xy);
+  CHECK(std::equal(or_xy.begin(), or_xy.end(),
+                   (x | y).begin(), (x | y).end()));
+
+  // Fills spanning segment boundaries.
+  ewah_bitstream ones{100000, true};
+  ewah_bitstream::parallelize(0);
+  auto expected = and_(ones, x);
+  ewah_bitstream::parallelize(64, 3);
+  CHECK(and_(ones, x) == expected);
+  CHECK(or_(ones, ones) == ones);
+
+  // More concurrent operations than pool threads.
+  ewah_bitstream::parallelize(64, 2);
+  std::vector<ewah_bitstream> results(8);
+  std::vector<std::thread> callers;
+  for (auto& r : results)
+    callers.emplace_back([&] { r = or_(x, y); });
+
+  for (auto& t : callers)
+    t.join();
+
+  for (auto& r : results)
+    CHECK(r == or_xy);
+
+  ewah_bitstream::parallelize(ewah_bitstream::default_parallel_threshold);
+}
+
+TEST("bulk construction from sorted IDs")
+{
+  std::mt19937_64 gen{42};
+  std::vector<null_bitstream::size_type> ids;
+  std::vector<std::pair<size_t, size_t>> runs;
+  null_bitstream nbs;
+  ewah_bitstream ebs;
+  for (auto i = 0; i < 500; ++i)
+  {
+    auto gap = gen() % 3 == 0 ? gen() % 1000 : gen() % 10;
+    auto len = gen() % 2 == 0 ? gen() % 300 + 1 : 1;
+    nbs.append(gap, false);
+    ebs.append(gap, false);
+    runs.emplace_back(nbs.size(), nbs.size() + len);
+    for (size_t j = 0; j < len; ++j)
+    {
+      ids.push_back(nbs.size());
+      nbs.push_back(true);
+      ebs.push_back(true);
+    }
+  }
+  REQUIRE(ids.size() > 1000);
+
+  // Positions.
+  auto n = from_positions<null_bitstream>(ids.begin(), ids.end());
+  REQUIRE(n);
+  CHECK(*n == nbs);
+  auto e = from_positions<ewah_bitstream>(ids.begin(), ids.end());
+  REQUIRE(e);
+  CHECK(*e == ebs);
+  CHECK(std::equal(e->begin(), e->end(), ids.begin(), ids.end()));
+
+  // Runs.
+  n = from_runs<null_bitstream>(runs.begin(), runs.end());
+  REQUIRE(n);
+  CHECK(*n == nbs);
+  e = from_runs<ewah_bitstream>(runs.begin(), runs.end());
+  REQUIRE(e);
+  CHECK(*e == ebs);
+
+  // Explicit size.
+  e = from_positions<ewah_bitstream>(ids.begin(), ids.end(), nbs.size() + 100);
+  REQUIRE(e);
+  CHECK(e->size() == nbs.size() + 100);
+  CHECK(e->count() == ids.size());
+
+  // Unsorted input.
+  std::vector<size_t> bad{1, 5, 5};
+  CHECK(! from_positions<ewah_bitstream>(bad.begin(), bad.end()));
+  std::vector<std::pair<size_t, size_t>> overlap{{0, 10}, {9, 20}};
+  CHECK(! from_runs<ewah_bitstream>(overlap.begin(), overlap.end()));
+
+  // Continuing an existing bitstream.
+  ewah_bitstream prefix;
+  prefix.append(70, true);
+  bitstream_builder<ewah_bitstream> builder{prefix};
+  CHECK(! builder.add(69));
+  CHECK(builder.add(100));
+  CHECK(builder.add(200, 300));
+  auto cont = builder.finish();
+  ewah_bitstream expected;
+  expected.append(70, true);
+  expected.append(30, false);
+  expected.push_back(true);
+  expected.append(99, false);
+  expected.append(100, true);
+  CHECK(cont == expected);
+  CHECK(builder.size() == 0);
+
+  // Continuing within the last block of a bitstream, for every prefix
+  // length of the first few blocks.
+  for (size_t p = 1; p < 200; p += 7)
+  {
+    ewah_bitstream x;
+    x.append(p, false);
+    bitstream_builder<ewah_bitstream> b{x};
+    for (auto i : ids)
+      if (i >= p)
+      {
+        b.add(i);
+        x.append(i - x.size(), false);
+        x.push_back(true);
+      }
+    x.append(ebs.size() - x.size(), false);
+    CHECK(b.finish(ebs.size()) == x);
+  }
+
+  // The encoding takes markers beyond the maximum clean count and keeps the
+  // skip index intact.
+  auto huge = size_t{1} << 40;
+  std::vector<size_t> far{3, huge, huge + 1, huge + 1000};
+  e = from_positions<ewah_bitstream>(far.begin(), far.end(), huge + 2000);
+  REQUIRE(e);
+  ewah_bitstream sparse;
+  sparse.append(3, false);
+  sparse.push_back(true);
+  sparse.append(huge - 4, false);
+  sparse.append(2, true);
+  sparse.append(998, false);
+  sparse.push_back(true);
+  sparse.append(999, false);
+  CHECK(*e == sparse);
+  CHECK(e->find_next(4) == huge);
+  CHECK(e->find_prev(huge) == 3);
+  CHECK(std::equal(e->begin(), e->end(), far.begin(), far.end()));
+}
+
+#ifdef VAST_MONOMORPHIC_BITSTREAM
+TEST("monomorphic")
+{
+  default_bitstream dx, dy;
+  dx.append(100, true);
+  dx.append(100, false);
+  dy.append(150, false);
+  dy.append(50, true);
+  bitstream x{dx}, y{dy}, invalid;
+  REQUIRE(x);
+  CHECK(! invalid);
+  CHECK((x & y) == bitstream{dx & dy});
+  CHECK((x | y) == bitstream{dx | dy});
+  CHECK((x - y) == bitstream{dx - dy});
+  CHECK(! (x & invalid));
+  CHECK((invalid | y) == y);
+  CHECK(and_count(x, y) == (dx & dy).count());
+  CHECK(or_count(invalid, y) == dy.count());
+
+  std::vector<bitstream> xs{x, y};
+  CHECK(or_all(xs.begin(), xs.end()) == bitstream{dx | dy});
+  xs.push_back(invalid);
+  CHECK(! and_all(xs.begin(), xs.end()));
+
+  // The wire format equals the one of the polymorphic bitstream.
+  std::vector<uint8_t> mono, poly;
+  io::archive(mono, x, invalid);
+  std::unique_ptr<detail::bitstream_concept> concept{
+    new detail::bitstream_model<default_bitstream>{dx}};
+  io::archive(poly, true, concept, false);
+  CHECK(mono == poly);
+
+  bitstream z;
+  io::unarchive(mono, z, invalid);
+  REQUIRE(z);
+  CHECK(z == x);
+  CHECK(! invalid);
+}
+#endif
@@ -20,8 +20,13 @@ TEST("chunk")
     REQUIRE(w.write(es.back()));
   }
 
+  // The meta data describes the chunk as of the last flush.
+  CHECK(! chk.meta().schema.find_type("i"));
+  CHECK(chk.meta().first == time_duration{});
   w.flush();
   CHECK(chk.events() == 1e3);
+  CHECK(chk.meta().schema.find_type("i"));
+  CHECK(chk.meta().first == es.front().timestamp());
 
   chunk::reader r{chk};
   for (auto i = 0; i < 1e3; ++i)
@@ -96,3 +101,42 @@ TEST("chunk event extraction")
   REQUIRE(e);
   CHECK(*get<integer>(*e) == 2000);
 }
+
+TEST("chunk event extraction with sparse IDs")
+{
+  auto t = type::integer{};
+  REQUIRE(t.name("test"));
+
+  // Spread the IDs such that the reader decodes them in several batches.
+  chunk chk;
+  chunk::writer w{chk};
+  for (auto i = 0; i < 3000; ++i)
+  {
+    auto e = event::make(integer{i}, t);
+    e.id(10 + 3 * i);
+    REQUIRE(w.write(e));
+  }
+
+  w.flush();
+  REQUIRE(chk.events() == 3000);
+
+  chunk::reader r{chk};
+  for (auto i = 0; i < 3000; ++i)
+  {
+    auto e = r.read();
+    REQUIRE(e);
+    CHECK(e->id() == event_id(10 + 3 * i));
+  }
+
+  CHECK(r.read().empty());
+
+  auto e = r.read(10 + 3 * 2500);
+  REQUIRE(e);
+  CHECK(*get<integer>(*e) == 2500);
+
+  e = r.read(10 + 3 * 1024);
+  REQUIRE(e);
+  CHECK(*get<integer>(*e) == 1024);
+
+  CHECK(! r.read(11 + 3 * 1024));
+}
@@ -397,6 +397,20 @@ TEST("predicate evaluation")
   rhs = real{4.2};
   CHECK(! data::evaluate(lhs, equal, rhs));
   CHECK(data::evaluate(lhs, not_equal, rhs));
+
+  rhs = table{{"foo", 1u}, {"bar", 2u}};
+  CHECK(data::evaluate(rhs, ni, "foo"));
+  CHECK(! data::evaluate(rhs, ni, 1u));
+  CHECK(data::evaluate(rhs, ni, table{{"bar", 2u}}));
+  CHECK(! data::evaluate(rhs, ni, table{{"bar", 1u}}));
+  CHECK(data::evaluate(rhs, ni, table{{nil, 1u}}));
+
+  rhs = *to<data>("{10.0.0.3, 10.0.0.1, 10.0.0.3, 10.0.0.2}");
+  REQUIRE(is<set>(rhs));
+  CHECK(get<set>(rhs)->size() == 3);
+  CHECK(to_string(rhs) == "{10.0.0.1, 10.0.0.2, 10.0.0.3}");
+  CHECK(data::evaluate(lhs, in, rhs));
+  CHECK(! data::evaluate(*to<data>("10.0.0.4"), in, rhs));
 }
 
 TEST("serialization")
@@ -61,6 +61,8 @@ TEST("parser tests")
   CHECK(to<expression>("\"the\" !in :string"));
   CHECK(to<expression>(":string ni \"sea\""));
   CHECK(to<expression>(":string !ni \"shore\""));
+  CHECK(to<expression>(":addr in {10.0.0.1, 10.0.0.2, 192.168.0.1}"));
+  CHECK(to<expression>("! :string in {\"foo\", \"bar\"}"));
 
   // Groups
   CHECK(to<expression>("(:real > 4.2)"));
@@ -201,3 +203,62 @@ TEST("event evaluation")
   REQUIRE(ast);
   CHECK(! visit(expr::schema_resolver{*sch}, *ast));
 }
+
+TEST("connection resolution")
+{
+  std::string str =
+    "type conn_id = record"
+    "{"
+    "  orig_h: addr, orig_p: port, resp_h: addr, resp_p: port"
+    "} &connection "
+    "type conn = record { id: conn_id, service: string }";
+
+  auto sch = to<schema>(str);
+  REQUIRE(sch);
+
+  auto ast = to<expression>(
+      "id.orig_h == 10.0.0.1 && id.resp_h == 10.0.0.2 "
+      "&& id.resp_p == 80/tcp && service == \"http\"");
+  REQUIRE(ast);
+
+  auto routed = visit(expr::connection_resolver{*sch}, *ast);
+  auto c = get<conjunction>(routed);
+  REQUIRE(c);
+  REQUIRE(c->size() == 2);
+  auto p = get<predicate>(c->at(0));
+  REQUIRE(p);
+  auto e = get<schema_extractor>(p->lhs);
+  REQUIRE(e);
+  CHECK(e->key == key{"id"});
+  auto r = get<record>(*get<data>(p->rhs));
+  REQUIRE(r);
+  REQUIRE(r->size() == 4);
+  CHECK(is<none>((*r)[1]));
+  CHECK((*r)[3] == port{80, port::tcp});
+
+  // Without the responder port there's no tuple to route.
+  ast = to<expression>("id.orig_h == 10.0.0.1 && id.resp_h == 10.0.0.2");
+  REQUIRE(ast);
+  CHECK(visit(expr::connection_resolver{*sch}, *ast) == *ast);
+
+  // Without the attribute the predicates stay as they are.
+  str = "type conn = record { id: record { orig_h: addr, orig_p: port, "
+        "resp_h: addr, resp_p: port }, service: string }";
+  sch = to<schema>(str);
+  REQUIRE(sch);
+  ast = to<expression>(
+      "id.orig_h == 10.0.0.1 && id.resp_h == 10.0.0.2 && id.resp_p == 80/tcp");
+  REQUIRE(ast);
+  CHECK(visit(expr::connection_resolver{*sch}, *ast) == *ast);
+
+  // If only some records have the attribute, partitions fall back to the
+  // field predicates for the others, so the tuple gets routed nonetheless.
+  str = "type conn_id = record { orig_h: addr, orig_p: port, resp_h: addr, "
+        "resp_p: port } &connection "
+        "type conn = record { id: conn_id } "
+        "type flow = record { id: record { orig_h: addr, orig_p: port, "
+        "resp_h: addr, resp_p: port } }";
+  sch = to<schema>(str);
+  REQUIRE(sch);
+  CHECK(is<predicate>(visit(expr::connection_resolver{*sch}, *ast)));
+}
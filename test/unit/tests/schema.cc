@@ -90,6 +90,47 @@ TEST("merging")
   CHECK(merged->find_type("inner"));
 }
 
+TEST("attributes")
+{
+  std::string str =
+    "type uri = string &ngram\n"
+    "type agent = string &ngram=4\n"
+    "type payload = string &skip\n"
+    "type answers = vector<string> &membership\n";
+
+  auto lval = str.begin();
+  auto sch = parse<schema>(lval, str.end());
+  REQUIRE(sch);
+
+  auto uri = sch->find_type("uri");
+  REQUIRE(uri);
+  auto a = uri->find_attribute(type::attribute::ngram);
+  REQUIRE(a);
+  CHECK(a->value.empty());
+
+  auto agent = sch->find_type("agent");
+  REQUIRE(agent);
+  a = agent->find_attribute(type::attribute::ngram);
+  REQUIRE(a);
+  CHECK(a->value == "4");
+
+  auto payload = sch->find_type("payload");
+  REQUIRE(payload);
+  CHECK(payload->find_attribute(type::attribute::skip));
+  CHECK(! payload->find_attribute(type::attribute::ngram));
+
+  auto answers = sch->find_type("answers");
+  REQUIRE(answers);
+  CHECK(answers->find_attribute(type::attribute::membership));
+
+  // Printed attributes parse again.
+  auto printed = to_string(*sch);
+  lval = printed.begin();
+  auto sch2 = parse<schema>(lval, printed.end());
+  REQUIRE(sch2);
+  CHECK(to_string(*sch2) == printed);
+}
+
 TEST("serialization")
 {
   schema sch, sch2;